@@ -0,0 +1,48 @@
+import { NextResponse } from 'next/server'
+import { exec } from 'child_process'
+import { promisify } from 'util'
+
+const execAsync = promisify(exec)
+
+function intParam(value: string | null, fallback: number) {
+  const parsed = parseInt(value || '', 10)
+  return Number.isFinite(parsed) ? parsed : fallback
+}
+
+// Alerts logged by the resident monitor's anomaly detectors
+export async function GET(request: Request) {
+  const { searchParams } = new URL(request.url)
+  // since is epoch seconds, or seconds relative to now when negative
+  const since = intParam(searchParams.get('since'), -86400)
+  const limit = Math.min(Math.max(intParam(searchParams.get('limit'), 100), 1), 1000)
+
+  try {
+    // Send option 18 (Alerts) followed by its options line
+    const { stdout, stderr } = await execAsync(`printf "18\\nsince=${since}&limit=${limit}\\n" | ./bin/vmd`, {
+      maxBuffer: 4 * 1024 * 1024,
+      timeout: 2000,
+      shell: '/bin/bash'
+    })
+
+    if (stderr) {
+      console.error('VMD Error:', stderr)
+      return NextResponse.json({ error: 'VMD process error' }, { status: 500 })
+    }
+
+    // Find JSON content between the outermost curly braces, ignoring menu text
+    const jsonMatch = stdout.match(/\{[\s\S]*\}/);
+    if (!jsonMatch) {
+      return NextResponse.json({ error: 'No JSON data found in output', rawOutput: stdout.slice(0, 200) }, { status: 500 })
+    }
+    return NextResponse.json(JSON.parse(jsonMatch[0]))
+  } catch (error) {
+    console.error('Alerts API Error:', error)
+    return NextResponse.json(
+      {
+        error: 'Failed to fetch alerts',
+        details: error instanceof Error ? error.message : 'Unknown error'
+      },
+      { status: 500 }
+    )
+  }
+}
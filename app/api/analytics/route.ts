@@ -1,6 +1,7 @@
 import { NextResponse } from 'next/server'
 import { exec } from 'child_process'
 import { promisify } from 'util'
+import { toAnalyticsFields } from '@/app/types/analytics.generated'
 
 const execAsync = promisify(exec)
 
@@ -21,8 +22,9 @@ export async function GET() {
     console.log('Raw output:', stdout) // For debugging
 
     try {
-      // Find JSON content between curly braces
-      const jsonMatch = stdout.match(/\{[\s\S]*?\}/);
+      // Find JSON content between the outermost curly braces (it contains
+      // the nested "self" section)
+      const jsonMatch = stdout.match(/\{[\s\S]*\}/);
       if (!jsonMatch) {
         throw new Error('No JSON data found in output');
       }
@@ -32,15 +34,11 @@ export async function GET() {
       const analyticsData = JSON.parse(cleanJson);
       
       return NextResponse.json({
-        fragmentation: analyticsData.fragmentation_index || 0,
-        pageFaultRate: analyticsData.fault_rate || 0,
-        pressureScore: analyticsData.pressure_score || 0,
-        swapUsagePercent: analyticsData.swap_usage_percent || 0,
-        majorFaults: analyticsData.major_faults || 0,
-        minorFaults: analyticsData.minor_faults || 0,
-        memory_usage: analyticsData.memory_usage || 0,  // Already in bytes
-        total_memory: analyticsData.total_memory || 0,
-        free_memory: analyticsData.free_memory || 0
+        ...toAnalyticsFields(analyticsData),
+        vmstat: analyticsData.vmstat || {},
+        faultCost: analyticsData.fault_cost || { available: false },
+        numa: analyticsData.numa || { nodes: [], imbalance: 0 },
+        self: analyticsData.self || {}
       })
     } catch (e) {
       console.error('Failed to parse analytics:', e)
@@ -0,0 +1,54 @@
+import { NextResponse } from 'next/server'
+import { exec } from 'child_process'
+import { promisify } from 'util'
+
+const execAsync = promisify(exec)
+
+// Allocator free lists and trimmable memory of ?pid=N, which must run with
+// bin/libvmdmalloc.so preloaded; without pid vmd reports its own heap
+export async function GET(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const pid = parseInt(searchParams.get('pid') || '', 10)
+  const options = pid > 0 ? `pid=${pid}` : ''
+
+  try {
+    // Send option 19 (Heap fragmentation) followed by its options line
+    const { stdout, stderr } = await execAsync(`printf "19\\n${options}\\n" | ./bin/vmd`, {
+      maxBuffer: 1024 * 1024,
+      timeout: 2000,
+      shell: '/bin/bash'
+    })
+
+    if (stderr) {
+      console.error('VMD Error:', stderr)
+      return NextResponse.json({ error: 'VMD process error' }, { status: 500 })
+    }
+
+    try {
+      // Find JSON content between the outermost curly braces, ignoring menu text
+      const jsonMatch = stdout.match(/\{[\s\S]*\}/);
+      if (!jsonMatch) {
+        throw new Error('No JSON data found in output');
+      }
+
+      const data = JSON.parse(jsonMatch[0])
+      return NextResponse.json(data, { status: data.error ? 404 : 200 })
+    } catch (e) {
+      console.error('Failed to parse heap fragmentation:', e)
+      return NextResponse.json({
+        error: 'Invalid heap fragmentation data',
+        details: e instanceof Error ? e.message : 'Unknown error',
+        rawOutput: stdout.slice(0, 200)
+      }, { status: 500 })
+    }
+  } catch (error) {
+    console.error('Heap Fragmentation API Error:', error)
+    return NextResponse.json(
+      {
+        error: 'Failed to fetch heap fragmentation',
+        details: error instanceof Error ? error.message : 'Unknown error'
+      },
+      { status: 500 }
+    )
+  }
+}
@@ -1,14 +1,20 @@
 import { NextResponse } from 'next/server'
 import { exec } from 'child_process'
 import { promisify } from 'util'
+import { regionQueryOptions } from '@/app/utils/regionQuery'
 
 const execAsync = promisify(exec)
 
-export async function GET() {
+// ?start=&end=&region=&stride=&cursor=&limit=&pid= select an address range;
+// next_cursor in the response fetches the rest
+export async function GET(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const options = regionQueryOptions(searchParams)
+
   try {
-    // Send option 7 (Memory hierarchy) and wait for output
-    const { stdout, stderr } = await execAsync('printf "7\n" | ./bin/vmd', {
-      maxBuffer: 1024 * 1024,
+    // Send option 7 (Memory hierarchy) followed by its options line
+    const { stdout, stderr } = await execAsync(`printf "7\\n${options}\\n" | ./bin/vmd`, {
+      maxBuffer: 16 * 1024 * 1024,
       timeout: 2000,
       shell: '/bin/bash'
     })
@@ -52,4 +58,39 @@ export async function GET() {
       { status: 500 }
     )
   }
-} 
\ No newline at end of file
+} 
+// Runs the cache and memory probe (option 13); results are also cached so
+// later GETs include them
+export async function POST(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const maxMb = Math.min(Math.max(parseInt(searchParams.get('max_mb') || '0', 10) || 0, 0), 8192)
+  const threads = Math.min(Math.max(parseInt(searchParams.get('threads') || '0', 10) || 0, 0), 16)
+
+  try {
+    const { stdout, stderr } = await execAsync(`printf "13\\nmax_mb=${maxMb}&threads=${threads}\\n" | ./bin/vmd`, {
+      maxBuffer: 1024 * 1024,
+      timeout: 120000,
+      shell: '/bin/bash'
+    })
+
+    if (stderr) {
+      console.error('VMD Error:', stderr)
+      return NextResponse.json({ error: 'VMD process error' }, { status: 500 })
+    }
+
+    const jsonMatch = stdout.match(/\{[\s\S]*\}/);
+    if (!jsonMatch) {
+      return NextResponse.json({ error: 'No JSON data found in output', rawOutput: stdout.slice(0, 200) }, { status: 500 })
+    }
+    return NextResponse.json(JSON.parse(jsonMatch[0]))
+  } catch (error) {
+    console.error('Cache Probe API Error:', error)
+    return NextResponse.json(
+      {
+        error: 'Failed to run cache probe',
+        details: error instanceof Error ? error.message : 'Unknown error'
+      },
+      { status: 500 }
+    )
+  }
+}
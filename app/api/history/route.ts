@@ -0,0 +1,66 @@
+import { NextResponse } from 'next/server'
+import { exec } from 'child_process'
+import { promisify } from 'util'
+
+const execAsync = promisify(exec)
+
+const SERIES_PATTERN = /^[A-Za-z0-9._:\/-]{0,63}$/
+
+function intParam(value: string | null, fallback: number) {
+  const parsed = parseInt(value || '', 10)
+  return Number.isFinite(parsed) ? parsed : fallback
+}
+
+export async function GET(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const series = searchParams.get('series') || ''
+  if (!SERIES_PATTERN.test(series)) {
+    return NextResponse.json({ error: 'Invalid series name' }, { status: 400 })
+  }
+  // from/to are epoch seconds, or seconds relative to now when negative
+  const from = intParam(searchParams.get('from'), -3600)
+  const to = intParam(searchParams.get('to'), 0) || Math.floor(Date.now() / 1000)
+  const step = Math.max(intParam(searchParams.get('step'), 0), 0)
+  const limit = Math.min(Math.max(intParam(searchParams.get('limit'), 1000), 1), 100000)
+
+  try {
+    // Send option 15 (History query) followed by its options line
+    const params = `series=${series}&from=${from}&to=${to}&step=${step}&limit=${limit}`
+    const { stdout, stderr } = await execAsync(`printf "15\\n${params}\\n" | ./bin/vmd`, {
+      maxBuffer: 16 * 1024 * 1024,
+      timeout: 5000,
+      shell: '/bin/bash'
+    })
+
+    if (stderr) {
+      console.error('VMD Error:', stderr)
+      return NextResponse.json({ error: 'VMD process error' }, { status: 500 })
+    }
+
+    try {
+      // Find JSON content between the outermost curly braces, ignoring menu text
+      const jsonMatch = stdout.match(/\{[\s\S]*\}/);
+      if (!jsonMatch) {
+        throw new Error('No JSON data found in output');
+      }
+
+      return NextResponse.json(JSON.parse(jsonMatch[0]))
+    } catch (e) {
+      console.error('Failed to parse history data:', e)
+      return NextResponse.json({
+        error: 'Invalid history data',
+        details: e instanceof Error ? e.message : 'Unknown error',
+        rawOutput: stdout.slice(0, 200)
+      }, { status: 500 })
+    }
+  } catch (error) {
+    console.error('History API Error:', error)
+    return NextResponse.json(
+      {
+        error: 'Failed to fetch history',
+        details: error instanceof Error ? error.message : 'Unknown error'
+      },
+      { status: 500 }
+    )
+  }
+}
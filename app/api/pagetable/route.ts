@@ -1,14 +1,20 @@
 import { NextResponse } from 'next/server'
 import { exec } from 'child_process'
 import { promisify } from 'util'
+import { regionQueryOptions } from '@/app/utils/regionQuery'
 
 const execAsync = promisify(exec)
 
-export async function GET() {
+// ?start=&end=&region=&stride=&cursor=&limit=&pid= select an address range;
+// next_cursor in the response fetches the rest
+export async function GET(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const options = regionQueryOptions(searchParams)
+
   try {
-    // Send option 6 (Page table analysis) and wait for output
-    const { stdout, stderr } = await execAsync('printf "6\n" | ./bin/vmd', {
-      maxBuffer: 1024 * 1024,
+    // Send option 6 (Page table analysis) followed by its options line
+    const { stdout, stderr } = await execAsync(`printf "6\\n${options}\\n" | ./bin/vmd`, {
+      maxBuffer: 16 * 1024 * 1024,
       timeout: 2000,
       shell: '/bin/bash'
     })
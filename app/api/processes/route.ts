@@ -0,0 +1,53 @@
+import { NextResponse } from 'next/server'
+import { exec } from 'child_process'
+import { promisify } from 'util'
+
+const execAsync = promisify(exec)
+
+const SORT_KEYS = ['rss', 'pss', 'swap', 'growth', 'faults']
+
+export async function GET(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const sort = SORT_KEYS.includes(searchParams.get('sort') || '') ? searchParams.get('sort') : 'rss'
+  const limit = Math.min(Math.max(parseInt(searchParams.get('limit') || '20', 10) || 20, 1), 500)
+
+  try {
+    // Send option 9 (Process ranking) followed by its options line
+    const { stdout, stderr } = await execAsync(`printf "9\\nsort=${sort}&limit=${limit}\\n" | ./bin/vmd`, {
+      maxBuffer: 1024 * 1024,
+      timeout: 2000,
+      shell: '/bin/bash'
+    })
+
+    if (stderr) {
+      console.error('VMD Error:', stderr)
+      return NextResponse.json({ error: 'VMD process error' }, { status: 500 })
+    }
+
+    try {
+      // Find JSON content between the outermost curly braces, ignoring menu text
+      const jsonMatch = stdout.match(/\{[\s\S]*\}/);
+      if (!jsonMatch) {
+        throw new Error('No JSON data found in output');
+      }
+
+      return NextResponse.json(JSON.parse(jsonMatch[0]))
+    } catch (e) {
+      console.error('Failed to parse process ranking:', e)
+      return NextResponse.json({
+        error: 'Invalid process ranking data',
+        details: e instanceof Error ? e.message : 'Unknown error',
+        rawOutput: stdout.slice(0, 200)
+      }, { status: 500 })
+    }
+  } catch (error) {
+    console.error('Process Ranking API Error:', error)
+    return NextResponse.json(
+      {
+        error: 'Failed to fetch process ranking',
+        details: error instanceof Error ? error.message : 'Unknown error'
+      },
+      { status: 500 }
+    )
+  }
+}
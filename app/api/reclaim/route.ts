@@ -0,0 +1,92 @@
+import { NextResponse } from 'next/server'
+import { exec } from 'child_process'
+import { promisify } from 'util'
+
+const execAsync = promisify(exec)
+
+const MODES = ['dry_run', 'cold', 'pageout']
+
+function intParam(searchParams: URLSearchParams, name: string, fallback: number, max: number) {
+  const value = parseInt(searchParams.get(name) || '', 10)
+  return Math.min(Math.max(Number.isNaN(value) ? fallback : value, 0), max)
+}
+
+function floatParam(searchParams: URLSearchParams, name: string, fallback: number, max: number) {
+  const value = parseFloat(searchParams.get(name) || '')
+  return Math.min(Math.max(Number.isNaN(value) ? fallback : value, 0), max)
+}
+
+async function runReclaim(searchParams: URLSearchParams, mode: string, clearRefs: boolean) {
+  const pid = parseInt(searchParams.get('pid') || '', 10)
+  if (!(pid > 0)) {
+    return NextResponse.json({ error: 'pid is required' }, { status: 400 })
+  }
+  const idle = intParam(searchParams, 'idle_s', 10, 300)
+  const settle = intParam(searchParams, 'settle_s', 10, 300)
+  const budget = intParam(searchParams, 'budget_mb', 256, 1 << 20)
+  const rate = intParam(searchParams, 'rate_mb', 0, 1 << 20)
+  const minIdle = floatParam(searchParams, 'min_idle', 0.9, 1)
+  const maxPsi = floatParam(searchParams, 'max_psi', 10, 100)
+  const options = `pid=${pid}&mode=${mode}&idle_s=${idle}&settle_s=${settle}&budget_mb=${budget}` +
+    `&rate_mb=${rate}&min_idle=${minIdle}&max_psi=${maxPsi}&clear_refs=${clearRefs ? 1 : 0}`
+  // Idle and settle windows plus one second per rate-limited batch
+  const timeout = (idle + settle + (rate > 0 ? Math.ceil(budget / rate) : 0) + 10) * 1000
+
+  try {
+    // Send option 20 (Reclaim advisor) followed by its options line
+    const { stdout, stderr } = await execAsync(`printf "20\\n${options}\\n" | ./bin/vmd`, {
+      maxBuffer: 4 * 1024 * 1024,
+      timeout,
+      shell: '/bin/bash'
+    })
+    if (stderr) {
+      console.error('VMD Error:', stderr)
+      return NextResponse.json({ error: 'VMD process error' }, { status: 500 })
+    }
+
+    // Find JSON content between the outermost curly braces, ignoring menu text
+    const jsonMatch = stdout.match(/\{[\s\S]*\}/);
+    if (!jsonMatch) {
+      throw new Error('No JSON data found in output')
+    }
+    const data = JSON.parse(jsonMatch[0])
+    return NextResponse.json(data, { status: data.error ? 400 : 200 })
+  } catch (error) {
+    console.error('Reclaim API Error:', error)
+    return NextResponse.json(
+      {
+        error: 'Failed to run reclaim advisor',
+        details: error instanceof Error ? error.message : 'Unknown error'
+      },
+      { status: 500 }
+    )
+  }
+}
+
+// Reports the regions of ?pid=N that look idle in a snapshot of their
+// referenced bits, without writing anything to the target
+export async function GET(request: Request) {
+  const { searchParams } = new URL(request.url)
+  return runReclaim(searchParams, 'dry_run', false)
+}
+
+// Applies ?mode=cold|pageout to the idle regions of ?pid=N and measures the
+// effect; dry_run is accepted for symmetry. Measuring idleness clears the
+// target's referenced and soft-dirty bits, so it needs ?clear_refs=1, which
+// cold and pageout require. Anything that changes the target is refused
+// unless the server runs with VMD_ALLOW_RECLAIM=1
+export async function POST(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const mode = searchParams.get('mode') || ''
+  if (!MODES.includes(mode)) {
+    return NextResponse.json({ error: 'mode must be dry_run, cold or pageout' }, { status: 400 })
+  }
+  const clearRefs = searchParams.get('clear_refs') === '1'
+  if ((mode !== 'dry_run' || clearRefs) && process.env.VMD_ALLOW_RECLAIM !== '1') {
+    return NextResponse.json(
+      { error: 'reclaim and clear_refs are disabled; start the server with VMD_ALLOW_RECLAIM=1' },
+      { status: 403 }
+    )
+  }
+  return runReclaim(searchParams, mode, clearRefs)
+}
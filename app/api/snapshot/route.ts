@@ -0,0 +1,86 @@
+import { NextResponse } from 'next/server'
+import { exec } from 'child_process'
+import { promisify } from 'util'
+
+const execAsync = promisify(exec)
+
+const NAME_PATTERN = /^[A-Za-z0-9_-][A-Za-z0-9._-]{0,62}$/
+const SORT_KEYS = ['rss', 'pss', 'swap']
+
+async function runVmd(input: string, timeout: number) {
+  const { stdout, stderr } = await execAsync(`printf "${input}" | ./bin/vmd`, {
+    maxBuffer: 16 * 1024 * 1024,
+    timeout,
+    shell: '/bin/bash'
+  })
+  if (stderr) {
+    console.error('VMD Error:', stderr)
+    throw new Error('VMD process error')
+  }
+  // Find JSON content between the outermost curly braces, ignoring menu text
+  const jsonMatch = stdout.match(/\{[\s\S]*\}/);
+  if (!jsonMatch) {
+    throw new Error('No JSON data found in output')
+  }
+  return JSON.parse(jsonMatch[0])
+}
+
+// Diffs snapshot "from" against "to", or against the live process when
+// "to" is omitted; without "from" the saved snapshots are listed
+export async function GET(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const from = searchParams.get('from') || ''
+  const to = searchParams.get('to') || ''
+  const sort = searchParams.get('sort') || 'rss'
+  const limit = Math.min(Math.max(parseInt(searchParams.get('limit') || '50', 10) || 50, 1), 10000)
+
+  if ((from && !NAME_PATTERN.test(from)) || (to && !NAME_PATTERN.test(to))) {
+    return NextResponse.json({ error: 'Invalid snapshot name' }, { status: 400 })
+  }
+  if (!SORT_KEYS.includes(sort)) {
+    return NextResponse.json({ error: 'Invalid sort key' }, { status: 400 })
+  }
+
+  try {
+    // Send option 17 (Snapshot diff) followed by its options line
+    const options = `from=${from}&to=${to}&sort=${sort}&limit=${limit}`
+    return NextResponse.json(await runVmd(`17\\n${options}\\n`, 10000))
+  } catch (error) {
+    console.error('Snapshot API Error:', error)
+    return NextResponse.json(
+      {
+        error: 'Failed to diff snapshots',
+        details: error instanceof Error ? error.message : 'Unknown error'
+      },
+      { status: 500 }
+    )
+  }
+}
+
+// Captures and saves a snapshot of ?pid=N, named ?name= or pid-time
+export async function POST(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const pid = parseInt(searchParams.get('pid') || '', 10)
+  const name = searchParams.get('name') || ''
+
+  if (!(pid > 0)) {
+    return NextResponse.json({ error: 'pid is required' }, { status: 400 })
+  }
+  if (name && !NAME_PATTERN.test(name)) {
+    return NextResponse.json({ error: 'Invalid snapshot name' }, { status: 400 })
+  }
+
+  try {
+    // Send option 16 (Snapshot capture) followed by its options line
+    return NextResponse.json(await runVmd(`16\\npid=${pid}&name=${name}\\n`, 30000))
+  } catch (error) {
+    console.error('Snapshot API Error:', error)
+    return NextResponse.json(
+      {
+        error: 'Failed to capture snapshot',
+        details: error instanceof Error ? error.message : 'Unknown error'
+      },
+      { status: 500 }
+    )
+  }
+}
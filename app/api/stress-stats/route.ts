@@ -6,8 +6,8 @@ const execAsync = promisify(exec)
 
 export async function GET() {
   try {
-    // Find stress-ng processes
-    const { stdout } = await execAsync('ps aux | grep "stress-ng" | grep -v grep || echo ""')
+    // Find vmd_workload processes
+    const { stdout } = await execAsync('ps aux | grep "vmd_workload" | grep -v grep || echo ""')
     
     if (!stdout.trim()) {
       return NextResponse.json({ 
@@ -5,10 +5,13 @@ import { getStressConfig } from '@/app/config/stress'
 
 const execAsync = promisify(exec)
 let stressProcess: any = null
+let lastReport: any = null
+
+const PATTERNS = ['seq', 'random', 'strided', 'chase', 'thp', 'madvise']
 
 export async function POST(request: Request) {
   try {
-    const { action } = await request.json()
+    const { action, pattern, threads } = await request.json()
 
     if (action === 'start') {
       if (stressProcess) {
@@ -42,38 +45,52 @@ export async function POST(request: Request) {
         CAP_LIMIT_MB = 100
       }
 
-      const memoryBytes = `${CAP_LIMIT_MB}M`
-
-      console.log(`Starting stress-ng with ${memoryBytes} memory allocation`)
-
-      // Use stress-ng with safe options
-      // --vm 1: spawn ONLY 1 worker
-      // --vm-bytes: amount of memory to allocate
-      // --vm-keep: keep memory allocated
-      // --timeout 0: run indefinitely
-      stressProcess = spawn('stress-ng', [
-        '--vm', '1',
-        '--vm-bytes', memoryBytes,
-        '--vm-keep',
-        '--timeout', '0',
-        '--verbose'
+      const workloadPattern = PATTERNS.includes(pattern) ? pattern : 'seq'
+      const workloadThreads = Math.min(Math.max(parseInt(threads, 10) || 1, 1), 16)
+
+      console.log(`Starting vmd_workload (${workloadPattern}) with ${CAP_LIMIT_MB}MB target`)
+
+      // vmd_workload maps CHUNK_SIZE_MB chunks every ALLOCATION_INTERVAL_MS
+      // per thread until CAP_LIMIT_MB is resident, then keeps accessing them.
+      // Each thread stops at its CAP_LIMIT_MB / threads share, so the chunk
+      // must fit in it
+      const chunkMB = Math.max(Math.min(config.CHUNK_SIZE_MB, Math.floor(CAP_LIMIT_MB / workloadThreads)), 1)
+      stressProcess = spawn('./bin/vmd_workload', [
+        '--pattern', workloadPattern,
+        '--threads', String(workloadThreads),
+        '--chunk-mb', String(chunkMB),
+        '--target-mb', String(CAP_LIMIT_MB),
+        '--interval-ms', String(config.ALLOCATION_INTERVAL_MS),
+        '--report-ms', '1000'
       ])
+      lastReport = null
 
+      // Each stdout line is a JSON report of bandwidth and fault latency
+      let pending = ''
       stressProcess.stdout.on('data', (data: Buffer) => {
-        console.log(`stress-ng: ${data.toString()}`)
+        pending += data.toString()
+        const lines = pending.split('\n')
+        pending = lines.pop() || ''
+        for (const line of lines) {
+          try {
+            lastReport = JSON.parse(line)
+          } catch {
+            console.log(`vmd_workload: ${line}`)
+          }
+        }
       })
 
       stressProcess.stderr.on('data', (data: Buffer) => {
-        console.log(`stress-ng: ${data.toString()}`)
+        console.log(`vmd_workload: ${data.toString()}`)
       })
 
       stressProcess.on('exit', (code: number) => {
-        console.log(`stress-ng exited with code ${code}`)
+        console.log(`vmd_workload exited with code ${code}`)
         stressProcess = null
       })
 
       stressProcess.on('error', (err: Error) => {
-        console.error(`stress-ng error:`, err)
+        console.error(`vmd_workload error:`, err)
         stressProcess = null
       })
 
@@ -85,7 +102,9 @@ export async function POST(request: Request) {
         message: `Memory stress test started - allocating ${CAP_LIMIT_MB}MB`,
         pid: stressProcess?.pid,
         config: { ...config, CAP_LIMIT_MB },
-        tool: 'stress-ng'
+        pattern: workloadPattern,
+        threads: workloadThreads,
+        tool: 'vmd_workload'
       })
     } 
     
@@ -97,7 +116,7 @@ export async function POST(request: Request) {
         })
       }
 
-      console.log('Stopping stress-ng...')
+      console.log('Stopping vmd_workload...')
       
       try {
         // Try graceful shutdown first
@@ -106,13 +125,13 @@ export async function POST(request: Request) {
         // Force kill if it doesn't stop in 3 seconds
         setTimeout(() => {
           if (stressProcess) {
-            console.log('Force killing stress-ng...')
+            console.log('Force killing vmd_workload...')
             stressProcess.kill('SIGKILL')
             stressProcess = null
           }
         }, 3000)
       } catch (err) {
-        console.error('Error stopping stress-ng:', err)
+        console.error('Error stopping vmd_workload:', err)
       }
       
       stressProcess = null
@@ -128,7 +147,8 @@ export async function POST(request: Request) {
       return NextResponse.json({ 
         status: stressProcess ? 'running' : 'stopped',
         pid: stressProcess?.pid || null,
-        config
+        config,
+        report: lastReport
       })
     }
 
@@ -148,6 +168,7 @@ export async function GET() {
   return NextResponse.json({ 
     status: stressProcess ? 'running' : 'stopped',
     pid: stressProcess?.pid || null,
-    config
+    config,
+    report: lastReport
   })
 }
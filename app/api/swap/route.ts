@@ -0,0 +1,52 @@
+import { NextResponse } from 'next/server'
+import { exec } from 'child_process'
+import { promisify } from 'util'
+
+const execAsync = promisify(exec)
+
+export async function GET(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const pid = parseInt(searchParams.get('pid') || '', 10)
+  const limit = Math.min(Math.max(parseInt(searchParams.get('limit') || '50', 10) || 50, 1), 1000)
+  const options = (pid > 0 ? `pid=${pid}&` : '') + `limit=${limit}`
+
+  try {
+    // Send option 11 (Swap analysis) followed by its options line
+    const { stdout, stderr } = await execAsync(`printf "11\\n${options}\\n" | ./bin/vmd`, {
+      maxBuffer: 1024 * 1024,
+      timeout: 2000,
+      shell: '/bin/bash'
+    })
+
+    if (stderr) {
+      console.error('VMD Error:', stderr)
+      return NextResponse.json({ error: 'VMD process error' }, { status: 500 })
+    }
+
+    try {
+      // Find JSON content between the outermost curly braces, ignoring menu text
+      const jsonMatch = stdout.match(/\{[\s\S]*\}/);
+      if (!jsonMatch) {
+        throw new Error('No JSON data found in output');
+      }
+
+      return NextResponse.json(JSON.parse(jsonMatch[0]))
+    } catch (e) {
+      console.error('Failed to parse swap analysis:', e)
+      return NextResponse.json({
+        error: 'Invalid swap analysis data',
+        details: e instanceof Error ? e.message : 'Unknown error',
+        rawOutput: stdout.slice(0, 200)
+      }, { status: 500 })
+    }
+  } catch (error) {
+    console.error('Swap Analysis API Error:', error)
+    return NextResponse.json(
+      {
+        error: 'Failed to fetch swap analysis',
+        details: error instanceof Error ? error.message : 'Unknown error'
+      },
+      { status: 500 }
+    )
+  }
+}
@@ -0,0 +1,50 @@
+import { NextResponse } from 'next/server'
+import { exec } from 'child_process'
+import { promisify } from 'util'
+
+const execAsync = promisify(exec)
+
+export async function GET(request: Request) {
+  const { searchParams } = new URL(request.url)
+  const maxMb = Math.min(Math.max(parseInt(searchParams.get('max_mb') || '0', 10) || 0, 0), 8192)
+
+  try {
+    // Send option 14 (TLB reach benchmark) followed by its options line
+    const { stdout, stderr } = await execAsync(`printf "14\\nmax_mb=${maxMb}\\n" | ./bin/vmd`, {
+      maxBuffer: 1024 * 1024,
+      timeout: 120000,
+      shell: '/bin/bash'
+    })
+
+    if (stderr) {
+      console.error('VMD Error:', stderr)
+      return NextResponse.json({ error: 'VMD process error' }, { status: 500 })
+    }
+
+    try {
+      // Find JSON content between the outermost curly braces, ignoring menu text
+      const jsonMatch = stdout.match(/\{[\s\S]*\}/);
+      if (!jsonMatch) {
+        throw new Error('No JSON data found in output');
+      }
+
+      return NextResponse.json(JSON.parse(jsonMatch[0]))
+    } catch (e) {
+      console.error('Failed to parse TLB benchmark:', e)
+      return NextResponse.json({
+        error: 'Invalid TLB benchmark data',
+        details: e instanceof Error ? e.message : 'Unknown error',
+        rawOutput: stdout.slice(0, 200)
+      }, { status: 500 })
+    }
+  } catch (error) {
+    console.error('TLB Benchmark API Error:', error)
+    return NextResponse.json(
+      {
+        error: 'Failed to run TLB benchmark',
+        details: error instanceof Error ? error.message : 'Unknown error'
+      },
+      { status: 500 }
+    )
+  }
+}
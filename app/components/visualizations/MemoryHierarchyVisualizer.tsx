@@ -7,10 +7,17 @@ export function MemoryHierarchyVisualizer({ regions }: { regions: MemoryRegionIn
   const getColorForType = (type: string) => {
     const colors = {
       'heap': 'bg-green-100 dark:bg-green-900',
+      'arena': 'bg-emerald-100 dark:bg-emerald-900',
       'stack': 'bg-blue-100 dark:bg-blue-900',
-      'code': 'bg-yellow-100 dark:bg-yellow-900',
+      'thread_stack': 'bg-sky-100 dark:bg-sky-900',
+      'text': 'bg-yellow-100 dark:bg-yellow-900',
+      'rodata': 'bg-amber-100 dark:bg-amber-900',
       'data': 'bg-purple-100 dark:bg-purple-900',
-      'shared': 'bg-orange-100 dark:bg-orange-900',
+      'bss': 'bg-violet-100 dark:bg-violet-900',
+      'file_shared': 'bg-orange-100 dark:bg-orange-900',
+      'shm': 'bg-red-100 dark:bg-red-900',
+      'vdso': 'bg-slate-200 dark:bg-slate-800',
+      'vvar': 'bg-slate-200 dark:bg-slate-800',
     }
     return colors[type as keyof typeof colors] || 'bg-gray-100 dark:bg-gray-900'
   }
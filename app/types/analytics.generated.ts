@@ -0,0 +1,68 @@
+// Generated by `make types` in bin/ from ANALYTICS_FIELDS in
+// bin/memory_types.h. Do not edit by hand.
+
+// Analytics fields as printed by vmd
+export interface VmdAnalytics {
+  fragmentation_index: number
+  fault_rate: number
+  pressure_score: number
+  swap_usage_percent: number
+  major_faults: number
+  minor_faults: number
+  memory_usage: number
+  total_memory: number
+  free_memory: number
+  largest_free_block: number
+  peak_usage: number
+}
+
+// The same fields as returned by /api/analytics
+export interface AnalyticsFields {
+  fragmentation: number
+  pageFaultRate: number
+  pressureScore: number
+  swapUsagePercent: number
+  majorFaults: number
+  minorFaults: number
+  memory_usage: number
+  total_memory: number
+  free_memory: number
+  largestFreeBlock: number
+  peakUsage: number
+}
+
+export function toAnalyticsFields(raw: Partial<Record<keyof VmdAnalytics, unknown>>): AnalyticsFields {
+  return {
+    fragmentation: Number(raw.fragmentation_index) || 0,
+    pageFaultRate: Number(raw.fault_rate) || 0,
+    pressureScore: Number(raw.pressure_score) || 0,
+    swapUsagePercent: Number(raw.swap_usage_percent) || 0,
+    majorFaults: Number(raw.major_faults) || 0,
+    minorFaults: Number(raw.minor_faults) || 0,
+    memory_usage: Number(raw.memory_usage) || 0,
+    total_memory: Number(raw.total_memory) || 0,
+    free_memory: Number(raw.free_memory) || 0,
+    largestFreeBlock: Number(raw.largest_free_block) || 0,
+    peakUsage: Number(raw.peak_usage) || 0,
+  }
+}
+
+export const ANALYTICS_BINARY_SIZE = 88
+
+// Decodes the 8-byte-per-field layout written by analytics_to_binary
+// (little-endian hosts)
+export function decodeAnalytics(view: DataView, offset = 0): VmdAnalytics {
+  return {
+    fragmentation_index: view.getFloat64(offset + 0, true),
+    fault_rate: view.getFloat64(offset + 8, true),
+    pressure_score: view.getFloat64(offset + 16, true),
+    swap_usage_percent: Number(view.getBigInt64(offset + 24, true)),
+    major_faults: Number(view.getBigInt64(offset + 32, true)),
+    minor_faults: Number(view.getBigInt64(offset + 40, true)),
+    memory_usage: Number(view.getBigUint64(offset + 48, true)),
+    total_memory: Number(view.getBigUint64(offset + 56, true)),
+    free_memory: Number(view.getBigUint64(offset + 64, true)),
+    largest_free_block: Number(view.getBigUint64(offset + 72, true)),
+    peak_usage: Number(view.getBigUint64(offset + 80, true)),
+  }
+}
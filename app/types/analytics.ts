@@ -1,11 +1,7 @@
-export interface MemoryMetrics {
-  fragmentation: number
-  pageFaultRate: number
-  pressureScore: number
-  swapUsagePercent: number
-  majorFaults: number
-  minorFaults: number
-}
+import { AnalyticsFields } from './analytics.generated'
+
+// Scalar fields come from ANALYTICS_FIELDS in bin/memory_types.h
+export type MemoryMetrics = AnalyticsFields
 
 export interface TimelineData {
   timestamp: number
@@ -80,6 +80,10 @@ export interface PageTableEntry {
   is_cached: boolean
   is_dirty: boolean
   level: number
+  region: string
+  span_pages: number
+  present_pages: number
+  swapped_pages: number
 }
 
 export interface MemoryRegionInfo {
@@ -91,10 +95,23 @@ export interface MemoryRegionInfo {
   mapped_file: string
 }
 
+export interface RegionQueryInfo {
+  pid: number
+  start: string
+  end: string
+  stride?: number
+  limit: number
+  pages_read?: number
+}
+
 export interface PageTableData {
   page_table: PageTableEntry[]
+  query: RegionQueryInfo
+  next_cursor: string | null
 }
 
 export interface MemoryHierarchyData {
   memory_regions: MemoryRegionInfo[]
+  query: RegionQueryInfo
+  next_cursor: string | null
 } 
\ No newline at end of file
@@ -0,0 +1,21 @@
+// Address range options of the page table (option 6) and memory hierarchy
+// (option 7) as vmd's options line. Values are restricted to the characters
+// addresses, kind lists and cursors use, since the line goes through a shell.
+const REGION_QUERY_KEYS = ['pid', 'start', 'end', 'region', 'stride', 'cursor', 'limit']
+const REGION_QUERY_VALUE = /^[0-9A-Za-z_,]{1,128}$/
+// A page table entry prints as about 450 bytes, so this keeps a page of
+// results well inside the routes' 16 MB maxBuffer; page on with cursor
+export const REGION_QUERY_MAX_LIMIT = 20000
+
+function clampOption(key: string, value: string) {
+  if (key !== 'limit' || !/^[0-9]+$/.test(value)) return value
+  return String(Math.min(Number(value), REGION_QUERY_MAX_LIMIT))
+}
+
+export function regionQueryOptions(searchParams: URLSearchParams) {
+  return REGION_QUERY_KEYS
+    .map(key => [key, searchParams.get(key)] as const)
+    .filter(([, value]) => value !== null && REGION_QUERY_VALUE.test(value))
+    .map(([key, value]) => `${key}=${clampOption(key, value as string)}`)
+    .join('&')
+}
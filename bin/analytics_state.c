@@ -0,0 +1,6 @@
+#include "memory_types.h"
+#include <pthread.h>
+
+// Global analytics instance, shared by vmd and the tracker library
+MemoryAnalytics g_analytics = {0};
+pthread_mutex_t g_analytics_mutex = PTHREAD_MUTEX_INITIALIZER;
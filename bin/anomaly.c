@@ -0,0 +1,348 @@
+#define _GNU_SOURCE
+#include "anomaly.h"
+#include "memory_types.h"
+#include "process_scan.h"
+#include "state_dir.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#define ANOMALY_QUEUE 64
+#define ANOMALY_LINE 512
+#define ANOMALY_MAX_LIMIT 1000
+
+extern MemoryAnalytics g_analytics;
+extern pthread_mutex_t g_analytics_mutex;
+
+typedef struct {
+    int64_t ts_ms;
+    AnomalyDetector detector;
+    const char* series;
+    int critical;
+    double value;
+    double baseline;
+    double score;                   // Sigmas, CUSUM sum or growth / minimum
+    int pid;                        // Growth alerts only
+    char comm[16];
+    double rate;
+    double duration_s;
+} Alert;
+
+// EWMA of the level and its variance plus the CUSUM sum, per series
+typedef struct {
+    const char* name;
+    double min_sd;                  // Noise floor, so flat series stay quiet
+    double mean;
+    double var;
+    unsigned long samples;
+    double cusum;
+    double last_alert_s[2];         // Band, CUSUM
+} SeriesState;
+
+enum {
+    SERIES_FAULTS,
+    SERIES_MAJOR_FAULTS,
+    SERIES_PRESSURE,
+    SERIES_PSI,
+    SERIES_USED_SLOPE,
+    SERIES_SWAP_OUT,
+    NUM_SERIES
+};
+
+static SeriesState g_series[NUM_SERIES] = {
+    [SERIES_FAULTS] = { .name = "fault_rate", .min_sd = 100 },
+    [SERIES_MAJOR_FAULTS] = { .name = "major_fault_rate", .min_sd = 5 },
+    [SERIES_PRESSURE] = { .name = "pressure_score", .min_sd = 0.02 },
+    [SERIES_PSI] = { .name = "psi_some_avg10", .min_sd = 0.5 },
+    [SERIES_USED_SLOPE] = { .name = "used_bytes_slope", .min_sd = 1 << 20 },
+    [SERIES_SWAP_OUT] = { .name = "swap_out_rate", .min_sd = 10 },
+};
+
+// Growth streak of one process; restarted after a drawdown
+typedef struct {
+    int pid;                        // 0 when the slot is free
+    unsigned long long start_time;
+    char comm[16];
+    size_t base_rss;
+    size_t max_rss;
+    size_t last_rss;
+    size_t alerted_growth;
+    double base_s;
+    unsigned int samples;
+    unsigned int rises;
+    unsigned int generation;
+} ProcessState;
+
+static ProcessState g_processes[ANOMALY_MAX_PROCESSES];
+static unsigned int g_generation = 0;
+
+static const char* g_detector_names[ANOMALY_NUM_DETECTORS] = { "band", "cusum", "growth" };
+
+static Alert g_queue[ANOMALY_QUEUE];
+static int g_queued = 0;
+static unsigned long long g_counts[ANOMALY_NUM_DETECTORS];
+static pthread_mutex_t g_alert_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static double monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int64_t realtime_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+const char* anomaly_detector_name(AnomalyDetector detector) {
+    return detector < ANOMALY_NUM_DETECTORS ? g_detector_names[detector] : "unknown";
+}
+
+unsigned long long anomaly_alert_count(AnomalyDetector detector) {
+    pthread_mutex_lock(&g_alert_mutex);
+    unsigned long long count = detector < ANOMALY_NUM_DETECTORS ? g_counts[detector] : 0;
+    pthread_mutex_unlock(&g_alert_mutex);
+    return count;
+}
+
+// Both lanes raise alerts, so they are queued and printed by the fast lane
+// between its own lines; a full queue drops the alert but still counts it
+static void raise_alert(const Alert* alert) {
+    pthread_mutex_lock(&g_alert_mutex);
+    if (g_queued < ANOMALY_QUEUE) g_queue[g_queued++] = *alert;
+    g_counts[alert->detector]++;
+    pthread_mutex_unlock(&g_alert_mutex);
+}
+
+static void feed_series(SeriesState* s, double x, double now_s, int64_t ts_ms) {
+    if (!isfinite(x)) return;
+    if (s->samples++ == 0) {
+        s->mean = x;
+        return;
+    }
+
+    double sd = sqrt(s->var);
+    if (sd < fabs(s->mean) * 0.05) sd = fabs(s->mean) * 0.05;
+    if (sd < s->min_sd) sd = s->min_sd;
+    double z = (x - s->mean) / sd;
+
+    // Only upward moves are regressions for these series
+    if (s->samples > ANOMALY_WARMUP) {
+        Alert alert = { .ts_ms = ts_ms, .series = s->name, .value = x, .baseline = s->mean };
+        if (z > ANOMALY_BAND_SIGMA && now_s - s->last_alert_s[0] >= ANOMALY_COOLDOWN_S) {
+            alert.detector = ANOMALY_BAND;
+            alert.score = z;
+            alert.critical = z >= 2 * ANOMALY_BAND_SIGMA;
+            raise_alert(&alert);
+            s->last_alert_s[0] = now_s;
+        }
+        s->cusum = fmax(0, s->cusum + z - ANOMALY_CUSUM_K);
+        if (s->cusum > ANOMALY_CUSUM_H) {
+            if (now_s - s->last_alert_s[1] >= ANOMALY_COOLDOWN_S) {
+                alert.detector = ANOMALY_CUSUM;
+                alert.score = s->cusum;
+                alert.critical = s->cusum >= 2 * ANOMALY_CUSUM_H;
+                raise_alert(&alert);
+                s->last_alert_s[1] = now_s;
+            }
+            // Accept the new level so one shift is reported once
+            s->cusum = 0;
+            s->mean = x;
+        }
+    }
+
+    double diff = x - s->mean;
+    s->mean += ANOMALY_ALPHA * diff;
+    s->var = (1 - ANOMALY_ALPHA) * (s->var + ANOMALY_ALPHA * diff * diff);
+}
+
+void anomaly_system_sample(double pressure_avg10) {
+    static size_t last_used = 0;
+    static double last_s = 0;
+    double values[NUM_SERIES];
+    double now = monotonic_s();
+
+    pthread_mutex_lock(&g_analytics_mutex);
+    values[SERIES_FAULTS] = g_analytics.fault_rate;
+    values[SERIES_MAJOR_FAULTS] = g_analytics.vmstat.rate[VMSTAT_PGMAJFAULT];
+    values[SERIES_PRESSURE] = g_analytics.pressure_score;
+    values[SERIES_SWAP_OUT] = g_analytics.vmstat.rate[VMSTAT_PSWPOUT];
+    size_t used = g_analytics.memory_usage;
+    pthread_mutex_unlock(&g_analytics_mutex);
+
+    values[SERIES_PSI] = pressure_avg10 >= 0 ? pressure_avg10 : NAN;
+    values[SERIES_USED_SLOPE] = last_s > 0 && now > last_s ? ((double)used - (double)last_used) / (now - last_s) : NAN;
+    last_used = used;
+    last_s = now;
+
+    int64_t ts = realtime_ms();
+    for (int i = 0; i < NUM_SERIES; i++) feed_series(&g_series[i], values[i], now, ts);
+}
+
+// Stored without JSON metacharacters, since alerts are printed raw
+static void set_comm(ProcessState* s, const ProcessStats* p) {
+    for (size_t k = 0; k < sizeof(s->comm); k++) {
+        char c = p->name[k];
+        s->comm[k] = c == '"' || c == '\\' || (c > 0 && c < 0x20) ? '_' : c;
+    }
+    s->comm[sizeof(s->comm) - 1] = '\0';
+}
+
+static void restart_streak(ProcessState* s, const ProcessStats* p, double now) {
+    set_comm(s, p);
+    s->base_rss = s->max_rss = s->last_rss = p->rss;
+    s->alerted_growth = 0;
+    s->base_s = now;
+    s->samples = 0;
+    s->rises = 0;
+}
+
+static void update_process(ProcessState* s, const ProcessStats* p, double now, int64_t ts) {
+    s->generation = g_generation;
+    // A fork is often first seen before it execs
+    set_comm(s, p);
+    if (p->rss + (size_t)(s->max_rss * ANOMALY_GROWTH_DRAWDOWN) < s->max_rss) {
+        restart_streak(s, p, now);
+        return;
+    }
+    s->samples++;
+    if (p->rss > s->last_rss) s->rises++;
+    s->last_rss = p->rss;
+    if (p->rss > s->max_rss) s->max_rss = p->rss;
+
+    size_t growth = p->rss > s->base_rss ? p->rss - s->base_rss : 0;
+    double duration = now - s->base_s;
+    if (duration < ANOMALY_GROWTH_MIN_S || s->samples < ANOMALY_GROWTH_MIN_SAMPLES) return;
+    if (s->rises < ANOMALY_GROWTH_RISE_SHARE * s->samples || growth < ANOMALY_GROWTH_MIN_BYTES) return;
+    // Once alerted, a process is reported again each time its growth doubles
+    if (growth < 2 * s->alerted_growth) return;
+
+    Alert alert = { .ts_ms = ts, .detector = ANOMALY_GROWTH, .series = "process_rss", .value = p->rss,
+                    .baseline = s->base_rss, .pid = p->pid, .rate = growth / duration, .duration_s = duration };
+    alert.score = (double)growth / ANOMALY_GROWTH_MIN_BYTES;
+    alert.critical = alert.score >= 4;
+    memcpy(alert.comm, s->comm, sizeof(alert.comm));
+    raise_alert(&alert);
+    s->alerted_growth = growth;
+}
+
+void anomaly_process_sample(void) {
+    static ProcessStats top[ANOMALY_MAX_PROCESSES];
+    static int pending[ANOMALY_MAX_PROCESSES];
+    int count = top_processes(top, ANOMALY_MAX_PROCESSES, PROC_SORT_RSS);
+    int num_pending = 0;
+    double now = monotonic_s();
+    int64_t ts = realtime_ms();
+
+    g_generation++;
+    for (int i = 0; i < count; i++) {
+        ProcessState* s = NULL;
+        for (int j = 0; j < ANOMALY_MAX_PROCESSES && s == NULL; j++) {
+            if (g_processes[j].pid == top[i].pid && g_processes[j].start_time == top[i].start_time)
+                s = &g_processes[j];
+        }
+        if (s != NULL) update_process(s, &top[i], now, ts);
+        else pending[num_pending++] = i;
+    }
+
+    // Processes that left the top list are forgotten, making room for new ones
+    for (int j = 0; j < ANOMALY_MAX_PROCESSES; j++) {
+        if (g_processes[j].generation != g_generation) g_processes[j].pid = 0;
+    }
+    for (int i = 0, j = 0; i < num_pending; i++) {
+        while (j < ANOMALY_MAX_PROCESSES && g_processes[j].pid != 0) j++;
+        if (j == ANOMALY_MAX_PROCESSES) break;
+        ProcessState* s = &g_processes[j];
+        const ProcessStats* p = &top[pending[i]];
+        s->pid = p->pid;
+        s->start_time = p->start_time;
+        s->generation = g_generation;
+        restart_streak(s, p, now);
+    }
+}
+
+static void format_alert(char* buf, size_t len, const Alert* a) {
+    int n = snprintf(buf, len, "{\"ts_ms\": %lld, \"detector\": \"%s\", \"series\": \"%s\", \"severity\": \"%s\", "
+                     "\"value\": %.4f, \"baseline\": %.4f, \"score\": %.2f",
+                     (long long)a->ts_ms, g_detector_names[a->detector], a->series,
+                     a->critical ? "critical" : "warning", a->value, a->baseline, a->score);
+    if (n > 0 && (size_t)n < len && a->detector == ANOMALY_GROWTH) {
+        n += snprintf(buf + n, len - n, ", \"pid\": %d, \"comm\": \"%s\", \"rate\": %.1f, \"duration_s\": %.0f",
+                      a->pid, a->comm, a->rate, a->duration_s);
+    }
+    if (n > 0 && (size_t)n < len) snprintf(buf + n, len - n, "}");
+}
+
+void anomaly_flush_alerts(void) {
+    static Alert batch[ANOMALY_QUEUE];
+    char path[512], rotated[520], line[ANOMALY_LINE];
+
+    pthread_mutex_lock(&g_alert_mutex);
+    int count = g_queued;
+    memcpy(batch, g_queue, count * sizeof(Alert));
+    g_queued = 0;
+    pthread_mutex_unlock(&g_alert_mutex);
+    if (count == 0) return;
+
+    FILE* log = NULL;
+    if (vmd_state_path(path, sizeof(path), ANOMALY_LOG) == 0) {
+        struct stat st;
+        if (stat(path, &st) == 0 && st.st_size > ANOMALY_LOG_MAX_BYTES) {
+            snprintf(rotated, sizeof(rotated), "%s.1", path);
+            rename(path, rotated);
+        }
+        log = vmd_state_fopen(path, "a");
+    }
+    for (int i = 0; i < count; i++) {
+        format_alert(line, sizeof(line), &batch[i]);
+        printf("{\"ts\": %lld.%03lld, \"alert\": %s}\n", (long long)(batch[i].ts_ms / 1000),
+               (long long)(batch[i].ts_ms % 1000), line);
+        if (log != NULL) fprintf(log, "%s\n", line);
+    }
+    fflush(stdout);
+    if (log != NULL) fclose(log);
+}
+
+// Keeps the newest limit matching lines of one log file in a ring
+static void read_alert_log(const char* path, int64_t since_ms, char (*ring)[ANOMALY_LINE], int limit,
+                           int* next, int* total) {
+    char line[ANOMALY_LINE];
+    long long ts;
+    FILE* f = vmd_state_fopen(path, "r");
+    if (f == NULL) return;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "{\"ts_ms\": %lld", &ts) != 1 || ts < since_ms) continue;
+        line[strcspn(line, "\n")] = '\0';
+        memcpy(ring[*next], line, sizeof(line));
+        *next = (*next + 1) % limit;
+        (*total)++;
+    }
+    fclose(f);
+}
+
+void output_alerts_json(int64_t since_ms, int limit) {
+    static char ring[ANOMALY_MAX_LIMIT][ANOMALY_LINE];
+    char path[512], rotated[520];
+    int next = 0, total = 0;
+
+    if (limit <= 0) limit = ANOMALY_DEFAULT_LIMIT;
+    if (limit > ANOMALY_MAX_LIMIT) limit = ANOMALY_MAX_LIMIT;
+    if (vmd_state_path(path, sizeof(path), ANOMALY_LOG) == 0) {
+        snprintf(rotated, sizeof(rotated), "%s.1", path);
+        read_alert_log(rotated, since_ms, ring, limit, &next, &total);
+        read_alert_log(path, since_ms, ring, limit, &next, &total);
+    }
+
+    int shown = total < limit ? total : limit;
+    int first = total < limit ? 0 : next;
+    printf("{\n  \"total\": %d,\n  \"alerts\": [", total);
+    for (int i = 0; i < shown; i++) {
+        printf("%s\n    %s", i ? "," : "", ring[(first + i) % limit]);
+    }
+    printf("%s]\n}\n", shown ? "\n  " : "");
+}
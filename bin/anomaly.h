@@ -0,0 +1,49 @@
+#ifndef ANOMALY_H
+#define ANOMALY_H
+
+#include <stdint.h>
+
+// Online detectors over the resident monitor's samples. Every series keeps
+// a constant amount of state; alerts are printed as JSON lines and
+// appended to ANOMALY_LOG in the state dir
+#define ANOMALY_LOG "alerts.jsonl"
+#define ANOMALY_LOG_MAX_BYTES (1 << 20)     // Rotated to ANOMALY_LOG ".1"
+#define ANOMALY_DEFAULT_LIMIT 100
+
+// System series: EWMA mean/variance bands and a one-sided CUSUM on the
+// standardized residual, both after ANOMALY_WARMUP samples
+#define ANOMALY_ALPHA 0.1
+#define ANOMALY_WARMUP 10
+#define ANOMALY_BAND_SIGMA 4.0
+#define ANOMALY_CUSUM_K 0.5
+#define ANOMALY_CUSUM_H 5.0
+#define ANOMALY_COOLDOWN_S 30
+
+// Per-process growth: RSS rising in most samples, without a drawdown,
+// by at least ANOMALY_GROWTH_MIN_BYTES over ANOMALY_GROWTH_MIN_S
+#define ANOMALY_MAX_PROCESSES 128
+#define ANOMALY_GROWTH_MIN_S 60
+#define ANOMALY_GROWTH_MIN_SAMPLES 6
+#define ANOMALY_GROWTH_MIN_BYTES (16UL << 20)
+#define ANOMALY_GROWTH_RISE_SHARE 0.75
+#define ANOMALY_GROWTH_DRAWDOWN 0.05
+
+typedef enum {
+    ANOMALY_BAND,
+    ANOMALY_CUSUM,
+    ANOMALY_GROWTH,
+    ANOMALY_NUM_DETECTORS
+} AnomalyDetector;
+
+// Fast lane: feeds g_analytics and the PSI avg10 (-1 when unavailable)
+void anomaly_system_sample(double pressure_avg10);
+// Background lane: feeds the largest processes of the latest scan
+void anomaly_process_sample(void);
+// Prints queued alerts and appends them to the log; fast lane only
+void anomaly_flush_alerts(void);
+const char* anomaly_detector_name(AnomalyDetector detector);
+unsigned long long anomaly_alert_count(AnomalyDetector detector);
+// Logged alerts at or after since_ms, newest last, at most limit
+void output_alerts_json(int64_t since_ms, int limit);
+
+#endif
@@ -0,0 +1,321 @@
+#define _GNU_SOURCE
+#include "batch_io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// Same numbers on every architecture
+#ifndef SYS_io_uring_setup
+#define SYS_io_uring_setup 425
+#define SYS_io_uring_enter 426
+#define SYS_io_uring_register 427
+#endif
+
+struct BatchIo {
+    BatchIoBackend backend;         // BATCH_IO_URING while the ring is usable
+    unsigned long long ns_per_read[2];  // By backend, 0 until measured
+    unsigned long batches;
+    int* fds;                       // Slot -> fd, -1 when free
+    unsigned char* fixed;           // Slot is in the registered file table
+    int* free_slots;
+    int num_free;
+    int max_files;
+    unsigned long syscalls;
+
+    int ring_fd;
+    int registered;
+    unsigned sq_entries;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    struct iovec* iovs;             // One per SQE, live until its completion
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+};
+
+static void uring_teardown(BatchIo* io) {
+    if (io->sqes != NULL) munmap(io->sqes, io->sqes_size);
+    if (io->cq_ring != NULL && io->cq_ring != io->sq_ring) munmap(io->cq_ring, io->cq_ring_size);
+    if (io->sq_ring != NULL) munmap(io->sq_ring, io->sq_ring_size);
+    if (io->ring_fd >= 0) close(io->ring_fd);
+    free(io->iovs);
+    if (io->fixed != NULL) memset(io->fixed, 0, io->max_files);
+    io->sqes = NULL;
+    io->cq_ring = io->sq_ring = NULL;
+    io->iovs = NULL;
+    io->ring_fd = -1;
+    io->registered = 0;
+    io->backend = BATCH_IO_PREADV;
+}
+
+static int uring_setup(BatchIo* io) {
+    struct io_uring_params p;
+    int fd = -1;
+
+    // Before 5.12 rings count against RLIMIT_MEMLOCK, so shrink until one fits
+    for (unsigned entries = BATCH_IO_RING_ENTRIES; fd < 0 && entries >= BATCH_IO_MIN_RING_ENTRIES; entries /= 2) {
+        memset(&p, 0, sizeof(p));
+        fd = (int)syscall(SYS_io_uring_setup, entries, &p);
+        if (fd < 0 && errno != ENOMEM) return -1;
+    }
+    if (fd < 0) return -1;
+    io->ring_fd = fd;
+
+    io->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    io->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (io->cq_ring_size > io->sq_ring_size) io->sq_ring_size = io->cq_ring_size;
+        io->cq_ring_size = io->sq_ring_size;
+    }
+    io->sq_ring = mmap(NULL, io->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd, IORING_OFF_SQ_RING);
+    if (io->sq_ring == MAP_FAILED) {
+        io->sq_ring = NULL;
+        return -1;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        io->cq_ring = io->sq_ring;
+    } else {
+        io->cq_ring = mmap(NULL, io->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           fd, IORING_OFF_CQ_RING);
+        if (io->cq_ring == MAP_FAILED) {
+            io->cq_ring = NULL;
+            return -1;
+        }
+    }
+    io->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    io->sqes = mmap(NULL, io->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_SQES);
+    if (io->sqes == MAP_FAILED) {
+        io->sqes = NULL;
+        return -1;
+    }
+    io->iovs = calloc(p.sq_entries, sizeof(struct iovec));
+    if (io->iovs == NULL) return -1;
+
+    char* sq = io->sq_ring;
+    char* cq = io->cq_ring;
+    io->sq_entries = p.sq_entries;
+    io->sq_head = (unsigned*)(sq + p.sq_off.head);
+    io->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    io->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    io->sq_array = (unsigned*)(sq + p.sq_off.array);
+    io->cq_head = (unsigned*)(cq + p.cq_off.head);
+    io->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    io->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    io->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    // A sparse table (5.5+) lets slots be filled one at a time; without it
+    // reads still go through the ring with plain fds
+    if (io->max_files > 0 &&
+        syscall(SYS_io_uring_register, fd, IORING_REGISTER_FILES, io->fds, io->max_files) == 0)
+        io->registered = 1;
+    io->backend = BATCH_IO_URING;
+    return 0;
+}
+
+BatchIo* batch_io_create(int max_files) {
+    BatchIo* io = calloc(1, sizeof(BatchIo));
+    if (io == NULL) return NULL;
+    if (max_files < 0) max_files = 0;
+    io->max_files = max_files;
+    io->ring_fd = -1;
+    io->backend = BATCH_IO_PREADV;
+    io->fds = malloc((max_files + 1) * sizeof(int));
+    io->fixed = calloc(max_files + 1, 1);
+    io->free_slots = malloc((max_files + 1) * sizeof(int));
+    if (io->fds == NULL || io->fixed == NULL || io->free_slots == NULL) {
+        batch_io_destroy(io);
+        return NULL;
+    }
+    // Lowest slots are handed out first
+    for (int i = 0; i < max_files; i++) {
+        io->fds[i] = -1;
+        io->free_slots[i] = max_files - 1 - i;
+    }
+    io->num_free = max_files;
+
+    const char* env = getenv(BATCH_IO_ENV);
+    if ((env == NULL || strcmp(env, "0") != 0) && uring_setup(io) != 0) uring_teardown(io);
+    return io;
+}
+
+void batch_io_destroy(BatchIo* io) {
+    if (io == NULL) return;
+    uring_teardown(io);
+    if (io->fds != NULL) {
+        for (int i = 0; i < io->max_files; i++)
+            if (io->fds[i] >= 0) close(io->fds[i]);
+    }
+    free(io->fds);
+    free(io->fixed);
+    free(io->free_slots);
+    free(io);
+}
+
+static int update_file(BatchIo* io, int slot, int fd) {
+    struct io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.fds = (uint64_t)(uintptr_t)&fd;
+    io->syscalls++;
+    return syscall(SYS_io_uring_register, io->ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1 ? 0 : -1;
+}
+
+int batch_io_add(BatchIo* io, int fd) {
+    if (io->num_free == 0) return -1;
+    int slot = io->free_slots[--io->num_free];
+    io->fds[slot] = fd;
+    io->fixed[slot] = io->registered && update_file(io, slot, fd) == 0;
+    return slot;
+}
+
+void batch_io_remove(BatchIo* io, int slot) {
+    if (slot < 0 || slot >= io->max_files || io->fds[slot] < 0) return;
+    // The registered table holds its own reference to the file
+    if (io->fixed[slot] && io->ring_fd >= 0) update_file(io, slot, -1);
+    close(io->fds[slot]);
+    io->syscalls++;
+    io->fds[slot] = -1;
+    io->fixed[slot] = 0;
+    io->free_slots[io->num_free++] = slot;
+}
+
+int batch_io_free_slots(const BatchIo* io) {
+    return io->num_free;
+}
+
+static void preadv_one(BatchIo* io, BatchRead* r) {
+    struct iovec iov = { r->buf, r->len };
+    ssize_t n = preadv(io->fds[r->slot], &iov, 1, r->offset);
+    io->syscalls++;
+    r->result = n >= 0 ? n : -errno;
+}
+
+static unsigned reap(BatchIo* io, BatchRead* reads) {
+    unsigned head = *io->cq_head;
+    unsigned tail = __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+    for (; head != tail; head++, count++) {
+        struct io_uring_cqe* cqe = &io->cqes[head & *io->cq_mask];
+        reads[cqe->user_data].result = cqe->res;
+    }
+    __atomic_store_n(io->cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+// Queues up to a ring's worth of reads and waits for all of them; returns
+// the number completed, or -1 if the ring failed
+static long uring_chunk(BatchIo* io, BatchRead* reads, size_t n) {
+    unsigned tail = *io->sq_tail;
+    unsigned queued = 0;
+    for (; queued < n && queued < io->sq_entries; queued++) {
+        BatchRead* r = &reads[queued];
+        unsigned index = tail & *io->sq_mask;
+        struct io_uring_sqe* sqe = &io->sqes[index];
+        int fixed = io->fixed[r->slot];
+
+        io->iovs[index].iov_base = r->buf;
+        io->iovs[index].iov_len = r->len;
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->flags = fixed ? IOSQE_FIXED_FILE : 0;
+        sqe->fd = fixed ? r->slot : io->fds[r->slot];
+        sqe->addr = (uint64_t)(uintptr_t)&io->iovs[index];
+        sqe->len = 1;
+        sqe->off = r->offset;
+        sqe->user_data = queued;
+        io->sq_array[index] = index;
+        tail++;
+    }
+    __atomic_store_n(io->sq_tail, tail, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0, completed = 0;
+    while (completed < queued) {
+        long ret = syscall(SYS_io_uring_enter, io->ring_fd, queued - submitted, queued - completed,
+                           IORING_ENTER_GETEVENTS, NULL, 0);
+        io->syscalls++;
+        // Closing the ring cancels whatever is left; the caller redoes them
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) return -1;
+        if (ret > 0) submitted += ret;
+        completed += reap(io, reads);
+    }
+    return completed;
+}
+
+static unsigned long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Reads with the given backend and folds the cost per read into its estimate
+static void timed_read(BatchIo* io, BatchIoBackend use, BatchRead* reads, size_t n) {
+    unsigned long long start = monotonic_ns();
+    size_t done = 0;
+    while (done < n && use == BATCH_IO_URING) {
+        long completed = uring_chunk(io, reads + done, n - done);
+        if (completed < 0) {
+            uring_teardown(io);
+            use = BATCH_IO_PREADV;
+            break;
+        }
+        done += completed;
+    }
+    for (; done < n; done++) preadv_one(io, &reads[done]);
+
+    unsigned long long cost = (monotonic_ns() - start) / n + 1;
+    unsigned long long* estimate = &io->ns_per_read[use];
+    *estimate = *estimate == 0 ? cost : (*estimate * 3 + cost) / 4;
+}
+
+BatchIoBackend batch_io_backend(const BatchIo* io) {
+    if (io->backend != BATCH_IO_URING) return BATCH_IO_PREADV;
+    unsigned long long uring = io->ns_per_read[BATCH_IO_URING];
+    unsigned long long preadv = io->ns_per_read[BATCH_IO_PREADV];
+    return preadv != 0 && (uring == 0 || preadv < uring) ? BATCH_IO_PREADV : BATCH_IO_URING;
+}
+
+void batch_io_read(BatchIo* io, BatchRead* reads, size_t n) {
+    if (n == 0) return;
+    BatchIoBackend use = batch_io_backend(io);
+    int measured = io->ns_per_read[BATCH_IO_URING] != 0 && io->ns_per_read[BATCH_IO_PREADV] != 0;
+
+    if (io->backend == BATCH_IO_URING && !measured && n >= 2) {
+        // Half on each, so even a single scan picks the cheaper one
+        timed_read(io, BATCH_IO_URING, reads, n / 2);
+        timed_read(io, BATCH_IO_PREADV, reads + n / 2, n - n / 2);
+    } else {
+        if (io->backend == BATCH_IO_URING && ++io->batches % BATCH_IO_PROBE_BATCHES == 0)
+            use = use == BATCH_IO_URING ? BATCH_IO_PREADV : BATCH_IO_URING;
+        timed_read(io, use, reads, n);
+    }
+}
+
+const char* batch_io_backend_name(const BatchIo* io) {
+    if (batch_io_backend(io) == BATCH_IO_PREADV) return "preadv";
+    return io->registered ? "io_uring_fixed" : "io_uring";
+}
+
+unsigned long batch_io_take_syscalls(BatchIo* io) {
+    unsigned long calls = io->syscalls;
+    io->syscalls = 0;
+    return calls;
+}
@@ -0,0 +1,53 @@
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Batched positional reads of long-lived fds, such as /proc/<pid>/stat
+// kept open across scans. With io_uring the fd table is registered as
+// fixed files and a batch costs one io_uring_enter per ring's worth of
+// reads; without it (old kernel, seccomp, VMD_IO_URING=0) each read is a
+// preadv. Raw syscalls only, no liburing.
+//
+// Fewer syscalls is not always faster: procfs has no async read path, so
+// the ring punts every read to an io-wq worker. Batches are timed and go
+// to whichever backend costs less per read; the other one is re-timed
+// every BATCH_IO_PROBE_BATCHES batches.
+#define BATCH_IO_ENV "VMD_IO_URING"
+#define BATCH_IO_RING_ENTRIES 1024
+#define BATCH_IO_MIN_RING_ENTRIES 64
+#define BATCH_IO_PROBE_BATCHES 32
+
+typedef enum {
+    BATCH_IO_URING,
+    BATCH_IO_PREADV
+} BatchIoBackend;
+
+typedef struct {
+    int slot;
+    void* buf;
+    size_t len;
+    off_t offset;
+    ssize_t result;                 // Bytes read or -errno
+} BatchRead;
+
+typedef struct BatchIo BatchIo;
+
+// Table of max_files slots; NULL only when out of memory
+BatchIo* batch_io_create(int max_files);
+void batch_io_destroy(BatchIo* io);
+// Takes ownership of fd and returns its slot, or -1 when the table is full
+int batch_io_add(BatchIo* io, int fd);
+// Closes the slot's fd and frees the slot
+void batch_io_remove(BatchIo* io, int slot);
+int batch_io_free_slots(const BatchIo* io);
+// One read per entry, each result filled in; not thread-safe
+void batch_io_read(BatchIo* io, BatchRead* reads, size_t n);
+// Backend reads currently go to
+BatchIoBackend batch_io_backend(const BatchIo* io);
+const char* batch_io_backend_name(const BatchIo* io);
+// Syscalls made through io (reads, table updates, closes) since the last call
+unsigned long batch_io_take_syscalls(BatchIo* io);
+
+#endif
@@ -0,0 +1,99 @@
+// Address-to-region lookup rate of region_index on this process's own
+// maps, grown to --vmas mappings. One JSON object per line.
+#include "region_index.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static size_t g_vmas = 20000;
+static size_t g_lookups = 4000000;
+
+// Alternating protections keep neighbouring mappings from merging
+static int grow_maps(size_t count, size_t page) {
+    char* base = mmap(NULL, count * page, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) return -1;
+    for (size_t i = 0; i < count; i += 2) {
+        if (mprotect(base + i * page, page, PROT_READ) != 0) return -1;
+    }
+    return 0;
+}
+
+static void report(const char* id, const char* pattern, size_t vmas, size_t n, uint64_t ns, size_t hits) {
+    printf("{\"id\": \"%s\", \"suite\": \"region_lookup\", \"pattern\": \"%s\", \"vmas\": %zu, "
+           "\"lookups\": %zu, \"hits\": %zu, \"ns_per_lookup\": %.2f, \"lookups_per_s\": %.0f}\n",
+           id, pattern, vmas, n, hits, (double)ns / n, n * 1e9 / ns);
+    fflush(stdout);
+}
+
+static void run_pattern(const RegionIndex* index, const char* pattern, const uint64_t* addrs, int32_t* out) {
+    char id[64];
+    size_t hits = 0;
+
+    uint64_t start = now_ns();
+    for (size_t k = 0; k < g_lookups; k++) out[k] = (int32_t)region_index_lookup(index, addrs[k]);
+    uint64_t single_ns = now_ns() - start;
+    for (size_t k = 0; k < g_lookups; k++) hits += out[k] >= 0;
+    snprintf(id, sizeof(id), "lookup/%s", pattern);
+    report(id, pattern, index->count, g_lookups, single_ns, hits);
+
+    hits = 0;
+    start = now_ns();
+    region_index_lookup_batch(index, addrs, g_lookups, out);
+    uint64_t batch_ns = now_ns() - start;
+    for (size_t k = 0; k < g_lookups; k++) hits += out[k] >= 0;
+    snprintf(id, sizeof(id), "batch/%s", pattern);
+    report(id, pattern, index->count, g_lookups, batch_ns, hits);
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--vmas") == 0) g_vmas = strtoull(argv[++i], NULL, 10);
+        else if (i + 1 < argc && strcmp(argv[i], "--lookups") == 0) g_lookups = strtoull(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "usage: %s [--vmas N] [--lookups N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (g_lookups == 0) g_lookups = 1;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (grow_maps(g_vmas, page) != 0) {
+        printf("{\"id\": \"region_lookup\", \"skipped\": \"cannot map %zu regions\"}\n", g_vmas);
+        return 0;
+    }
+    RegionIndex index;
+    if (region_index_build(&index, getpid()) != 0 || index.count == 0) {
+        printf("{\"id\": \"region_lookup\", \"skipped\": \"cannot read /proc/self/maps\"}\n");
+        return 0;
+    }
+
+    uint64_t* addrs = malloc(g_lookups * sizeof(uint64_t));
+    int32_t* out = malloc(g_lookups * sizeof(int32_t));
+    if (addrs == NULL || out == NULL) return 1;
+
+    // Random: a uniformly chosen VMA, then a random offset in it
+    uint64_t rng = 0x9e3779b97f4a7c15ULL;
+    for (size_t k = 0; k < g_lookups; k++) {
+        size_t i = next_random(&rng) % index.count;
+        addrs[k] = index.starts[i] + next_random(&rng) % (index.ends[i] - index.starts[i]);
+    }
+    run_pattern(&index, "random", addrs, out);
+
+    // Sorted: the same addresses in address order, as from a page walk or
+    // a sorted heap profile, so runs fall in one VMA
+    qsort(addrs, g_lookups, sizeof(uint64_t), compare_u64);
+    run_pattern(&index, "sorted", addrs, out);
+
+    free(addrs);
+    free(out);
+    region_index_free(&index);
+    return 0;
+}
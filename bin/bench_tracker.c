@@ -0,0 +1,305 @@
+// Microbenchmarks for tracked_malloc/tracked_free and leak queries.
+// Results are printed as one JSON object per line; progress goes to stderr.
+#include "memory_tracking.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#define BENCH_CALLSITES 8
+#define QUERY_REPEATS 25
+#define BLOCK_OVERHEAD 96
+
+typedef enum { DIST_SMALL, DIST_MIXED, DIST_LARGE } SizeDist;
+typedef enum { ORDER_LIFO, ORDER_FIFO, ORDER_RANDOM } FreeOrder;
+
+static const char* dist_names[] = { "small", "mixed", "large" };
+static const char* order_names[] = { "lifo", "fifo", "random" };
+
+typedef struct {
+    const char* suite;
+    int threads;
+    SizeDist dist;
+    FreeOrder order;
+    size_t live;
+    size_t ops;
+} BenchCase;
+
+typedef struct {
+    const BenchCase* bc;
+    pthread_barrier_t* barrier;
+    uint64_t rng;
+    Histogram malloc_hist;
+    Histogram free_hist;
+    double elapsed_ns;
+} Worker;
+
+static size_t g_ops = 200000;
+static size_t g_live_max = 10000000;
+static int g_max_threads = 0;
+static const char* g_baseline = NULL;
+
+static inline size_t draw_size(SizeDist dist, uint64_t* rng) {
+    uint64_t r = next_random(rng);
+    switch (dist) {
+        case DIST_SMALL:
+            return 16 + r % 241;
+        case DIST_LARGE:
+            return 4096 + r % (60 * 1024);
+        default:
+            // 80% small, 18% medium, 2% large
+            if (r % 100 < 80) return 16 + (r >> 8) % 241;
+            if (r % 100 < 98) return 256 + (r >> 8) % 3841;
+            return 4096 + (r >> 8) % (60 * 1024);
+    }
+}
+
+static size_t mean_size(SizeDist dist) {
+    switch (dist) {
+        case DIST_SMALL: return 136;
+        case DIST_LARGE: return 34816;
+        default: return 1200;
+    }
+}
+
+static void* bench_worker(void* arg) {
+    Worker* w = arg;
+    const BenchCase* bc = w->bc;
+    size_t slots = bc->live / bc->threads;
+    if (slots == 0) slots = 1;
+    void** live = malloc(slots * sizeof(void*));
+    if (live == NULL) return NULL;
+
+    for (size_t i = 0; i < slots; i++) {
+        live[i] = tracked_malloc(draw_size(bc->dist, &w->rng), __FILE__, __LINE__ + (int)(i % BENCH_CALLSITES));
+    }
+
+    pthread_barrier_wait(w->barrier);
+    size_t head = 0;
+    uint64_t start = now_ns();
+    for (size_t op = 0; op < bc->ops; op++) {
+        size_t idx;
+        switch (bc->order) {
+            case ORDER_LIFO:
+                idx = slots - 1;
+                break;
+            case ORDER_FIFO:
+                idx = head;
+                head = head + 1 == slots ? 0 : head + 1;
+                break;
+            default:
+                idx = next_random(&w->rng) % slots;
+        }
+        size_t size = draw_size(bc->dist, &w->rng);
+
+        uint64_t t0 = now_ns();
+        tracked_free(live[idx]);
+        uint64_t t1 = now_ns();
+        live[idx] = tracked_malloc(size, __FILE__, __LINE__ + (int)(op % BENCH_CALLSITES));
+        uint64_t t2 = now_ns();
+
+        if (live[idx] != NULL) *(volatile char*)live[idx] = 1;
+        hist_record(&w->free_hist, t1 - t0);
+        hist_record(&w->malloc_hist, t2 - t1);
+    }
+    w->elapsed_ns = (double)(now_ns() - start);
+
+    for (size_t i = 0; i < slots; i++) tracked_free(live[i]);
+    free(live);
+    return NULL;
+}
+
+static size_t mem_available_bytes(void) {
+    FILE* meminfo = fopen("/proc/meminfo", "r");
+    if (!meminfo) return 0;
+    char line[256];
+    unsigned long kb = 0;
+    while (fgets(line, sizeof(line), meminfo)) {
+        if (sscanf(line, "MemAvailable: %lu", &kb) == 1) break;
+    }
+    fclose(meminfo);
+    return kb * 1024;
+}
+
+// Looks up ops_per_sec for the same case id in a previous results file
+static double baseline_ops_per_sec(const char* id) {
+    if (g_baseline == NULL) return 0;
+    FILE* fp = fopen(g_baseline, "r");
+    if (!fp) return 0;
+
+    char key[256];
+    char line[2048];
+    double value = 0;
+    snprintf(key, sizeof(key), "\"id\": \"%s\"", id);
+    while (fgets(line, sizeof(line), fp)) {
+        if (strstr(line, key) == NULL) continue;
+        char* field = strstr(line, "\"ops_per_sec\": ");
+        if (field) value = strtod(field + 15, NULL);
+        break;
+    }
+    fclose(fp);
+    return value;
+}
+
+static void print_latency(const char* name, const Histogram* h) {
+    printf("\"%s\": {\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu}",
+           name,
+           (unsigned long long)hist_percentile(h, 0.50),
+           (unsigned long long)hist_percentile(h, 0.90),
+           (unsigned long long)hist_percentile(h, 0.99),
+           (unsigned long long)hist_percentile(h, 0.999));
+}
+
+static void run_case(const BenchCase* bc) {
+    char id[128];
+    snprintf(id, sizeof(id), "%s/t%d/%s/%s/%zu", bc->suite, bc->threads,
+             dist_names[bc->dist], order_names[bc->order], bc->live);
+
+    size_t needed = bc->live * (mean_size(bc->dist) + BLOCK_OVERHEAD);
+    size_t available = mem_available_bytes();
+    if (available != 0 && needed > available / 2) {
+        printf("{\"id\": \"%s\", \"skipped\": \"needs ~%zu MB, %zu MB available\"}\n",
+               id, needed >> 20, available >> 20);
+        fflush(stdout);
+        return;
+    }
+    fprintf(stderr, "running %s\n", id);
+
+    Worker* workers = calloc(bc->threads, sizeof(Worker));
+    pthread_t* tids = calloc(bc->threads, sizeof(pthread_t));
+    if (!workers || !tids) {
+        free(workers);
+        free(tids);
+        return;
+    }
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, bc->threads);
+
+    for (int t = 0; t < bc->threads; t++) {
+        workers[t].bc = bc;
+        workers[t].barrier = &barrier;
+        workers[t].rng = 0x9e3779b97f4a7c15ULL * (t + 1);
+        pthread_create(&tids[t], NULL, bench_worker, &workers[t]);
+    }
+    for (int t = 0; t < bc->threads; t++) pthread_join(tids[t], NULL);
+    pthread_barrier_destroy(&barrier);
+
+    Histogram* malloc_hist = calloc(1, sizeof(Histogram));
+    Histogram* free_hist = calloc(1, sizeof(Histogram));
+    double slowest = 0;
+    for (int t = 0; t < bc->threads; t++) {
+        hist_merge(malloc_hist, &workers[t].malloc_hist);
+        hist_merge(free_hist, &workers[t].free_hist);
+        if (workers[t].elapsed_ns > slowest) slowest = workers[t].elapsed_ns;
+    }
+    double ops_per_sec = slowest > 0 ? bc->ops * bc->threads / (slowest / 1e9) : 0;
+    double baseline = baseline_ops_per_sec(id);
+
+    printf("{\"id\": \"%s\", \"suite\": \"%s\", \"threads\": %d, \"dist\": \"%s\", "
+           "\"order\": \"%s\", \"live\": %zu, \"ops\": %zu, \"sample_bytes\": %zu, "
+           "\"ops_per_sec\": %.0f, ",
+           id, bc->suite, bc->threads, dist_names[bc->dist], order_names[bc->order],
+           bc->live, bc->ops * bc->threads, tracker_sample_interval(), ops_per_sec);
+    print_latency("malloc_ns", malloc_hist);
+    printf(", ");
+    print_latency("free_ns", free_hist);
+    if (baseline > 0) printf(", \"vs_baseline\": %.3f", ops_per_sec / baseline);
+    printf("}\n");
+    fflush(stdout);
+
+    free(malloc_hist);
+    free(free_hist);
+    free(workers);
+    free(tids);
+}
+
+static void run_query_case(size_t live) {
+    char id[64];
+    snprintf(id, sizeof(id), "query/%zu", live);
+
+    size_t available = mem_available_bytes();
+    if (available != 0 && live * (mean_size(DIST_MIXED) + BLOCK_OVERHEAD) > available / 2) {
+        printf("{\"id\": \"%s\", \"skipped\": \"insufficient memory\"}\n", id);
+        return;
+    }
+    fprintf(stderr, "running %s\n", id);
+
+    void** blocks = malloc(live * sizeof(void*));
+    if (blocks == NULL) return;
+    uint64_t rng = 42;
+    for (size_t i = 0; i < live; i++)
+        blocks[i] = tracked_malloc(draw_size(DIST_MIXED, &rng), __FILE__, __LINE__ + (int)(i % BENCH_CALLSITES));
+
+    Histogram* hist = calloc(1, sizeof(Histogram));
+    CallsiteStats top[20];
+    for (int r = 0; hist != NULL && r < QUERY_REPEATS; r++) {
+        uint64_t t0 = now_ns();
+        tracker_top_callsites(top, 20, NULL);
+        hist_record(hist, now_ns() - t0);
+    }
+    if (hist != NULL) {
+        printf("{\"id\": \"%s\", \"suite\": \"query\", \"live\": %zu, ", id, live);
+        print_latency("top_callsites_ns", hist);
+        printf("}\n");
+        fflush(stdout);
+    }
+
+    for (size_t i = 0; i < live; i++) tracked_free(blocks[i]);
+    free(blocks);
+    free(hist);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--ops N] [--threads N] [--live-max N] [--sample BYTES] [--baseline FILE]\n"
+            "  --ops       operations per thread per case (default %zu)\n"
+            "  --threads   largest thread count in the scalability suite (default: CPUs)\n"
+            "  --live-max  largest live-set size (default %zu)\n"
+            "  --sample    run with sampling mode at this interval\n"
+            "  --baseline  previous output to compare ops_per_sec against\n",
+            prog, g_ops, g_live_max);
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--ops") == 0) g_ops = strtoull(argv[++i], NULL, 10);
+        else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) g_max_threads = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--live-max") == 0) g_live_max = strtoull(argv[++i], NULL, 10);
+        else if (i + 1 < argc && strcmp(argv[i], "--sample") == 0) tracker_set_sample_interval(strtoull(argv[++i], NULL, 10));
+        else if (i + 1 < argc && strcmp(argv[i], "--baseline") == 0) g_baseline = argv[++i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (g_max_threads <= 0) g_max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (g_max_threads <= 0) g_max_threads = 1;
+
+    // Scalability: mixed sizes, random frees, 100K live blocks
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > g_max_threads) threads = g_max_threads;
+        BenchCase bc = { "threads", threads, DIST_MIXED, ORDER_RANDOM, 100000, g_ops };
+        run_case(&bc);
+        if (threads == g_max_threads) break;
+    }
+
+    // Size distribution x free order on one thread
+    for (int dist = DIST_SMALL; dist <= DIST_LARGE; dist++) {
+        for (int order = ORDER_LIFO; order <= ORDER_RANDOM; order++) {
+            BenchCase bc = { "pattern", 1, dist, order, 100000, g_ops };
+            run_case(&bc);
+        }
+    }
+
+    // Live-set size sweep and leak query latency
+    for (size_t live = 1000; live <= g_live_max; live *= 10) {
+        BenchCase bc = { "live", 1, DIST_MIXED, ORDER_RANDOM, live, g_ops };
+        run_case(&bc);
+        run_query_case(live);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+// Timing and latency histogram helpers shared by the benchmarks
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define HIST_SUB_BUCKETS 16
+#define HIST_BUCKETS (64 * HIST_SUB_BUCKETS)
+
+// Log-linear latency histogram: 16 sub-buckets per power of two
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+} Histogram;
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Cheapest available timestamp; convert with a ticks/ns ratio measured
+// against now_ns over the same run
+static inline uint64_t bench_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return now_ns();
+#endif
+}
+
+static inline uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static inline void hist_record(Histogram* h, uint64_t value) {
+    int index;
+    if (value < HIST_SUB_BUCKETS) {
+        index = (int)value;
+    } else {
+        int lg = 63 - __builtin_clzll(value);
+        int sub = (int)((value >> (lg - 4)) & (HIST_SUB_BUCKETS - 1));
+        index = (lg - 3) * HIST_SUB_BUCKETS + sub;
+    }
+    h->counts[index < HIST_BUCKETS ? index : HIST_BUCKETS - 1]++;
+    h->total++;
+}
+
+static inline uint64_t hist_bucket_value(int index) {
+    if (index < HIST_SUB_BUCKETS) return (uint64_t)index;
+    int lg = index / HIST_SUB_BUCKETS + 3;
+    int sub = index % HIST_SUB_BUCKETS;
+    return (1ULL << lg) + ((uint64_t)sub << (lg - 4));
+}
+
+static inline uint64_t hist_percentile(const Histogram* h, double fraction) {
+    uint64_t target = (uint64_t)(h->total * fraction);
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > target) return hist_bucket_value(i);
+    }
+    return 0;
+}
+
+static inline void hist_merge(Histogram* into, const Histogram* from) {
+    for (int i = 0; i < HIST_BUCKETS; i++) into->counts[i] += from->counts[i];
+    into->total += from->total;
+}
+
+#endif
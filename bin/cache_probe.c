@@ -0,0 +1,510 @@
+#define _GNU_SOURCE
+#include "cache_probe.h"
+#include "bench_util.h"
+#include "state_dir.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+
+#define PROBE_LINE 64
+#define PROBE_MIN_BYTES 4096
+#define CHASE_LOADS (1UL << 21)
+#define STREAM_REPS 5
+#define STREAM_MIN_ARRAY (32UL << 20)
+#define STREAM_MAX_ARRAY (256UL << 20)
+#define PROBE_DEFAULT_MIN (64UL << 20)
+#define PROBE_DEFAULT_MAX (1UL << 30)
+#define STEP_RISE 1.3           // Growth over a plateau's lowest point that ends it
+#define STEP_FLAT 1.1           // Point-to-point growth below which a new plateau starts
+
+// Compile the kernels for several ISAs and let the loader pick, so one
+// binary reports comparable numbers on every host generation
+#if defined(__x86_64__) && defined(__GNUC__)
+#define STREAM_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define STREAM_KERNEL
+#endif
+
+enum { STREAM_COPY, STREAM_SCALE, STREAM_ADD, STREAM_TRIAD, STREAM_KERNELS };
+
+// Bytes moved per element, counted the way STREAM does
+static const int g_stream_bytes[STREAM_KERNELS] = { 16, 16, 24, 24 };
+
+static void* volatile g_chase_sink;
+
+static size_t parse_cache_size(const char* s) {
+    char* end;
+    size_t size = strtoull(s, &end, 10);
+    if (*end == 'K') size <<= 10;
+    else if (*end == 'M') size <<= 20;
+    else if (*end == 'G') size <<= 30;
+    return size;
+}
+
+static int read_sysfs_line(const char* path, char* buf, size_t len) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return -1;
+    int ok = fgets(buf, len, f) != NULL;
+    fclose(f);
+    if (!ok) return -1;
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+static int compare_levels(const void* a, const void* b) {
+    const CacheLevel* la = a;
+    const CacheLevel* lb = b;
+    if (la->level != lb->level) return la->level - lb->level;
+    return strcmp(la->type, lb->type);
+}
+
+int read_cache_topology(CacheLevel* levels, int max) {
+    char path[128], buf[64];
+    int count = 0;
+
+    for (int index = 0; count < max; index++) {
+        CacheLevel* l = &levels[count];
+        memset(l, 0, sizeof(*l));
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+        if (read_sysfs_line(path, buf, sizeof(buf)) != 0) break;
+        l->level = atoi(buf);
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+        if (read_sysfs_line(path, l->type, sizeof(l->type)) != 0) strcpy(l->type, "Unknown");
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) l->size = parse_cache_size(buf);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/coherency_line_size", index);
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) l->line_size = atoi(buf);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/ways_of_associativity", index);
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) l->ways = atoi(buf);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/number_of_sets", index);
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) l->sets = atoi(buf);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/shared_cpu_list", index);
+        if (read_sysfs_line(path, l->shared_cpus, sizeof(l->shared_cpus)) != 0) l->shared_cpus[0] = '\0';
+        count++;
+    }
+    qsort(levels, count, sizeof(CacheLevel), compare_levels);
+    return count;
+}
+
+static void read_cpu_model(char* buf, size_t len) {
+    char line[256];
+    buf[0] = '\0';
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    if (f == NULL) return;
+    while (fgets(line, sizeof(line), f)) {
+        char* colon = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && colon != NULL) {
+            snprintf(buf, len, "%s", colon + 2);
+            buf[strcspn(buf, "\n")] = '\0';
+            break;
+        }
+    }
+    fclose(f);
+}
+
+// Mean latency of a dependent load chain visiting every line of the first
+// bytes of buf once per lap, in an order no prefetcher can follow
+static double chase_latency(char* buf, size_t bytes, uint64_t* seed) {
+    size_t lines = bytes / PROBE_LINE;
+
+    // Sattolo's shuffle gives a single cycle through all lines
+    for (size_t i = 0; i < lines; i++) *(size_t*)(buf + i * PROBE_LINE) = i;
+    for (size_t i = lines - 1; i > 0; i--) {
+        size_t j = next_random(seed) % i;
+        size_t* a = (size_t*)(buf + i * PROBE_LINE);
+        size_t* b = (size_t*)(buf + j * PROBE_LINE);
+        size_t tmp = *a;
+        *a = *b;
+        *b = tmp;
+    }
+    for (size_t i = 0; i < lines; i++) {
+        char** slot = (char**)(buf + i * PROBE_LINE);
+        *slot = buf + *(size_t*)slot * PROBE_LINE;
+    }
+
+    char** p = (char**)buf;
+    size_t warm = lines < CHASE_LOADS ? lines : CHASE_LOADS;
+    for (size_t i = 0; i < warm; i++) p = (char**)*p;
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < CHASE_LOADS; i++) p = (char**)*p;
+    uint64_t elapsed = now_ns() - start;
+    g_chase_sink = p;
+    return (double)elapsed / CHASE_LOADS;
+}
+
+static const char* label_step(size_t start_bytes, const CacheLevel* levels, int num_levels) {
+    static char names[CACHE_MAX_LEVELS][8];
+
+    // The first cache bigger than the plateau's smallest working set; a
+    // set exactly the size of a cache already misses it
+    for (int i = 0; i < num_levels; i++) {
+        if (strcmp(levels[i].type, "Instruction") == 0 || levels[i].size <= start_bytes) continue;
+        snprintf(names[i], sizeof(names[i]), "L%d", levels[i].level);
+        return names[i];
+    }
+    return "DRAM";
+}
+
+// Splits the curve into plateaus: a plateau runs until latency grows by
+// STEP_RISE over its lowest point, and the rising points after it are
+// skipped until the curve flattens again
+static int detect_steps(const LatencyPoint* points, int n, const CacheLevel* levels, int num_levels,
+                        LatencyStep* steps, int max) {
+    int count = 0;
+    int i = 0;
+    while (i < n && count < max) {
+        size_t start_bytes = points[i].bytes;
+        double base = points[i].ns;
+        double sum = 0;
+        int len = 0;
+        while (i < n && points[i].ns <= base * STEP_RISE) {
+            if (points[i].ns < base) base = points[i].ns;
+            sum += points[i].ns;
+            len++;
+            i++;
+        }
+
+        LatencyStep* s = &steps[count++];
+        snprintf(s->name, sizeof(s->name), "%s", label_step(start_bytes, levels, num_levels));
+        s->bytes = points[i - 1].bytes;
+        s->ns = sum / len;
+        s->bounded = i < n;
+        while (i + 1 < n && points[i + 1].ns > points[i].ns * STEP_FLAT) i++;
+    }
+    return count;
+}
+
+typedef struct {
+    int count;
+    int waiting;
+    int generation;
+} SpinBarrier;
+
+// Workers are started one by one and some may fail to start, so the
+// barrier is sized only once they are all running
+static void spin_barrier_wait(SpinBarrier* b) {
+    int generation = __atomic_load_n(&b->generation, __ATOMIC_ACQUIRE);
+    if (__atomic_add_fetch(&b->waiting, 1, __ATOMIC_ACQ_REL) == b->count) {
+        __atomic_store_n(&b->waiting, 0, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&b->generation, 1, __ATOMIC_RELEASE);
+        return;
+    }
+    while (__atomic_load_n(&b->generation, __ATOMIC_ACQUIRE) == generation) sched_yield();
+}
+
+STREAM_KERNEL
+static void stream_copy(double* restrict c, const double* restrict a, size_t n) {
+    for (size_t i = 0; i < n; i++) c[i] = a[i];
+}
+
+STREAM_KERNEL
+static void stream_scale(double* restrict b, const double* restrict c, double q, size_t n) {
+    for (size_t i = 0; i < n; i++) b[i] = q * c[i];
+}
+
+STREAM_KERNEL
+static void stream_add(double* restrict c, const double* restrict a, const double* restrict b, size_t n) {
+    for (size_t i = 0; i < n; i++) c[i] = a[i] + b[i];
+}
+
+STREAM_KERNEL
+static void stream_triad(double* restrict a, const double* restrict b, const double* restrict c,
+                         double q, size_t n) {
+    for (size_t i = 0; i < n; i++) a[i] = b[i] + q * c[i];
+}
+
+static const char* stream_isa(void) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return "avx512f";
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    return "sse2";
+#else
+    return "default";
+#endif
+}
+
+typedef struct {
+    double* a;
+    double* b;
+    double* c;
+    size_t n;
+    int id;
+    const int* go;
+    const int* active;
+    SpinBarrier* barrier;
+    double* best_ns;        // Written by worker 0
+} StreamWorker;
+
+static void* stream_worker(void* arg) {
+    StreamWorker* w = arg;
+    while (!__atomic_load_n(w->go, __ATOMIC_ACQUIRE)) sched_yield();
+
+    int active = *w->active;
+    size_t lo = w->n * w->id / active;
+    size_t n = w->n * (w->id + 1) / active - lo;
+    double* a = w->a + lo;
+    double* b = w->b + lo;
+    double* c = w->c + lo;
+
+    // Each thread first-touches its own slice so pages land on its node
+    for (size_t i = 0; i < n; i++) {
+        a[i] = 1.0;
+        b[i] = 2.0;
+        c[i] = 0.0;
+    }
+
+    for (int rep = 0; rep < STREAM_REPS; rep++) {
+        for (int k = 0; k < STREAM_KERNELS; k++) {
+            spin_barrier_wait(w->barrier);
+            uint64_t start = now_ns();
+            switch (k) {
+                case STREAM_COPY: stream_copy(c, a, n); break;
+                case STREAM_SCALE: stream_scale(b, c, 3.0, n); break;
+                case STREAM_ADD: stream_add(c, a, b, n); break;
+                default: stream_triad(a, b, c, 3.0, n); break;
+            }
+            spin_barrier_wait(w->barrier);
+            double elapsed = now_ns() - start;
+            if (w->id == 0 && (rep == 0 || elapsed < w->best_ns[k])) w->best_ns[k] = elapsed;
+        }
+    }
+    return NULL;
+}
+
+static int run_stream(double* a, double* b, double* c, size_t n, int threads, BandwidthResult* r) {
+    StreamWorker workers[CACHE_PROBE_MAX_THREADS];
+    pthread_t tids[CACHE_PROBE_MAX_THREADS];
+    SpinBarrier barrier = { 0, 0, 0 };
+    double best_ns[STREAM_KERNELS] = { 0 };
+    int go = 0, active = 1;
+
+    for (int i = 0; i < threads; i++) {
+        workers[i] = (StreamWorker){ .a = a, .b = b, .c = c, .n = n, .id = i, .go = &go,
+                                     .active = &active, .barrier = &barrier, .best_ns = best_ns };
+    }
+    // The caller runs worker 0
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, stream_worker, &workers[i]) != 0) break;
+        active++;
+    }
+    barrier.count = active;
+    __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+    stream_worker(&workers[0]);
+    for (int i = 1; i < active; i++) pthread_join(tids[i], NULL);
+
+    double elems = n;
+    r->threads = active;
+    r->copy = best_ns[STREAM_COPY] ? elems * g_stream_bytes[STREAM_COPY] / best_ns[STREAM_COPY] : 0;
+    r->scale = best_ns[STREAM_SCALE] ? elems * g_stream_bytes[STREAM_SCALE] / best_ns[STREAM_SCALE] : 0;
+    r->add = best_ns[STREAM_ADD] ? elems * g_stream_bytes[STREAM_ADD] / best_ns[STREAM_ADD] : 0;
+    r->triad = best_ns[STREAM_TRIAD] ? elems * g_stream_bytes[STREAM_TRIAD] / best_ns[STREAM_TRIAD] : 0;
+    return active;
+}
+
+static void* map_probe_buffer(size_t bytes) {
+    void* buf = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) return NULL;
+    // Huge pages keep TLB misses out of the cache curve where THP allows
+    madvise(buf, bytes, MADV_HUGEPAGE);
+    return buf;
+}
+
+static size_t largest_cache(const CacheLevel* levels, int count) {
+    size_t largest = 0;
+    for (int i = 0; i < count; i++) {
+        if (levels[i].size > largest) largest = levels[i].size;
+    }
+    return largest;
+}
+
+static void save_cache(const CacheProbeResult* r) {
+    char path[256];
+    struct utsname uts;
+    if (vmd_state_path(path, sizeof(path), CACHE_PROBE_CACHE) != 0 || uname(&uts) != 0) return;
+
+    FILE* f = vmd_state_fopen(path, "w");
+    if (f == NULL) return;
+    fprintf(f, "# vmd cache probe v1 %ld %s\n", r->measured_at, uts.release);
+    fprintf(f, "array %zu\n", r->array_bytes);
+    for (int i = 0; i < r->num_points; i++)
+        fprintf(f, "point %zu %.2f\n", r->points[i].bytes, r->points[i].ns);
+    for (int i = 0; i < r->num_steps; i++)
+        fprintf(f, "step %s %zu %.2f %d\n", r->steps[i].name, r->steps[i].bytes, r->steps[i].ns,
+                r->steps[i].bounded);
+    for (int i = 0; i < r->num_bandwidth; i++) {
+        const BandwidthResult* b = &r->bandwidth[i];
+        fprintf(f, "bw %d %.3f %.3f %.3f %.3f\n", b->threads, b->copy, b->scale, b->add, b->triad);
+    }
+    fclose(f);
+}
+
+int run_cache_probe(CacheProbeResult* result, size_t max_bytes, int max_threads) {
+    CacheLevel levels[CACHE_MAX_LEVELS];
+    int num_levels = read_cache_topology(levels, CACHE_MAX_LEVELS);
+    size_t llc = largest_cache(levels, num_levels);
+    size_t avail = (size_t)sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+    uint64_t seed = 0x9E3779B97F4A7C15ULL ^ now_ns();
+
+    memset(result, 0, sizeof(*result));
+    if (max_bytes == 0) {
+        // Far enough past the LLC to see a DRAM plateau
+        max_bytes = llc * 4;
+        if (max_bytes < PROBE_DEFAULT_MIN) max_bytes = PROBE_DEFAULT_MIN;
+        if (max_bytes > PROBE_DEFAULT_MAX) max_bytes = PROBE_DEFAULT_MAX;
+    }
+    if (avail && max_bytes > avail / 2) max_bytes = avail / 2;
+    if (max_bytes < PROBE_MIN_BYTES) max_bytes = PROBE_MIN_BYTES;
+    if (max_threads <= 0) max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > CACHE_PROBE_MAX_THREADS) max_threads = CACHE_PROBE_MAX_THREADS;
+
+    char* buf = map_probe_buffer(max_bytes);
+    if (buf == NULL) return -1;
+    // Discarded run so clock ramp-up does not land on the first point
+    chase_latency(buf, PROBE_MIN_BYTES, &seed);
+    // Working sets grow by alternating factors of 1.5 and 4/3, about sqrt(2)
+    for (int k = 0; result->num_points < CACHE_PROBE_MAX_POINTS; k++) {
+        size_t bytes = (size_t)PROBE_MIN_BYTES << (k / 2);
+        if (k & 1) bytes += bytes / 2;
+        if (bytes > max_bytes) break;
+        LatencyPoint* p = &result->points[result->num_points++];
+        p->bytes = bytes;
+        p->ns = chase_latency(buf, bytes, &seed);
+    }
+    munmap(buf, max_bytes);
+    result->num_steps = detect_steps(result->points, result->num_points, levels, num_levels,
+                                     result->steps, CACHE_PROBE_MAX_STEPS);
+
+    size_t array_bytes = llc * 4;
+    if (array_bytes < STREAM_MIN_ARRAY) array_bytes = STREAM_MIN_ARRAY;
+    if (array_bytes > STREAM_MAX_ARRAY) array_bytes = STREAM_MAX_ARRAY;
+    if (avail && array_bytes > avail / 8) array_bytes = avail / 8;
+    size_t n = array_bytes / sizeof(double);
+    double* a = map_probe_buffer(n * sizeof(double));
+    double* b = map_probe_buffer(n * sizeof(double));
+    double* c = map_probe_buffer(n * sizeof(double));
+    if (a != NULL && b != NULL && c != NULL) {
+        result->array_bytes = n * sizeof(double);
+        for (int threads = 1; result->num_bandwidth < CACHE_PROBE_MAX_BW; threads *= 2) {
+            if (threads > max_threads) threads = max_threads;
+            BandwidthResult* r = &result->bandwidth[result->num_bandwidth++];
+            // Fresh pages each run so first touch matches the thread layout
+            madvise(a, n * sizeof(double), MADV_DONTNEED);
+            madvise(b, n * sizeof(double), MADV_DONTNEED);
+            madvise(c, n * sizeof(double), MADV_DONTNEED);
+            if (run_stream(a, b, c, n, threads, r) < threads || threads == max_threads) break;
+        }
+    }
+    if (a != NULL) munmap(a, n * sizeof(double));
+    if (b != NULL) munmap(b, n * sizeof(double));
+    if (c != NULL) munmap(c, n * sizeof(double));
+
+    result->measured_at = (long)time(NULL);
+    save_cache(result);
+    return 0;
+}
+
+int load_cache_probe(CacheProbeResult* result) {
+    char path[256], release[128], line[256], name[8];
+    struct utsname uts;
+    if (vmd_state_path(path, sizeof(path), CACHE_PROBE_CACHE) != 0 || uname(&uts) != 0) return -1;
+
+    FILE* f = vmd_state_fopen(path, "r");
+    if (f == NULL) return -1;
+    memset(result, 0, sizeof(*result));
+    if (fgets(line, sizeof(line), f) == NULL ||
+        sscanf(line, "# vmd cache probe v1 %ld %127s", &result->measured_at, release) != 2 ||
+        strcmp(release, uts.release) != 0) {
+        fclose(f);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        LatencyPoint* p = &result->points[result->num_points];
+        LatencyStep* s = &result->steps[result->num_steps];
+        BandwidthResult* b = &result->bandwidth[result->num_bandwidth];
+        if (sscanf(line, "array %zu", &result->array_bytes) == 1) continue;
+        if (result->num_points < CACHE_PROBE_MAX_POINTS &&
+            sscanf(line, "point %zu %lf", &p->bytes, &p->ns) == 2) {
+            result->num_points++;
+        } else if (result->num_steps < CACHE_PROBE_MAX_STEPS &&
+                   sscanf(line, "step %7s %zu %lf %d", name, &s->bytes, &s->ns, &s->bounded) == 4) {
+            snprintf(s->name, sizeof(s->name), "%s", name);
+            result->num_steps++;
+        } else if (result->num_bandwidth < CACHE_PROBE_MAX_BW &&
+                   sscanf(line, "bw %d %lf %lf %lf %lf", &b->threads, &b->copy, &b->scale, &b->add,
+                          &b->triad) == 5) {
+            result->num_bandwidth++;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static void output_topology_json(void) {
+    CacheLevel levels[CACHE_MAX_LEVELS];
+    char model[128];
+    int count = read_cache_topology(levels, CACHE_MAX_LEVELS);
+    read_cpu_model(model, sizeof(model));
+
+    printf("  \"cache_topology\": {\"cpu_model\": \"%s\", \"levels\": [", model);
+    for (int i = 0; i < count; i++) {
+        CacheLevel* l = &levels[i];
+        printf("%s\n    {\"level\": %d, \"type\": \"%s\", \"size\": %zu, \"line_size\": %d, \"ways\": %d, "
+               "\"sets\": %d, \"shared_cpus\": \"%s\"}",
+               i ? "," : "", l->level, l->type, l->size, l->line_size, l->ways, l->sets, l->shared_cpus);
+    }
+    printf("%s]},\n", count ? "\n  " : "");
+}
+
+// Prints "cache_probe" without a trailing comma or newline
+static void output_probe_result_json(const CacheProbeResult* r) {
+    if (r == NULL) {
+        printf("  \"cache_probe\": {\"available\": false}");
+        return;
+    }
+
+    printf("  \"cache_probe\": {\"available\": true, \"measured_at\": %ld, \"latency\": [", r->measured_at);
+    for (int i = 0; i < r->num_points; i++)
+        printf("%s{\"bytes\": %zu, \"ns\": %.2f}", i ? ", " : "", r->points[i].bytes, r->points[i].ns);
+    printf("],\n    \"steps\": [");
+    for (int i = 0; i < r->num_steps; i++) {
+        const LatencyStep* s = &r->steps[i];
+        printf("%s{\"level\": \"%s\", \"bytes\": %zu, \"ns\": %.2f, \"bounded\": %s}",
+               i ? ", " : "", s->name, s->bytes, s->ns, s->bounded ? "true" : "false");
+    }
+    printf("],\n    \"bandwidth\": {\"isa\": \"%s\", \"array_bytes\": %zu, \"results\": [",
+           stream_isa(), r->array_bytes);
+    for (int i = 0; i < r->num_bandwidth; i++) {
+        const BandwidthResult* b = &r->bandwidth[i];
+        printf("%s{\"threads\": %d, \"copy_gbps\": %.2f, \"scale_gbps\": %.2f, \"add_gbps\": %.2f, "
+               "\"triad_gbps\": %.2f}",
+               i ? ", " : "", b->threads, b->copy, b->scale, b->add, b->triad);
+    }
+    printf("]}}");
+}
+
+void output_cache_probe_json(size_t max_bytes, int max_threads) {
+    static CacheProbeResult result;
+    int ok = run_cache_probe(&result, max_bytes, max_threads) == 0;
+
+    printf("{\n");
+    output_topology_json();
+    output_probe_result_json(ok ? &result : NULL);
+    printf("\n}\n");
+}
+
+void output_cache_hierarchy_json(void) {
+    static CacheProbeResult result;
+    output_topology_json();
+    output_probe_result_json(load_cache_probe(&result) == 0 ? &result : NULL);
+    printf(",\n");
+}
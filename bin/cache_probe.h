@@ -0,0 +1,67 @@
+#ifndef CACHE_PROBE_H
+#define CACHE_PROBE_H
+
+#include <stddef.h>
+
+// Last probe is cached here (in the state dir) for the hierarchy page
+#define CACHE_PROBE_CACHE "cache_probe.txt"
+#define CACHE_MAX_LEVELS 8
+#define CACHE_PROBE_MAX_POINTS 64
+#define CACHE_PROBE_MAX_STEPS 8
+#define CACHE_PROBE_MAX_THREADS 16
+#define CACHE_PROBE_MAX_BW 8
+
+typedef struct {
+    int level;
+    char type[16];          // Data, Instruction or Unified
+    size_t size;
+    int line_size;
+    int ways;
+    int sets;
+    char shared_cpus[64];
+} CacheLevel;
+
+typedef struct {
+    size_t bytes;           // Working set size
+    double ns;              // Mean dependent load latency
+} LatencyPoint;
+
+// A plateau of the latency curve; bytes is the largest working set that
+// still ran at its latency, i.e. the measured capacity unless !bounded
+typedef struct {
+    char name[8];           // L1, L2, L3 or DRAM
+    size_t bytes;
+    double ns;
+    int bounded;
+} LatencyStep;
+
+typedef struct {
+    int threads;
+    double copy;            // GB/s, STREAM byte counting
+    double scale;
+    double add;
+    double triad;
+} BandwidthResult;
+
+typedef struct {
+    long measured_at;
+    size_t array_bytes;     // Per STREAM array
+    int num_points;
+    LatencyPoint points[CACHE_PROBE_MAX_POINTS];
+    int num_steps;
+    LatencyStep steps[CACHE_PROBE_MAX_STEPS];
+    int num_bandwidth;
+    BandwidthResult bandwidth[CACHE_PROBE_MAX_BW];
+} CacheProbeResult;
+
+// cpu0's caches from sysfs, ordered by level
+int read_cache_topology(CacheLevel* levels, int max);
+// Pointer-chase latency from 4 KB up to max_bytes and STREAM bandwidth
+// for 1..max_threads threads; 0 picks defaults from the topology
+int run_cache_probe(CacheProbeResult* result, size_t max_bytes, int max_threads);
+int load_cache_probe(CacheProbeResult* result);
+void output_cache_probe_json(size_t max_bytes, int max_threads);
+// Prints the topology and cached probe sections of the hierarchy JSON
+void output_cache_hierarchy_json(void);
+
+#endif
@@ -0,0 +1,41 @@
+#include "cgroup.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+// Returns -1 when the file is missing; "max" reads as 0
+static int read_u64_file(const char* path, unsigned long long* out) {
+    char buf[64];
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return -1;
+    int ok = fgets(buf, sizeof(buf), f) != NULL;
+    fclose(f);
+    if (!ok) return -1;
+    *out = strtoull(buf, NULL, 10);
+    return 0;
+}
+
+int read_cgroups(CgroupMemory* groups, int max) {
+    char path[512];
+    int count = 0;
+    DIR* dir = opendir(CGROUP_ROOT);
+    if (dir == NULL) return 0;
+
+    struct dirent* entry;
+    while (count < max && (entry = readdir(dir)) != NULL) {
+        if (entry->d_type != DT_DIR || entry->d_name[0] == '.') continue;
+        CgroupMemory* g = &groups[count];
+        memset(g, 0, sizeof(*g));
+        snprintf(path, sizeof(path), CGROUP_ROOT "/%s/memory.current", entry->d_name);
+        if (read_u64_file(path, &g->current) != 0) continue;
+        snprintf(path, sizeof(path), CGROUP_ROOT "/%s/memory.swap.current", entry->d_name);
+        read_u64_file(path, &g->swap_current);
+        snprintf(path, sizeof(path), CGROUP_ROOT "/%s/memory.max", entry->d_name);
+        read_u64_file(path, &g->max);
+        snprintf(g->name, sizeof(g->name), "%.63s", entry->d_name);
+        count++;
+    }
+    closedir(dir);
+    return count;
+}
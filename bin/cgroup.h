@@ -0,0 +1,13 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include "memory_types.h"
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#define CGROUP_MAX_GROUPS 16
+
+// Memory usage of the top-level cgroup v2 groups (deeper ones would crowd
+// out everything else); returns the number read
+int read_cgroups(CgroupMemory* groups, int max);
+
+#endif
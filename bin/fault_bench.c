@@ -0,0 +1,284 @@
+#define _GNU_SOURCE
+#include "fault_bench.h"
+#include "bench_util.h"
+#include "state_dir.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+#include <time.h>
+
+#define HUGE_PAGE (2UL << 20)
+
+typedef enum { FAULT_ANON, FAULT_THP, FAULT_FILE, FAULT_HUGETLB } FaultKind;
+
+typedef struct {
+    const char* name;
+    FaultKind kind;
+    size_t step;            // One fault per step bytes
+    size_t region;
+    int rounds;
+} FaultCase;
+
+static const FaultCase g_cases[] = {
+    { "anon_4k", FAULT_ANON, 4096, 16UL << 20, 4 },
+    { "anon_thp", FAULT_THP, HUGE_PAGE, 32UL << 20, 4 },
+    { "file", FAULT_FILE, 4096, 16UL << 20, 4 },
+    { "hugetlb", FAULT_HUGETLB, HUGE_PAGE, 16UL << 20, 2 },
+};
+#define NUM_CASES (sizeof(g_cases) / sizeof(g_cases[0]))
+
+typedef struct {
+    const FaultCase* fc;
+    const int* go;
+    int fd;
+    int failed;
+    uint64_t ticks;
+    Histogram hist;
+} FaultWorker;
+
+static int thp_enabled(void) {
+    char buf[128];
+    FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (f == NULL) return 0;
+    int ok = fgets(buf, sizeof(buf), f) != NULL;
+    fclose(f);
+    return ok && strstr(buf, "[never]") == NULL;
+}
+
+static char* map_region(FaultWorker* w) {
+    const FaultCase* fc = w->fc;
+    char* addr;
+
+    switch (fc->kind) {
+        case FAULT_THP: {
+            // Over-map so the region can start on a huge page boundary
+            char* raw = mmap(NULL, fc->region + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED) return NULL;
+            addr = (char*)(((unsigned long)raw + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1));
+            if (addr > raw) munmap(raw, addr - raw);
+            munmap(addr + fc->region, raw + HUGE_PAGE - addr);
+            madvise(addr, fc->region, MADV_HUGEPAGE);
+            return addr;
+        }
+        case FAULT_FILE:
+            // Truncating drops the page cache so every touch allocates
+            if (ftruncate(w->fd, 0) != 0 || ftruncate(w->fd, fc->region) != 0) return NULL;
+            addr = mmap(NULL, fc->region, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+            return addr == MAP_FAILED ? NULL : addr;
+        case FAULT_HUGETLB:
+            addr = mmap(NULL, fc->region, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            return addr == MAP_FAILED ? NULL : addr;
+        default:
+            addr = mmap(NULL, fc->region, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            return addr == MAP_FAILED ? NULL : addr;
+    }
+}
+
+static void* fault_worker(void* arg) {
+    FaultWorker* w = arg;
+    const FaultCase* fc = w->fc;
+
+    // Start together so the threads actually contend
+    while (!__atomic_load_n(w->go, __ATOMIC_ACQUIRE)) sched_yield();
+    for (int round = 0; round < fc->rounds && !w->failed; round++) {
+        volatile char* region = map_region(w);
+        if (region == NULL) {
+            w->failed = 1;
+            break;
+        }
+        for (size_t off = 0; off < fc->region; off += fc->step) {
+            uint64_t start = bench_ticks();
+            region[off] = 1;
+            uint64_t elapsed = bench_ticks() - start;
+            w->ticks += elapsed;
+            hist_record(&w->hist, elapsed);
+        }
+        munmap((void*)region, fc->region);
+    }
+    return NULL;
+}
+
+static void run_case(const FaultCase* fc, int threads, FaultBenchResult* r) {
+    memset(r, 0, sizeof(*r));
+    snprintf(r->name, sizeof(r->name), "%s", fc->name);
+    r->threads = threads;
+    if (fc->kind == FAULT_THP && !thp_enabled()) return;
+
+    FaultWorker* workers = calloc(threads, sizeof(FaultWorker));
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    if (workers == NULL || tids == NULL) {
+        free(workers);
+        free(tids);
+        return;
+    }
+
+    int go = 0;
+    char name[64], path[256];
+    for (int i = 0; i < threads; i++) {
+        workers[i].fc = fc;
+        workers[i].go = &go;
+        workers[i].fd = -1;
+        if (fc->kind == FAULT_FILE) {
+            // Unlinked right away; the fd keeps the file alive. A leftover
+            // from a crashed run is removed so O_EXCL can insist on a new file
+            snprintf(name, sizeof(name), "fault_bench.%d.%d", (int)getpid(), i);
+            if (vmd_state_path(path, sizeof(path), name) == 0) {
+                unlink(path);
+                workers[i].fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+                unlink(path);
+            }
+            if (workers[i].fd < 0) workers[i].failed = 1;
+        }
+    }
+
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, fault_worker, &workers[i]) != 0) {
+            workers[i].failed = 1;
+            break;
+        }
+        started++;
+    }
+    uint64_t start_ns = now_ns();
+    uint64_t start_ticks = bench_ticks();
+    __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+    uint64_t elapsed_ns = now_ns() - start_ns;
+    double ticks_per_ns = elapsed_ns ? (double)(bench_ticks() - start_ticks) / elapsed_ns : 1.0;
+
+    Histogram hist;
+    memset(&hist, 0, sizeof(hist));
+    uint64_t ticks = 0;
+    r->available = 1;
+    for (int i = 0; i < threads; i++) {
+        if (workers[i].failed) r->available = 0;
+        hist_merge(&hist, &workers[i].hist);
+        ticks += workers[i].ticks;
+        if (workers[i].fd >= 0) close(workers[i].fd);
+    }
+    free(workers);
+    free(tids);
+
+    if (!r->available || hist.total == 0) {
+        r->available = 0;
+        return;
+    }
+    r->faults = hist.total;
+    r->mean_ns = ticks / ticks_per_ns / hist.total;
+    r->p50_ns = hist_percentile(&hist, 0.50) / ticks_per_ns;
+    r->p99_ns = hist_percentile(&hist, 0.99) / ticks_per_ns;
+    r->p999_ns = hist_percentile(&hist, 0.999) / ticks_per_ns;
+    r->faults_per_sec = hist.total / (elapsed_ns / 1e9);
+}
+
+static void save_cache(const FaultBenchResult* results, int count) {
+    char path[256];
+    struct utsname uts;
+    if (vmd_state_path(path, sizeof(path), FAULT_BENCH_CACHE) != 0 || uname(&uts) != 0) return;
+
+    FILE* f = vmd_state_fopen(path, "w");
+    if (f == NULL) return;
+    fprintf(f, "# vmd fault latency v1 %ld %s\n", (long)time(NULL), uts.release);
+    for (int i = 0; i < count; i++) {
+        const FaultBenchResult* r = &results[i];
+        fprintf(f, "%s %d %d %lu %.1f %.1f %.1f %.1f %.1f\n", r->name, r->threads, r->available,
+                r->faults, r->mean_ns, r->p50_ns, r->p99_ns, r->p999_ns, r->faults_per_sec);
+    }
+    fclose(f);
+}
+
+int run_fault_bench(FaultBenchResult* results, int max) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int contended = cpus < 2 ? 2 : (cpus > FAULT_BENCH_MAX_THREADS ? FAULT_BENCH_MAX_THREADS : (int)cpus);
+    int count = 0;
+
+    for (size_t c = 0; c < NUM_CASES && count + 2 <= max; c++) {
+        run_case(&g_cases[c], 1, &results[count++]);
+        run_case(&g_cases[c], contended, &results[count++]);
+    }
+    save_cache(results, count);
+    return count;
+}
+
+int load_fault_bench(FaultBenchResult* results, int max, long* measured_at) {
+    char path[256], release[128], line[256];
+    struct utsname uts;
+    if (vmd_state_path(path, sizeof(path), FAULT_BENCH_CACHE) != 0 || uname(&uts) != 0) return -1;
+
+    FILE* f = vmd_state_fopen(path, "r");
+    if (f == NULL) return -1;
+    if (fgets(line, sizeof(line), f) == NULL ||
+        sscanf(line, "# vmd fault latency v1 %ld %127s", measured_at, release) != 2 ||
+        strcmp(release, uts.release) != 0) {
+        fclose(f);
+        return -1;
+    }
+
+    int count = 0;
+    while (count < max && fgets(line, sizeof(line), f)) {
+        FaultBenchResult* r = &results[count];
+        if (sscanf(line, "%15s %d %d %lu %lf %lf %lf %lf %lf", r->name, &r->threads, &r->available,
+                   &r->faults, &r->mean_ns, &r->p50_ns, &r->p99_ns, &r->p999_ns, &r->faults_per_sec) == 9)
+            count++;
+    }
+    fclose(f);
+    return count;
+}
+
+void output_fault_bench_json(void) {
+    FaultBenchResult results[FAULT_BENCH_MAX_RESULTS];
+    int count = run_fault_bench(results, FAULT_BENCH_MAX_RESULTS);
+
+    printf("{\n");
+    printf("  \"fault_latency\": [");
+    for (int i = 0; i < count; i++) {
+        FaultBenchResult* r = &results[i];
+        printf("%s\n    {\"case\": \"%s\", \"threads\": %d, \"available\": %s, \"faults\": %lu, "
+               "\"mean_ns\": %.1f, \"p50_ns\": %.1f, \"p99_ns\": %.1f, \"p999_ns\": %.1f, \"faults_per_sec\": %.1f}",
+               i ? "," : "", r->name, r->threads, r->available ? "true" : "false", r->faults,
+               r->mean_ns, r->p50_ns, r->p99_ns, r->p999_ns, r->faults_per_sec);
+    }
+    printf("\n  ]\n}\n");
+}
+
+static const FaultBenchResult* find_result(const FaultBenchResult* results, int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (results[i].threads == 1 && results[i].available && strcmp(results[i].name, name) == 0)
+            return &results[i];
+    }
+    return NULL;
+}
+
+void output_fault_cost_json(const VmstatSnapshot* vmstat) {
+    FaultBenchResult results[FAULT_BENCH_MAX_RESULTS];
+    long measured_at = 0;
+    int count = load_fault_bench(results, FAULT_BENCH_MAX_RESULTS, &measured_at);
+    const FaultBenchResult* anon = count > 0 ? find_result(results, count, "anon_4k") : NULL;
+
+    if (anon == NULL) {
+        printf("  \"fault_cost\": {\"available\": false},\n");
+        return;
+    }
+    const FaultBenchResult* thp = find_result(results, count, "anon_thp");
+
+    // Major faults wait on I/O, which the benchmark does not measure, so
+    // only minor and THP faults are converted to time
+    double thp_rate = thp ? vmstat->rate[VMSTAT_THP_FAULT_ALLOC] : 0;
+    double minor_rate = vmstat->rate[VMSTAT_PGFAULT] - vmstat->rate[VMSTAT_PGMAJFAULT] - thp_rate;
+    if (minor_rate < 0) minor_rate = 0;
+    double lost_ns = minor_rate * anon->mean_ns + (thp ? thp_rate * thp->mean_ns : 0);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    printf("  \"fault_cost\": {\"available\": true, \"measured_at\": %ld, \"anon_4k_mean_ns\": %.1f, "
+           "\"anon_thp_mean_ns\": %.1f, \"time_lost_ms_per_sec\": %.3f, \"cpu_fraction\": %.5f},\n",
+           measured_at, anon->mean_ns, thp ? thp->mean_ns : 0.0, lost_ns / 1e6,
+           lost_ns / (1e9 * (cpus > 0 ? cpus : 1)));
+}
@@ -0,0 +1,33 @@
+#ifndef FAULT_BENCH_H
+#define FAULT_BENCH_H
+
+#include "memory_types.h"
+
+// Results are cached here (in the state dir) until the kernel changes
+#define FAULT_BENCH_CACHE "fault_latency.txt"
+#define FAULT_BENCH_MAX_RESULTS 16
+#define FAULT_BENCH_MAX_THREADS 8
+
+typedef struct {
+    char name[16];          // anon_4k, anon_thp, file or hugetlb
+    int threads;
+    int available;
+    unsigned long faults;
+    double mean_ns;
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    double faults_per_sec;
+} FaultBenchResult;
+
+// Times first-touch faults for every case, single-threaded and with
+// threads contending on mmap_lock, and updates the cache
+int run_fault_bench(FaultBenchResult* results, int max);
+// Cached results for this kernel; returns the count or -1
+int load_fault_bench(FaultBenchResult* results, int max, long* measured_at);
+void output_fault_bench_json(void);
+// Prints the "fault_cost" analytics section: vmstat fault rates converted
+// to time using the cached latencies
+void output_fault_cost_json(const VmstatSnapshot* vmstat);
+
+#endif
@@ -0,0 +1,313 @@
+#define _GNU_SOURCE  // For dladdr
+#include "heap_profile.h"
+#include "memory_tracking.h"
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Minimal protobuf writer for the pprof profile.proto message
+typedef struct {
+    unsigned char* data;
+    size_t len;
+    size_t cap;
+    int failed;
+} PbBuf;
+
+// Open-addressed uint64 -> uint64 map used to dedup strings, functions
+// and locations. Key 0 is reserved as the empty marker.
+typedef struct {
+    uint64_t* keys;
+    uint64_t* values;
+    size_t cap;
+    size_t count;
+} IdMap;
+
+typedef struct {
+    PbBuf profile;
+    PbBuf scratch;
+    IdMap strings;
+    IdMap functions;
+    IdMap locations;
+    const char** string_table;
+    size_t num_strings;
+    size_t string_cap;
+} PprofBuilder;
+
+static void pb_put(PbBuf* b, const void* src, size_t n) {
+    if (b->failed) return;
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        while (cap < b->len + n) cap *= 2;
+        unsigned char* data = realloc(b->data, cap);
+        if (data == NULL) {
+            b->failed = 1;
+            return;
+        }
+        b->data = data;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+}
+
+static void pb_varint(PbBuf* b, uint64_t v) {
+    unsigned char tmp[10];
+    size_t n = 0;
+    do {
+        tmp[n] = v & 0x7f;
+        v >>= 7;
+        if (v) tmp[n] |= 0x80;
+        n++;
+    } while (v);
+    pb_put(b, tmp, n);
+}
+
+static void pb_uint(PbBuf* b, int field, uint64_t v) {
+    pb_varint(b, ((uint64_t)field << 3) | 0);
+    pb_varint(b, v);
+}
+
+static void pb_bytes(PbBuf* b, int field, const void* data, size_t n) {
+    pb_varint(b, ((uint64_t)field << 3) | 2);
+    pb_varint(b, n);
+    pb_put(b, data, n);
+}
+
+// Appends msg as a length-delimited field and resets it for reuse
+static void pb_message(PbBuf* b, int field, PbBuf* msg) {
+    if (msg->failed) b->failed = 1;
+    pb_bytes(b, field, msg->data, msg->len);
+    msg->len = 0;
+}
+
+static uint64_t hash_string(const char* s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 1099511628211ULL;
+    return h ? h : 1;
+}
+
+static int idmap_find(IdMap* map, uint64_t key, uint64_t* value) {
+    if (map->cap == 0) return 0;
+    for (size_t i = key & (map->cap - 1); map->keys[i] != 0; i = (i + 1) & (map->cap - 1)) {
+        if (map->keys[i] == key) {
+            *value = map->values[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int idmap_insert(IdMap* map, uint64_t key, uint64_t value) {
+    if ((map->count + 1) * 2 > map->cap) {
+        size_t cap = map->cap ? map->cap * 2 : 256;
+        uint64_t* keys = calloc(cap, sizeof(uint64_t));
+        uint64_t* values = calloc(cap, sizeof(uint64_t));
+        if (keys == NULL || values == NULL) {
+            free(keys);
+            free(values);
+            return -1;
+        }
+        for (size_t i = 0; i < map->cap; i++) {
+            if (map->keys[i] == 0) continue;
+            size_t j = map->keys[i] & (cap - 1);
+            while (keys[j] != 0) j = (j + 1) & (cap - 1);
+            keys[j] = map->keys[i];
+            values[j] = map->values[i];
+        }
+        free(map->keys);
+        free(map->values);
+        map->keys = keys;
+        map->values = values;
+        map->cap = cap;
+    }
+    size_t i = key & (map->cap - 1);
+    while (map->keys[i] != 0) i = (i + 1) & (map->cap - 1);
+    map->keys[i] = key;
+    map->values[i] = value;
+    map->count++;
+    return 0;
+}
+
+static void idmap_free(IdMap* map) {
+    free(map->keys);
+    free(map->values);
+}
+
+static uint64_t intern_string(PprofBuilder* pb, const char* s) {
+    uint64_t key = hash_string(s);
+    uint64_t index;
+    if (idmap_find(&pb->strings, key, &index)) return index;
+
+    if (pb->num_strings == pb->string_cap) {
+        size_t cap = pb->string_cap ? pb->string_cap * 2 : 256;
+        const char** table = realloc(pb->string_table, cap * sizeof(char*));
+        if (table == NULL) {
+            pb->profile.failed = 1;
+            return 0;
+        }
+        pb->string_table = table;
+        pb->string_cap = cap;
+    }
+    char* copy = strdup(s);
+    if (copy == NULL || idmap_insert(&pb->strings, key, pb->num_strings) != 0) {
+        free(copy);
+        pb->profile.failed = 1;
+        return 0;
+    }
+    pb->string_table[pb->num_strings] = copy;
+    return pb->num_strings++;
+}
+
+static const char* frame_name(void* addr, char* buf, size_t len) {
+    Dl_info info = {0};
+    // Return addresses point just past the call instruction
+    if (dladdr((char*)addr - 1, &info) && info.dli_sname != NULL)
+        return info.dli_sname;
+    if (info.dli_fname != NULL) {
+        const char* base = strrchr(info.dli_fname, '/');
+        snprintf(buf, len, "%s+0x%lx", base ? base + 1 : info.dli_fname,
+                 (unsigned long)((char*)addr - (char*)info.dli_fbase));
+    } else {
+        snprintf(buf, len, "0x%lx", (unsigned long)addr);
+    }
+    return buf;
+}
+
+static uint64_t function_id(PprofBuilder* pb, const char* name, const char* file) {
+    uint64_t key = hash_string(name);
+    uint64_t id;
+    if (idmap_find(&pb->functions, key, &id)) return id;
+
+    id = pb->functions.count + 1;
+    if (idmap_insert(&pb->functions, key, id) != 0) {
+        pb->profile.failed = 1;
+        return 0;
+    }
+    uint64_t name_index = intern_string(pb, name);
+    pb_uint(&pb->scratch, 1, id);
+    pb_uint(&pb->scratch, 2, name_index);
+    pb_uint(&pb->scratch, 3, name_index);
+    if (file != NULL) pb_uint(&pb->scratch, 4, intern_string(pb, file));
+    pb_message(&pb->profile, 5, &pb->scratch);
+    return id;
+}
+
+static uint64_t location_id(PprofBuilder* pb, void* addr, const char* file, int line) {
+    uint64_t key = (uint64_t)(uintptr_t)addr;
+    uint64_t id;
+    if (key == 0) key = 1;
+    if (idmap_find(&pb->locations, key, &id)) return id;
+
+    char buf[256];
+    uint64_t function = function_id(pb, frame_name(addr, buf, sizeof(buf)), file);
+
+    id = pb->locations.count + 1;
+    if (idmap_insert(&pb->locations, key, id) != 0) {
+        pb->profile.failed = 1;
+        return 0;
+    }
+    PbBuf line_msg = {0};
+    pb_uint(&line_msg, 1, function);
+    if (line > 0) pb_uint(&line_msg, 2, (uint64_t)line);
+
+    pb_uint(&pb->scratch, 1, id);
+    pb_uint(&pb->scratch, 3, key);
+    pb_message(&pb->scratch, 4, &line_msg);
+    pb_message(&pb->profile, 4, &pb->scratch);
+    free(line_msg.data);
+    return id;
+}
+
+static void value_type(PprofBuilder* pb, int field, const char* type, const char* unit) {
+    pb_uint(&pb->scratch, 1, intern_string(pb, type));
+    pb_uint(&pb->scratch, 2, intern_string(pb, unit));
+    pb_message(&pb->profile, field, &pb->scratch);
+}
+
+static int snapshot_callsites(CallsiteStats** rows) {
+    *rows = malloc(TRACK_MAX_CALLSITES * sizeof(CallsiteStats));
+    if (*rows == NULL) return -1;
+    return tracker_top_callsites(*rows, TRACK_MAX_CALLSITES, NULL);
+}
+
+int heap_profile_write_pprof(FILE* out) {
+    CallsiteStats* rows;
+    int count = snapshot_callsites(&rows);
+    if (count < 0) return -1;
+
+    PprofBuilder pb = {0};
+    intern_string(&pb, "");
+    value_type(&pb, 1, "alloc_objects", "count");
+    value_type(&pb, 1, "alloc_space", "bytes");
+    value_type(&pb, 1, "inuse_objects", "count");
+    value_type(&pb, 1, "inuse_space", "bytes");
+
+    PbBuf packed = {0};
+    PbBuf sample = {0};
+    for (int i = 0; i < count; i++) {
+        CallsiteStats* cs = &rows[i];
+
+        // pprof lists locations leaf first, which matches backtrace order
+        for (int f = 0; f < cs->stack_depth; f++) {
+            pb_varint(&packed, location_id(&pb, cs->stack[f],
+                                           f == 0 ? cs->file : NULL, f == 0 ? cs->line : 0));
+        }
+        pb_message(&sample, 1, &packed);
+
+        pb_varint(&packed, cs->total_count);
+        pb_varint(&packed, cs->total_bytes);
+        pb_varint(&packed, cs->live_count);
+        pb_varint(&packed, cs->live_bytes);
+        pb_message(&sample, 2, &packed);
+
+        pb_message(&pb.profile, 2, &sample);
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    size_t interval = tracker_sample_interval();
+    pb_uint(&pb.profile, 9, (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec);
+    value_type(&pb, 11, "space", "bytes");
+    pb_uint(&pb.profile, 12, interval ? interval : 1);
+    pb_uint(&pb.profile, 14, intern_string(&pb, "inuse_space"));
+
+    for (size_t i = 0; i < pb.num_strings; i++)
+        pb_bytes(&pb.profile, 6, pb.string_table[i], strlen(pb.string_table[i]));
+
+    int failed = pb.profile.failed || packed.failed || sample.failed || pb.scratch.failed;
+    if (!failed && fwrite(pb.profile.data, 1, pb.profile.len, out) != pb.profile.len)
+        failed = 1;
+
+    for (size_t i = 0; i < pb.num_strings; i++)
+        free((char*)pb.string_table[i]);
+    free(pb.string_table);
+    idmap_free(&pb.strings);
+    idmap_free(&pb.functions);
+    idmap_free(&pb.locations);
+    free(pb.profile.data);
+    free(pb.scratch.data);
+    free(packed.data);
+    free(sample.data);
+    free(rows);
+    return failed ? -1 : 0;
+}
+
+int heap_profile_write_folded(FILE* out) {
+    CallsiteStats* rows;
+    int count = snapshot_callsites(&rows);
+    if (count < 0) return -1;
+
+    // One line per callsite: root;...;leaf;file:line <live bytes>
+    char buf[256];
+    for (int i = 0; i < count; i++) {
+        CallsiteStats* cs = &rows[i];
+        for (int f = cs->stack_depth - 1; f >= 0; f--)
+            fprintf(out, "%s;", frame_name(cs->stack[f], buf, sizeof(buf)));
+        fprintf(out, "%s:%d %zu\n", cs->file, cs->line, cs->live_bytes);
+    }
+
+    free(rows);
+    return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,10 @@
+#ifndef HEAP_PROFILE_H
+#define HEAP_PROFILE_H
+
+#include <stdio.h>
+
+// Export live tracked allocations by callsite. Both return 0 on success.
+int heap_profile_write_pprof(FILE* out);
+int heap_profile_write_folded(FILE* out);
+
+#endif
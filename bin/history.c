@@ -0,0 +1,713 @@
+#define _GNU_SOURCE
+#include "history.h"
+#include "memory_types.h"
+#include "process_scan.h"
+#include "cgroup.h"
+#include "state_dir.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HISTORY_MAGIC "VMDHIST1"
+#define HISTORY_BLOCK 4096
+#define HISTORY_STAGE_ROWS 512
+#define HISTORY_ROW_WORDS (HISTORY_MAX_COLUMNS + 1)
+#define HISTORY_MAX_MB 4096
+
+extern MemoryAnalytics g_analytics;
+extern pthread_mutex_t g_analytics_mutex;
+
+// File layout, each region page aligned:
+//   header | series table | per-series staging rows | block index | blocks
+// Rows are appended uncompressed to their series' staging area. When it
+// fills, as many rows as fit are encoded into one fixed-size block in the
+// ring of blocks and the index slot for that block records its series and
+// time range.
+typedef struct {
+    char magic[8];
+    uint32_t block_size;
+    uint32_t max_series;
+    uint32_t max_blocks;
+    uint32_t stage_rows;
+    uint32_t row_words;
+    uint32_t next_series_id;
+    uint32_t block_head;             // Ring slot written next
+    uint32_t block_count;
+    uint64_t next_seq;
+} HistoryHeader;
+
+typedef struct {
+    uint32_t id;                     // 0 when the slot is free
+    uint16_t num_columns;
+    uint16_t staged;                 // Rows not yet sealed into a block
+    int64_t first_ts;
+    int64_t last_ts;
+    uint64_t rows;
+    char name[64];
+    uint8_t kinds[HISTORY_MAX_COLUMNS];
+    char columns[HISTORY_MAX_COLUMNS][24];
+} HistorySeries;
+
+typedef struct {
+    uint32_t series_id;              // 0 when the slot is empty
+    uint32_t rows;
+    int64_t t_first;
+    int64_t t_last;
+    uint64_t seq;                    // Orders the ring
+} HistoryIndexEntry;
+
+// Column c is a bit stream at col_offset[c] bytes into the payload;
+// column 0 holds the timestamps
+typedef struct {
+    uint32_t series_id;
+    uint16_t rows;
+    uint16_t num_columns;
+    uint16_t col_offset[HISTORY_ROW_WORDS + 1];
+} HistoryBlockHeader;
+
+#define HISTORY_PAYLOAD (HISTORY_BLOCK - sizeof(HistoryBlockHeader))
+
+typedef struct {
+    int fd;
+    char* base;
+    size_t size;
+    HistoryHeader* header;
+    HistorySeries* series;
+    int64_t* staging;
+    HistoryIndexEntry* index;
+    char* blocks;
+} HistoryFile;
+
+static HistoryFile g_history = { .fd = -1 };
+static pthread_mutex_t g_history_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t page_align(size_t n) {
+    return (n + 4095) & ~(size_t)4095;
+}
+
+static uint32_t capacity_blocks(void) {
+    const char* env = getenv("VMD_HISTORY_MB");
+    long mb = env ? atol(env) : 0;
+    if (mb <= 0) mb = HISTORY_DEFAULT_MB;
+    if (mb > HISTORY_MAX_MB) mb = HISTORY_MAX_MB;
+    return (uint32_t)(mb * (1024 * 1024 / HISTORY_BLOCK));
+}
+
+static int header_matches(const HistoryHeader* h, uint32_t max_blocks) {
+    return memcmp(h->magic, HISTORY_MAGIC, 8) == 0 && h->block_size == HISTORY_BLOCK &&
+           h->max_series == HISTORY_MAX_SERIES && h->max_blocks == max_blocks &&
+           h->stage_rows == HISTORY_STAGE_ROWS && h->row_words == HISTORY_ROW_WORDS;
+}
+
+// Lays out an empty file of size bytes next to path and renames it into
+// place. A vmd that still maps the old file keeps its own inode, so it is
+// never truncated under a live mapping. Returns the open fd
+static int history_create(const char* path, size_t size, uint32_t max_blocks) {
+    char tmp[300];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+
+    HistoryHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, HISTORY_MAGIC, 8);
+    h.block_size = HISTORY_BLOCK;
+    h.max_series = HISTORY_MAX_SERIES;
+    h.max_blocks = max_blocks;
+    h.stage_rows = HISTORY_STAGE_ROWS;
+    h.row_words = HISTORY_ROW_WORDS;
+    h.next_series_id = 1;
+    if (ftruncate(fd, size) != 0 || pwrite(fd, &h, sizeof(h), 0) != sizeof(h) || rename(tmp, path) != 0) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    return fd;
+}
+
+// Opens path locked, retrying when another vmd renamed a new file over it
+// while this one waited for the lock
+static int history_open_locked(const char* path) {
+    for (int attempt = 0; attempt < 4; attempt++) {
+        int fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+        if (fd < 0) return -1;
+        flock(fd, LOCK_EX);
+        struct stat opened, current;
+        if (fstat(fd, &opened) == 0 && stat(path, &current) == 0 &&
+            opened.st_dev == current.st_dev && opened.st_ino == current.st_ino)
+            return fd;
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+    return -1;
+}
+
+// Maps the history file, creating it (sparse) or replacing it when its
+// geometry does not match this build. Called with g_history_mutex held
+static int history_map(void) {
+    if (g_history.base != NULL) return 0;
+
+    char path[256];
+    if (vmd_state_path(path, sizeof(path), HISTORY_FILE) != 0) return -1;
+    uint32_t max_blocks = capacity_blocks();
+    size_t series_off = page_align(sizeof(HistoryHeader));
+    size_t staging_off = page_align(series_off + HISTORY_MAX_SERIES * sizeof(HistorySeries));
+    size_t index_off = page_align(staging_off + (size_t)HISTORY_MAX_SERIES * HISTORY_STAGE_ROWS *
+                                                    HISTORY_ROW_WORDS * sizeof(int64_t));
+    size_t blocks_off = page_align(index_off + max_blocks * sizeof(HistoryIndexEntry));
+    size_t size = blocks_off + (size_t)max_blocks * HISTORY_BLOCK;
+
+    int fd = history_open_locked(path);
+    if (fd < 0) return -1;
+
+    HistoryHeader existing;
+    struct stat st;
+    int valid = fstat(fd, &st) == 0 && (size_t)st.st_size == size &&
+                pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+                header_matches(&existing, max_blocks);
+    if (!valid) {
+        // Renamed while the old lock is held, so waiters see the new inode
+        int fresh = history_create(path, size, max_blocks);
+        flock(fd, LOCK_UN);
+        close(fd);
+        if (fresh < 0) return -1;
+        fd = fresh;
+        flock(fd, LOCK_EX);
+    }
+
+    char* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return -1;
+    }
+    g_history = (HistoryFile){ .fd = fd, .base = base, .size = size, .header = (HistoryHeader*)base,
+                               .series = (HistorySeries*)(base + series_off),
+                               .staging = (int64_t*)(base + staging_off),
+                               .index = (HistoryIndexEntry*)(base + index_off), .blocks = base + blocks_off };
+    flock(fd, LOCK_UN);
+    return 0;
+}
+
+typedef struct {
+    uint8_t* buf;
+    size_t cap;                      // Bytes; bits past it are counted, not written
+    size_t bits;
+} BitWriter;
+
+typedef struct {
+    const uint8_t* buf;
+    size_t len;                      // Bits
+    size_t bits;
+} BitReader;
+
+static void put_bits(BitWriter* w, uint64_t value, int n) {
+    for (int i = n - 1; i >= 0; i--) {
+        if (w->bits < w->cap * 8) {
+            uint8_t mask = 0x80 >> (w->bits & 7);
+            if ((value >> i) & 1) w->buf[w->bits >> 3] |= mask;
+            else w->buf[w->bits >> 3] &= ~mask;
+        }
+        w->bits++;
+    }
+}
+
+static uint64_t get_bits(BitReader* r, int n) {
+    uint64_t value = 0;
+    for (int i = 0; i < n; i++) {
+        value <<= 1;
+        if (r->bits < r->len) value |= (r->buf[r->bits >> 3] >> (7 - (r->bits & 7))) & 1;
+        r->bits++;
+    }
+    return value;
+}
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Delta-of-delta buckets: '0' for a repeat of the last delta, then
+// prefixes 10, 110, 1110, 11110 and 11111 for 7, 9, 16, 32 and 64 bits
+static const int g_dod_widths[] = { 0, 7, 9, 16, 32, 64 };
+
+static void put_dod(BitWriter* w, int64_t dod) {
+    uint64_t z = zigzag(dod);
+    int bucket = 0;
+    while (bucket < 5 && (bucket == 0 ? z != 0 : z >= (1ULL << g_dod_widths[bucket]))) bucket++;
+    put_bits(w, bucket < 5 ? ((1ULL << bucket) - 1) << 1 : 0x1F, bucket < 5 ? bucket + 1 : 5);
+    if (bucket) put_bits(w, z, g_dod_widths[bucket]);
+}
+
+static int64_t get_dod(BitReader* r) {
+    int bucket = 0;
+    while (bucket < 5 && get_bits(r, 1)) bucket++;
+    return bucket ? unzigzag(get_bits(r, g_dod_widths[bucket])) : 0;
+}
+
+static void encode_int(BitWriter* w, const int64_t* rows, int count, int col) {
+    int64_t prev = 0, prev_delta = 0;
+    for (int i = 0; i < count; i++) {
+        int64_t v = rows[i * HISTORY_ROW_WORDS + col];
+        if (i == 0) {
+            put_bits(w, (uint64_t)v, 64);
+        } else {
+            int64_t delta = (int64_t)((uint64_t)v - (uint64_t)prev);
+            put_dod(w, (int64_t)((uint64_t)delta - (uint64_t)prev_delta));
+            prev_delta = delta;
+        }
+        prev = v;
+    }
+}
+
+static void decode_int(BitReader* r, int64_t* rows, int count, int col) {
+    int64_t prev = 0, prev_delta = 0;
+    for (int i = 0; i < count; i++) {
+        int64_t v;
+        if (i == 0) {
+            v = (int64_t)get_bits(r, 64);
+        } else {
+            prev_delta = (int64_t)((uint64_t)prev_delta + (uint64_t)get_dod(r));
+            v = (int64_t)((uint64_t)prev + (uint64_t)prev_delta);
+        }
+        rows[i * HISTORY_ROW_WORDS + col] = v;
+        prev = v;
+    }
+}
+
+// XOR with the previous value: '0' for a repeat, '10' + bits when the
+// meaningful bits fit the previous leading/trailing zero window, else
+// '11' + 5 bits leading zeros + 6 bits length - 1 + bits
+static void encode_float(BitWriter* w, const int64_t* rows, int count, int col) {
+    uint64_t prev = 0;
+    int lead = -1, trail = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t v = (uint64_t)rows[i * HISTORY_ROW_WORDS + col];
+        uint64_t x = v ^ prev;
+        prev = v;
+        if (i == 0) {
+            put_bits(w, v, 64);
+        } else if (x == 0) {
+            put_bits(w, 0, 1);
+        } else {
+            int l = __builtin_clzll(x);
+            int t = __builtin_ctzll(x);
+            if (l > 31) l = 31;
+            if (lead >= 0 && l >= lead && t >= trail) {
+                put_bits(w, 0x2, 2);
+                put_bits(w, x >> trail, 64 - lead - trail);
+            } else {
+                put_bits(w, 0x3, 2);
+                put_bits(w, l, 5);
+                put_bits(w, 64 - l - t - 1, 6);
+                put_bits(w, x >> t, 64 - l - t);
+                lead = l;
+                trail = t;
+            }
+        }
+    }
+}
+
+static void decode_float(BitReader* r, int64_t* rows, int count, int col) {
+    uint64_t prev = 0;
+    int lead = 0, trail = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t v;
+        if (i == 0) {
+            v = get_bits(r, 64);
+        } else if (get_bits(r, 1) == 0) {
+            v = prev;
+        } else {
+            if (get_bits(r, 1)) {
+                lead = (int)get_bits(r, 5);
+                trail = 64 - lead - ((int)get_bits(r, 6) + 1);
+            }
+            v = prev ^ (get_bits(r, 64 - lead - trail) << trail);
+        }
+        rows[i * HISTORY_ROW_WORDS + col] = (int64_t)v;
+        prev = v;
+    }
+}
+
+static int column_kind(const HistorySeries* s, int col) {
+    return col == 0 ? HISTORY_INT : s->kinds[col - 1];
+}
+
+// Encodes count rows column by column into payload; returns the bytes
+// needed, which may exceed the payload (nothing past it is written)
+static size_t encode_block(const HistorySeries* s, const int64_t* rows, int count, uint8_t* payload,
+                           uint16_t* offsets) {
+    size_t used = 0;
+    for (int c = 0; c <= s->num_columns; c++) {
+        size_t start = used < HISTORY_PAYLOAD ? used : HISTORY_PAYLOAD;
+        BitWriter w = { payload + start, HISTORY_PAYLOAD - start, 0 };
+        offsets[c] = (uint16_t)start;
+        if (column_kind(s, c) == HISTORY_FLOAT) encode_float(&w, rows, count, c);
+        else encode_int(&w, rows, count, c);
+        used += (w.bits + 7) / 8;
+    }
+    offsets[s->num_columns + 1] = (uint16_t)(used < HISTORY_PAYLOAD ? used : HISTORY_PAYLOAD);
+    return used;
+}
+
+static int decode_block(const HistorySeries* s, const char* block, int64_t* rows) {
+    HistoryBlockHeader bh;
+    memcpy(&bh, block, sizeof(bh));
+    if (bh.series_id != s->id || bh.num_columns != s->num_columns + 1 || bh.rows > HISTORY_STAGE_ROWS)
+        return -1;
+
+    const uint8_t* payload = (const uint8_t*)block + sizeof(bh);
+    for (int c = 0; c <= s->num_columns; c++) {
+        if (bh.col_offset[c] > bh.col_offset[c + 1] || bh.col_offset[c + 1] > HISTORY_PAYLOAD) return -1;
+        BitReader r = { payload + bh.col_offset[c], (size_t)(bh.col_offset[c + 1] - bh.col_offset[c]) * 8, 0 };
+        if (column_kind(s, c) == HISTORY_FLOAT) decode_float(&r, rows, bh.rows, c);
+        else decode_int(&r, rows, bh.rows, c);
+    }
+    return bh.rows;
+}
+
+static int64_t* stage_rows(const HistorySeries* s) {
+    size_t slot = s - g_history.series;
+    return g_history.staging + slot * HISTORY_STAGE_ROWS * HISTORY_ROW_WORDS;
+}
+
+// Moves as many staged rows as fit into the next ring block
+static void seal_block(HistorySeries* s) {
+    static uint8_t payload[HISTORY_PAYLOAD];
+    uint16_t offsets[HISTORY_ROW_WORDS + 1] = { 0 };
+    int64_t* rows = stage_rows(s);
+    int count = s->staged;
+    size_t used;
+
+    while ((used = encode_block(s, rows, count, payload, offsets)) > HISTORY_PAYLOAD && count > 1) {
+        int fit = (int)((double)count * HISTORY_PAYLOAD / used * 0.95);
+        count = fit < count && fit > 0 ? fit : count - 1;
+    }
+
+    HistoryHeader* h = g_history.header;
+    uint32_t slot = h->block_head;
+    HistoryBlockHeader bh = { .series_id = s->id, .rows = (uint16_t)count, .num_columns = s->num_columns + 1 };
+    memcpy(bh.col_offset, offsets, sizeof(bh.col_offset));
+    char* block = g_history.blocks + (size_t)slot * HISTORY_BLOCK;
+    memcpy(block, &bh, sizeof(bh));
+    memcpy(block + sizeof(bh), payload, used);
+
+    g_history.index[slot] = (HistoryIndexEntry){ .series_id = s->id, .rows = count, .t_first = rows[0],
+                                                 .t_last = rows[(count - 1) * HISTORY_ROW_WORDS],
+                                                 .seq = h->next_seq++ };
+    h->block_head = (slot + 1) % h->max_blocks;
+    if (h->block_count < h->max_blocks) h->block_count++;
+
+    memmove(rows, rows + count * HISTORY_ROW_WORDS, (size_t)(s->staged - count) * HISTORY_ROW_WORDS * sizeof(int64_t));
+    s->staged -= count;
+}
+
+static void retire_series(HistorySeries* s) {
+    while (s->staged > 0) seal_block(s);
+    memset(s, 0, sizeof(*s));
+}
+
+static HistorySeries* find_series(const char* name) {
+    for (int i = 0; i < HISTORY_MAX_SERIES; i++) {
+        if (g_history.series[i].id != 0 && strcmp(g_history.series[i].name, name) == 0) return &g_history.series[i];
+    }
+    return NULL;
+}
+
+static int columns_match(const HistorySeries* s, const HistoryColumn* columns, int num_columns) {
+    if (s->num_columns != num_columns) return 0;
+    for (int c = 0; c < num_columns; c++) {
+        if (s->kinds[c] != columns[c].kind || strncmp(s->columns[c], columns[c].name, sizeof(s->columns[c]) - 1) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+// Takes a free slot, or the one least recently appended to
+static HistorySeries* create_series(const char* name, const HistoryColumn* columns, int num_columns) {
+    HistorySeries* s = NULL;
+    for (int i = 0; i < HISTORY_MAX_SERIES; i++) {
+        HistorySeries* candidate = &g_history.series[i];
+        if (candidate->id == 0) {
+            s = candidate;
+            break;
+        }
+        if (s == NULL || candidate->last_ts < s->last_ts) s = candidate;
+    }
+    if (s->id != 0) retire_series(s);
+
+    s->id = g_history.header->next_series_id++;
+    s->num_columns = num_columns;
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    for (int c = 0; c < num_columns; c++) {
+        s->kinds[c] = columns[c].kind;
+        snprintf(s->columns[c], sizeof(s->columns[c]), "%s", columns[c].name);
+    }
+    return s;
+}
+
+int history_append(const char* series, const HistoryColumn* columns, int num_columns,
+                   int64_t ts_ms, const double* values) {
+    if (num_columns <= 0 || num_columns > HISTORY_MAX_COLUMNS) return -1;
+
+    pthread_mutex_lock(&g_history_mutex);
+    if (history_map() != 0) {
+        pthread_mutex_unlock(&g_history_mutex);
+        return -1;
+    }
+    flock(g_history.fd, LOCK_EX);
+
+    HistorySeries* s = find_series(series);
+    if (s != NULL && !columns_match(s, columns, num_columns)) {
+        retire_series(s);
+        s = NULL;
+    }
+    if (s == NULL) s = create_series(series, columns, num_columns);
+    if (s->staged == HISTORY_STAGE_ROWS) seal_block(s);
+
+    int64_t* row = stage_rows(s) + (size_t)s->staged * HISTORY_ROW_WORDS;
+    row[0] = ts_ms;
+    for (int c = 0; c < num_columns; c++) {
+        if (columns[c].kind == HISTORY_FLOAT) memcpy(&row[c + 1], &values[c], sizeof(double));
+        else row[c + 1] = (int64_t)llround(values[c]);
+    }
+    s->staged++;
+    if (s->rows++ == 0) s->first_ts = ts_ms;
+    s->last_ts = ts_ms;
+
+    flock(g_history.fd, LOCK_UN);
+    pthread_mutex_unlock(&g_history_mutex);
+    return 0;
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static const HistoryColumn g_system_columns[] = {
+    { "total_memory", HISTORY_INT },
+    { "free_memory", HISTORY_INT },
+    { "memory_usage", HISTORY_INT },
+    { "swap_usage_percent", HISTORY_INT },
+    { "fragmentation_index", HISTORY_FLOAT },
+    { "pressure_score", HISTORY_FLOAT },
+    { "fault_rate", HISTORY_FLOAT },
+    { "pgfault", HISTORY_INT },
+    { "pgmajfault", HISTORY_INT },
+    { "pgscan_kswapd", HISTORY_INT },
+    { "pgscan_direct", HISTORY_INT },
+    { "workingset_refault", HISTORY_INT },
+    { "pswpin", HISTORY_INT },
+    { "pswpout", HISTORY_INT },
+    { "oom_kill", HISTORY_INT },
+};
+#define NUM_SYSTEM_COLUMNS (int)(sizeof(g_system_columns) / sizeof(g_system_columns[0]))
+
+void history_record_system(void) {
+    double values[NUM_SYSTEM_COLUMNS];
+
+    pthread_mutex_lock(&g_analytics_mutex);
+    const unsigned long long* counters = g_analytics.vmstat.value;
+    double row[NUM_SYSTEM_COLUMNS] = {
+        g_analytics.total_memory, g_analytics.free_memory, g_analytics.memory_usage,
+        g_analytics.swap_usage_percent, g_analytics.fragmentation_index, g_analytics.pressure_score,
+        g_analytics.fault_rate, counters[VMSTAT_PGFAULT], counters[VMSTAT_PGMAJFAULT],
+        counters[VMSTAT_PGSCAN_KSWAPD], counters[VMSTAT_PGSCAN_DIRECT], counters[VMSTAT_WORKINGSET_REFAULT],
+        counters[VMSTAT_PSWPIN], counters[VMSTAT_PSWPOUT], counters[VMSTAT_OOM_KILL],
+    };
+    memcpy(values, row, sizeof(values));
+    pthread_mutex_unlock(&g_analytics_mutex);
+
+    history_append("system", g_system_columns, NUM_SYSTEM_COLUMNS, now_ms(), values);
+}
+
+// Series names are prefix/id/name with anything unusual in name replaced
+static void series_name(char* out, size_t len, const char* prefix, const char* name) {
+    int n = snprintf(out, len, "%s/", prefix);
+    for (const char* p = name; *p && n + 1 < (int)len; p++) {
+        char ch = *p;
+        int ok = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+                 ch == '.' || ch == '-' || ch == '_' || ch == '/' || ch == ':';
+        out[n++] = ok ? ch : '_';
+    }
+    out[n] = '\0';
+}
+
+static const HistoryColumn g_process_columns[] = {
+    { "rss", HISTORY_INT },
+    { "pss", HISTORY_INT },
+    { "swap", HISTORY_INT },
+    { "growth_rate", HISTORY_FLOAT },
+    { "fault_rate", HISTORY_FLOAT },
+};
+
+void history_record_processes(void) {
+    ProcessStats top[PROC_SCAN_DEFAULT_TOP];
+    int count = top_processes(top, PROC_SCAN_DEFAULT_TOP, PROC_SORT_RSS);
+    int64_t ts = now_ms();
+    char id[64], name[64];
+
+    for (int i = 0; i < count; i++) {
+        if (top[i].rss == 0) continue;      // Kernel threads
+        double values[] = { top[i].rss, top[i].pss, top[i].swap, top[i].growth_rate, top[i].fault_rate };
+        snprintf(id, sizeof(id), "%d/%s", top[i].pid, top[i].name);
+        series_name(name, sizeof(name), "proc", id);
+        history_append(name, g_process_columns, 5, ts, values);
+    }
+}
+
+static const HistoryColumn g_cgroup_columns[] = {
+    { "memory_current", HISTORY_INT },
+    { "swap_current", HISTORY_INT },
+};
+
+void history_record_cgroups(void) {
+    CgroupMemory groups[CGROUP_MAX_GROUPS];
+    int count = read_cgroups(groups, CGROUP_MAX_GROUPS);
+    int64_t ts = now_ms();
+    char name[64];
+
+    for (int i = 0; i < count; i++) {
+        double values[] = { groups[i].current, groups[i].swap_current };
+        series_name(name, sizeof(name), "cgroup", groups[i].name);
+        history_append(name, g_cgroup_columns, 2, ts, values);
+    }
+}
+
+typedef struct {
+    int64_t from;
+    int64_t to;
+    int64_t step;
+    int64_t last_ts;
+    int64_t last_emitted;
+    int limit;
+    int emitted;
+    int truncated;
+} HistoryQuery;
+
+static void print_value(int kind, int64_t word) {
+    if (kind == HISTORY_INT) {
+        printf(", %lld", (long long)word);
+        return;
+    }
+    double v;
+    memcpy(&v, &word, sizeof(v));
+    if (isfinite(v)) printf(", %.6g", v);
+    else printf(", null");
+}
+
+static void emit_row(HistoryQuery* q, const HistorySeries* s, const int64_t* row) {
+    int64_t ts = row[0];
+    // Rows are in time order; a repeat can only come from a seal that was
+    // interrupted after writing its block
+    if (ts <= q->last_ts || ts < q->from || ts > q->to) return;
+    q->last_ts = ts;
+    if (q->emitted && ts - q->last_emitted < q->step) return;
+    if (q->emitted >= q->limit) {
+        q->truncated = 1;
+        return;
+    }
+
+    printf("%s\n    [%lld", q->emitted ? "," : "", (long long)ts);
+    for (int c = 1; c <= s->num_columns; c++) print_value(s->kinds[c - 1], row[c]);
+    printf("]");
+    q->last_emitted = ts;
+    q->emitted++;
+}
+
+static void output_series_list_json(void) {
+    HistoryHeader* h = g_history.header;
+    struct stat st;
+    fstat(g_history.fd, &st);
+
+    printf("{\n");
+    printf("  \"file\": {\"capacity_bytes\": %zu, \"disk_bytes\": %lld, \"blocks_used\": %u, \"blocks_total\": %u},\n",
+           g_history.size, (long long)st.st_blocks * 512, h->block_count, h->max_blocks);
+    printf("  \"series\": [");
+    int first = 1;
+    for (int i = 0; i < HISTORY_MAX_SERIES; i++) {
+        HistorySeries* s = &g_history.series[i];
+        if (s->id == 0) continue;
+        printf("%s\n    {\"name\": \"%s\", \"rows\": %llu, \"staged\": %u, \"first_ts\": %lld, \"last_ts\": %lld, "
+               "\"columns\": [",
+               first ? "" : ",", s->name, (unsigned long long)s->rows, s->staged, (long long)s->first_ts,
+               (long long)s->last_ts);
+        for (int c = 0; c < s->num_columns; c++) printf("%s\"%s\"", c ? ", " : "", s->columns[c]);
+        printf("]}");
+        first = 0;
+    }
+    printf("%s]\n}\n", first ? "" : "\n  ");
+}
+
+static void output_series_rows_json(const HistorySeries* s, HistoryQuery* q) {
+    static int64_t rows[HISTORY_STAGE_ROWS * HISTORY_ROW_WORDS];
+    HistoryHeader* h = g_history.header;
+    int blocks_read = 0, blocks_skipped = 0;
+
+    printf("{\n");
+    printf("  \"series\": \"%s\",\n", s->name);
+    printf("  \"columns\": [\"ts\"");
+    for (int c = 0; c < s->num_columns; c++) printf(", \"%s\"", s->columns[c]);
+    printf("],\n");
+    printf("  \"rows\": [");
+
+    // Oldest ring slot first; the index alone decides which blocks to read
+    uint32_t oldest = (h->block_head + h->max_blocks - h->block_count) % h->max_blocks;
+    for (uint32_t i = 0; i < h->block_count && !q->truncated; i++) {
+        uint32_t slot = (oldest + i) % h->max_blocks;
+        HistoryIndexEntry* e = &g_history.index[slot];
+        if (e->series_id != s->id) continue;
+        if (e->t_last < q->from || e->t_first > q->to) {
+            blocks_skipped++;
+            continue;
+        }
+        int count = decode_block(s, g_history.blocks + (size_t)slot * HISTORY_BLOCK, rows);
+        blocks_read++;
+        for (int r = 0; r < count; r++) emit_row(q, s, &rows[r * HISTORY_ROW_WORDS]);
+    }
+    const int64_t* staged = stage_rows(s);
+    for (int r = 0; r < s->staged && !q->truncated; r++) emit_row(q, s, &staged[r * HISTORY_ROW_WORDS]);
+
+    printf("%s],\n", q->emitted ? "\n  " : "");
+    printf("  \"truncated\": %s,\n", q->truncated ? "true" : "false");
+    printf("  \"blocks_read\": %d,\n", blocks_read);
+    printf("  \"blocks_skipped\": %d\n", blocks_skipped);
+    printf("}\n");
+}
+
+void output_history_json(const char* series, int64_t from_ms, int64_t to_ms, int64_t step_ms, int limit) {
+    pthread_mutex_lock(&g_history_mutex);
+    if (history_map() != 0) {
+        pthread_mutex_unlock(&g_history_mutex);
+        printf("{\n  \"available\": false\n}\n");
+        return;
+    }
+    flock(g_history.fd, LOCK_SH);
+
+    HistorySeries* s = series && *series ? find_series(series) : NULL;
+    if (series == NULL || *series == '\0') {
+        output_series_list_json();
+    } else if (s == NULL) {
+        printf("{\n  \"error\": \"unknown series\"\n}\n");
+    } else {
+        HistoryQuery q = { .from = from_ms, .to = to_ms, .step = step_ms, .last_ts = INT64_MIN,
+                           .limit = limit > 0 ? limit : HISTORY_DEFAULT_LIMIT };
+        output_series_rows_json(s, &q);
+    }
+
+    flock(g_history.fd, LOCK_UN);
+    pthread_mutex_unlock(&g_history_mutex);
+}
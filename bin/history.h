@@ -0,0 +1,38 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+
+// Metrics history lives in this file in the state dir; its size is
+// $VMD_HISTORY_MB (default HISTORY_DEFAULT_MB), oldest blocks are reused
+#define HISTORY_FILE "history.vmdh"
+#define HISTORY_DEFAULT_MB 64
+#define HISTORY_MAX_SERIES 128
+#define HISTORY_MAX_COLUMNS 15      // Value columns; the timestamp is extra
+#define HISTORY_DEFAULT_LIMIT 1000
+
+// Integer columns (sizes, counters, timestamps) are stored with
+// delta-of-delta encoding, float columns (ratios, rates) with XOR encoding
+typedef enum {
+    HISTORY_INT,
+    HISTORY_FLOAT
+} HistoryKind;
+
+typedef struct {
+    const char* name;
+    HistoryKind kind;
+} HistoryColumn;
+
+// Appends one row to the named series, creating it on first use; a series
+// whose columns changed is started over. Returns 0 on success
+int history_append(const char* series, const HistoryColumn* columns, int num_columns,
+                   int64_t ts_ms, const double* values);
+// Rows from g_analytics, the top processes and the top-level cgroups
+void history_record_system(void);
+void history_record_processes(void);
+void history_record_cgroups(void);
+// Rows of series between from_ms and to_ms, at most one per step_ms and
+// at most limit rows; an empty series lists the stored series instead
+void output_history_json(const char* series, int64_t from_ms, int64_t to_ms, int64_t step_ms, int limit);
+
+#endif
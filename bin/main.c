@@ -3,14 +3,29 @@
 #include "memory_analysis.h"
 #include "page_table.h"
 #include "memory_hierarchy.h"
+#include "self_stats.h"
+#include "scheduler.h"
+#include "process_scan.h"
+#include "numa.h"
+#include "swap.h"
+#include "vmstat.h"
+#include "fault_bench.h"
+#include "cache_probe.h"
+#include "tlb_bench.h"
+#include "history.h"
+#include "snapshot.h"
+#include "anomaly.h"
+#include "schema.h"
+#include "malloc_stats.h"
+#include "reclaim.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
-#include <math.h>
+#include <unistd.h>
+#include <time.h>
 
-// Global analytics instance
-MemoryAnalytics g_analytics = {0};
-pthread_mutex_t g_analytics_mutex = PTHREAD_MUTEX_INITIALIZER;
+extern MemoryAnalytics g_analytics;
 
 void print_menu(void) {
     printf("\nVirtual Memory Dashboard\n");
@@ -22,30 +37,101 @@ void print_menu(void) {
     printf("5. Advanced analytics\n");
     printf("6. Page table analysis\n");
     printf("7. Memory hierarchy\n");
-    printf("8. Exit\n");
+    printf("8. Resident monitor\n");
+    printf("9. Process ranking\n");
+    printf("10. NUMA placement\n");
+    printf("11. Swap analysis\n");
+    printf("12. Fault latency benchmark\n");
+    printf("13. Cache and memory probe\n");
+    printf("14. TLB reach benchmark\n");
+    printf("15. History query\n");
+    printf("16. Snapshot capture\n");
+    printf("17. Snapshot diff\n");
+    printf("18. Alerts\n");
+    printf("19. Heap fragmentation\n");
+    printf("20. Reclaim advisor\n");
+    printf("21. Exit\n");
     printf("------------------------\n");
-    printf("Enter your choice (1-8): ");
+    printf("Enter your choice (1-21): ");
+}
+
+// Reads an optional parameter line after the menu choice; returns 0 at EOF
+static int read_param_line(const char* prompt, char* buf, size_t len) {
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF); // Rest of the choice line
+
+    printf("%s", prompt);
+    fflush(stdout);
+    if (c == EOF || fgets(buf, len, stdin) == NULL) return 0;
+    buf[strcspn(buf, "\n")] = '\0';
+    return 1;
+}
+
+// Looks up key in a "key=value&key=value" parameter line
+static int param_value(const char* params, const char* key, char* out, size_t len) {
+    size_t key_len = strlen(key);
+    const char* p = params;
+    while (p != NULL && *p) {
+        if (strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            p += key_len + 1;
+            size_t n = strcspn(p, "&");
+            if (n >= len) n = len - 1;
+            memcpy(out, p, n);
+            out[n] = '\0';
+            return 1;
+        }
+        p = strchr(p, '&');
+        if (p != NULL) p++;
+    }
+    return 0;
+}
+
+// Address range options shared by the page table and region listings;
+// addresses take 0x hex or decimal, the cursor is passed back as printed
+static int parse_region_query(const char* params, RegionQuery* query) {
+    char value[256];
+    region_query_init(query);
+    if (param_value(params, "pid", value, sizeof(value))) query->pid = (pid_t)atoi(value);
+    if (param_value(params, "start", value, sizeof(value))) query->start = strtoull(value, NULL, 0);
+    if (param_value(params, "end", value, sizeof(value))) query->end = strtoull(value, NULL, 0);
+    if (param_value(params, "stride", value, sizeof(value))) query->stride = strtoull(value, NULL, 0);
+    if (param_value(params, "limit", value, sizeof(value))) query->limit = atoi(value);
+    if (param_value(params, "cursor", value, sizeof(value))) {
+        uint64_t cursor = strtoull(value, NULL, 16);
+        if (cursor > query->start) query->start = cursor;
+    }
+    if (param_value(params, "region", value, sizeof(value)) && parse_region_kinds(value, &query->kinds) != 0) {
+        printf("Unknown region kind: %s\n", value);
+        return -1;
+    }
+    return 0;
+}
+
+// Epoch seconds, or seconds relative to now when negative; returns ms
+static int64_t time_param(const char* value, int64_t now_ms) {
+    long long seconds = atoll(value);
+    return seconds < 0 ? now_ms + seconds * 1000 : seconds * 1000;
 }
 
 void output_memory_stats_json(void) {
-    double fault_rate = isfinite(g_analytics.fault_rate) ? g_analytics.fault_rate : 0.0;
-    
+    char fields[ANALYTICS_JSON_MAX];
+    analytics_json_members(&g_analytics, ",\n  ", fields);
+
     printf("{\n");
-    printf("  \"fragmentation_index\": %.2f,\n", g_analytics.fragmentation_index);
-    printf("  \"fault_rate\": %.2f,\n", fault_rate);
-    printf("  \"pressure_score\": %.2f,\n", g_analytics.pressure_score);
-    printf("  \"swap_usage_percent\": %d,\n", g_analytics.swap_usage_percent);
-    printf("  \"major_faults\": %ld,\n", g_analytics.major_faults);
-    printf("  \"minor_faults\": %ld,\n", g_analytics.minor_faults);
-    printf("  \"memory_usage\": %zu,\n", g_analytics.memory_usage);
-    printf("  \"total_memory\": %zu,\n", g_analytics.total_memory);
-    printf("  \"free_memory\": %zu\n", g_analytics.free_memory);
-    printf("}\n");
+    printf("  %s,\n", fields);
+    output_vmstat_json(&g_analytics.vmstat);
+    printf(",\n");
+    output_fault_cost_json(&g_analytics.vmstat);
+    output_numa_summary_json();
+    output_self_stats_json();
+    printf("\n}\n");
 }
 
 int main(void) {
     int choice;
-    
+
+    tracker_init_from_env();
+
     while (1) {
         print_menu();
         if (scanf("%d", &choice) != 1) {
@@ -54,7 +140,7 @@ int main(void) {
             continue;
         }
 
-        if (choice == 8) break;
+        if (choice == 21) break;
 
         switch(choice) {
             case 1: 
@@ -73,15 +159,217 @@ int main(void) {
                 analyze_memory_advanced(); // This will exit after printing JSON
                 break;
             case 6: 
-                display_page_table_info();
+            case 7: {
+                char params[512] = "";
+                RegionQuery query;
+                read_param_line(choice == 6
+                                    ? "Options (pid=N&start=A&end=A&region=K,K&stride=BYTES&cursor=C&limit=N): "
+                                    : "Options (pid=N&start=A&end=A&region=K,K&cursor=C&limit=N): ",
+                                params, sizeof(params));
+                printf("\n");
+                if (parse_region_query(params, &query) != 0) exit(1);
+                if (choice == 6) display_page_table_info(&query);
+                else display_memory_hierarchy(&query);
                 fflush(stdout);
                 exit(0);
-                break;
-            case 7: 
-                display_memory_hierarchy();
+            }
+            case 8: {
+                char param[64] = "0";
+                read_param_line("Duration in seconds (0 = until interrupted): ", param, sizeof(param));
+                printf("\n");
+                run_resident_monitor((unsigned int)strtoul(param, NULL, 10));
+                exit(0);
+            }
+            case 9: {
+                char params[256] = "";
+                char value[32];
+                ProcessSortKey key = PROC_SORT_RSS;
+                int limit = PROC_SCAN_DEFAULT_TOP;
+
+                read_param_line("Options (sort=rss|pss|swap|growth|faults&limit=N): ", params, sizeof(params));
+                printf("\n");
+                if (param_value(params, "sort", value, sizeof(value)) &&
+                    parse_process_sort_key(value, &key) != 0) {
+                    printf("Unknown sort key: %s\n", value);
+                    exit(1);
+                }
+                if (param_value(params, "limit", value, sizeof(value))) limit = atoi(value);
+                output_process_ranking_json(key, limit);
+                fflush(stdout);
+                history_record_processes();
+                history_record_cgroups();
                 fflush(stdout);
                 exit(0);
-                break;
+            }
+            case 10: {
+                char params[256] = "";
+                char value[32];
+                pid_t pid = getpid();
+
+                read_param_line("Options (pid=N): ", params, sizeof(params));
+                printf("\n");
+                if (param_value(params, "pid", value, sizeof(value))) pid = (pid_t)atoi(value);
+                output_numa_process_json(pid);
+                fflush(stdout);
+                exit(0);
+            }
+            case 11: {
+                char params[256] = "";
+                char value[32];
+                pid_t pid = getpid();
+                int limit = SWAP_DEFAULT_TOP;
+
+                read_param_line("Options (pid=N&limit=N): ", params, sizeof(params));
+                printf("\n");
+                if (param_value(params, "pid", value, sizeof(value))) pid = (pid_t)atoi(value);
+                if (param_value(params, "limit", value, sizeof(value))) limit = atoi(value);
+                output_swap_json(pid, limit);
+                fflush(stdout);
+                exit(0);
+            }
+            case 12:
+                output_fault_bench_json();
+                fflush(stdout);
+                exit(0);
+            case 13: {
+                char params[128] = "";
+                char value[32];
+                size_t max_mb = 0;
+                int threads = 0;
+                read_param_line("Options (max_mb=N&threads=N): ", params, sizeof(params));
+                printf("\n");
+                if (param_value(params, "max_mb", value, sizeof(value))) max_mb = strtoul(value, NULL, 10);
+                if (param_value(params, "threads", value, sizeof(value))) threads = atoi(value);
+                output_cache_probe_json(max_mb << 20, threads);
+                fflush(stdout);
+                exit(0);
+            }
+            case 14: {
+                char params[128] = "";
+                char value[32];
+                size_t max_mb = 0;
+                read_param_line("Options (max_mb=N): ", params, sizeof(params));
+                printf("\n");
+                if (param_value(params, "max_mb", value, sizeof(value))) max_mb = strtoul(value, NULL, 10);
+                output_tlb_bench_json(max_mb << 20);
+                fflush(stdout);
+                exit(0);
+            }
+            case 15: {
+                char params[256] = "";
+                char series[64] = "";
+                char value[32];
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                int64_t now = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+                int64_t from = now - 3600 * 1000, to = now, step = 0;
+                int limit = HISTORY_DEFAULT_LIMIT;
+
+                read_param_line("Options (series=NAME&from=S&to=S&step=S&limit=N): ", params, sizeof(params));
+                printf("\n");
+                param_value(params, "series", series, sizeof(series));
+                if (param_value(params, "from", value, sizeof(value))) from = time_param(value, now);
+                if (param_value(params, "to", value, sizeof(value))) to = time_param(value, now);
+                if (param_value(params, "step", value, sizeof(value))) step = atoll(value) * 1000;
+                if (param_value(params, "limit", value, sizeof(value))) limit = atoi(value);
+                output_history_json(series, from, to, step, limit);
+                fflush(stdout);
+                exit(0);
+            }
+            case 16: {
+                char params[256] = "";
+                char name[64] = "";
+                char value[32];
+                pid_t pid = getpid();
+
+                read_param_line("Options (pid=N&name=NAME): ", params, sizeof(params));
+                printf("\n");
+                if (param_value(params, "pid", value, sizeof(value))) pid = (pid_t)atoi(value);
+                param_value(params, "name", name, sizeof(name));
+                output_snapshot_capture_json(pid, name);
+                fflush(stdout);
+                exit(0);
+            }
+            case 17: {
+                char params[256] = "";
+                char from[64] = "";
+                char to[64] = "";
+                char value[32];
+                SnapshotSortKey key = SNAP_SORT_RSS;
+                int limit = SNAPSHOT_DEFAULT_TOP;
+
+                read_param_line("Options (from=NAME&to=NAME&sort=rss|pss|swap&limit=N): ", params, sizeof(params));
+                printf("\n");
+                param_value(params, "from", from, sizeof(from));
+                param_value(params, "to", to, sizeof(to));
+                if (param_value(params, "sort", value, sizeof(value)) &&
+                    parse_snapshot_sort_key(value, &key) != 0) {
+                    printf("Unknown sort key: %s\n", value);
+                    exit(1);
+                }
+                if (param_value(params, "limit", value, sizeof(value))) limit = atoi(value);
+                output_snapshot_diff_json(from, to, key, limit);
+                fflush(stdout);
+                exit(0);
+            }
+            case 18: {
+                char params[128] = "";
+                char value[32];
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                int64_t now = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+                int64_t since = now - 24 * 3600 * 1000;
+                int limit = ANOMALY_DEFAULT_LIMIT;
+
+                read_param_line("Options (since=S&limit=N): ", params, sizeof(params));
+                printf("\n");
+                if (param_value(params, "since", value, sizeof(value))) since = time_param(value, now);
+                if (param_value(params, "limit", value, sizeof(value))) limit = atoi(value);
+                output_alerts_json(since, limit);
+                fflush(stdout);
+                exit(0);
+            }
+            case 19: {
+                char params[64] = "";
+                char value[32];
+                pid_t pid = getpid();
+
+                read_param_line("Options (pid=N): ", params, sizeof(params));
+                printf("\n");
+                if (param_value(params, "pid", value, sizeof(value))) pid = (pid_t)atoi(value);
+                output_malloc_stats_json(pid);
+                fflush(stdout);
+                exit(0);
+            }
+            case 20: {
+                char params[256] = "";
+                char value[32];
+                ReclaimOptions opts;
+                pid_t pid = 0;
+                int limit = RECLAIM_DEFAULT_TOP;
+
+                reclaim_default_options(&opts);
+                read_param_line("Options (pid=N&mode=dry_run|cold|pageout&idle_s=S&settle_s=S&budget_mb=N"
+                                "&rate_mb=N&min_idle=F&max_psi=F&clear_refs=0|1&limit=N): ", params, sizeof(params));
+                printf("\n");
+                if (param_value(params, "pid", value, sizeof(value))) pid = (pid_t)atoi(value);
+                if (param_value(params, "mode", value, sizeof(value)) &&
+                    parse_reclaim_mode(value, &opts.mode) != 0) {
+                    printf("Unknown mode: %s\n", value);
+                    exit(1);
+                }
+                if (param_value(params, "idle_s", value, sizeof(value))) opts.idle_s = (unsigned int)strtoul(value, NULL, 10);
+                if (param_value(params, "settle_s", value, sizeof(value))) opts.settle_s = (unsigned int)strtoul(value, NULL, 10);
+                if (param_value(params, "budget_mb", value, sizeof(value))) opts.budget_bytes = strtoul(value, NULL, 10) << 20;
+                if (param_value(params, "rate_mb", value, sizeof(value))) opts.rate_bytes = strtoul(value, NULL, 10) << 20;
+                if (param_value(params, "min_idle", value, sizeof(value))) opts.min_idle = atof(value);
+                if (param_value(params, "max_psi", value, sizeof(value))) opts.max_psi = atof(value);
+                if (param_value(params, "clear_refs", value, sizeof(value))) opts.clear_refs = atoi(value) != 0;
+                if (param_value(params, "limit", value, sizeof(value))) limit = atoi(value);
+                output_reclaim_json(pid, &opts, limit);
+                fflush(stdout);
+                exit(0);
+            }
             default:
                 printf("Invalid choice\n");
         }
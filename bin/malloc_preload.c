@@ -0,0 +1,49 @@
+// LD_PRELOAD=libvmdmalloc.so: dumps the allocator state of the host
+// process for vmd's heap fragmentation report
+#define _GNU_SOURCE
+#include "malloc_stats.h"
+#include "state_dir.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+static unsigned int g_period_s = MALLOC_STATS_DEFAULT_PERIOD_S;
+
+// Written next to the final name and renamed, so readers never see half a dump
+static void write_dump(void) {
+    char name[64], path[4096], tmp[4200];
+    snprintf(name, sizeof(name), MALLOC_STATS_PREFIX "%d" MALLOC_STATS_SUFFIX, (int)getpid());
+    if (vmd_state_path(path, sizeof(path), name) != 0) return;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE* out = vmd_state_fopen(tmp, "w");
+    if (out == NULL) return;
+    int written = malloc_stats_write(out);
+    if (fclose(out) != 0 || written != 0 || rename(tmp, path) != 0) unlink(tmp);
+}
+
+static void* dump_loop(void* arg) {
+    (void)arg;
+    for (;;) {
+        sleep(g_period_s);
+        write_dump();
+    }
+    return NULL;
+}
+
+__attribute__((constructor)) static void malloc_preload_init(void) {
+    const char* period = getenv(MALLOC_STATS_ENV);
+    if (period != NULL && *period != '\0') g_period_s = (unsigned int)strtoul(period, NULL, 10);
+
+    atexit(write_dump);
+    write_dump();
+    if (g_period_s == 0) return;
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_create(&thread, &attr, dump_loop, NULL);
+    pthread_attr_destroy(&attr);
+}
@@ -0,0 +1,208 @@
+#define _GNU_SOURCE
+#include "malloc_stats.h"
+#include "state_dir.h"
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MALLOC_STATS_LINE 512
+// Free chunks keep their malloc_chunk links, so malloc_trim only returns
+// the pages past this header
+#define MALLOC_CHUNK_HEADER 48
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int malloc_stats_write(FILE* out) {
+    struct mallinfo2 mi = mallinfo2();
+    fprintf(out, "<vmd pid=\"%d\" ts=\"%lld\">\n", (int)getpid(), (long long)now_ms());
+    fprintf(out, "<mallinfo2 arena=\"%zu\" ordblks=\"%zu\" hblks=\"%zu\" hblkhd=\"%zu\" fsmblks=\"%zu\""
+                 " uordblks=\"%zu\" fordblks=\"%zu\"/>\n",
+            mi.arena, mi.ordblks, mi.hblks, mi.hblkhd, mi.fsmblks, mi.uordblks, mi.fordblks);
+    if (malloc_info(0, out) != 0) return -1;
+    fprintf(out, "</vmd>\n");
+    return ferror(out) ? -1 : 0;
+}
+
+static size_t attr(const char* line, const char* name) {
+    char key[32];
+    snprintf(key, sizeof(key), " %s=\"", name);
+    const char* p = strstr(line, key);
+    return p != NULL ? strtoull(p + strlen(key), NULL, 10) : 0;
+}
+
+static int is_type(const char* line, const char* type) {
+    char key[32];
+    snprintf(key, sizeof(key), "type=\"%s\"", type);
+    return strstr(line, key) != NULL;
+}
+
+// Expected bytes of whole pages past the chunk header: a span of length L
+// at a random page offset holds L / page_size - 1 whole pages on average
+static size_t chunk_interior(size_t chunk, size_t page_size) {
+    if (chunk < MALLOC_CHUNK_HEADER + 2 * page_size) return 0;
+    return chunk - MALLOC_CHUNK_HEADER - page_size;
+}
+
+// A bin line gives the size range, total bytes and chunk count
+static size_t account_bin(MallocArenaStats* arena, const char* line, size_t page_size) {
+    size_t from = attr(line, "from"), to = attr(line, "to");
+    size_t total = attr(line, "total"), count = attr(line, "count");
+    if (count == 0) return 0;
+
+    size_t largest = count == 1 ? total : from == to ? to : total / count > from ? total / count : from;
+    if (largest > arena->largest_free_block) arena->largest_free_block = largest;
+    arena->trimmable_bytes += chunk_interior(total / count, page_size) * count;
+    return total;
+}
+
+// Trimming shrinks the top chunk down to a page
+static void finish_arena(MallocStats* stats, MallocArenaStats* arena, size_t binned, size_t page_size) {
+    size_t free_bytes = arena->fast_bytes + arena->rest_bytes;
+    arena->top_bytes = free_bytes > binned ? free_bytes - binned : 0;
+    if (arena->top_bytes > page_size)
+        arena->trimmable_bytes += (arena->top_bytes - page_size) / page_size * page_size;
+    if (arena->top_bytes > arena->largest_free_block) arena->largest_free_block = arena->top_bytes;
+
+    if (stats->num_arenas < MALLOC_STATS_MAX_ARENAS) stats->arenas[stats->num_arenas] = *arena;
+    stats->num_arenas++;
+    if (arena->largest_free_block > stats->largest_free_block) stats->largest_free_block = arena->largest_free_block;
+    stats->trimmable_bytes += arena->trimmable_bytes;
+    stats->top_bytes += arena->top_bytes;
+}
+
+int malloc_stats_parse(const char* xml, MallocStats* stats) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    MallocArenaStats arena;
+    size_t binned = 0;
+    int in_heap = 0, seen_malloc = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    while (*xml) {
+        char line[MALLOC_STATS_LINE];
+        size_t n = strcspn(xml, "\n");
+        size_t copy = n < sizeof(line) - 1 ? n : sizeof(line) - 1;
+        memcpy(line, xml, copy);
+        line[copy] = '\0';
+        xml += n + (xml[n] == '\n');
+
+        const char* tag = line + strspn(line, " \t");
+        if (strncmp(tag, "<vmd ", 5) == 0) {
+            stats->pid = (pid_t)attr(tag, "pid");
+            stats->captured_ms = (int64_t)attr(tag, "ts");
+        } else if (strncmp(tag, "<mallinfo2 ", 11) == 0) {
+            stats->arena_bytes = attr(tag, "arena");
+            stats->in_use_bytes = attr(tag, "uordblks");
+            stats->free_bytes = attr(tag, "fordblks");
+            stats->free_chunks = attr(tag, "ordblks");
+            stats->fast_bytes = attr(tag, "fsmblks");
+            stats->mmap_bytes = attr(tag, "hblkhd");
+            stats->mmap_count = attr(tag, "hblks");
+        } else if (strncmp(tag, "<malloc ", 8) == 0) {
+            seen_malloc = 1;
+        } else if (strncmp(tag, "<heap ", 6) == 0) {
+            memset(&arena, 0, sizeof(arena));
+            binned = 0;
+            arena.arena = (int)attr(tag, "nr");
+            in_heap = 1;
+        } else if (strncmp(tag, "</heap>", 7) == 0) {
+            if (in_heap) finish_arena(stats, &arena, binned, page_size);
+            in_heap = 0;
+        } else if (in_heap && (strncmp(tag, "<size ", 6) == 0 || strncmp(tag, "<unsorted ", 10) == 0)) {
+            binned += account_bin(&arena, tag, page_size);
+        } else if (in_heap && strncmp(tag, "<total ", 7) == 0) {
+            if (is_type(tag, "fast")) {
+                arena.fast_count = attr(tag, "count");
+                arena.fast_bytes = attr(tag, "size");
+            } else if (is_type(tag, "rest")) {
+                arena.rest_count = attr(tag, "count");
+                arena.rest_bytes = attr(tag, "size");
+            }
+        } else if (in_heap && strncmp(tag, "<system ", 8) == 0) {
+            if (is_type(tag, "current")) arena.system_bytes = attr(tag, "size");
+            else if (is_type(tag, "max")) arena.max_system_bytes = attr(tag, "size");
+        } else if (!in_heap && strncmp(tag, "<total ", 7) == 0 && is_type(tag, "mmap")) {
+            stats->mmap_count = attr(tag, "count");
+            stats->mmap_bytes = attr(tag, "size");
+        }
+    }
+    return seen_malloc ? 0 : -1;
+}
+
+int malloc_stats_self(MallocStats* stats) {
+    char* xml = NULL;
+    size_t len = 0;
+    FILE* out = open_memstream(&xml, &len);
+    if (out == NULL) return -1;
+    int written = malloc_stats_write(out);
+    fclose(out);
+    int rc = written == 0 ? malloc_stats_parse(xml, stats) : -1;
+    free(xml);
+    return rc;
+}
+
+static char* read_dump(pid_t pid) {
+    char name[64], path[4096];
+    snprintf(name, sizeof(name), MALLOC_STATS_PREFIX "%d" MALLOC_STATS_SUFFIX, (int)pid);
+    if (vmd_state_path(path, sizeof(path), name) != 0) return NULL;
+
+    FILE* f = vmd_state_fopen(path, "r");
+    if (f == NULL) return NULL;
+    struct stat st;
+    char* xml = NULL;
+    if (fstat(fileno(f), &st) == 0 && (xml = malloc(st.st_size + 1)) != NULL) {
+        size_t n = fread(xml, 1, st.st_size, f);
+        xml[n] = '\0';
+    }
+    fclose(f);
+    return xml;
+}
+
+void output_malloc_stats_json(pid_t pid) {
+    MallocStats* stats = malloc(sizeof(MallocStats));
+    int self = pid == getpid();
+    int rc = -1;
+    if (stats != NULL && self) {
+        rc = malloc_stats_self(stats);
+    } else if (stats != NULL) {
+        char* xml = read_dump(pid);
+        if (xml != NULL) rc = malloc_stats_parse(xml, stats);
+        free(xml);
+    }
+    if (rc != 0) {
+        printf("{\n  \"error\": \"no malloc statistics for pid %d, run it with LD_PRELOAD=libvmdmalloc.so\"\n}\n", (int)pid);
+        free(stats);
+        return;
+    }
+
+    size_t held = stats->arena_bytes + stats->mmap_bytes;
+    printf("{\n");
+    printf("  \"pid\": %d,\n", (int)pid);
+    printf("  \"source\": \"%s\",\n", self ? "self" : "preload");
+    printf("  \"age_ms\": %lld,\n", (long long)(now_ms() - stats->captured_ms));
+    printf("  \"heap\": {\"arena_bytes\": %zu, \"in_use_bytes\": %zu, \"free_bytes\": %zu, \"free_chunks\": %zu, "
+           "\"fast_bytes\": %zu, \"top_bytes\": %zu, \"mmap_bytes\": %zu, \"mmap_count\": %zu, \"num_arenas\": %d, "
+           "\"largest_free_block\": %zu, \"trimmable_bytes\": %zu, \"free_ratio\": %.4f},\n",
+           stats->arena_bytes, stats->in_use_bytes, stats->free_bytes, stats->free_chunks,
+           stats->fast_bytes, stats->top_bytes, stats->mmap_bytes, stats->mmap_count, stats->num_arenas,
+           stats->largest_free_block, stats->trimmable_bytes,
+           held ? (double)stats->free_bytes / held : 0.0);
+    printf("  \"arenas\": [");
+    int shown = stats->num_arenas < MALLOC_STATS_MAX_ARENAS ? stats->num_arenas : MALLOC_STATS_MAX_ARENAS;
+    for (int i = 0; i < shown; i++) {
+        MallocArenaStats* a = &stats->arenas[i];
+        printf("%s\n    {\"arena\": %d, \"system_bytes\": %zu, \"max_system_bytes\": %zu, \"free_bytes\": %zu, "
+               "\"free_chunks\": %zu, \"fast_bytes\": %zu, \"top_bytes\": %zu, \"largest_free_block\": %zu, "
+               "\"trimmable_bytes\": %zu}",
+               i ? "," : "", a->arena, a->system_bytes, a->max_system_bytes, a->fast_bytes + a->rest_bytes,
+               a->fast_count + a->rest_count, a->fast_bytes, a->top_bytes, a->largest_free_block, a->trimmable_bytes);
+    }
+    printf("%s]\n}\n", shown ? "\n  " : "");
+    free(stats);
+}
@@ -0,0 +1,60 @@
+#ifndef MALLOC_STATS_H
+#define MALLOC_STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// libvmdmalloc.so, when preloaded, rewrites <state dir>/malloc-<pid>.xml
+// every $VMD_MALLOC_INFO_S seconds (default MALLOC_STATS_DEFAULT_PERIOD_S)
+// and at exit
+#define MALLOC_STATS_PREFIX "malloc-"
+#define MALLOC_STATS_SUFFIX ".xml"
+#define MALLOC_STATS_ENV "VMD_MALLOC_INFO_S"
+#define MALLOC_STATS_DEFAULT_PERIOD_S 5
+#define MALLOC_STATS_MAX_ARENAS 128
+
+// One <heap> of malloc_info(); glibc counts the top chunk as one of the
+// "rest" chunks, so it is what the listed bins do not account for
+typedef struct {
+    int arena;
+    size_t system_bytes;            // Memory the arena holds from the kernel
+    size_t max_system_bytes;
+    size_t fast_count;
+    size_t fast_bytes;
+    size_t rest_count;
+    size_t rest_bytes;
+    size_t top_bytes;
+    size_t largest_free_block;      // Lower bound when a bin holds several chunks
+    size_t trimmable_bytes;         // Whole pages inside free chunks and the top
+} MallocArenaStats;
+
+typedef struct {
+    pid_t pid;
+    int64_t captured_ms;
+    // mallinfo2() totals over all arenas
+    size_t arena_bytes;
+    size_t in_use_bytes;
+    size_t free_bytes;
+    size_t free_chunks;
+    size_t fast_bytes;
+    size_t mmap_bytes;
+    size_t mmap_count;
+    size_t top_bytes;               // Sum of the arenas' top chunks
+    int num_arenas;                 // May exceed MALLOC_STATS_MAX_ARENAS
+    MallocArenaStats arenas[MALLOC_STATS_MAX_ARENAS];
+    size_t largest_free_block;
+    size_t trimmable_bytes;         // Estimate of what malloc_trim(0) returns
+} MallocStats;
+
+// Writes mallinfo2() and malloc_info() of the calling process as one XML
+// document; 0 on success
+int malloc_stats_write(FILE* out);
+int malloc_stats_parse(const char* xml, MallocStats* stats);
+// Stats of the calling process
+int malloc_stats_self(MallocStats* stats);
+// Stats of pid from its preload dump, or of vmd itself for its own pid
+void output_malloc_stats_json(pid_t pid);
+
+#endif
@@ -1,50 +1,51 @@
 #include "memory_analysis.h"
+#include "self_stats.h"
+#include "vmstat.h"
+#include "history.h"
+#include "malloc_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/resource.h>
 #include <sys/sysinfo.h>
 #include <pthread.h>
 #include <math.h>
 
 // Global variables
 extern MemoryAnalytics g_analytics;
-static pthread_mutex_t g_analytics_mutex = PTHREAD_MUTEX_INITIALIZER;
-static struct timespec g_last_check_time = {0};
-static long g_last_major_faults = 0;
-static long g_last_minor_faults = 0;
+extern pthread_mutex_t g_analytics_mutex;
 
 void init_analytics(void) {
-    clock_gettime(CLOCK_MONOTONIC, &g_last_check_time);
-    struct rusage usage;
-    if (getrusage(RUSAGE_SELF, &usage) == 0) {
-        g_last_major_faults = usage.ru_majflt;
-        g_last_minor_faults = usage.ru_minflt;
-    }
+    pthread_mutex_lock(&g_analytics_mutex);
+    memset(&g_analytics.vmstat, 0, sizeof(g_analytics.vmstat));
+    vmstat_sample(&g_analytics.vmstat);
+    pthread_mutex_unlock(&g_analytics_mutex);
 }
 
 void update_analytics(void) {
-    struct timespec current_time;
-    clock_gettime(CLOCK_MONOTONIC, &current_time);
-
-    double time_diff = (current_time.tv_sec - g_last_check_time.tv_sec) +
-                      (current_time.tv_nsec - g_last_check_time.tv_nsec) / 1e9;
-
-    struct rusage usage;
-    if (getrusage(RUSAGE_SELF, &usage) == 0) {
-        g_analytics.major_faults = usage.ru_majflt - g_last_major_faults;
-        g_analytics.minor_faults = usage.ru_minflt - g_last_minor_faults;
-        g_analytics.fault_rate = (g_analytics.major_faults + g_analytics.minor_faults) / time_diff;
-
-        g_last_major_faults = usage.ru_majflt;
-        g_last_minor_faults = usage.ru_minflt;
+    // System-wide fault counts from /proc/vmstat; pgfault includes major faults
+    SelfSample cost;
+    pthread_mutex_lock(&g_analytics_mutex);
+    VmstatSnapshot vmstat = g_analytics.vmstat;
+    pthread_mutex_unlock(&g_analytics_mutex);
+
+    self_begin(&cost);
+    int sampled = vmstat_sample(&vmstat) == 0;
+    self_end("vmstat", &cost);
+    if (sampled) {
+        pthread_mutex_lock(&g_analytics_mutex);
+        g_analytics.vmstat = vmstat;
+        g_analytics.major_faults = vmstat.delta[VMSTAT_PGMAJFAULT];
+        g_analytics.minor_faults = vmstat.delta[VMSTAT_PGFAULT] - vmstat.delta[VMSTAT_PGMAJFAULT];
+        g_analytics.fault_rate = vmstat.rate[VMSTAT_PGFAULT];
+        pthread_mutex_unlock(&g_analytics_mutex);
     }
 
     // Try to read container memory limit first (for Docker/cgroups)
     unsigned long memTotal = 0;
     unsigned long memAvailable = 0;
-    
+    self_begin(&cost);
+
     // Check cgroup v2 first
     FILE *cgroup_mem = fopen("/sys/fs/cgroup/memory.max", "r");
     if (cgroup_mem) {
@@ -72,8 +73,10 @@ void update_analytics(void) {
             fclose(cgroup_mem);
         }
     }
+    self_end("cgroup", &cost);
 
     // Fallback to /proc/meminfo if no cgroup limit found
+    self_begin(&cost);
     FILE *meminfo = fopen("/proc/meminfo", "r");
     if (meminfo) {
         char line[256];
@@ -117,8 +120,7 @@ void update_analytics(void) {
         }
         pthread_mutex_unlock(&g_analytics_mutex);
     }
-
-    g_last_check_time = current_time;
+    self_end("meminfo", &cost);
 }
 
 void analyze_memory_advanced(void) {
@@ -128,7 +130,12 @@ void analyze_memory_advanced(void) {
         initialized = 1;
     }
 
+    // Give the vmstat rates a meaningful interval
+    usleep(VMSTAT_MIN_INTERVAL_MS * 1000);
     update_analytics();
+    MallocStats heap;
+    if (malloc_stats_self(&heap) == 0) g_analytics.largest_free_block = heap.largest_free_block;
+    history_record_system();
     output_memory_stats_json();
     exit(0);
 }
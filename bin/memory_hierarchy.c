@@ -1,63 +1,58 @@
 #include "memory_hierarchy.h"
 #include "memory_types.h"
+#include "self_stats.h"
+#include "cache_probe.h"
+#include "region_index.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
 
 extern MemoryAnalytics g_analytics;
 
-static const char* determine_region_type(const char* line, const char* perms, const char* path) {
-    if (strstr(line, "[heap]"))
-        return "heap";
-    else if (strstr(line, "[stack]"))
-        return "stack";
-    else if (strstr(perms, "x"))
-        return "code";
-    else if (strlen(path) > 0)
-        return "shared";
-    else
-        return "data";
-}
-
-void analyze_memory_hierarchy(void) {
-    FILE* maps = fopen("/proc/self/maps", "r");
-    if (!maps) return;
+static RegionQuery g_query;
+static uint64_t g_next_cursor;          // Start of the first VMA left out, 0 if none
 
-    // Initialize the regions array
+// VMAs overlapping the query range, whole; the stride does not apply
+void analyze_memory_hierarchy(const RegionQuery* query) {
+    RegionIndex index;
+    if (query != NULL) g_query = *query;
+    else region_query_init(&g_query);
+    g_next_cursor = 0;
     g_analytics.num_regions = 0;
-    g_analytics.memory_regions = malloc(100 * sizeof(MemoryRegion));
+    if (region_index_build(&index, g_query.pid > 0 ? g_query.pid : getpid()) != 0) return;
+
+    size_t first = region_index_seek(&index, g_query.start);
+    size_t cap = index.count - first;
+    if (g_query.limit > 0 && (size_t)g_query.limit < cap) cap = g_query.limit;
+    g_analytics.memory_regions = malloc((cap ? cap : 1) * sizeof(MemoryRegion));
     if (!g_analytics.memory_regions) {
-        fclose(maps);
+        region_index_free(&index);
         return;
     }
 
-    char line[256];
-    while (fgets(line, sizeof(line), maps)) {
-        unsigned long start, end;
-        char perms[5] = {0};
-        char path[256] = {0};
-        
-        if (sscanf(line, "%lx-%lx %4s %*s %*s %*s %s", &start, &end, perms, path) >= 3) {
-            if (g_analytics.num_regions >= 100) break;
-
-            MemoryRegion region = {
-                .start_addr = start,
-                .end_addr = end,
-                .permissions = (strchr(perms, 'r') ? 4 : 0) |
-                             (strchr(perms, 'w') ? 2 : 0) |
-                             (strchr(perms, 'x') ? 1 : 0),
-                .page_size = 4096,
-                .mapped_file = strdup(path),
-                .tlb_hits = 0,
-                .page_faults = 0,
-                .type = determine_region_type(line, perms, path)
-            };
-
-            g_analytics.memory_regions[g_analytics.num_regions++] = region;
+    for (size_t i = first; i < index.count && index.starts[i] < g_query.end; i++) {
+        if (!region_query_kind_match(&g_query, &index, i)) continue;
+        if ((size_t)g_analytics.num_regions == cap) {
+            g_next_cursor = index.starts[i];
+            break;
         }
+        MemoryRegion region = {
+            .start_addr = index.starts[i],
+            .end_addr = index.ends[i],
+            .permissions = index.perms[i] & (REGION_PERM_READ | REGION_PERM_WRITE | REGION_PERM_EXEC),
+            .page_size = 4096,
+            .mapped_file = strdup(region_index_name(&index, i)),
+            .tlb_hits = 0,
+            .page_faults = 0,
+            .type = region_kind_name(index.kinds[i])
+        };
+
+        g_analytics.memory_regions[g_analytics.num_regions++] = region;
     }
 
-    fclose(maps);
+    region_index_free(&index);
 }
 
 void output_memory_hierarchy_json(void) {
@@ -77,12 +72,21 @@ void output_memory_hierarchy_json(void) {
         printf("      \"mapped_file\": \"%s\"\n", region->mapped_file);
         printf("    }%s\n", i < g_analytics.num_regions - 1 ? "," : "");
     }
-    printf("  ]\n");
-    printf("}\n");
+    printf("  ],\n");
+    printf("  \"query\": {\"pid\": %d, \"start\": \"0x%" PRIx64 "\", \"end\": \"0x%" PRIx64 "\", \"limit\": %d},\n",
+           g_query.pid > 0 ? (int)g_query.pid : (int)getpid(), g_query.start, g_query.end, g_query.limit);
+    if (g_next_cursor) printf("  \"next_cursor\": \"%" PRIx64 "\",\n", g_next_cursor);
+    else printf("  \"next_cursor\": null,\n");
+    output_cache_hierarchy_json();
+    output_self_stats_json();
+    printf("\n}\n");
 }
 
-void display_memory_hierarchy(void) {
-    analyze_memory_hierarchy();
+void display_memory_hierarchy(const RegionQuery* query) {
+    SelfSample cost;
+    self_begin(&cost);
+    analyze_memory_hierarchy(query);
+    self_end("hierarchy", &cost);
     output_memory_hierarchy_json();
     
     // Clean up
@@ -1,8 +1,11 @@
 #ifndef MEMORY_HIERARCHY_H
 #define MEMORY_HIERARCHY_H
 
-void analyze_memory_hierarchy(void);
-void display_memory_hierarchy(void);
+#include "region_index.h"
+
+// NULL lists every VMA of vmd itself
+void analyze_memory_hierarchy(const RegionQuery* query);
+void display_memory_hierarchy(const RegionQuery* query);
 void output_memory_hierarchy_json(void);
 
-#endif 
\ No newline at end of file
+#endif 
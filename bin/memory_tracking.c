@@ -1,100 +1,726 @@
 #include "memory_tracking.h"
 #include <stdio.h>
+#include <stdint.h>
 #include <pthread.h>
+#include <sched.h>
 #include <string.h>
+#include <math.h>
+#include <malloc.h>
+#include <execinfo.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "heap_profile.h"
+
+#define BLOCK_SHARDS 64
+#define BLOCK_SHARD_MIN_BUCKETS 256
+#define MAX_CALLSITES TRACK_MAX_CALLSITES
+#define SAMPLE_FILTER_SIZE 16384
+#define OVERFLOW_CALLSITE (MAX_CALLSITES - 1)
+#define LEAK_REPORT_TOP 20
+#define POOL_REPORT_TOP 10
+#define POOL_SHORT_LIFETIME_NS 100000
+
+// Live blocks are indexed by pointer across independently locked shards
+typedef struct {
+    pthread_mutex_t lock;
+    MemoryBlock** buckets;
+    size_t num_buckets;
+    size_t count;
+} BlockShard;
 
 // Global variables for memory tracking
-static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static BlockShard g_shards[BLOCK_SHARDS] = {
+    [0 ... BLOCK_SHARDS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+};
 extern pthread_mutex_t g_analytics_mutex;
-static MemoryBlock* g_memory_block_head = NULL;
 extern MemoryAnalytics g_analytics;
 
+// Callsite table: slots are claimed with a CAS on the key and never removed,
+// so readers can walk it without taking any lock
+static CallsiteStats g_callsites[MAX_CALLSITES];
+static unsigned long g_callsite_keys[MAX_CALLSITES];
+static int g_callsite_ready[MAX_CALLSITES] = { [OVERFLOW_CALLSITE] = 1 };
+
+// Sampling mode: 0 records every allocation, otherwise one sample is taken
+// on average every g_sample_interval bytes using per-thread countdowns
+static size_t g_sample_interval = 0;
+static __thread long t_bytes_until_sample;
+static __thread unsigned long t_sample_rng;
+
+// Counting filter over recorded pointers, so freeing an unsampled block
+// skips the shard lock entirely
+static unsigned int g_sample_filter[SAMPLE_FILTER_SIZE];
+static const char* g_profile_path = NULL;
+
+// Lock-free histograms, updated with the same weights as the callsites
+static struct {
+    size_t count;
+    size_t bytes;
+} g_size_classes[TRACK_SIZE_CLASSES];
+static ReallocStats g_realloc_stats;
+
+// Lifetimes are measured in raw clock ticks and converted at report time
+static pthread_once_t g_clock_once = PTHREAD_ONCE_INIT;
+static unsigned long long g_clock_origin_ticks;
+static struct timespec g_clock_origin;
+
+static inline size_t hash_pointer(const void* ptr) {
+    uintptr_t h = (uintptr_t)ptr >> 4;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)h;
+}
+
+static unsigned long hash_callsite(const char* file, int line, void** stack, int depth) {
+    unsigned long h = 1469598103934665603UL;
+    for (const char* p = file ? file : ""; *p; p++)
+        h = (h ^ (unsigned char)*p) * 1099511628211UL;
+    h = (h ^ (unsigned long)line) * 1099511628211UL;
+    for (int i = 0; i < depth; i++)
+        h = (h ^ (uintptr_t)stack[i]) * 1099511628211UL;
+    return h ? h : 1;
+}
+
+static CallsiteStats* lookup_callsite(const char* file, int line, void** stack, int depth) {
+    unsigned long key = hash_callsite(file, line, stack, depth);
+    size_t slot = key % OVERFLOW_CALLSITE;
+
+    for (size_t probe = 0; probe < OVERFLOW_CALLSITE; probe++) {
+        unsigned long current = __atomic_load_n(&g_callsite_keys[slot], __ATOMIC_ACQUIRE);
+        if (current == 0) {
+            if (__atomic_compare_exchange_n(&g_callsite_keys[slot], &current, key, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                CallsiteStats* cs = &g_callsites[slot];
+                cs->file = file;
+                cs->line = line;
+                cs->stack_hash = key;
+                cs->stack_depth = depth;
+                memcpy(cs->stack, stack, depth * sizeof(void*));
+                clock_gettime(CLOCK_MONOTONIC, &cs->first_seen);
+                __atomic_store_n(&g_callsite_ready[slot], 1, __ATOMIC_RELEASE);
+                return cs;
+            }
+        }
+        if (current == key) {
+            // Another thread claimed the slot and is still filling it in
+            while (!__atomic_load_n(&g_callsite_ready[slot], __ATOMIC_ACQUIRE))
+                sched_yield();
+            return &g_callsites[slot];
+        }
+        slot = (slot + 1) % OVERFLOW_CALLSITE;
+    }
+    return &g_callsites[OVERFLOW_CALLSITE];
+}
+
+static long next_sample_countdown(size_t interval) {
+    if (t_sample_rng == 0)
+        t_sample_rng = hash_pointer(&t_sample_rng) | 1;
+
+    // xorshift64, then an exponential draw so sample points form a
+    // Poisson process over allocated bytes
+    t_sample_rng ^= t_sample_rng << 13;
+    t_sample_rng ^= t_sample_rng >> 7;
+    t_sample_rng ^= t_sample_rng << 17;
+    double u = ((t_sample_rng >> 11) + 1) * (1.0 / 9007199254740993.0);
+    return (long)(-log(u) * (double)interval) + 1;
+}
+
+// Decides whether this allocation is recorded and with what weight
+static int sample_allocation(size_t size, size_t* weight_count, size_t* weight_bytes) {
+    size_t interval = __atomic_load_n(&g_sample_interval, __ATOMIC_RELAXED);
+    if (interval == 0) {
+        *weight_count = 1;
+        *weight_bytes = size;
+        return 1;
+    }
+
+    if (t_bytes_until_sample == 0)
+        t_bytes_until_sample = next_sample_countdown(interval);
+    t_bytes_until_sample -= (long)size;
+    if (t_bytes_until_sample > 0) return 0;
+    t_bytes_until_sample = next_sample_countdown(interval);
+
+    // P(sampled) = 1 - exp(-size / interval); weighting by 1/P keeps the
+    // per-callsite estimates unbiased
+    double probability = 1.0 - exp(-(double)size / (double)interval);
+    double weight = probability > 0 ? 1.0 / probability : (double)interval;
+    *weight_count = (size_t)(weight + 0.5);
+    *weight_bytes = (size_t)(weight * (double)size + 0.5);
+    return 1;
+}
+
+static inline unsigned int* sample_filter_slot(const void* ptr) {
+    return &g_sample_filter[(hash_pointer(ptr) >> 32) % SAMPLE_FILTER_SIZE];
+}
+
+void tracker_set_sample_interval(size_t bytes) {
+    __atomic_store_n(&g_sample_interval, bytes, __ATOMIC_RELAXED);
+}
+
+size_t tracker_sample_interval(void) {
+    return __atomic_load_n(&g_sample_interval, __ATOMIC_RELAXED);
+}
+
+static void write_profile_at_exit(void) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.pb", g_profile_path);
+    FILE* pprof = fopen(path, "wb");
+    if (pprof) {
+        heap_profile_write_pprof(pprof);
+        fclose(pprof);
+    }
+
+    snprintf(path, sizeof(path), "%s.folded", g_profile_path);
+    FILE* folded = fopen(path, "w");
+    if (folded) {
+        heap_profile_write_folded(folded);
+        fclose(folded);
+    }
+}
+
+void tracker_init_from_env(void) {
+    const char* rate = getenv("VMD_HEAP_SAMPLE_BYTES");
+    if (rate != NULL) {
+        char* end;
+        unsigned long long bytes = strtoull(rate, &end, 10);
+        tracker_set_sample_interval(end == rate ? TRACK_DEFAULT_SAMPLE_INTERVAL : (size_t)bytes);
+    }
+
+    g_profile_path = getenv("VMD_HEAP_PROFILE");
+    if (g_profile_path != NULL && *g_profile_path != '\0')
+        atexit(write_profile_at_exit);
+}
+
+static inline unsigned long long lifetime_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static void init_lifetime_clock(void) {
+    clock_gettime(CLOCK_MONOTONIC, &g_clock_origin);
+    g_clock_origin_ticks = lifetime_clock();
+}
+
+// Calibrated against CLOCK_MONOTONIC over the tracker's lifetime so far
+static double ticks_per_ns(void) {
+    pthread_once(&g_clock_once, init_lifetime_clock);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    unsigned long long ticks = lifetime_clock();
+    double elapsed_ns = (now.tv_sec - g_clock_origin.tv_sec) * 1e9 +
+                        (now.tv_nsec - g_clock_origin.tv_nsec);
+    if (elapsed_ns < 1e6) {
+        struct timespec pause = { 0, 2000000 };
+        nanosleep(&pause, NULL);
+        return ticks_per_ns();
+    }
+    return (double)(ticks - g_clock_origin_ticks) / elapsed_ns;
+}
+
+static int shard_grow(BlockShard* shard) {
+    size_t num_buckets = shard->num_buckets ? shard->num_buckets * 2 : BLOCK_SHARD_MIN_BUCKETS;
+    MemoryBlock** buckets = calloc(num_buckets, sizeof(MemoryBlock*));
+    if (buckets == NULL) return -1;
+
+    for (size_t i = 0; i < shard->num_buckets; i++) {
+        MemoryBlock* curr = shard->buckets[i];
+        while (curr != NULL) {
+            MemoryBlock* next = curr->next;
+            size_t idx = (hash_pointer(curr->ptr) / BLOCK_SHARDS) & (num_buckets - 1);
+            curr->next = buckets[idx];
+            buckets[idx] = curr;
+            curr = next;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->num_buckets = num_buckets;
+    return 0;
+}
+
+static int insert_block(MemoryBlock* block) {
+    size_t h = hash_pointer(block->ptr);
+    BlockShard* shard = &g_shards[h % BLOCK_SHARDS];
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->count >= shard->num_buckets && shard_grow(shard) != 0 && shard->num_buckets == 0) {
+        pthread_mutex_unlock(&shard->lock);
+        return -1;
+    }
+    size_t idx = (h / BLOCK_SHARDS) & (shard->num_buckets - 1);
+    block->next = shard->buckets[idx];
+    shard->buckets[idx] = block;
+    shard->count++;
+    pthread_mutex_unlock(&shard->lock);
+    return 0;
+}
+
+static MemoryBlock* remove_block(void* ptr) {
+    size_t h = hash_pointer(ptr);
+    BlockShard* shard = &g_shards[h % BLOCK_SHARDS];
+    MemoryBlock* found = NULL;
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->num_buckets > 0) {
+        MemoryBlock** link = &shard->buckets[(h / BLOCK_SHARDS) & (shard->num_buckets - 1)];
+        while (*link != NULL && (*link)->ptr != ptr)
+            link = &(*link)->next;
+        if (*link != NULL) {
+            found = *link;
+            *link = found->next;
+            shard->count--;
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return found;
+}
+
+static inline int size_class_index(size_t size) {
+    if (size <= 16) return size <= 8 ? 0 : 1;
+
+    // Four classes per power of two above 16 bytes
+    int lg = 63 - __builtin_clzl(size - 1);
+    int index = 2 + (lg - 4) * 4 + (int)(((size - 1) >> (lg - 2)) & 3);
+    return index < TRACK_SIZE_CLASSES ? index : TRACK_SIZE_CLASSES - 1;
+}
+
+static size_t size_class_max(int index) {
+    if (index < 2) return index == 0 ? 8 : 16;
+    if (index == TRACK_SIZE_CLASSES - 1) return SIZE_MAX;
+    int lg = (index - 2) / 4 + 4;
+    return ((size_t)1 << lg) + (size_t)((index - 2) % 4 + 1) * ((size_t)1 << (lg - 2));
+}
+
+// Callers must be the public tracked_* entry points so the backtrace skip is right.
+// born is the lifetime clock when the data was first allocated, 0 for now
+static __attribute__((noinline)) void record_allocation(void* ptr, size_t size, const char* filename,
+                                                        int line, unsigned long long born) {
+    size_t weight_count, weight_bytes;
+    if (!sample_allocation(size, &weight_count, &weight_bytes)) return;
+
+    int size_class = size_class_index(size);
+    __atomic_fetch_add(&g_size_classes[size_class].count, weight_count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_size_classes[size_class].bytes, weight_bytes, __ATOMIC_RELAXED);
+
+    MemoryBlock* block = malloc(sizeof(MemoryBlock));
+    if (block == NULL) return;
+
+    // Frames 0 and 1 are record_allocation and the tracked_* entry point
+    void* stack[TRACK_STACK_DEPTH + 2];
+    int depth = backtrace(stack, TRACK_STACK_DEPTH + 2);
+    CallsiteStats* cs = lookup_callsite(filename, line, stack + 2, depth > 2 ? depth - 2 : 0);
+
+    block->ptr = ptr;
+    block->size = size;
+    block->file = filename;
+    block->line = line;
+    block->callsite = cs;
+    block->weight_count = weight_count;
+    block->weight_bytes = weight_bytes;
+    pthread_once(&g_clock_once, init_lifetime_clock);
+    block->alloc_ticks = born ? born : lifetime_clock();
+
+    __atomic_fetch_add(sample_filter_slot(ptr), 1, __ATOMIC_RELAXED);
+    if (insert_block(block) != 0) {
+        __atomic_fetch_sub(sample_filter_slot(ptr), 1, __ATOMIC_RELAXED);
+        free(block);
+        return;
+    }
+
+    __atomic_fetch_add(&cs->live_count, weight_count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cs->live_bytes, weight_bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cs->total_count, weight_count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cs->total_bytes, weight_bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cs->live_samples, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&g_analytics_mutex);
+    g_analytics.memory_usage += weight_bytes;
+    if (g_analytics.memory_usage > g_analytics.peak_usage) {
+        g_analytics.peak_usage = g_analytics.memory_usage;
+    }
+    pthread_mutex_unlock(&g_analytics_mutex);
+}
+
+// Unlinks the block for ptr from the index without touching its stats
+static MemoryBlock* take_block(void* ptr) {
+    unsigned int* filter = sample_filter_slot(ptr);
+    if (__atomic_load_n(filter, __ATOMIC_RELAXED) == 0) return NULL;
+
+    MemoryBlock* block = remove_block(ptr);
+    if (block != NULL) __atomic_fetch_sub(filter, 1, __ATOMIC_RELAXED);
+    return block;
+}
+
+static void restore_block(MemoryBlock* block) {
+    __atomic_fetch_add(sample_filter_slot(block->ptr), 1, __ATOMIC_RELAXED);
+    if (insert_block(block) != 0) {
+        __atomic_fetch_sub(sample_filter_slot(block->ptr), 1, __ATOMIC_RELAXED);
+        free(block);
+    }
+}
+
+// A realloc hands the data on rather than freeing it, so it ends no
+// lifetime and counts no free
+static void release_block(MemoryBlock* block, int freed) {
+    if (freed) {
+        unsigned long long lifetime = lifetime_clock() - block->alloc_ticks;
+        int bucket = 63 - __builtin_clzll(lifetime | 1);
+        if (bucket >= TRACK_LIFETIME_BUCKETS) bucket = TRACK_LIFETIME_BUCKETS - 1;
+        __atomic_fetch_add(&block->callsite->lifetime_hist[bucket], block->weight_count, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&block->callsite->freed_count, block->weight_count, __ATOMIC_RELAXED);
+    }
+
+    __atomic_fetch_sub(&block->callsite->live_count, block->weight_count, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&block->callsite->live_bytes, block->weight_bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&block->callsite->live_samples, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&g_analytics_mutex);
+    g_analytics.memory_usage -= block->weight_bytes;
+    pthread_mutex_unlock(&g_analytics_mutex);
+
+    free(block);
+}
+
 void* tracked_malloc(size_t size, const char* filename, int line) {
     void* ptr = malloc(size);
-    if (ptr != NULL) {
-        MemoryBlock* block = malloc(sizeof(MemoryBlock));
-        if (block == NULL) return ptr;
-
-        block->ptr = ptr;
-        block->size = size;
-        block->file = filename;
-        block->line = line;
-
-        pthread_mutex_lock(&g_mutex);
-        block->next = g_memory_block_head;
-        g_memory_block_head = block;
-        pthread_mutex_unlock(&g_mutex);
-
-        pthread_mutex_lock(&g_analytics_mutex);
-        g_analytics.memory_usage += size;
-        if (g_analytics.memory_usage > g_analytics.peak_usage) {
-            g_analytics.peak_usage = g_analytics.memory_usage;
-        }
-        pthread_mutex_unlock(&g_analytics_mutex);
+    if (ptr != NULL) record_allocation(ptr, size, filename, line, 0);
+    return ptr;
+}
+
+void* tracked_calloc(size_t count, size_t size, const char* filename, int line) {
+    void* ptr = calloc(count, size);
+    if (ptr != NULL) record_allocation(ptr, count * size, filename, line, 0);
+    return ptr;
+}
+
+void* tracked_realloc(void* ptr, size_t size, const char* filename, int line) {
+    if (ptr == NULL) {
+        void* fresh = malloc(size);
+        if (fresh != NULL) record_allocation(fresh, size, filename, line, 0);
+        return fresh;
+    }
+    if (size == 0) {
+        tracked_free(ptr);
+        return NULL;
+    }
+
+    // Unlink first so a concurrent allocation reusing the old address
+    // cannot be mistaken for this block
+    MemoryBlock* old = take_block(ptr);
+    size_t old_size = old != NULL ? old->size : malloc_usable_size(ptr);
+    void* new_ptr = realloc(ptr, size);
+    if (new_ptr == NULL) {
+        if (old != NULL) restore_block(old);
+        return NULL;
     }
+
+    __atomic_fetch_add(&g_realloc_stats.calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(new_ptr == ptr ? &g_realloc_stats.in_place : &g_realloc_stats.moved,
+                       1, __ATOMIC_RELAXED);
+    if (size > old_size)
+        __atomic_fetch_add(&g_realloc_stats.grow_bytes, size - old_size, __ATOMIC_RELAXED);
+    else
+        __atomic_fetch_add(&g_realloc_stats.shrink_bytes, old_size - size, __ATOMIC_RELAXED);
+
+    // The new block keeps the old one's birth, so growing a buffer does
+    // not show up as a short-lived allocation
+    unsigned long long born = old != NULL ? old->alloc_ticks : 0;
+    if (old != NULL) release_block(old, 0);
+    record_allocation(new_ptr, size, filename, line, born);
+    return new_ptr;
+}
+
+void* tracked_aligned_alloc(size_t alignment, size_t size, const char* filename, int line) {
+    void* ptr = aligned_alloc(alignment, size);
+    if (ptr != NULL) record_allocation(ptr, size, filename, line, 0);
     return ptr;
 }
 
+int tracked_posix_memalign(void** out, size_t alignment, size_t size,
+                           const char* filename, int line) {
+    int err = posix_memalign(out, alignment, size);
+    if (err == 0) record_allocation(*out, size, filename, line, 0);
+    return err;
+}
+
 void tracked_free(void* ptr) {
     if (ptr == NULL) return;
 
-    pthread_mutex_lock(&g_mutex);
-    MemoryBlock* prev = NULL;
-    MemoryBlock* curr = g_memory_block_head;
-    
-    while (curr != NULL && curr->ptr != ptr) {
-        prev = curr;
-        curr = curr->next;
+    MemoryBlock* block = take_block(ptr);
+    if (block != NULL) release_block(block, 1);
+    free(ptr);
+}
+
+int tracker_size_classes(SizeClassStats* out, int max_classes) {
+    int count = 0;
+    for (int i = 0; i < TRACK_SIZE_CLASSES && count < max_classes; i++) {
+        size_t allocs = __atomic_load_n(&g_size_classes[i].count, __ATOMIC_RELAXED);
+        if (allocs == 0) continue;
+        out[count].max_size = size_class_max(i);
+        out[count].count = allocs;
+        out[count].bytes = __atomic_load_n(&g_size_classes[i].bytes, __ATOMIC_RELAXED);
+        count++;
     }
+    return count;
+}
+
+void tracker_realloc_stats(ReallocStats* out) {
+    out->calls = __atomic_load_n(&g_realloc_stats.calls, __ATOMIC_RELAXED);
+    out->in_place = __atomic_load_n(&g_realloc_stats.in_place, __ATOMIC_RELAXED);
+    out->moved = __atomic_load_n(&g_realloc_stats.moved, __ATOMIC_RELAXED);
+    out->grow_bytes = __atomic_load_n(&g_realloc_stats.grow_bytes, __ATOMIC_RELAXED);
+    out->shrink_bytes = __atomic_load_n(&g_realloc_stats.shrink_bytes, __ATOMIC_RELAXED);
+}
+
+static void copy_callsite(const CallsiteStats* cs, CallsiteStats* row) {
+    // Counters are read individually, so a row may mix values from
+    // allocations that raced with the snapshot
+    *row = *cs;
+    if (row->file == NULL) row->file = "(other callsites)";
+    row->live_count = __atomic_load_n(&cs->live_count, __ATOMIC_RELAXED);
+    row->live_bytes = __atomic_load_n(&cs->live_bytes, __ATOMIC_RELAXED);
+    row->total_count = __atomic_load_n(&cs->total_count, __ATOMIC_RELAXED);
+    row->total_bytes = __atomic_load_n(&cs->total_bytes, __ATOMIC_RELAXED);
+    row->live_samples = __atomic_load_n(&cs->live_samples, __ATOMIC_RELAXED);
+    row->freed_count = __atomic_load_n(&cs->freed_count, __ATOMIC_RELAXED);
+    for (int b = 0; b < TRACK_LIFETIME_BUCKETS; b++)
+        row->lifetime_hist[b] = __atomic_load_n(&cs->lifetime_hist[b], __ATOMIC_RELAXED);
+}
 
-    if (curr != NULL) {
-        if (prev != NULL) prev->next = curr->next;
-        else g_memory_block_head = curr->next;
+int tracker_top_callsites(CallsiteStats* out, int max_results, const char* file_name) {
+    int found = 0;
 
-        pthread_mutex_lock(&g_analytics_mutex);
-        g_analytics.memory_usage -= curr->size;
-        pthread_mutex_unlock(&g_analytics_mutex);
+    for (int slot = 0; slot < MAX_CALLSITES; slot++) {
+        if (!__atomic_load_n(&g_callsite_ready[slot], __ATOMIC_ACQUIRE)) continue;
 
-        free(curr);
+        const CallsiteStats* cs = &g_callsites[slot];
+        if (file_name != NULL && slot != OVERFLOW_CALLSITE &&
+            (cs->file == NULL || strcmp(cs->file, file_name) != 0)) continue;
+        if (__atomic_load_n(&cs->live_count, __ATOMIC_RELAXED) == 0) continue;
+
+        CallsiteStats row;
+        copy_callsite(cs, &row);
+
+        // Keep out[] sorted by live bytes, largest first
+        int pos;
+        if (found < max_results)
+            pos = found++;
+        else if (max_results > 0 && out[max_results - 1].live_bytes < row.live_bytes)
+            pos = max_results - 1;
+        else
+            continue;
+
+        while (pos > 0 && out[pos - 1].live_bytes < row.live_bytes) {
+            out[pos] = out[pos - 1];
+            pos--;
+        }
+        out[pos] = row;
     }
-    pthread_mutex_unlock(&g_mutex);
-    free(ptr);
+    return found;
+}
+
+// Lifetime (ns) below which the given fraction of freed allocations fall
+static double lifetime_percentile_ns(const CallsiteStats* cs, double fraction, double tpn) {
+    size_t target = (size_t)(cs->freed_count * fraction);
+    size_t seen = 0;
+    for (int b = 0; b < TRACK_LIFETIME_BUCKETS; b++) {
+        seen += cs->lifetime_hist[b];
+        if (seen > target) return (double)(2ULL << b) / tpn;
+    }
+    return (double)(1ULL << TRACK_LIFETIME_BUCKETS) / tpn;
+}
+
+int tracker_pool_candidates(PoolCandidate* out, int max_results) {
+    double tpn = ticks_per_ns();
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int found = 0;
+
+    for (int slot = 0; slot < MAX_CALLSITES; slot++) {
+        if (!__atomic_load_n(&g_callsite_ready[slot], __ATOMIC_ACQUIRE)) continue;
+        if (__atomic_load_n(&g_callsites[slot].freed_count, __ATOMIC_RELAXED) == 0) continue;
+
+        PoolCandidate row;
+        copy_callsite(&g_callsites[slot], &row.callsite);
+        CallsiteStats* cs = &row.callsite;
+
+        double age = (now.tv_sec - cs->first_seen.tv_sec) +
+                     (now.tv_nsec - cs->first_seen.tv_nsec) / 1e9;
+        size_t short_lived = 0;
+        for (int b = 0; b < TRACK_LIFETIME_BUCKETS; b++) {
+            if ((double)(2ULL << b) / tpn <= POOL_SHORT_LIFETIME_NS)
+                short_lived += cs->lifetime_hist[b];
+        }
+
+        row.alloc_rate = cs->total_count / (age > 1e-3 ? age : 1e-3);
+        row.short_lived_fraction = (double)short_lived / cs->total_count;
+        row.p50_lifetime_ns = lifetime_percentile_ns(cs, 0.5, tpn);
+        row.p90_lifetime_ns = lifetime_percentile_ns(cs, 0.9, tpn);
+        row.score = row.alloc_rate * row.short_lived_fraction;
+
+        // Keep out[] sorted by score, highest first
+        int pos;
+        if (found < max_results)
+            pos = found++;
+        else if (max_results > 0 && out[max_results - 1].score < row.score)
+            pos = max_results - 1;
+        else
+            continue;
+
+        while (pos > 0 && out[pos - 1].score < row.score) {
+            out[pos] = out[pos - 1];
+            pos--;
+        }
+        out[pos] = row;
+    }
+    return found;
+}
+
+void report_pool_candidates(void) {
+    PoolCandidate* top = malloc(POOL_REPORT_TOP * sizeof(PoolCandidate));
+    if (top == NULL) return;
+    int count = tracker_pool_candidates(top, POOL_REPORT_TOP);
+
+    printf("\nPooling candidates (allocation rate x short-lived share):\n");
+    printf("-----------------------------\n");
+    for (int i = 0; i < count; i++) {
+        PoolCandidate* pc = &top[i];
+        printf("%s:%d  score %.1f  %.1f allocs/s  %.0f%% freed within %dus  "
+               "lifetime p50 %.0fns p90 %.0fns\n",
+               pc->callsite.file, pc->callsite.line, pc->score, pc->alloc_rate,
+               pc->short_lived_fraction * 100, POOL_SHORT_LIFETIME_NS / 1000,
+               pc->p50_lifetime_ns, pc->p90_lifetime_ns);
+    }
+    if (count == 0) printf("No freed allocations recorded yet.\n");
+    printf("-----------------------------\n");
+    free(top);
 }
 
 void detect_memory_leaks(const char* file_name) {
-    pthread_mutex_lock(&g_mutex);
-    MemoryBlock* curr = g_memory_block_head;
-    int leak_count = 0;
+    CallsiteStats top[LEAK_REPORT_TOP];
+    int count = tracker_top_callsites(top, LEAK_REPORT_TOP, file_name);
+    size_t leak_count = 0;
     size_t total_leaked = 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
     printf("\nChecking for memory leaks...\n");
     printf("-----------------------------\n");
 
-    while (curr != NULL) {
-        if (strcmp(curr->file, file_name) == 0) {
-            printf("Leak detected: %zu bytes at %s:%d\n", 
-                   curr->size, curr->file, curr->line);
-            leak_count++;
-            total_leaked += curr->size;
+    for (int i = 0; i < count; i++) {
+        CallsiteStats* cs = &top[i];
+        double age = (now.tv_sec - cs->first_seen.tv_sec) +
+                     (now.tv_nsec - cs->first_seen.tv_nsec) / 1e9;
+
+        printf("Leak detected: %zu bytes in %zu blocks at %s:%d\n",
+               cs->live_bytes, cs->live_count, cs->file, cs->line);
+        printf("  callsite %016lx, age %.1fs, %zu allocations / %zu bytes total\n",
+               cs->stack_hash, age, cs->total_count, cs->total_bytes);
+
+        char** symbols = backtrace_symbols(cs->stack, cs->stack_depth);
+        for (int f = 0; symbols != NULL && f < cs->stack_depth; f++) {
+            printf("    #%d %s\n", f, symbols[f]);
         }
-        curr = curr->next;
+        free(symbols);
+
+        leak_count += cs->live_count;
+        total_leaked += cs->live_bytes;
     }
 
     if (leak_count == 0) {
         printf("No memory leaks detected.\n");
     } else {
         printf("\nSummary:\n");
-        printf("- Total leaks found: %d\n", leak_count);
+        printf("- Leaking callsites shown: %d\n", count);
+        printf("- Total leaks found: %zu\n", leak_count);
         printf("- Total memory leaked: %zu bytes\n", total_leaked);
     }
     printf("-----------------------------\n");
+}
+
+static size_t round_glibc(size_t size) {
+    // 16-byte aligned chunks with an 8-byte header; large requests are mmapped
+    if (size >= 128 * 1024) return (size + 16 + 4095) & ~(size_t)4095;
+    size_t chunk = (size + 8 + 15) & ~(size_t)15;
+    return (chunk < 32 ? 32 : chunk) - 8;
+}
+
+static size_t round_quarter_classes(size_t size, size_t small_step, size_t small_max) {
+    if (size <= small_max) return size <= small_step ? small_step : (size + small_step - 1) / small_step * small_step;
+    int lg = 63 - __builtin_clzl(size - 1);
+    size_t step = (size_t)1 << (lg - 2);
+    return (size + step - 1) & ~(step - 1);
+}
+
+static size_t round_jemalloc(size_t size) {
+    return size <= 8 ? 8 : round_quarter_classes(size, 16, 128);
+}
+
+static size_t round_mimalloc(size_t size) {
+    return round_quarter_classes(size, 8, 64);
+}
+
+void report_size_classes(void) {
+    SizeClassStats classes[TRACK_SIZE_CLASSES];
+    int count = tracker_size_classes(classes, TRACK_SIZE_CLASSES);
+    size_t total_count = 0;
+    size_t total_bytes = 0;
+    double waste_glibc = 0, waste_jemalloc = 0, waste_mimalloc = 0;
+
+    for (int i = 0; i < count; i++) {
+        total_count += classes[i].count;
+        total_bytes += classes[i].bytes;
+    }
+
+    printf("\nAllocation size classes:\n");
+    printf("-----------------------------\n");
+    printf("%12s %12s %14s %7s\n", "size <=", "count", "bytes", "share");
+    for (int i = 0; i < count; i++) {
+        SizeClassStats* sc = &classes[i];
+        double share = total_count ? (double)sc->count / total_count : 0;
+
+        // Rounding waste is estimated from the mean request in the class
+        size_t mean = sc->bytes / sc->count;
+        waste_glibc += (double)(round_glibc(mean) - mean) * sc->count;
+        waste_jemalloc += (double)(round_jemalloc(mean) - mean) * sc->count;
+        waste_mimalloc += (double)(round_mimalloc(mean) - mean) * sc->count;
+
+        if (sc->max_size == SIZE_MAX)
+            printf("%12s %12zu %14zu %6.1f%%", "max", sc->count, sc->bytes, share * 100);
+        else
+            printf("%12zu %12zu %14zu %6.1f%%", sc->max_size, sc->count, sc->bytes, share * 100);
+        printf("%s\n", share >= 0.10 && sc->count >= 1000 ? "  <- pool candidate" : "");
+    }
 
-    pthread_mutex_unlock(&g_mutex);
+    if (total_bytes > 0) {
+        printf("\nEstimated rounding waste: glibc %.1f%%, jemalloc %.1f%%, mimalloc %.1f%%\n",
+               waste_glibc * 100 / total_bytes, waste_jemalloc * 100 / total_bytes,
+               waste_mimalloc * 100 / total_bytes);
+    }
+
+    ReallocStats rs;
+    tracker_realloc_stats(&rs);
+    if (rs.calls > 0) {
+        printf("Realloc: %zu calls, %zu in place, %zu moved, +%zu / -%zu bytes\n",
+               rs.calls, rs.in_place, rs.moved, rs.grow_bytes, rs.shrink_bytes);
+    }
+    printf("-----------------------------\n");
 }
 
 void test_memory_leaks(void) {
     int* ptr1 = tracked_malloc(sizeof(int) * 100, __FILE__, __LINE__);
     tracked_malloc(sizeof(int) * 200, __FILE__, __LINE__);
     tracked_free(ptr1);
+    char* buffer = tracked_calloc(16, sizeof(char), __FILE__, __LINE__);
+    buffer = tracked_realloc(buffer, 4096, __FILE__, __LINE__);
     detect_memory_leaks(__FILE__);
-} 
\ No newline at end of file
+    report_size_classes();
+    report_pool_candidates();
+}
@@ -4,9 +4,46 @@
 #include <stdlib.h>
 #include "memory_types.h"
 
+// Mean bytes between samples when sampling is enabled without a rate
+#define TRACK_DEFAULT_SAMPLE_INTERVAL (512 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 void* tracked_malloc(size_t size, const char* filename, int line);
+void* tracked_calloc(size_t count, size_t size, const char* filename, int line);
+void* tracked_realloc(void* ptr, size_t size, const char* filename, int line);
+void* tracked_aligned_alloc(size_t alignment, size_t size, const char* filename, int line);
+int tracked_posix_memalign(void** out, size_t alignment, size_t size,
+                           const char* filename, int line);
 void tracked_free(void* ptr);
 void detect_memory_leaks(const char* file_name);
+
+// Copies up to max_results callsites with live allocations, largest live
+// bytes first, without blocking allocation. file_name == NULL matches all.
+int tracker_top_callsites(CallsiteStats* out, int max_results, const char* file_name);
 void test_memory_leaks(void);
 
+// Sampling mode: record one allocation per `bytes` allocated on average,
+// 0 records every allocation. VMD_HEAP_SAMPLE_BYTES sets it at startup and
+// VMD_HEAP_PROFILE=<prefix> writes <prefix>.pb and <prefix>.folded at exit.
+void tracker_set_sample_interval(size_t bytes);
+size_t tracker_sample_interval(void);
+void tracker_init_from_env(void);
+
+// Per-size-class request histogram and realloc growth counters
+int tracker_size_classes(SizeClassStats* out, int max_classes);
+void tracker_realloc_stats(ReallocStats* out);
+void report_size_classes(void);
+
+// Per-callsite alloc->free lifetimes; sites with many short-lived
+// allocations are where an arena or object pool pays off
+int tracker_pool_candidates(PoolCandidate* out, int max_results);
+void report_pool_candidates(void);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif 
\ No newline at end of file
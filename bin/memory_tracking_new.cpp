@@ -0,0 +1,44 @@
+// Routes C++ allocations through the tracker. Link this object (or
+// libvmdtrack.a) into a C++ program to replace the global operators.
+#include <new>
+#include <cstdlib>
+#include "memory_tracking.h"
+
+static void* tracked_new(std::size_t size) {
+    void* ptr = tracked_malloc(size ? size : 1, "operator new", 0);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+static void* tracked_new_aligned(std::size_t size, std::align_val_t alignment) {
+    std::size_t align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants the size to be a multiple of the alignment
+    std::size_t rounded = ((size ? size : 1) + align - 1) & ~(align - 1);
+    void* ptr = tracked_aligned_alloc(align, rounded, "operator new", 0);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(std::size_t size) { return tracked_new(size); }
+void* operator new[](std::size_t size) { return tracked_new(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return tracked_new_aligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return tracked_new_aligned(size, alignment); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return tracked_malloc(size ? size : 1, "operator new", 0);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return tracked_malloc(size ? size : 1, "operator new", 0);
+}
+
+void operator delete(void* ptr) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr) noexcept { tracked_free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { tracked_free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { tracked_free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { tracked_free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { tracked_free(ptr); }
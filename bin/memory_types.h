@@ -13,7 +13,14 @@ typedef struct {
     int is_executable;
     int is_cached;
     int is_dirty;
+    int is_swapped;
+    int swap_type;              // Index into /proc/swaps, -1 when hidden
+    unsigned long swap_offset;
     int level;
+    const char* region;         // Kind of the VMA the page belongs to
+    unsigned long span_pages;   // Pages of the tile this entry stands for
+    unsigned long present_pages;
+    unsigned long swapped_pages;
 } PageTableEntry;
 
 typedef struct {
@@ -27,27 +34,189 @@ typedef struct {
     int page_faults;
 } MemoryRegion;
 
+#define TRACK_STACK_DEPTH 16
+#define TRACK_MAX_CALLSITES 4096
+#define TRACK_LIFETIME_BUCKETS 48
+
+// Allocations grouped by file:line plus a hashed, deduplicated backtrace.
+// In sampling mode the counts and bytes are unbiased estimates.
+typedef struct CallsiteStats {
+    const char* file;
+    int line;
+    unsigned long stack_hash;
+    void* stack[TRACK_STACK_DEPTH];
+    int stack_depth;
+    size_t live_count;
+    size_t live_bytes;
+    size_t total_count;
+    size_t total_bytes;
+    size_t live_samples;
+    struct timespec first_seen;
+    // alloc->free lifetimes, bucket i holds [2^i, 2^(i+1)) clock ticks
+    size_t freed_count;
+    size_t lifetime_hist[TRACK_LIFETIME_BUCKETS];
+} CallsiteStats;
+
+#define TRACK_SIZE_CLASSES 160
+
+// Requests are bucketed four classes per power of two, fine enough to be
+// re-binned into glibc, jemalloc or mimalloc size classes
+typedef struct {
+    size_t max_size;
+    size_t count;
+    size_t bytes;
+} SizeClassStats;
+
+typedef struct {
+    size_t calls;
+    size_t in_place;
+    size_t moved;
+    size_t grow_bytes;
+    size_t shrink_bytes;
+} ReallocStats;
+
+// Callsites ranked by allocation rate times the share of short lifetimes
+typedef struct {
+    CallsiteStats callsite;
+    double alloc_rate;
+    double short_lived_fraction;
+    double p50_lifetime_ns;
+    double p90_lifetime_ns;
+    double score;
+} PoolCandidate;
+
 typedef struct MemoryBlock {
     void* ptr;
     size_t size;
     const char* file;
     int line;
+    CallsiteStats* callsite;
+    size_t weight_count;
+    size_t weight_bytes;
+    unsigned long long alloc_ticks;
     struct MemoryBlock* next;
 } MemoryBlock;
 
+// One row of the system-wide process ranking
+typedef struct {
+    int pid;
+    char name[16];
+    unsigned long long start_time;  // Clock ticks after boot, from /proc/pid/stat
+    size_t rss;
+    size_t pss;                     // 0 when smaps_rollup is not readable
+    size_t swap;
+    int pss_known;
+    double growth_rate;             // RSS bytes per second
+    double fault_rate;              // Minor + major faults per second
+} ProcessStats;
+
+// memory.* of one cgroup v2 group
+typedef struct {
+    char name[64];
+    unsigned long long current;
+    unsigned long long swap_current;
+    unsigned long long max;         // 0 when unlimited
+} CgroupMemory;
+
+typedef struct {
+    char filename[128];
+    char type[16];
+    size_t size;
+    size_t used;
+    int priority;
+} SwapDevice;
+
+// Swapped pages of one VMA, decoded from pagemap
+typedef struct {
+    unsigned long start_addr;
+    unsigned long end_addr;
+    char perms[5];
+    char mapped_file[128];
+    size_t present_pages;
+    size_t swapped_pages;
+    int swap_type;              // Device holding most of them, -1 when hidden
+} SwapRegion;
+
+typedef struct {
+    int node;
+    size_t total;
+    size_t free;
+    size_t anon;
+    size_t file;
+    size_t inactive_file;
+    unsigned long numa_hit;
+    unsigned long numa_miss;
+    unsigned long numa_foreign;
+    unsigned long other_node;
+    double pressure;        // 1 - (free + inactive file) / total
+    double foreign_ratio;   // Allocations meant for this node that went elsewhere
+    size_t process_bytes;   // Target process memory on this node, from numa_maps
+    size_t sampled_pages;   // move_pages samples resident on this node
+} NumaNodeStats;
+
+// /proc/vmstat counters tracked by the delta engine: X(id, key)
+#define VMSTAT_COUNTERS(X) \
+    X(PGFAULT, "pgfault") \
+    X(PGMAJFAULT, "pgmajfault") \
+    X(PGSCAN_KSWAPD, "pgscan_kswapd") \
+    X(PGSCAN_DIRECT, "pgscan_direct") \
+    X(PGSTEAL_KSWAPD, "pgsteal_kswapd") \
+    X(PGSTEAL_DIRECT, "pgsteal_direct") \
+    X(COMPACT_STALL, "compact_stall") \
+    X(COMPACT_FAIL, "compact_fail") \
+    X(THP_FAULT_ALLOC, "thp_fault_alloc") \
+    X(THP_FAULT_FALLBACK, "thp_fault_fallback") \
+    X(WORKINGSET_REFAULT, "workingset_refault") \
+    X(WORKINGSET_REFAULT_ANON, "workingset_refault_anon") \
+    X(WORKINGSET_REFAULT_FILE, "workingset_refault_file") \
+    X(OOM_KILL, "oom_kill") \
+    X(PSWPIN, "pswpin") \
+    X(PSWPOUT, "pswpout")
+
+#define VMSTAT_ENUM(id, key) VMSTAT_##id,
+typedef enum {
+    VMSTAT_COUNTERS(VMSTAT_ENUM)
+    VMSTAT_NUM_COUNTERS
+} VmstatCounter;
+#undef VMSTAT_ENUM
+
+// Counter values at the last sample and the change since the one before.
+// Each consumer keeps its own snapshot so deltas are per consumer.
+typedef struct {
+    unsigned long long value[VMSTAT_NUM_COUNTERS];
+    unsigned long long delta[VMSTAT_NUM_COUNTERS];
+    double rate[VMSTAT_NUM_COUNTERS];
+    double interval_s;
+    struct timespec taken;
+} VmstatSnapshot;
+
+// Scalar analytics fields: X(kind, name, api_name). This list generates the
+// struct members below, the serializers in schema.c and, via `make types`,
+// app/types/analytics.generated.ts; api_name is the field's name in the
+// Next.js API. kind is SIZE (size_t), COUNT (long), INT (int) or REAL
+// (double, two decimals in JSON)
+#define ANALYTICS_FIELDS(X) \
+    X(REAL, fragmentation_index, fragmentation) \
+    X(REAL, fault_rate, pageFaultRate) \
+    X(REAL, pressure_score, pressureScore) \
+    X(INT, swap_usage_percent, swapUsagePercent) \
+    X(COUNT, major_faults, majorFaults) \
+    X(COUNT, minor_faults, minorFaults) \
+    X(SIZE, memory_usage, memory_usage) \
+    X(SIZE, total_memory, total_memory) \
+    X(SIZE, free_memory, free_memory) \
+    X(SIZE, largest_free_block, largestFreeBlock) \
+    X(SIZE, peak_usage, peakUsage)
+
+#define ANALYTICS_CTYPE_SIZE size_t
+#define ANALYTICS_CTYPE_COUNT long
+#define ANALYTICS_CTYPE_INT int
+#define ANALYTICS_CTYPE_REAL double
+#define ANALYTICS_FIELD_DECL(kind, name, api_name) ANALYTICS_CTYPE_##kind name;
+
 typedef struct {
-    size_t total_memory;
-    size_t free_memory;
-    size_t largest_free_block;
-    double fragmentation_index;
-    long major_faults;
-    long minor_faults;
-    double fault_rate;
-    double pressure_score;
-    int swap_usage_percent;
+    ANALYTICS_FIELDS(ANALYTICS_FIELD_DECL)
     struct timespec last_update;
-    size_t memory_usage;
-    size_t peak_usage;
     PageTableEntry* page_table_entries;
     int num_entries;
     MemoryRegion* memory_regions;
@@ -58,6 +227,7 @@ typedef struct {
     int page_table_levels;
     unsigned long page_walks;
     unsigned long page_faults;
+    VmstatSnapshot vmstat;
 } MemoryAnalytics;
 
 #endif 
\ No newline at end of file
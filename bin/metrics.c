@@ -0,0 +1,532 @@
+#define _GNU_SOURCE
+#include "metrics.h"
+#include "memory_types.h"
+#include "process_scan.h"
+#include "cgroup.h"
+#include "vmstat.h"
+#include "anomaly.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#define METRICS_REQUEST_MAX 1024
+#define METRICS_MEMINFO_FIELDS 96
+
+extern MemoryAnalytics g_analytics;
+extern pthread_mutex_t g_analytics_mutex;
+
+// A fully rendered response. Two are kept: one is served while the other
+// is rendered, and a snapshot is only re-rendered once nobody reads it.
+typedef struct {
+    char* body;
+    size_t len;
+    size_t cap;
+    char header[192];
+    size_t header_len;
+    int readers;
+} Snapshot;
+
+typedef struct {
+    int fd;                          // -1 when the slot is free
+    char request[METRICS_REQUEST_MAX];
+    size_t request_len;
+    int writing;
+    int snapshot;                    // Index being sent, or -1
+    const char* fixed;               // Canned response when not a snapshot
+    size_t fixed_len;
+    size_t sent;
+    unsigned long long started_ns;
+} MetricsClient;
+
+#define CANNED(status, body) \
+    "HTTP/1.1 " status "\r\nContent-Type: text/plain\r\nContent-Length: " #body "\r\nConnection: close\r\n\r\n"
+static const char g_not_found[] = CANNED("404 Not Found", 10) "not found\n";
+static const char g_bad_request[] = CANNED("400 Bad Request", 12) "bad request\n";
+static const char g_unavailable[] = CANNED("503 Service Unavailable", 12) "no data yet\n";
+
+static Snapshot g_snapshots[2];
+static int g_current = -1;
+static pthread_mutex_t g_snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static MetricsClient g_clients[METRICS_MAX_CLIENTS];
+static int g_listen_fd = -1;
+static char g_unix_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static pthread_t g_thread;
+static volatile int g_running = 0;
+static unsigned long long g_scrapes = 0;
+static unsigned long long g_skipped_renders = 0;
+static double g_render_seconds = 0;
+
+static unsigned long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void append(Snapshot* s, const char* fmt, ...) {
+    while (1) {
+        size_t room = s->cap - s->len;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(s->body ? s->body + s->len : NULL, room, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t)n < room) {
+            s->len += n;
+            return;
+        }
+        // Buffers only grow, so steady-state renders do not allocate
+        size_t cap = s->cap ? s->cap * 2 : 16384;
+        while (cap - s->len <= (size_t)n) cap *= 2;
+        char* body = realloc(s->body, cap);
+        if (body == NULL) return;
+        s->body = body;
+        s->cap = cap;
+    }
+}
+
+static void append_label(Snapshot* s, const char* value) {
+    for (const char* p = value; *p; p++) {
+        if (*p == '\\' || *p == '"') append(s, "\\%c", *p);
+        else if (*p == '\n') append(s, "\\n");
+        else append(s, "%c", *p);
+    }
+}
+
+static void family(Snapshot* s, const char* name, const char* type, const char* help) {
+    append(s, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+static void render_meminfo(Snapshot* s) {
+    char line[256];
+    char keys[METRICS_MEMINFO_FIELDS][48];
+    unsigned long long values[METRICS_MEMINFO_FIELDS];
+    int in_kb[METRICS_MEMINFO_FIELDS];
+    int count = 0;
+
+    FILE* f = fopen("/proc/meminfo", "r");
+    if (f == NULL) return;
+    while (count < METRICS_MEMINFO_FIELDS && fgets(line, sizeof(line), f)) {
+        char unit[8] = "";
+        if (sscanf(line, "%47[^:]: %llu %7s", keys[count], &values[count], unit) < 2) continue;
+        in_kb[count] = strcmp(unit, "kB") == 0;
+        count++;
+    }
+    fclose(f);
+
+    // Families must be contiguous, so sizes and counts are two passes
+    family(s, "vmd_meminfo_bytes", "gauge", "Size fields of /proc/meminfo.");
+    for (int i = 0; i < count; i++) {
+        if (in_kb[i]) append(s, "vmd_meminfo_bytes{field=\"%s\"} %llu\n", keys[i], values[i] * 1024);
+    }
+    family(s, "vmd_meminfo_pages", "gauge", "Page count fields of /proc/meminfo.");
+    for (int i = 0; i < count; i++) {
+        if (!in_kb[i]) append(s, "vmd_meminfo_pages{field=\"%s\"} %llu\n", keys[i], values[i]);
+    }
+}
+
+static void render_analytics(Snapshot* s) {
+    pthread_mutex_lock(&g_analytics_mutex);
+    family(s, "vmd_vmstat", "counter", "Tracked /proc/vmstat counters.");
+    for (int c = 0; c < VMSTAT_NUM_COUNTERS; c++) {
+        append(s, "vmd_vmstat_total{counter=\"%s\"} %llu\n", vmstat_counter_name(c), g_analytics.vmstat.value[c]);
+    }
+    family(s, "vmd_vmstat_rate", "gauge", "Per-second rate of the vmstat counters over the last cycle.");
+    for (int c = 0; c < VMSTAT_NUM_COUNTERS; c++) {
+        append(s, "vmd_vmstat_rate{counter=\"%s\"} %.3f\n", vmstat_counter_name(c), g_analytics.vmstat.rate[c]);
+    }
+    family(s, "vmd_fault_rate", "gauge", "Page faults per second.");
+    append(s, "vmd_fault_rate %.3f\n", g_analytics.fault_rate);
+    family(s, "vmd_pressure_score", "gauge", "vmd memory pressure score, 0 to 1.");
+    append(s, "vmd_pressure_score %.4f\n", g_analytics.pressure_score);
+    family(s, "vmd_fragmentation_index", "gauge", "vmd fragmentation index, 0 to 1.");
+    append(s, "vmd_fragmentation_index %.4f\n", g_analytics.fragmentation_index);
+    family(s, "vmd_swap_usage_ratio", "gauge", "Fraction of swap in use.");
+    append(s, "vmd_swap_usage_ratio %.4f\n", g_analytics.swap_usage_percent / 100.0);
+    pthread_mutex_unlock(&g_analytics_mutex);
+}
+
+static void render_pressure(Snapshot* s) {
+    char line[256], kind[8];
+    double avg10, avg60, avg300;
+    unsigned long long total;
+    struct { char kind[8]; double avg[3]; unsigned long long total; } rows[2];
+    int count = 0;
+
+    FILE* f = fopen("/proc/pressure/memory", "r");
+    if (f == NULL) return;
+    while (count < 2 && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%7s avg10=%lf avg60=%lf avg300=%lf total=%llu", kind, &avg10, &avg60, &avg300, &total) != 5)
+            continue;
+        snprintf(rows[count].kind, sizeof(rows[count].kind), "%s", kind);
+        rows[count].avg[0] = avg10;
+        rows[count].avg[1] = avg60;
+        rows[count].avg[2] = avg300;
+        rows[count].total = total;
+        count++;
+    }
+    fclose(f);
+
+    static const char* windows[] = { "10", "60", "300" };
+    family(s, "vmd_memory_pressure_avg", "gauge", "PSI memory stall share in percent over the window in seconds.");
+    for (int i = 0; i < count; i++) {
+        for (int w = 0; w < 3; w++)
+            append(s, "vmd_memory_pressure_avg{kind=\"%s\",window=\"%s\"} %.2f\n", rows[i].kind, windows[w], rows[i].avg[w]);
+    }
+    family(s, "vmd_memory_pressure_stall_seconds", "counter", "PSI memory stall time.");
+    for (int i = 0; i < count; i++) {
+        append(s, "vmd_memory_pressure_stall_seconds_total{kind=\"%s\"} %.6f\n", rows[i].kind, rows[i].total / 1e6);
+    }
+}
+
+static void render_cgroups(Snapshot* s) {
+    CgroupMemory groups[CGROUP_MAX_GROUPS];
+    int count = read_cgroups(groups, CGROUP_MAX_GROUPS);
+    if (count == 0) return;
+
+    family(s, "vmd_cgroup_memory_bytes", "gauge", "memory.current of top-level cgroups.");
+    for (int i = 0; i < count; i++) {
+        append(s, "vmd_cgroup_memory_bytes{cgroup=\"");
+        append_label(s, groups[i].name);
+        append(s, "\"} %llu\n", groups[i].current);
+    }
+    family(s, "vmd_cgroup_swap_bytes", "gauge", "memory.swap.current of top-level cgroups.");
+    for (int i = 0; i < count; i++) {
+        append(s, "vmd_cgroup_swap_bytes{cgroup=\"");
+        append_label(s, groups[i].name);
+        append(s, "\"} %llu\n", groups[i].swap_current);
+    }
+    family(s, "vmd_cgroup_memory_max_bytes", "gauge", "memory.max of top-level cgroups that have a limit.");
+    for (int i = 0; i < count; i++) {
+        if (groups[i].max == 0) continue;
+        append(s, "vmd_cgroup_memory_max_bytes{cgroup=\"");
+        append_label(s, groups[i].name);
+        append(s, "\"} %llu\n", groups[i].max);
+    }
+}
+
+static void process_labels(Snapshot* s, const char* name, const ProcessStats* p) {
+    append(s, "%s{pid=\"%d\",comm=\"", name, p->pid);
+    append_label(s, p->name);
+    append(s, "\"}");
+}
+
+// Top processes come from the resident scan's cache; nothing is scanned here
+static void render_processes(Snapshot* s) {
+    ProcessStats top[METRICS_TOP_PROCESSES];
+    int count = top_processes(top, METRICS_TOP_PROCESSES, PROC_SORT_RSS);
+    if (count == 0) return;
+
+    family(s, "vmd_process_rss_bytes", "gauge", "Resident set size of the largest processes.");
+    for (int i = 0; i < count; i++) {
+        process_labels(s, "vmd_process_rss_bytes", &top[i]);
+        append(s, " %zu\n", top[i].rss);
+    }
+    family(s, "vmd_process_pss_bytes", "gauge", "Proportional set size of the largest processes, when readable.");
+    for (int i = 0; i < count; i++) {
+        if (!top[i].pss_known) continue;
+        process_labels(s, "vmd_process_pss_bytes", &top[i]);
+        append(s, " %zu\n", top[i].pss);
+    }
+    family(s, "vmd_process_swap_bytes", "gauge", "Swapped-out memory of the largest processes.");
+    for (int i = 0; i < count; i++) {
+        process_labels(s, "vmd_process_swap_bytes", &top[i]);
+        append(s, " %zu\n", top[i].swap);
+    }
+    family(s, "vmd_process_fault_rate", "gauge", "Page faults per second of the largest processes.");
+    for (int i = 0; i < count; i++) {
+        process_labels(s, "vmd_process_fault_rate", &top[i]);
+        append(s, " %.3f\n", top[i].fault_rate);
+    }
+}
+
+static void render(Snapshot* s) {
+    s->len = 0;
+    render_meminfo(s);
+    render_analytics(s);
+    render_pressure(s);
+    render_cgroups(s);
+    render_processes(s);
+    family(s, "vmd_alerts", "counter", "Alerts raised by the anomaly detectors.");
+    for (int d = 0; d < ANOMALY_NUM_DETECTORS; d++)
+        append(s, "vmd_alerts_total{detector=\"%s\"} %llu\n", anomaly_detector_name(d), anomaly_alert_count(d));
+    family(s, "vmd_metrics_scrapes", "counter", "Snapshots served.");
+    append(s, "vmd_metrics_scrapes_total %llu\n", __atomic_load_n(&g_scrapes, __ATOMIC_RELAXED));
+    family(s, "vmd_metrics_skipped_renders", "counter", "Cycles whose render was skipped because both snapshots were in use.");
+    append(s, "vmd_metrics_skipped_renders_total %llu\n", g_skipped_renders);
+    family(s, "vmd_metrics_render_seconds", "gauge", "Time taken by the previous render.");
+    append(s, "vmd_metrics_render_seconds %.6f\n", g_render_seconds);
+    append(s, "# EOF\n");
+
+    s->header_len = snprintf(s->header, sizeof(s->header),
+                             "HTTP/1.1 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; "
+                             "charset=utf-8\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", s->len);
+}
+
+void metrics_publish(void) {
+    if (g_listen_fd < 0) return;
+
+    pthread_mutex_lock(&g_snapshot_mutex);
+    int idle = g_current == 0 ? 1 : 0;
+    if (g_snapshots[idle].readers > 0) {
+        // A slow client still holds it; serve the current one a while longer
+        g_skipped_renders++;
+        pthread_mutex_unlock(&g_snapshot_mutex);
+        return;
+    }
+    pthread_mutex_unlock(&g_snapshot_mutex);
+
+    // Not current and unread, so no client can pick it up while rendering
+    unsigned long long start = monotonic_ns();
+    render(&g_snapshots[idle]);
+    g_render_seconds = (monotonic_ns() - start) / 1e9;
+
+    pthread_mutex_lock(&g_snapshot_mutex);
+    g_current = idle;
+    pthread_mutex_unlock(&g_snapshot_mutex);
+}
+
+static void close_client(MetricsClient* c) {
+    if (c->snapshot >= 0) {
+        pthread_mutex_lock(&g_snapshot_mutex);
+        g_snapshots[c->snapshot].readers--;
+        pthread_mutex_unlock(&g_snapshot_mutex);
+    }
+    close(c->fd);
+    c->fd = -1;
+}
+
+static void start_response(MetricsClient* c) {
+    c->writing = 1;
+    c->sent = 0;
+    c->snapshot = -1;
+    int metrics = strncmp(c->request, "GET /metrics ", 13) == 0 || strncmp(c->request, "GET /metrics?", 13) == 0 ||
+                  strncmp(c->request, "GET / ", 6) == 0;
+    if (!metrics) {
+        c->fixed = g_not_found;
+        c->fixed_len = sizeof(g_not_found) - 1;
+        return;
+    }
+
+    pthread_mutex_lock(&g_snapshot_mutex);
+    if (g_current >= 0) {
+        c->snapshot = g_current;
+        g_snapshots[g_current].readers++;
+    }
+    pthread_mutex_unlock(&g_snapshot_mutex);
+    if (c->snapshot < 0) {
+        c->fixed = g_unavailable;
+        c->fixed_len = sizeof(g_unavailable) - 1;
+        return;
+    }
+    __atomic_add_fetch(&g_scrapes, 1, __ATOMIC_RELAXED);
+}
+
+static void read_request(MetricsClient* c) {
+    ssize_t n = recv(c->fd, c->request + c->request_len, sizeof(c->request) - 1 - c->request_len, 0);
+    if (n <= 0) {
+        if (n == 0 || (errno != EAGAIN && errno != EINTR)) close_client(c);
+        return;
+    }
+    c->request_len += n;
+    c->request[c->request_len] = '\0';
+    if (strstr(c->request, "\r\n\r\n") != NULL || strstr(c->request, "\n\n") != NULL) {
+        start_response(c);
+    } else if (c->request_len == sizeof(c->request) - 1) {
+        c->writing = 1;
+        c->sent = 0;
+        c->fixed = g_bad_request;
+        c->fixed_len = sizeof(g_bad_request) - 1;
+    }
+}
+
+// Sends the pre-rendered header and body straight from the snapshot
+static void write_response(MetricsClient* c) {
+    struct iovec iov[2];
+    int parts = 0;
+    size_t total;
+
+    if (c->snapshot >= 0) {
+        Snapshot* s = &g_snapshots[c->snapshot];
+        total = s->header_len + s->len;
+        if (c->sent < s->header_len) {
+            iov[parts++] = (struct iovec){ s->header + c->sent, s->header_len - c->sent };
+            iov[parts++] = (struct iovec){ s->body, s->len };
+        } else {
+            iov[parts++] = (struct iovec){ s->body + (c->sent - s->header_len), total - c->sent };
+        }
+    } else {
+        total = c->fixed_len;
+        iov[parts++] = (struct iovec){ (void*)(c->fixed + c->sent), total - c->sent };
+    }
+
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = parts };
+    ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EINTR) close_client(c);
+        return;
+    }
+    c->sent += n;
+    if (c->sent >= total) close_client(c);
+}
+
+static void accept_clients(void) {
+    while (1) {
+        MetricsClient* c = NULL;
+        for (int i = 0; i < METRICS_MAX_CLIENTS && c == NULL; i++) {
+            if (g_clients[i].fd < 0) c = &g_clients[i];
+        }
+        if (c == NULL) return;
+
+        int fd = accept4(g_listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        memset(c, 0, sizeof(*c));
+        c->fd = fd;
+        c->snapshot = -1;
+        c->started_ns = monotonic_ns();
+    }
+}
+
+static void* metrics_thread(void* arg) {
+    (void)arg;
+    struct pollfd fds[METRICS_MAX_CLIENTS + 1];
+    int owners[METRICS_MAX_CLIENTS + 1];
+
+    while (g_running) {
+        int n = 0, active = 0;
+        for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+            if (g_clients[i].fd < 0) continue;
+            fds[n] = (struct pollfd){ g_clients[i].fd, g_clients[i].writing ? POLLOUT : POLLIN, 0 };
+            owners[n++] = i;
+            active++;
+        }
+        // A full client table leaves new connections in the backlog
+        if (active < METRICS_MAX_CLIENTS) {
+            fds[n] = (struct pollfd){ g_listen_fd, POLLIN, 0 };
+            owners[n++] = -1;
+        }
+
+        // Short timeout so metrics_stop() is noticed promptly
+        if (poll(fds, n, 250) < 0 && errno != EINTR) break;
+        for (int i = 0; i < n; i++) {
+            if (fds[i].revents == 0) continue;
+            if (owners[i] < 0) {
+                accept_clients();
+                continue;
+            }
+            MetricsClient* c = &g_clients[owners[i]];
+            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL) && !(fds[i].revents & (POLLIN | POLLOUT))) close_client(c);
+            else if (c->writing) write_response(c);
+            else read_request(c);
+        }
+
+        unsigned long long now = monotonic_ns();
+        for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+            MetricsClient* c = &g_clients[i];
+            if (c->fd >= 0 && now - c->started_ns > METRICS_CLIENT_TIMEOUT_MS * 1000000ULL) close_client(c);
+        }
+    }
+    return NULL;
+}
+
+static int listen_unix(const char* path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    snprintf(g_unix_path, sizeof(g_unix_path), "%s", path);
+    return fd;
+}
+
+// "host:port", "[v6]:port" or ":port" for every address
+static int listen_tcp(const char* spec) {
+    char host[256];
+    const char* colon = strrchr(spec, ':');
+    if (colon == NULL || colon[1] == '\0') return -1;
+    size_t host_len = colon - spec;
+    if (host_len >= sizeof(host)) return -1;
+    memcpy(host, spec, host_len);
+    host[host_len] = '\0';
+    if (host_len >= 2 && host[0] == '[' && host[host_len - 1] == ']') {
+        memmove(host, host + 1, host_len - 2);
+        host[host_len - 2] = '\0';
+    }
+
+    struct addrinfo hints = { .ai_flags = AI_PASSIVE, .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* res;
+    if (getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &res) != 0) return -1;
+
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+int metrics_start(void) {
+    const char* addr = getenv(METRICS_ENV);
+    if (addr == NULL || *addr == '\0') return 0;
+
+    g_listen_fd = strncmp(addr, "unix:", 5) == 0 ? listen_unix(addr + 5) : listen_tcp(addr);
+    if (g_listen_fd >= 0 && listen(g_listen_fd, 64) != 0) {
+        close(g_listen_fd);
+        g_listen_fd = -1;
+    }
+    if (g_listen_fd < 0) {
+        fprintf(stderr, "metrics: cannot listen on %s\n", addr);
+        return -1;
+    }
+
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) g_clients[i].fd = -1;
+    g_running = 1;
+    if (pthread_create(&g_thread, NULL, metrics_thread, NULL) != 0) {
+        g_running = 0;
+        close(g_listen_fd);
+        g_listen_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void metrics_stop(void) {
+    if (g_listen_fd < 0) return;
+    g_running = 0;
+    pthread_join(g_thread, NULL);
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (g_clients[i].fd >= 0) close_client(&g_clients[i]);
+    }
+    close(g_listen_fd);
+    g_listen_fd = -1;
+    if (g_unix_path[0]) unlink(g_unix_path);
+    g_unix_path[0] = '\0';
+    for (int i = 0; i < 2; i++) {
+        free(g_snapshots[i].body);
+        memset(&g_snapshots[i], 0, sizeof(g_snapshots[i]));
+    }
+    g_current = -1;
+}
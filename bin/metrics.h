@@ -0,0 +1,20 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// OpenMetrics exposition for the resident monitor. With VMD_METRICS_ADDR
+// set to "host:port", ":port" or "unix:/path", a listener thread serves
+// GET /metrics from the last rendered snapshot; scrapes never trigger
+// collection, formatting or allocation.
+#define METRICS_ENV "VMD_METRICS_ADDR"
+#define METRICS_MAX_CLIENTS 32
+#define METRICS_CLIENT_TIMEOUT_MS 5000
+#define METRICS_TOP_PROCESSES 20
+
+// Starts the listener; returns 0 when serving or not configured
+int metrics_start(void);
+void metrics_stop(void);
+// Renders the current metrics into the idle snapshot buffer and makes it
+// the one served. Call once per collection cycle
+void metrics_publish(void);
+
+#endif
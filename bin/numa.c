@@ -0,0 +1,309 @@
+#define _GNU_SOURCE
+#include "numa.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define NODE_DIR "/sys/devices/system/node"
+
+// Parses a sysfs node list such as "0-3,5"
+static int parse_node_list(const char* list, int* out, int max) {
+    int count = 0;
+    const char* p = list;
+    while (*p && count < max) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p) break;
+        long last = first;
+        if (*end == '-') last = strtol(end + 1, &end, 10);
+        for (long n = first; n <= last && count < max; n++) out[count++] = (int)n;
+        p = *end == ',' ? end + 1 : end;
+        if (*p == '\n') break;
+    }
+    return count;
+}
+
+static int read_node_meminfo(int node, NumaNodeStats* stats) {
+    char path[128], line[256], key[64];
+    unsigned long value;
+    snprintf(path, sizeof(path), NODE_DIR "/node%d/meminfo", node);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return -1;
+
+    // Lines look like "Node 0 MemTotal:  4685560 kB"
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "Node %*d %63[^:]: %lu", key, &value) != 2) continue;
+        size_t bytes = value * 1024;
+        if (strcmp(key, "MemTotal") == 0) stats->total = bytes;
+        else if (strcmp(key, "MemFree") == 0) stats->free = bytes;
+        else if (strcmp(key, "AnonPages") == 0) stats->anon = bytes;
+        else if (strcmp(key, "FilePages") == 0) stats->file = bytes;
+        else if (strcmp(key, "Inactive(file)") == 0) stats->inactive_file = bytes;
+    }
+    fclose(f);
+    return 0;
+}
+
+static void read_node_numastat(int node, NumaNodeStats* stats) {
+    char path[128], key[32];
+    unsigned long value;
+    snprintf(path, sizeof(path), NODE_DIR "/node%d/numastat", node);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return;
+
+    while (fscanf(f, "%31s %lu", key, &value) == 2) {
+        if (strcmp(key, "numa_hit") == 0) stats->numa_hit = value;
+        else if (strcmp(key, "numa_miss") == 0) stats->numa_miss = value;
+        else if (strcmp(key, "numa_foreign") == 0) stats->numa_foreign = value;
+        else if (strcmp(key, "other_node") == 0) stats->other_node = value;
+    }
+    fclose(f);
+}
+
+// Without NUMA support the whole machine is node 0
+static int read_single_node(NumaNodeStats* stats) {
+    char line[256], key[64];
+    unsigned long value;
+    FILE* f = fopen("/proc/meminfo", "r");
+    if (f == NULL) return -1;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%63[^:]: %lu", key, &value) != 2) continue;
+        size_t bytes = value * 1024;
+        if (strcmp(key, "MemTotal") == 0) stats->total = bytes;
+        else if (strcmp(key, "MemFree") == 0) stats->free = bytes;
+        else if (strcmp(key, "AnonPages") == 0) stats->anon = bytes;
+        else if (strcmp(key, "Cached") == 0) stats->file = bytes;
+        else if (strcmp(key, "Inactive(file)") == 0) stats->inactive_file = bytes;
+    }
+    fclose(f);
+    return 0;
+}
+
+static void compute_node_scores(NumaNodeStats* stats) {
+    size_t reclaimable = stats->free + stats->inactive_file;
+    stats->pressure = stats->total > reclaimable ? 1.0 - (double)reclaimable / stats->total : 0.0;
+    unsigned long wanted = stats->numa_hit + stats->numa_foreign;
+    stats->foreign_ratio = wanted ? (double)stats->numa_foreign / wanted : 0.0;
+}
+
+int read_numa_nodes(NumaNodeStats* nodes, int max) {
+    int ids[NUMA_MAX_NODES];
+    int count = 0;
+    char list[256];
+
+    // Memory-less (CPU only) nodes are not interesting here
+    FILE* f = fopen(NODE_DIR "/has_memory", "r");
+    if (f == NULL) f = fopen(NODE_DIR "/online", "r");
+    if (f != NULL) {
+        if (fgets(list, sizeof(list), f)) count = parse_node_list(list, ids, NUMA_MAX_NODES);
+        fclose(f);
+    }
+    if (count > max) count = max;
+
+    int filled = 0;
+    for (int i = 0; i < count; i++) {
+        memset(&nodes[filled], 0, sizeof(NumaNodeStats));
+        nodes[filled].node = ids[i];
+        if (read_node_meminfo(ids[i], &nodes[filled]) != 0) continue;
+        read_node_numastat(ids[i], &nodes[filled]);
+        compute_node_scores(&nodes[filled]);
+        filled++;
+    }
+
+    if (filled == 0 && max > 0) {
+        memset(&nodes[0], 0, sizeof(NumaNodeStats));
+        if (read_single_node(&nodes[0]) != 0) return 0;
+        compute_node_scores(&nodes[0]);
+        filled = 1;
+    }
+    return filled;
+}
+
+double numa_imbalance(const NumaNodeStats* nodes, int count) {
+    if (count < 2) return 0.0;
+    double lo = nodes[0].pressure, hi = nodes[0].pressure;
+    for (int i = 1; i < count; i++) {
+        if (nodes[i].pressure < lo) lo = nodes[i].pressure;
+        if (nodes[i].pressure > hi) hi = nodes[i].pressure;
+    }
+    return hi - lo;
+}
+
+static int node_index(const NumaNodeStats* nodes, int count, int node) {
+    for (int i = 0; i < count; i++) {
+        if (nodes[i].node == node) return i;
+    }
+    return -1;
+}
+
+// Adds each VMA's "N<node>=<pages>" counts to the nodes; returns -1 when
+// numa_maps cannot be read
+static int read_numa_maps(pid_t pid, NumaNodeStats* nodes, int count, int* vmas, int* split_vmas) {
+    char path[64], line[1024];
+    snprintf(path, sizeof(path), "/proc/%d/numa_maps", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return -1;
+
+    *vmas = 0;
+    *split_vmas = 0;
+    while (fgets(line, sizeof(line), f)) {
+        size_t page_size = 4096;
+        char* kps = strstr(line, " kernelpagesize_kB=");
+        if (kps != NULL) page_size = strtoul(kps + 19, NULL, 10) * 1024;
+
+        int nodes_used = 0;
+        for (char* p = strstr(line, " N"); p != NULL; p = strstr(p + 1, " N")) {
+            char* end;
+            long node = strtol(p + 2, &end, 10);
+            if (end == p + 2 || *end != '=') continue;
+            unsigned long pages = strtoul(end + 1, NULL, 10);
+            int i = node_index(nodes, count, (int)node);
+            if (i >= 0) nodes[i].process_bytes += pages * page_size;
+            nodes_used++;
+        }
+        (*vmas)++;
+        if (nodes_used > 1) (*split_vmas)++;
+    }
+    fclose(f);
+    return 0;
+}
+
+// Queries the node of up to NUMA_SAMPLE_PAGES pages spread evenly over the
+// process's mappings. move_pages with a NULL node list only reports.
+static int sample_page_placement(pid_t pid, NumaNodeStats* nodes, int count,
+                                 size_t* sampled, size_t* not_present) {
+    char path[64], line[512];
+    unsigned long starts[4096], ends[4096];
+    int num_vmas = 0;
+    size_t total_pages = 0;
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return -1;
+    while (fgets(line, sizeof(line), f) && num_vmas < 4096) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx", &start, &end) != 2) continue;
+        if (strstr(line, "[vsyscall]") != NULL) continue;
+        starts[num_vmas] = start;
+        ends[num_vmas] = end;
+        total_pages += (end - start) / page_size;
+        num_vmas++;
+    }
+    fclose(f);
+
+    size_t stride = total_pages / NUMA_SAMPLE_PAGES + 1;
+    void** pages = malloc(NUMA_SAMPLE_PAGES * sizeof(void*));
+    int* status = malloc(NUMA_SAMPLE_PAGES * sizeof(int));
+    if (pages == NULL || status == NULL) {
+        free(pages);
+        free(status);
+        return -1;
+    }
+
+    size_t n = 0;
+    for (int v = 0; v < num_vmas && n < NUMA_SAMPLE_PAGES; v++) {
+        for (unsigned long addr = starts[v]; addr < ends[v] && n < NUMA_SAMPLE_PAGES;
+             addr += stride * page_size) {
+            pages[n++] = (void*)addr;
+        }
+    }
+
+    int rc = -1;
+    *sampled = 0;
+    *not_present = 0;
+    if (n > 0 && syscall(SYS_move_pages, pid, n, pages, NULL, status, 0) == 0) {
+        for (size_t i = 0; i < n; i++) {
+            int idx = status[i] >= 0 ? node_index(nodes, count, status[i]) : -1;
+            if (idx >= 0) {
+                nodes[idx].sampled_pages++;
+                (*sampled)++;
+            } else {
+                (*not_present)++;
+            }
+        }
+        rc = 0;
+    }
+    free(pages);
+    free(status);
+    return rc;
+}
+
+// Fraction of the total not on the node holding the most
+static double remote_fraction(const NumaNodeStats* nodes, int count, int sampled) {
+    double total = 0, top = 0;
+    for (int i = 0; i < count; i++) {
+        double value = sampled ? (double)nodes[i].sampled_pages : (double)nodes[i].process_bytes;
+        total += value;
+        if (value > top) top = value;
+    }
+    return total > 0 ? 1.0 - top / total : 0.0;
+}
+
+void output_numa_summary_json(void) {
+    NumaNodeStats nodes[NUMA_MAX_NODES];
+    int count = read_numa_nodes(nodes, NUMA_MAX_NODES);
+
+    printf("  \"numa\": {\"nodes\": [");
+    for (int i = 0; i < count; i++) {
+        printf("%s{\"node\": %d, \"total\": %zu, \"free\": %zu, \"pressure\": %.3f, \"foreign_ratio\": %.4f}",
+               i ? ", " : "", nodes[i].node, nodes[i].total, nodes[i].free,
+               nodes[i].pressure, nodes[i].foreign_ratio);
+    }
+    printf("], \"imbalance\": %.3f},\n", numa_imbalance(nodes, count));
+}
+
+static void output_node_distances(int node) {
+    char path[128], line[512];
+    snprintf(path, sizeof(path), NODE_DIR "/node%d/distance", node);
+    FILE* f = fopen(path, "r");
+
+    printf("\"distance\": [");
+    if (f != NULL && fgets(line, sizeof(line), f)) {
+        char* p = line;
+        int first = 1;
+        char* end;
+        for (long d = strtol(p, &end, 10); end != p; d = strtol(p, &end, 10)) {
+            printf("%s%ld", first ? "" : ", ", d);
+            first = 0;
+            p = end;
+        }
+    }
+    printf("]");
+    if (f != NULL) fclose(f);
+}
+
+void output_numa_process_json(pid_t pid) {
+    NumaNodeStats nodes[NUMA_MAX_NODES];
+    int count = read_numa_nodes(nodes, NUMA_MAX_NODES);
+    int vmas = 0, split_vmas = 0;
+    size_t sampled = 0, not_present = 0;
+
+    int have_maps = read_numa_maps(pid, nodes, count, &vmas, &split_vmas) == 0;
+    int have_samples = sample_page_placement(pid, nodes, count, &sampled, &not_present) == 0;
+
+    printf("{\n");
+    printf("  \"pid\": %d,\n", (int)pid);
+    printf("  \"nodes\": [");
+    for (int i = 0; i < count; i++) {
+        NumaNodeStats* n = &nodes[i];
+        printf("%s\n    {\"node\": %d, \"total\": %zu, \"free\": %zu, \"anon\": %zu, \"file\": %zu, "
+               "\"pressure\": %.3f, \"foreign_ratio\": %.4f, \"numa_hit\": %lu, \"numa_miss\": %lu, "
+               "\"numa_foreign\": %lu, \"other_node\": %lu, \"process_bytes\": %zu, \"sampled_pages\": %zu, ",
+               i ? "," : "", n->node, n->total, n->free, n->anon, n->file, n->pressure,
+               n->foreign_ratio, n->numa_hit, n->numa_miss, n->numa_foreign, n->other_node,
+               n->process_bytes, n->sampled_pages);
+        output_node_distances(n->node);
+        printf("}");
+    }
+    printf("\n  ],\n");
+    printf("  \"imbalance\": %.3f,\n", numa_imbalance(nodes, count));
+    printf("  \"process\": {\"numa_maps\": %s, \"vmas\": %d, \"split_vmas\": %d, \"remote_fraction\": %.4f, "
+           "\"sampled\": %s, \"sampled_pages\": %zu, \"not_present\": %zu, \"sampled_remote_fraction\": %.4f}\n",
+           have_maps ? "true" : "false", vmas, split_vmas, remote_fraction(nodes, count, 0),
+           have_samples ? "true" : "false", sampled, not_present, remote_fraction(nodes, count, 1));
+    printf("}\n");
+}
@@ -0,0 +1,19 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include "memory_types.h"
+#include <sys/types.h>
+
+#define NUMA_MAX_NODES 64
+// Upper bound on pages queried with move_pages per process
+#define NUMA_SAMPLE_PAGES 4096
+
+// Fills nodes with per-node meminfo and numastat; returns the node count.
+// Kernels without NUMA support report a single node built from /proc/meminfo.
+int read_numa_nodes(NumaNodeStats* nodes, int max);
+// Spread of node pressure: max - min, 0 on single-node machines
+double numa_imbalance(const NumaNodeStats* nodes, int count);
+void output_numa_summary_json(void);
+void output_numa_process_json(pid_t pid);
+
+#endif
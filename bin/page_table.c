@@ -1,55 +1,138 @@
 #include "page_table.h"
 #include "memory_types.h"
+#include "self_stats.h"
+#include "swap.h"
+#include "tlb_bench.h"
+#include "region_index.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
 
 extern MemoryAnalytics g_analytics;
 
-void get_page_table_info(void) {
-    FILE* pagemap = fopen("/proc/self/pagemap", "rb");
-    FILE* maps = fopen("/proc/self/maps", "r");
-    if (!pagemap || !maps) return;
+static RegionQuery g_query;
+static uint64_t g_next_cursor;          // 0 when the range was exhausted
+static size_t g_pages_read;
 
-    // Initialize or reallocate the entries array
+// Window of pagemap entries, refilled with one pread when a lookup falls
+// outside it; never reads past the end of the current region
+typedef struct {
+    int fd;
+    uint64_t first;                     // Virtual page number of entries[0]
+    size_t count;
+    uint64_t entries[PAGE_TABLE_PAGEMAP_WINDOW];
+} PagemapWindow;
+
+static int pagemap_entry(PagemapWindow* w, uint64_t vpn, uint64_t limit_vpn, uint64_t* entry) {
+    if (vpn < w->first || vpn >= w->first + w->count) {
+        size_t want = limit_vpn - vpn < PAGE_TABLE_PAGEMAP_WINDOW ? limit_vpn - vpn : PAGE_TABLE_PAGEMAP_WINDOW;
+        ssize_t n = pread(w->fd, w->entries, want * sizeof(uint64_t), vpn * sizeof(uint64_t));
+        if (n < (ssize_t)sizeof(uint64_t)) {
+            w->count = 0;
+            return -1;
+        }
+        w->first = vpn;
+        w->count = n / sizeof(uint64_t);
+        g_pages_read += w->count;
+    }
+    *entry = w->entries[vpn - w->first];
+    return 0;
+}
+
+// One entry per stride-aligned tile of each matching VMA inside the query
+// range. The entry describes the tile's first page and counts the present
+// and swapped pages of the whole tile, so a large stride gives overview
+// tiles and the page size gives every page. Only the VMAs and pages in
+// range are read, and reading stops once limit entries are out.
+void get_page_table_info(const RegionQuery* query) {
+    RegionIndex index;
+    PagemapWindow* window;
+    char path[64];
+    uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+
+    if (query != NULL) g_query = *query;
+    else region_query_init(&g_query);
+    pid_t pid = g_query.pid > 0 ? g_query.pid : getpid();
+    uint64_t stride = g_query.stride ? g_query.stride : PAGE_TABLE_DEFAULT_STRIDE_PAGES * page_size;
+    stride = stride < page_size ? page_size : stride / page_size * page_size;
+    g_query.stride = stride;
+    if (g_query.limit <= 0) g_query.limit = PAGE_TABLE_DEFAULT_LIMIT;
+    if (g_query.limit > PAGE_TABLE_MAX_LIMIT) g_query.limit = PAGE_TABLE_MAX_LIMIT;
+    g_next_cursor = 0;
+    g_pages_read = 0;
     g_analytics.num_entries = 0;
-    g_analytics.page_table_entries = malloc(1000 * sizeof(PageTableEntry));
-    
-    char line[256];
-    while (fgets(line, sizeof(line), maps)) {
-        unsigned long start, end;
-        char perms[5];
-        if (sscanf(line, "%lx-%lx %4s", &start, &end, perms) == 3) {
-            // Sample only a few pages from each region to avoid excessive entries
-            for (unsigned long addr = start; addr < end; addr += 4096 * 10) {
-                unsigned long offset = (addr / 4096) * 8;
-                unsigned long page_info;
-                
-                if (fseek(pagemap, offset, SEEK_SET) == 0 &&
-                    fread(&page_info, sizeof(page_info), 1, pagemap) == 1) {
-                    
-                    PageTableEntry entry = {
-                        .virtual_addr = addr,
-                        .physical_addr = (page_info & 0x7FFFFFFFFFFFFF) * 4096,
-                        .page_size = 4096,
-                        .is_present = (page_info & (1ULL << 63)) != 0,
-                        .is_writable = strchr(perms, 'w') != NULL,
-                        .is_executable = strchr(perms, 'x') != NULL,
-                        .is_cached = 1,
-                        .is_dirty = (page_info & (1ULL << 55)) != 0,
-                        .level = 4
-                    };
 
-                    if (g_analytics.num_entries < 1000) {
-                        g_analytics.page_table_entries[g_analytics.num_entries++] = entry;
-                    }
-                }
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)pid);
+    window = malloc(sizeof(PagemapWindow));
+    if (window == NULL) return;
+    window->fd = open(path, O_RDONLY | O_CLOEXEC);
+    window->count = 0;
+    if (window->fd < 0 || region_index_build(&index, pid) != 0) {
+        if (window->fd >= 0) close(window->fd);
+        free(window);
+        return;
+    }
+
+    g_analytics.page_table_entries = malloc(g_query.limit * sizeof(PageTableEntry));
+    for (size_t i = region_index_seek(&index, g_query.start);
+         i < index.count && index.starts[i] < g_query.end && g_analytics.page_table_entries; i++) {
+        if (!region_query_kind_match(&g_query, &index, i)) continue;
+        uint64_t start = index.starts[i] > g_query.start ? index.starts[i] : g_query.start;
+        uint64_t end = index.ends[i] < g_query.end ? index.ends[i] : g_query.end;
+        int perms = index.perms[i];
+        start = start / page_size * page_size;
+
+        for (uint64_t addr = start; addr < end; ) {
+            if (g_analytics.num_entries == g_query.limit) {
+                g_next_cursor = addr;
+                goto done;
             }
+            // Tiles line up on the stride grid whatever the range, so the
+            // same tile covers the same addresses in every query
+            uint64_t tile_end = (addr / stride + 1) * stride;
+            if (tile_end > end) tile_end = end;
+
+            uint64_t first, page_info;
+            unsigned long present = 0, swapped_pages = 0;
+            if (pagemap_entry(window, addr / page_size, (end + page_size - 1) / page_size, &first) != 0) break;
+            for (uint64_t vpn = addr / page_size; vpn < (tile_end + page_size - 1) / page_size; vpn++) {
+                if (pagemap_entry(window, vpn, (end + page_size - 1) / page_size, &page_info) != 0) break;
+                present += (page_info & PM_PRESENT) != 0;
+                swapped_pages += !(page_info & PM_PRESENT) && (page_info & PM_SWAPPED);
+            }
+
+            // Swapped entries hold the swap type and offset instead of a PFN
+            int swapped = !(first & PM_PRESENT) && (first & PM_SWAPPED);
+            PageTableEntry entry = {
+                .virtual_addr = addr,
+                .physical_addr = swapped ? 0 : (first & PM_PFN_MASK) * page_size,
+                .page_size = (unsigned int)page_size,
+                .is_present = (first & PM_PRESENT) != 0,
+                .is_writable = (perms & REGION_PERM_WRITE) != 0,
+                .is_executable = (perms & REGION_PERM_EXEC) != 0,
+                .is_cached = 1,
+                .is_dirty = (first & PM_SOFT_DIRTY) != 0,
+                .is_swapped = swapped,
+                .swap_type = swapped && PM_SWAP_OFFSET(first) ? PM_SWAP_TYPE(first) : -1,
+                .swap_offset = swapped ? PM_SWAP_OFFSET(first) : 0,
+                .level = page_table_levels(),
+                .region = region_kind_name(index.kinds[i]),
+                .span_pages = (tile_end - addr + page_size - 1) / page_size,
+                .present_pages = present,
+                .swapped_pages = swapped_pages
+            };
+            g_analytics.page_table_entries[g_analytics.num_entries++] = entry;
+            addr = tile_end;
         }
     }
 
-    fclose(pagemap);
-    fclose(maps);
+done:
+    region_index_free(&index);
+    close(window->fd);
+    free(window);
 }
 
 void output_page_table_json(void) {
@@ -66,15 +149,32 @@ void output_page_table_json(void) {
         printf("      \"is_executable\": %s,\n", entry->is_executable ? "true" : "false");
         printf("      \"is_cached\": %s,\n", entry->is_cached ? "true" : "false");
         printf("      \"is_dirty\": %s,\n", entry->is_dirty ? "true" : "false");
-        printf("      \"level\": %d\n", entry->level);
+        printf("      \"is_swapped\": %s,\n", entry->is_swapped ? "true" : "false");
+        printf("      \"swap_type\": %d,\n", entry->swap_type);
+        printf("      \"swap_offset\": %lu,\n", entry->swap_offset);
+        printf("      \"level\": %d,\n", entry->level);
+        printf("      \"region\": \"%s\",\n", entry->region);
+        printf("      \"span_pages\": %lu,\n", entry->span_pages);
+        printf("      \"present_pages\": %lu,\n", entry->present_pages);
+        printf("      \"swapped_pages\": %lu\n", entry->swapped_pages);
         printf("    }%s\n", i < g_analytics.num_entries - 1 ? "," : "");
     }
-    printf("  ]\n");
-    printf("}\n");
+    printf("  ],\n");
+    printf("  \"query\": {\"pid\": %d, \"start\": \"0x%" PRIx64 "\", \"end\": \"0x%" PRIx64 "\", "
+           "\"stride\": %" PRIu64 ", \"limit\": %d, \"pages_read\": %zu},\n",
+           g_query.pid > 0 ? (int)g_query.pid : (int)getpid(), g_query.start, g_query.end,
+           g_query.stride, g_query.limit, g_pages_read);
+    if (g_next_cursor) printf("  \"next_cursor\": \"%" PRIx64 "\",\n", g_next_cursor);
+    else printf("  \"next_cursor\": null,\n");
+    output_self_stats_json();
+    printf("\n}\n");
 }
 
-void display_page_table_info(void) {
-    get_page_table_info();
+void display_page_table_info(const RegionQuery* query) {
+    SelfSample cost;
+    self_begin(&cost);
+    get_page_table_info(query);
+    self_end("pagemap", &cost);
     output_page_table_json();
     
     // Clean up
@@ -1,8 +1,16 @@
 #ifndef PAGE_TABLE_H
 #define PAGE_TABLE_H
 
-void get_page_table_info(void);
-void display_page_table_info(void);
+#include "region_index.h"
+
+#define PAGE_TABLE_DEFAULT_STRIDE_PAGES 10
+#define PAGE_TABLE_DEFAULT_LIMIT 1000
+#define PAGE_TABLE_MAX_LIMIT 100000
+#define PAGE_TABLE_PAGEMAP_WINDOW 512
+
+// NULL queries all of vmd's own mappings at the default stride
+void get_page_table_info(const RegionQuery* query);
+void display_page_table_info(const RegionQuery* query);
 void output_page_table_json(void);
 
-#endif 
\ No newline at end of file
+#endif 
@@ -0,0 +1,531 @@
+#define _GNU_SOURCE
+#include "process_scan.h"
+#include "batch_io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/resource.h>
+
+#define PROC_SCAN_RATE_INTERVAL_MS 250
+
+typedef struct {
+    ProcessStats stats;
+    unsigned long long faults;
+    size_t detail_rss;          // RSS when smaps_rollup was last read
+    unsigned long seen_scan;
+    unsigned long detail_scan;
+    int stat_slot;              // batch_io slot of the open /proc/<pid>/stat, -1 if none
+    ssize_t stat_len;           // Bytes of this scan's stat read, <= 0 if it failed
+    int fresh;                  // No previous sample to compute rates from
+    int alive;
+} ProcEntry;
+
+// Cache of every known process. Entries are compacted after each scan and
+// pid_index (open addressing, pid -> entry index + 1) is rebuilt.
+static ProcEntry* g_entries = NULL;
+static int g_num_entries = 0;
+static int g_entry_cap = 0;
+static int* g_pid_index = NULL;
+static int g_index_cap = 0;
+static unsigned long g_scan = 0;
+static unsigned long long g_last_scan_ns = 0;
+static double g_scan_interval_s = 0;
+static ProcessScanStats g_stats;
+static int g_proc_fd = -1;
+static BatchIo* g_io = NULL;
+static char* g_stat_bufs = NULL;        // PROC_SCAN_STAT_BUF per entry
+static BatchRead* g_reads = NULL;
+static int* g_read_owners = NULL;       // Entry index of each read
+static int g_io_cap = 0;
+static unsigned long g_io_syscalls = 0; // Direct opens, reads and closes
+static pthread_mutex_t g_scan_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Persistent worker pool; the scanning thread works alongside it
+static pthread_t g_workers[PROC_SCAN_MAX_THREADS];
+static int g_num_workers = -1;
+static pthread_mutex_t g_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_pool_done = PTHREAD_COND_INITIALIZER;
+static unsigned long g_pool_job = 0;
+static int g_pool_active = 0;
+static int g_work_next = 0;
+static int g_detail_reads = 0;
+
+static unsigned long long clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static ssize_t read_proc_file(int pid, const char* file, char* buf, size_t len) {
+    char path[64];
+    snprintf(path, sizeof(path), "%d/%s", pid, file);
+    int fd = openat(g_proc_fd, path, O_RDONLY | O_CLOEXEC);
+    unsigned long calls = 1;
+    if (fd < 0) {
+        __atomic_fetch_add(&g_io_syscalls, calls, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    size_t total = 0;
+    ssize_t n;
+    do {
+        n = read(fd, buf + total, len - 1 - total);
+        calls++;
+    } while (n > 0 && (total += n) < len - 1);
+    close(fd);
+    buf[total] = '\0';
+    __atomic_fetch_add(&g_io_syscalls, calls + 1, __ATOMIC_RELAXED);
+    return total;
+}
+
+// Value in kB of "\n<key> <value> kB" in a status-style file, in bytes
+static int find_kb_field(const char* buf, const char* key, size_t* bytes) {
+    const char* p = strstr(buf, key);
+    if (p == NULL) return 0;
+    *bytes = strtoull(p + strlen(key), NULL, 10) * 1024;
+    return 1;
+}
+
+// Parses /proc/pid/stat: comm, minflt, majflt, starttime and rss
+static int parse_stat(char* buf, ProcessStats* stats, unsigned long long* faults) {
+    char* open = strchr(buf, '(');
+    char* close = strrchr(buf, ')');
+    if (open == NULL || close == NULL || close < open) return -1;
+
+    size_t name_len = close - open - 1;
+    if (name_len >= sizeof(stats->name)) name_len = sizeof(stats->name) - 1;
+    memcpy(stats->name, open + 1, name_len);
+    stats->name[name_len] = '\0';
+
+    // Field 3 (state) follows ") "; walk the space-separated numbers after it
+    char* p = close + 2;
+    unsigned long long minflt = 0, majflt = 0, rss_pages = 0;
+    for (int field = 3; field <= 24 && *p; field++) {
+        unsigned long long value = field == 3 ? 0 : strtoull(p, NULL, 10);
+        if (field == 10) minflt = value;
+        else if (field == 12) majflt = value;
+        else if (field == 22) stats->start_time = value;
+        else if (field == 24) rss_pages = value;
+        p = strchr(p, ' ');
+        if (p == NULL) break;
+        p++;
+    }
+    *faults = minflt + majflt;
+    stats->rss = rss_pages * (size_t)sysconf(_SC_PAGESIZE);
+    return 0;
+}
+
+// smaps_rollup gives PSS and swap but needs ptrace access; fall back to
+// VmSwap from status for processes we cannot inspect
+static void read_details(ProcEntry* e) {
+    char buf[4096];
+    ProcessStats* s = &e->stats;
+
+    if (read_proc_file(s->pid, "smaps_rollup", buf, sizeof(buf)) > 0 &&
+        find_kb_field(buf, "\nPss:", &s->pss)) {
+        s->pss_known = 1;
+        if (!find_kb_field(buf, "\nSwap:", &s->swap)) s->swap = 0;
+    } else {
+        s->pss = 0;
+        s->pss_known = 0;
+        if (read_proc_file(s->pid, "status", buf, sizeof(buf)) <= 0 ||
+            !find_kb_field(buf, "\nVmSwap:", &s->swap))
+            s->swap = 0;
+    }
+    e->detail_rss = s->rss;
+    e->detail_scan = g_scan;
+    __atomic_fetch_add(&g_detail_reads, 1, __ATOMIC_RELAXED);
+}
+
+static void refresh_entry(ProcEntry* e, char* buf) {
+    ProcessStats sample = e->stats;
+    unsigned long long faults;
+
+    if (e->stat_len <= 0 || parse_stat(buf, &sample, &faults) != 0) {
+        e->alive = 0;
+        return;
+    }
+
+    // A different start time means the pid was reused; the stat fd was
+    // opened after the reuse, since a stale one fails with ESRCH
+    if (!e->fresh && sample.start_time != e->stats.start_time) {
+        int pid = e->stats.pid, slot = e->stat_slot;
+        unsigned long seen = e->seen_scan;
+        memset(e, 0, sizeof(*e));
+        e->stats.pid = pid;
+        e->stat_slot = slot;
+        e->seen_scan = seen;
+        e->fresh = 1;
+    }
+
+    if (!e->fresh && g_scan_interval_s > 0) {
+        sample.growth_rate = ((double)sample.rss - (double)e->stats.rss) / g_scan_interval_s;
+        sample.fault_rate = (faults - e->faults) / g_scan_interval_s;
+    } else {
+        sample.growth_rate = 0;
+        sample.fault_rate = 0;
+    }
+    sample.pid = e->stats.pid;
+    sample.pss = e->stats.pss;
+    sample.swap = e->stats.swap;
+    sample.pss_known = e->stats.pss_known;
+    e->stats = sample;
+    e->faults = faults;
+    e->alive = 1;
+
+    // Kernel threads have no user memory to inspect
+    if (sample.rss == 0) return;
+    size_t drift = e->detail_rss >> PROC_SCAN_RSS_SHIFT;
+    size_t delta = sample.rss > e->detail_rss ? sample.rss - e->detail_rss : e->detail_rss - sample.rss;
+    if (e->fresh || delta > drift || g_scan - e->detail_scan >= PROC_SCAN_DETAIL_EVERY)
+        read_details(e);
+    e->fresh = 0;
+}
+
+static void process_work(void) {
+    int i;
+    while ((i = __atomic_fetch_add(&g_work_next, 1, __ATOMIC_RELAXED)) < g_num_entries) {
+        if (g_entries[i].seen_scan == g_scan) refresh_entry(&g_entries[i], g_stat_bufs + (size_t)i * PROC_SCAN_STAT_BUF);
+    }
+}
+
+static void* scan_worker(void* arg) {
+    unsigned long seen = 0;
+    (void)arg;
+
+    while (1) {
+        pthread_mutex_lock(&g_pool_mutex);
+        while (g_pool_job == seen) pthread_cond_wait(&g_pool_start, &g_pool_mutex);
+        seen = g_pool_job;
+        pthread_mutex_unlock(&g_pool_mutex);
+
+        process_work();
+
+        pthread_mutex_lock(&g_pool_mutex);
+        if (--g_pool_active == 0) pthread_cond_signal(&g_pool_done);
+        pthread_mutex_unlock(&g_pool_mutex);
+    }
+    return NULL;
+}
+
+static void start_workers(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int wanted = cpus > 1 ? (int)cpus - 1 : 0;
+    if (wanted > PROC_SCAN_MAX_THREADS - 1) wanted = PROC_SCAN_MAX_THREADS - 1;
+
+    g_num_workers = 0;
+    for (int i = 0; i < wanted; i++) {
+        if (pthread_create(&g_workers[i], NULL, scan_worker, NULL) != 0) break;
+        pthread_detach(g_workers[i]);
+        g_num_workers++;
+    }
+}
+
+static void run_workers(void) {
+    g_work_next = 0;
+    g_detail_reads = 0;
+    if (g_num_workers > 0) {
+        pthread_mutex_lock(&g_pool_mutex);
+        g_pool_active = g_num_workers;
+        g_pool_job++;
+        pthread_cond_broadcast(&g_pool_start);
+        pthread_mutex_unlock(&g_pool_mutex);
+    }
+
+    process_work();
+
+    pthread_mutex_lock(&g_pool_mutex);
+    while (g_pool_active > 0) pthread_cond_wait(&g_pool_done, &g_pool_mutex);
+    pthread_mutex_unlock(&g_pool_mutex);
+}
+
+static int lookup_pid(int pid) {
+    if (g_index_cap == 0) return -1;
+    for (int i = pid & (g_index_cap - 1); g_pid_index[i] != 0; i = (i + 1) & (g_index_cap - 1)) {
+        if (g_entries[g_pid_index[i] - 1].stats.pid == pid) return g_pid_index[i] - 1;
+    }
+    return -1;
+}
+
+static int rebuild_index(void) {
+    int cap = 64;
+    while (cap < g_num_entries * 2) cap *= 2;
+    if (cap != g_index_cap) {
+        int* index = malloc(cap * sizeof(int));
+        if (index == NULL) return -1;
+        free(g_pid_index);
+        g_pid_index = index;
+        g_index_cap = cap;
+    }
+    memset(g_pid_index, 0, g_index_cap * sizeof(int));
+    for (int e = 0; e < g_num_entries; e++) {
+        int i = g_entries[e].stats.pid & (g_index_cap - 1);
+        while (g_pid_index[i] != 0) i = (i + 1) & (g_index_cap - 1);
+        g_pid_index[i] = e + 1;
+    }
+    return 0;
+}
+
+static ProcEntry* add_entry(int pid) {
+    if (g_num_entries == g_entry_cap) {
+        int cap = g_entry_cap ? g_entry_cap * 2 : 1024;
+        ProcEntry* entries = realloc(g_entries, cap * sizeof(ProcEntry));
+        if (entries == NULL) return NULL;
+        g_entries = entries;
+        g_entry_cap = cap;
+    }
+    ProcEntry* e = &g_entries[g_num_entries++];
+    memset(e, 0, sizeof(*e));
+    e->stats.pid = pid;
+    e->stat_slot = -1;
+    e->fresh = 1;
+    return e;
+}
+
+// Every cached stat fd counts against RLIMIT_NOFILE, so raise the soft
+// limit to the hard one and keep PROC_SCAN_FD_RESERVE for everything else
+static int stat_fd_budget(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return 0;
+    if (rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) != 0) getrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > PROC_SCAN_MAX_STAT_FDS + PROC_SCAN_FD_RESERVE)
+        return PROC_SCAN_MAX_STAT_FDS;
+    return rl.rlim_cur > PROC_SCAN_FD_RESERVE ? (int)(rl.rlim_cur - PROC_SCAN_FD_RESERVE) : 0;
+}
+
+static int reserve_io_buffers(void) {
+    if (g_io_cap >= g_entry_cap) return 0;
+    char* bufs = realloc(g_stat_bufs, (size_t)g_entry_cap * PROC_SCAN_STAT_BUF);
+    if (bufs == NULL) return -1;
+    g_stat_bufs = bufs;
+    BatchRead* reads = realloc(g_reads, g_entry_cap * sizeof(BatchRead));
+    if (reads == NULL) return -1;
+    g_reads = reads;
+    int* owners = realloc(g_read_owners, g_entry_cap * sizeof(int));
+    if (owners == NULL) return -1;
+    g_read_owners = owners;
+    g_io_cap = g_entry_cap;
+    return 0;
+}
+
+static void open_stat(ProcEntry* e) {
+    char path[32];
+    snprintf(path, sizeof(path), "%d/stat", e->stats.pid);
+    int fd = openat(g_proc_fd, path, O_RDONLY | O_CLOEXEC);
+    g_io_syscalls++;
+    if (fd >= 0 && (e->stat_slot = batch_io_add(g_io, fd)) < 0) {
+        close(fd);
+        g_io_syscalls++;
+    }
+}
+
+// Reads /proc/<pid>/stat of every seen entry into its buffer. Stat fds
+// stay open across scans, so a known process costs one read in a batch
+// instead of an open, reads and a close; processes past the fd budget
+// go through read_proc_file
+static void read_stats(void) {
+    int n = 0;
+    for (int i = 0; i < g_num_entries; i++) {
+        ProcEntry* e = &g_entries[i];
+        char* buf = g_stat_bufs + (size_t)i * PROC_SCAN_STAT_BUF;
+        if (e->seen_scan != g_scan) continue;
+        if (e->stat_slot < 0 && g_io != NULL && batch_io_free_slots(g_io) > 0) open_stat(e);
+        if (e->stat_slot < 0) {
+            e->stat_len = read_proc_file(e->stats.pid, "stat", buf, PROC_SCAN_STAT_BUF);
+            continue;
+        }
+        g_read_owners[n] = i;
+        g_reads[n].slot = e->stat_slot;
+        g_reads[n].buf = buf;
+        g_reads[n].len = PROC_SCAN_STAT_BUF - 1;
+        g_reads[n].offset = 0;
+        n++;
+    }
+    if (n > 0) batch_io_read(g_io, g_reads, n);
+
+    for (int j = 0; j < n; j++) {
+        ProcEntry* e = &g_entries[g_read_owners[j]];
+        char* buf = g_reads[j].buf;
+        e->stat_len = g_reads[j].result;
+        if (e->stat_len > 0) {
+            buf[e->stat_len] = '\0';
+            continue;
+        }
+        // The process exited, or its pid was reused behind our fd; a fresh
+        // read tells the two apart in this scan
+        batch_io_remove(g_io, e->stat_slot);
+        e->stat_slot = -1;
+        if (e->stat_len == -ESRCH) e->stat_len = read_proc_file(e->stats.pid, "stat", buf, PROC_SCAN_STAT_BUF);
+    }
+}
+
+int scan_processes(void) {
+    pthread_mutex_lock(&g_scan_mutex);
+    unsigned long long wall_start = clock_ns(CLOCK_MONOTONIC);
+    unsigned long long cpu_start = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+
+    if (g_num_workers < 0) start_workers();
+    if (g_io == NULL) g_io = batch_io_create(stat_fd_budget());
+    if (g_proc_fd < 0) g_proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* dir = g_proc_fd >= 0 ? fdopendir(dup(g_proc_fd)) : NULL;
+    if (dir == NULL) {
+        pthread_mutex_unlock(&g_scan_mutex);
+        return -1;
+    }
+
+    g_scan++;
+    g_scan_interval_s = g_last_scan_ns ? (wall_start - g_last_scan_ns) / 1e9 : 0;
+    g_last_scan_ns = wall_start;
+
+    // The dup shares its offset with g_proc_fd, so start from the top
+    rewinddir(dir);
+
+    // Mark every pid present now; new pids are appended to the cache
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!isdigit((unsigned char)entry->d_name[0])) continue;
+        int pid = atoi(entry->d_name);
+        int index = lookup_pid(pid);
+        ProcEntry* e = index >= 0 ? &g_entries[index] : add_entry(pid);
+        if (e != NULL) e->seen_scan = g_scan;
+    }
+    closedir(dir);
+
+    if (reserve_io_buffers() != 0) {
+        pthread_mutex_unlock(&g_scan_mutex);
+        return -1;
+    }
+    read_stats();
+    run_workers();
+
+    // Drop processes that exited
+    int live = 0, cached = 0;
+    for (int i = 0; i < g_num_entries; i++) {
+        if (g_entries[i].seen_scan != g_scan || !g_entries[i].alive) {
+            if (g_entries[i].stat_slot >= 0) batch_io_remove(g_io, g_entries[i].stat_slot);
+            continue;
+        }
+        if (live != i) g_entries[live] = g_entries[i];
+        cached += g_entries[i].stat_slot >= 0;
+        live++;
+    }
+    g_num_entries = live;
+    rebuild_index();
+
+    g_stats.processes = live;
+    g_stats.detail_reads = g_detail_reads;
+    g_stats.threads = g_num_workers + 1;
+    g_stats.cached_fds = cached;
+    g_stats.io_backend = g_io != NULL ? batch_io_backend_name(g_io) : "read";
+    g_stats.io_syscalls = g_io_syscalls + (g_io != NULL ? batch_io_take_syscalls(g_io) : 0);
+    g_io_syscalls = 0;
+    g_stats.wall_ms = (clock_ns(CLOCK_MONOTONIC) - wall_start) / 1e6;
+    g_stats.cpu_ms = (clock_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu_start) / 1e6;
+    pthread_mutex_unlock(&g_scan_mutex);
+    return live;
+}
+
+static double sort_value(const ProcessStats* s, ProcessSortKey key) {
+    switch (key) {
+        case PROC_SORT_PSS: return (double)s->pss;
+        case PROC_SORT_SWAP: return (double)s->swap;
+        case PROC_SORT_GROWTH: return s->growth_rate;
+        case PROC_SORT_FAULTS: return s->fault_rate;
+        default: return (double)s->rss;
+    }
+}
+
+int top_processes(ProcessStats* out, int max, ProcessSortKey key) {
+    int count = 0;
+
+    pthread_mutex_lock(&g_scan_mutex);
+    for (int i = 0; i < g_num_entries; i++) {
+        const ProcessStats* s = &g_entries[i].stats;
+        double value = sort_value(s, key);
+        if (count == max && value <= sort_value(&out[count - 1], key)) continue;
+
+        // Insertion into the sorted top-N, dropping the smallest when full
+        int pos = count < max ? count++ : max - 1;
+        while (pos > 0 && sort_value(&out[pos - 1], key) < value) {
+            out[pos] = out[pos - 1];
+            pos--;
+        }
+        out[pos] = *s;
+    }
+    pthread_mutex_unlock(&g_scan_mutex);
+    return count;
+}
+
+ProcessScanStats process_scan_stats(void) {
+    pthread_mutex_lock(&g_scan_mutex);
+    ProcessScanStats stats = g_stats;
+    pthread_mutex_unlock(&g_scan_mutex);
+    return stats;
+}
+
+static const char* g_sort_names[] = { "rss", "pss", "swap", "growth", "faults" };
+
+int parse_process_sort_key(const char* name, ProcessSortKey* key) {
+    for (size_t i = 0; i < sizeof(g_sort_names) / sizeof(g_sort_names[0]); i++) {
+        if (strcmp(name, g_sort_names[i]) == 0) {
+            *key = (ProcessSortKey)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void print_json_string(const char* s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') printf("\\%c", *s);
+        else if ((unsigned char)*s < 0x20) printf("\\u%04x", *s);
+        else putchar(*s);
+    }
+    putchar('"');
+}
+
+void output_process_ranking_json(ProcessSortKey key, int limit) {
+    // Growth and fault rates need two samples
+    if (g_scan < 2) {
+        scan_processes();
+        usleep(PROC_SCAN_RATE_INTERVAL_MS * 1000);
+    }
+    scan_processes();
+
+    if (limit <= 0) limit = PROC_SCAN_DEFAULT_TOP;
+    ProcessStats* top = malloc(limit * sizeof(ProcessStats));
+    int count = top ? top_processes(top, limit, key) : 0;
+    ProcessScanStats stats = process_scan_stats();
+
+    printf("{\n");
+    printf("  \"scan\": {\"processes\": %d, \"detail_reads\": %d, \"threads\": %d, "
+           "\"io_backend\": \"%s\", \"io_syscalls\": %lu, \"cached_fds\": %d, "
+           "\"wall_ms\": %.2f, \"cpu_ms\": %.2f},\n",
+           stats.processes, stats.detail_reads, stats.threads, stats.io_backend, stats.io_syscalls,
+           stats.cached_fds, stats.wall_ms, stats.cpu_ms);
+    printf("  \"sort\": \"%s\",\n", g_sort_names[key]);
+    printf("  \"processes\": [");
+    for (int i = 0; i < count; i++) {
+        ProcessStats* s = &top[i];
+        printf("%s\n    {\"pid\": %d, \"name\": ", i ? "," : "", s->pid);
+        print_json_string(s->name);
+        printf(", \"rss\": %zu, \"pss\": %zu, \"pss_known\": %s, \"swap\": %zu, "
+               "\"growth_rate\": %.1f, \"fault_rate\": %.1f}",
+               s->rss, s->pss, s->pss_known ? "true" : "false", s->swap,
+               s->growth_rate, s->fault_rate);
+    }
+    printf("%s]\n}\n", count ? "\n  " : "");
+    free(top);
+}
@@ -0,0 +1,45 @@
+#ifndef PROCESS_SCAN_H
+#define PROCESS_SCAN_H
+
+#include "memory_types.h"
+
+#define PROC_SCAN_MAX_THREADS 8
+#define PROC_SCAN_DEFAULT_TOP 20
+// Known processes have their smaps_rollup / status re-read when RSS moves
+// by more than 1/PROC_SCAN_RSS_SHIFT, or at least every this many scans
+#define PROC_SCAN_DETAIL_EVERY 10
+#define PROC_SCAN_RSS_SHIFT 4
+// /proc/<pid>/stat fds are kept open between scans and read in one batch;
+// the first 24 fields that parse_stat needs fit well within the buffer
+#define PROC_SCAN_STAT_BUF 512
+#define PROC_SCAN_MAX_STAT_FDS 65536
+#define PROC_SCAN_FD_RESERVE 256
+
+typedef enum {
+    PROC_SORT_RSS,
+    PROC_SORT_PSS,
+    PROC_SORT_SWAP,
+    PROC_SORT_GROWTH,
+    PROC_SORT_FAULTS
+} ProcessSortKey;
+
+typedef struct {
+    int processes;
+    int detail_reads;
+    int threads;
+    const char* io_backend;         // "io_uring_fixed", "io_uring" or "preadv"
+    unsigned long io_syscalls;      // File syscalls made by the scan
+    int cached_fds;
+    double wall_ms;
+    double cpu_ms;
+} ProcessScanStats;
+
+// Refreshes the process cache; returns the number of live processes
+int scan_processes(void);
+// Copies the top max processes by key into out; returns the number copied
+int top_processes(ProcessStats* out, int max, ProcessSortKey key);
+ProcessScanStats process_scan_stats(void);
+int parse_process_sort_key(const char* name, ProcessSortKey* key);
+void output_process_ranking_json(ProcessSortKey key, int limit);
+
+#endif
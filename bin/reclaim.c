@@ -0,0 +1,575 @@
+#define _GNU_SOURCE
+#include "reclaim.h"
+#include "region_index.h"
+#include "cgroup.h"
+#include "swap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_process_madvise
+#define SYS_process_madvise 440
+#endif
+#ifndef MADV_COLD
+#define MADV_COLD 20
+#endif
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+
+// Stacks are hot by construction and shared or special mappings are not
+// this process's to reclaim
+#define RECLAIM_KINDS ((1U << REGION_KIND_HEAP) | (1U << REGION_KIND_ARENA) | (1U << REGION_KIND_ANON) | \
+                       (1U << REGION_KIND_BSS) | (1U << REGION_KIND_DATA) | (1U << REGION_KIND_RODATA) | \
+                       (1U << REGION_KIND_TEXT))
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    size_t rss_kb;
+    size_t referenced_kb;
+    size_t swap_kb;
+    RegionKind kind;
+    uint32_t name;                  // Offset into the index's strings
+    size_t advise_bytes;            // Counted against the budget
+    size_t written_bytes;           // Present but written during the idle window
+    int advised;
+} ReclaimRegion;
+
+// Counters compared between the idle window before acting and the settle
+// window after it
+typedef struct {
+    unsigned long long major_faults;
+    size_t rss_kb;
+    size_t anon_kb;
+    size_t file_kb;
+    size_t swap_kb;
+    unsigned long long psi_some_us;
+    unsigned long long refault_anon;
+    unsigned long long refault_file;
+    unsigned long long taken_ns;
+} ReclaimSample;
+
+static const char* g_mode_names[] = { "dry_run", "cold", "pageout" };
+
+void reclaim_default_options(ReclaimOptions* opts) {
+    opts->mode = RECLAIM_DRY_RUN;
+    opts->idle_s = RECLAIM_DEFAULT_IDLE_S;
+    opts->settle_s = RECLAIM_DEFAULT_SETTLE_S;
+    opts->budget_bytes = (size_t)RECLAIM_DEFAULT_BUDGET_MB << 20;
+    opts->rate_bytes = 0;
+    opts->min_idle = RECLAIM_DEFAULT_MIN_IDLE;
+    opts->max_psi = RECLAIM_DEFAULT_MAX_PSI;
+    opts->clear_refs = 0;
+}
+
+int parse_reclaim_mode(const char* name, ReclaimMode* mode) {
+    for (int i = 0; i <= RECLAIM_PAGEOUT; i++) {
+        if (strcmp(name, g_mode_names[i]) == 0) {
+            *mode = (ReclaimMode)i;
+            return 0;
+        }
+    }
+    if (strcmp(name, "dry") == 0) {
+        *mode = RECLAIM_DRY_RUN;
+        return 0;
+    }
+    return -1;
+}
+
+static unsigned long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_ns(unsigned long long ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL) };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR);
+}
+
+static ssize_t read_file(const char* path, char* buf, size_t len) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+// Value after "key" at the start of a line, e.g. "RssAnon:" or "workingset_refault_anon "
+static unsigned long long line_value(const char* buf, const char* key) {
+    size_t len = strlen(key);
+    for (const char* p = buf; p != NULL && *p; p = strchr(p, '\n'), p = p ? p + 1 : NULL) {
+        if (strncmp(p, key, len) == 0) return strtoull(p + len, NULL, 10);
+    }
+    return 0;
+}
+
+// The target's cgroup v2 directory, so refaults and stalls are its own
+static int target_cgroup(pid_t pid, char* dir, size_t len) {
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/cgroup", (int)pid);
+    if (read_file(path, buf, sizeof(buf)) <= 0) return -1;
+    char* line = strstr(buf, "0::");
+    if (line == NULL) return -1;
+    line += 3;
+    line[strcspn(line, "\n")] = '\0';
+    snprintf(dir, len, CGROUP_ROOT "%s", line);
+
+    // The root group has no memory.pressure; the system file covers it
+    char probe[4200];
+    snprintf(probe, sizeof(probe), "%s/memory.pressure", dir);
+    return access(probe, R_OK) == 0 ? 0 : -1;
+}
+
+static void take_sample(pid_t pid, const char* cgroup, ReclaimSample* s) {
+    char path[4200], buf[8192];
+    memset(s, 0, sizeof(*s));
+    s->taken_ns = monotonic_ns();
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    if (read_file(path, buf, sizeof(buf)) > 0) {
+        // majflt is the 10th field after the parenthesized comm
+        char* p = strrchr(buf, ')');
+        for (int field = 0; p != NULL && field < 10; field++) p = strchr(p + 1, ' ');
+        if (p != NULL) s->major_faults = strtoull(p + 1, NULL, 10);
+    }
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    if (read_file(path, buf, sizeof(buf)) > 0) {
+        s->rss_kb = line_value(buf, "VmRSS:");
+        s->anon_kb = line_value(buf, "RssAnon:");
+        s->file_kb = line_value(buf, "RssFile:");
+        s->swap_kb = line_value(buf, "VmSwap:");
+    }
+
+    if (cgroup != NULL) snprintf(path, sizeof(path), "%s/memory.pressure", cgroup);
+    else snprintf(path, sizeof(path), "/proc/pressure/memory");
+    if (read_file(path, buf, sizeof(buf)) > 0) {
+        const char* total = strstr(buf, "total=");
+        if (total != NULL) s->psi_some_us = strtoull(total + 6, NULL, 10);
+    }
+    if (cgroup != NULL) snprintf(path, sizeof(path), "%s/memory.stat", cgroup);
+    else snprintf(path, sizeof(path), "/proc/vmstat");
+    if (read_file(path, buf, sizeof(buf)) > 0) {
+        s->refault_anon = line_value(buf, "workingset_refault_anon ");
+        s->refault_file = line_value(buf, "workingset_refault_file ");
+    }
+}
+
+static double current_psi_avg10(const char* cgroup) {
+    char path[4200], buf[512];
+    double avg10;
+    if (cgroup != NULL) snprintf(path, sizeof(path), "%s/memory.pressure", cgroup);
+    else snprintf(path, sizeof(path), "/proc/pressure/memory");
+    if (read_file(path, buf, sizeof(buf)) <= 0) return 0;
+    return sscanf(buf, "some avg10=%lf", &avg10) == 1 ? avg10 : 0;
+}
+
+// Referenced counts pages accessed since clear_refs; only the listed
+// kinds of the index are kept
+static int read_regions(pid_t pid, const RegionIndex* index, ReclaimRegion** out, int* count) {
+    char path[64];
+    char* line = NULL;
+    size_t line_cap = 0, cap = 0;
+    ReclaimRegion* regions = NULL;
+    ReclaimRegion* current = NULL;
+    int n = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/smaps", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return -1;
+    while (getline(&line, &line_cap, f) > 0) {
+        if (!((line[0] >= '0' && line[0] <= '9') || (line[0] >= 'a' && line[0] <= 'f'))) {
+            if (current == NULL) continue;
+            if (strncmp(line, "Rss:", 4) == 0) current->rss_kb = strtoul(line + 4, NULL, 10);
+            else if (strncmp(line, "Referenced:", 11) == 0) current->referenced_kb = strtoul(line + 11, NULL, 10);
+            else if (strncmp(line, "Swap:", 5) == 0) current->swap_kb = strtoul(line + 5, NULL, 10);
+            continue;
+        }
+
+        current = NULL;
+        uint64_t start = strtoull(line, NULL, 16);
+        long i = region_index_lookup(index, start);
+        if (i < 0 || index->starts[i] != start || !(RECLAIM_KINDS & (1U << index->kinds[i]))) continue;
+        if ((size_t)n == cap) {
+            size_t grown = cap ? cap * 2 : 256;
+            ReclaimRegion* r = realloc(regions, grown * sizeof(ReclaimRegion));
+            if (r == NULL) break;
+            regions = r;
+            cap = grown;
+        }
+        current = &regions[n++];
+        memset(current, 0, sizeof(*current));
+        current->start = start;
+        current->end = index->ends[i];
+        current->kind = (RegionKind)index->kinds[i];
+        current->name = index->names[i];
+    }
+    free(line);
+    fclose(f);
+    *out = regions;
+    *count = n;
+    return 0;
+}
+
+static size_t idle_kb(const ReclaimRegion* r) {
+    return r->rss_kb > r->referenced_kb ? r->rss_kb - r->referenced_kb : 0;
+}
+
+static int compare_idle(const void* a, const void* b) {
+    size_t ia = idle_kb(a), ib = idle_kb(b);
+    return ia < ib ? 1 : ia > ib ? -1 : 0;
+}
+
+typedef struct {
+    uint64_t start;
+    uint64_t len;
+    ReclaimRegion* owner;
+} ReclaimRange;
+
+typedef struct {
+    ReclaimRange* items;
+    size_t count;
+    size_t cap;
+} ReclaimRanges;
+
+static int push_range(ReclaimRanges* ranges, uint64_t start, uint64_t len, ReclaimRegion* owner) {
+    if (ranges->count > 0) {
+        ReclaimRange* last = &ranges->items[ranges->count - 1];
+        if (last->owner == owner && last->start + last->len == start) {
+            last->len += len;
+            return 0;
+        }
+    }
+    if (ranges->count == ranges->cap) {
+        size_t grown = ranges->cap ? ranges->cap * 2 : 1024;
+        ReclaimRange* items = realloc(ranges->items, grown * sizeof(ReclaimRange));
+        if (items == NULL) return -1;
+        ranges->items = items;
+        ranges->cap = grown;
+    }
+    ranges->items[ranges->count++] = (ReclaimRange){ start, len, owner };
+    return 0;
+}
+
+// Kernels without CONFIG_MEM_SOFT_DIRTY accept clear_refs 4 but never set
+// the bit, so the probe writes a page of vmd's own after clearing it
+static int soft_dirty_supported(void) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    volatile char* page = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) return 0;
+    page[0] = 1;
+
+    uint64_t entry = 0;
+    int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    int pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    if (fd >= 0 && pagemap >= 0 && write(fd, "4", 1) == 1) {
+        page[0] = 2;
+        if (pread(pagemap, &entry, sizeof(entry), (off_t)((uintptr_t)page / page_size * sizeof(entry))) != sizeof(entry))
+            entry = 0;
+    }
+    if (fd >= 0) close(fd);
+    if (pagemap >= 0) close(pagemap);
+    munmap((void*)page, page_size);
+    return (entry & PM_SOFT_DIRTY) != 0;
+}
+
+// Present pages of r not written since clear_refs, up to remaining bytes
+static void select_pages(ReclaimRegion* r, int pagemap, int track_writes, size_t page_size,
+                         size_t remaining, ReclaimRanges* ranges) {
+    static uint64_t entries[RECLAIM_PAGEMAP_BATCH];
+    uint64_t addr = r->start;
+    while (addr < r->end && r->advise_bytes + page_size <= remaining) {
+        size_t pages = (r->end - addr) / page_size;
+        if (pages > RECLAIM_PAGEMAP_BATCH) pages = RECLAIM_PAGEMAP_BATCH;
+        ssize_t n = pread(pagemap, entries, pages * sizeof(uint64_t), (off_t)(addr / page_size * sizeof(uint64_t)));
+        if (n <= 0) break;
+        pages = (size_t)n / sizeof(uint64_t);
+        for (size_t k = 0; k < pages && r->advise_bytes + page_size <= remaining; k++) {
+            if (!(entries[k] & PM_PRESENT)) continue;
+            if (track_writes && (entries[k] & PM_SOFT_DIRTY)) {
+                r->written_bytes += page_size;
+                continue;
+            }
+            if (push_range(ranges, addr + k * page_size, page_size, r) != 0) return;
+            r->advise_bytes += page_size;
+        }
+        addr += pages * page_size;
+    }
+}
+
+// Coldest regions first until the budget is spent. With soft-dirty only
+// the pages left unwritten are taken. Without it nothing tells hot pages
+// of a region from cold ones, so only regions with no referenced page at
+// all are eligible
+static int select_ranges(ReclaimRegion* regions, int count, const ReclaimOptions* opts, int pagemap,
+                         int track_writes, ReclaimRanges* ranges, size_t* selected) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    int chosen = 0;
+    *selected = 0;
+
+    qsort(regions, count, sizeof(ReclaimRegion), compare_idle);
+    for (int i = 0; i < count; i++) {
+        ReclaimRegion* r = &regions[i];
+        if (r->rss_kb < RECLAIM_MIN_RSS_KB || (double)idle_kb(r) < opts->min_idle * r->rss_kb) continue;
+        if (!track_writes && r->referenced_kb > 0) continue;
+        size_t remaining = opts->budget_bytes - *selected;
+        if (remaining < page_size) break;
+
+        if (pagemap >= 0) {
+            select_pages(r, pagemap, track_writes, page_size, remaining, ranges);
+        } else {
+            size_t rss = r->rss_kb * 1024, len = r->end - r->start;
+            if (rss > remaining) len = (size_t)((double)len * remaining / rss + page_size - 1) / page_size * page_size;
+            if (len > r->end - r->start) len = r->end - r->start;
+            r->advise_bytes = rss < remaining ? rss : remaining;
+            push_range(ranges, r->start, len, r);
+        }
+        *selected += r->advise_bytes;
+        if (r->advise_bytes > 0) chosen++;
+    }
+    return chosen;
+}
+
+typedef struct {
+    struct iovec iov[RECLAIM_MAX_IOV];
+    ReclaimRegion* owner[RECLAIM_MAX_IOV];
+    int count;
+    size_t bytes;
+} ReclaimBatch;
+
+static int flush_batch(int pidfd, int advice, ReclaimBatch* batch, size_t* advised) {
+    if (batch->count == 0) return 0;
+    ssize_t done = syscall(SYS_process_madvise, pidfd, batch->iov, (size_t)batch->count, advice, 0U);
+    int rc = done < 0 ? -1 : 0;
+    if (done > 0) *advised += (size_t)done;
+
+    // The kernel stops at the first failing range; earlier ones count
+    size_t left = done > 0 ? (size_t)done : 0;
+    for (int i = 0; i < batch->count; i++) {
+        if (left >= batch->iov[i].iov_len) {
+            batch->owner[i]->advised = 1;
+            left -= batch->iov[i].iov_len;
+        } else {
+            left = 0;
+        }
+    }
+    batch->count = 0;
+    batch->bytes = 0;
+    return rc;
+}
+
+// Advises the selected ranges in batches of at most rate_bytes per second,
+// checking PSI before each batch
+static const char* apply_advice(pid_t pid, const ReclaimRanges* ranges, const ReclaimOptions* opts,
+                                const char* cgroup, size_t* advised, int* err) {
+    int advice = opts->mode == RECLAIM_COLD ? MADV_COLD : MADV_PAGEOUT;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    static ReclaimBatch batch;
+    const char* stopped = NULL;
+
+    *advised = 0;
+    *err = 0;
+    int pidfd = (int)syscall(SYS_pidfd_open, pid, 0U);
+    if (pidfd < 0) {
+        *err = errno;
+        return "pidfd_open";
+    }
+
+    batch.count = 0;
+    batch.bytes = 0;
+    unsigned long long window = monotonic_ns();
+    for (size_t i = 0; i < ranges->count && stopped == NULL; i++) {
+        const ReclaimRange* range = &ranges->items[i];
+        uint64_t addr = range->start, end = range->start + range->len;
+
+        while (addr < end && stopped == NULL) {
+            size_t len = end - addr;
+            if (opts->rate_bytes > 0) {
+                size_t room = opts->rate_bytes > batch.bytes ? (opts->rate_bytes - batch.bytes) / page_size * page_size : 0;
+                if (room < page_size) room = page_size;
+                if (len > room) len = room;
+            }
+            batch.iov[batch.count].iov_base = (void*)(uintptr_t)addr;
+            batch.iov[batch.count].iov_len = len;
+            batch.owner[batch.count] = range->owner;
+            batch.count++;
+            batch.bytes += len;
+            addr += len;
+
+            int last = i + 1 == ranges->count && addr == end;
+            int full = batch.count == RECLAIM_MAX_IOV || (opts->rate_bytes > 0 && batch.bytes + page_size > opts->rate_bytes);
+            if (!full && !last) continue;
+            if (current_psi_avg10(cgroup) > opts->max_psi) {
+                stopped = "psi";
+            } else if (flush_batch(pidfd, advice, &batch, advised) != 0) {
+                *err = errno;
+                stopped = "process_madvise";
+            } else if (opts->rate_bytes > 0 && !last) {
+                unsigned long long elapsed = monotonic_ns() - window;
+                if (elapsed < 1000000000ULL) sleep_ns(1000000000ULL - elapsed);
+                window = monotonic_ns();
+            }
+        }
+    }
+    close(pidfd);
+    return stopped;
+}
+
+static void print_json_string(const char* s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') printf("\\%c", *s);
+        else if ((unsigned char)*s < 0x20) printf("\\u%04x", *s);
+        else putchar(*s);
+    }
+    putchar('"');
+}
+
+static double per_second(unsigned long long delta, unsigned long long ns) {
+    return ns ? delta * 1e9 / ns : 0;
+}
+
+static void output_window(const char* name, const ReclaimSample* from, const ReclaimSample* to) {
+    unsigned long long ns = to->taken_ns - from->taken_ns;
+    printf("    \"%s\": {\"seconds\": %.2f, \"major_faults_per_s\": %.2f, \"refaults_anon_per_s\": %.2f, "
+           "\"refaults_file_per_s\": %.2f, \"psi_some_percent\": %.3f}",
+           name, ns / 1e9, per_second(to->major_faults - from->major_faults, ns),
+           per_second(to->refault_anon - from->refault_anon, ns),
+           per_second(to->refault_file - from->refault_file, ns),
+           ns ? (to->psi_some_us - from->psi_some_us) * 1e5 / ns : 0.0);
+}
+
+static void output_memory(const char* name, const ReclaimSample* s) {
+    printf("    \"%s\": {\"rss_bytes\": %zu, \"anon_bytes\": %zu, \"file_bytes\": %zu, \"swap_bytes\": %zu}",
+           name, s->rss_kb * 1024, s->anon_kb * 1024, s->file_kb * 1024, s->swap_kb * 1024);
+}
+
+void output_reclaim_json(pid_t pid, const ReclaimOptions* opts, int limit) {
+    char clear_refs[64], cgroup_dir[4096];
+    RegionIndex index;
+    ReclaimSample idle_from, idle_to, acted, settled;
+
+    snprintf(clear_refs, sizeof(clear_refs), "/proc/%d/clear_refs", (int)pid);
+    if (pid <= 0 || (kill(pid, 0) != 0 && errno == ESRCH)) {
+        printf("{\n  \"error\": \"no process %d\"\n}\n", (int)pid);
+        return;
+    }
+    // A snapshot of Referenced says nothing about how recently a page was
+    // used, which is too little to act on
+    if (opts->mode != RECLAIM_DRY_RUN && !opts->clear_refs) {
+        printf("{\n  \"error\": \"%s needs clear_refs=1 to measure idleness\"\n}\n", g_mode_names[opts->mode]);
+        return;
+    }
+    if (region_index_build(&index, pid) != 0) {
+        printf("{\n  \"error\": \"cannot read maps of pid %d\"\n}\n", (int)pid);
+        return;
+    }
+    const char* cgroup = target_cgroup(pid, cgroup_dir, sizeof(cgroup_dir)) == 0 ? cgroup_dir : NULL;
+
+    // 1 clears the accessed bits of every page, 4 the soft-dirty bits that
+    // pagemap reports for pages written afterwards
+    int track_writes = 0;
+    if (opts->clear_refs) {
+        int fd = open(clear_refs, O_WRONLY | O_CLOEXEC);
+        if (fd < 0 || write(fd, "1", 1) != 1) {
+            printf("{\n  \"error\": \"cannot clear referenced bits of pid %d: %s\"\n}\n", (int)pid, strerror(errno));
+            if (fd >= 0) close(fd);
+            region_index_free(&index);
+            return;
+        }
+        track_writes = soft_dirty_supported() && write(fd, "4", 1) == 1;
+        close(fd);
+    }
+    take_sample(pid, cgroup, &idle_from);
+    if (opts->clear_refs) sleep_ns((unsigned long long)opts->idle_s * 1000000000ULL);
+    take_sample(pid, cgroup, &idle_to);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)pid);
+    int pagemap = open(path, O_RDONLY | O_CLOEXEC);
+    ReclaimRegion* regions = NULL;
+    ReclaimRanges ranges = { NULL, 0, 0 };
+    int count = 0;
+    size_t selected = 0, advised = 0;
+    read_regions(pid, &index, &regions, &count);
+    int chosen = select_ranges(regions, count, opts, pagemap, track_writes, &ranges, &selected);
+    if (pagemap >= 0) close(pagemap);
+
+    const char* stopped = NULL;
+    int err = 0;
+    if (opts->mode != RECLAIM_DRY_RUN && chosen > 0) {
+        stopped = apply_advice(pid, &ranges, opts, cgroup, &advised, &err);
+        take_sample(pid, cgroup, &acted);
+        sleep_ns((unsigned long long)opts->settle_s * 1000000000ULL);
+        take_sample(pid, cgroup, &settled);
+    }
+
+    printf("{\n");
+    printf("  \"pid\": %d,\n", (int)pid);
+    printf("  \"mode\": \"%s\",\n", g_mode_names[opts->mode]);
+    printf("  \"options\": {\"idle_s\": %u, \"settle_s\": %u, \"budget_bytes\": %zu, \"rate_bytes_per_s\": %zu, "
+           "\"min_idle\": %.2f, \"max_psi\": %.2f, \"clear_refs\": %s},\n",
+           opts->idle_s, opts->settle_s, opts->budget_bytes, opts->rate_bytes, opts->min_idle, opts->max_psi,
+           opts->clear_refs ? "true" : "false");
+    printf("  \"idle_source\": \"%s\",\n", opts->clear_refs ? "window" : "snapshot");
+    printf("  \"scope\": \"%s\",\n", cgroup ? "cgroup" : "system");
+    printf("  \"granularity\": \"%s\",\n", !track_writes ? "idle_regions" : pagemap < 0 ? "region" : "unwritten_pages");
+    printf("  \"candidates\": %d,\n", count);
+    printf("  \"selected\": %d,\n", chosen);
+    printf("  \"ranges\": %zu,\n", ranges.count);
+    printf("  \"selected_bytes\": %zu,\n", selected);
+    printf("  \"advised_bytes\": %zu,\n", advised);
+    if (stopped != NULL) {
+        printf("  \"stopped\": {\"reason\": \"%s\"", stopped);
+        if (err) printf(", \"error\": \"%s\"", strerror(err));
+        printf("},\n");
+    }
+
+    printf("  \"regions\": [");
+    int shown = 0;
+    for (int i = 0; i < count && shown < limit; i++) {
+        ReclaimRegion* r = &regions[i];
+        if (r->advise_bytes == 0) continue;
+        printf("%s\n    {\"start\": \"0x%llx\", \"end\": \"0x%llx\", \"kind\": \"%s\", \"name\": ",
+               shown++ ? "," : "", (unsigned long long)r->start, (unsigned long long)r->end, region_kind_name(r->kind));
+        print_json_string(index.strings + r->name);
+        printf(", \"rss\": %zu, \"referenced\": %zu, \"written\": %zu, \"swap\": %zu, \"advise_bytes\": %zu, \"advised\": %s}",
+               r->rss_kb * 1024, r->referenced_kb * 1024, r->written_bytes, r->swap_kb * 1024, r->advise_bytes,
+               r->advised ? "true" : "false");
+    }
+    printf("%s]", shown ? "\n  " : "");
+
+    if (opts->mode != RECLAIM_DRY_RUN && chosen > 0) {
+        printf(",\n  \"result\": {\n");
+        output_memory("before", &idle_to);
+        printf(",\n");
+        output_memory("after_advice", &acted);
+        printf(",\n");
+        output_memory("after_settle", &settled);
+        printf(",\n    \"rss_reduction_bytes\": %lld,\n",
+               (long long)idle_to.rss_kb * 1024 - (long long)settled.rss_kb * 1024);
+        output_window("idle_window", &idle_from, &idle_to);
+        printf(",\n");
+        output_window("settle_window", &acted, &settled);
+        printf("\n  }");
+    }
+    printf("\n}\n");
+
+    free(ranges.items);
+    free(regions);
+    region_index_free(&index);
+}
@@ -0,0 +1,49 @@
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// With clear_refs set, idle regions are found by clearing the target's
+// referenced and soft-dirty bits through /proc/pid/clear_refs, then
+// reading smaps Referenced after idle_s seconds. That resets state the
+// target's LRU and tools such as CRIU rely on, so it is opt-in, and cold
+// and pageout require it. Without it a dry run only reads a snapshot of
+// Referenced, which covers accesses since whoever last cleared the bits.
+// Within an idle region only pages that pagemap shows present and
+// unwritten are advised; without soft-dirty only regions with no
+// referenced page are.
+#define RECLAIM_DEFAULT_IDLE_S 10
+#define RECLAIM_DEFAULT_SETTLE_S 10
+#define RECLAIM_DEFAULT_BUDGET_MB 256
+#define RECLAIM_DEFAULT_MIN_IDLE 0.9    // Share of a region's RSS left unreferenced
+#define RECLAIM_DEFAULT_MAX_PSI 10.0    // Stop advising above this PSI some avg10
+#define RECLAIM_MIN_RSS_KB 64           // Smaller regions are not worth a syscall
+#define RECLAIM_MAX_IOV 512
+#define RECLAIM_PAGEMAP_BATCH 1024
+#define RECLAIM_DEFAULT_TOP 50
+
+typedef enum {
+    RECLAIM_DRY_RUN,
+    RECLAIM_COLD,                   // MADV_COLD: deactivate, reclaim later
+    RECLAIM_PAGEOUT                 // MADV_PAGEOUT: reclaim now
+} ReclaimMode;
+
+typedef struct {
+    ReclaimMode mode;
+    unsigned int idle_s;
+    unsigned int settle_s;
+    size_t budget_bytes;            // Resident bytes advised in total
+    size_t rate_bytes;              // Per second, 0 = unlimited
+    double min_idle;
+    double max_psi;
+    int clear_refs;                 // Measure idleness over idle_s; writes the target's clear_refs
+} ReclaimOptions;
+
+void reclaim_default_options(ReclaimOptions* opts);
+int parse_reclaim_mode(const char* name, ReclaimMode* mode);
+// Finds idle regions of pid, advises them unless dry-running, then
+// measures RSS, refaults and memory PSI over settle_s
+void output_reclaim_json(pid_t pid, const ReclaimOptions* opts, int limit);
+
+#endif
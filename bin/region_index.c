@@ -0,0 +1,308 @@
+#define _GNU_SOURCE
+#include "region_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#define REGION_KIND_NAME(id, name) name,
+static const char* g_kind_names[REGION_NUM_KINDS] = { REGION_KINDS(REGION_KIND_NAME) };
+#undef REGION_KIND_NAME
+
+const char* region_kind_name(RegionKind kind) {
+    return kind < REGION_NUM_KINDS ? g_kind_names[kind] : "unknown";
+}
+
+int parse_region_kinds(const char* names, uint32_t* mask) {
+    *mask = 0;
+    while (*names) {
+        size_t len = strcspn(names, ",");
+        int found = 0;
+        for (int k = 0; k < REGION_NUM_KINDS; k++) {
+            if (strlen(g_kind_names[k]) == len && strncmp(names, g_kind_names[k], len) == 0) {
+                *mask |= 1u << k;
+                found = 1;
+            }
+        }
+        if (!found && len > 0) return -1;
+        names += len + (names[len] == ',');
+    }
+    return 0;
+}
+
+void region_query_init(RegionQuery* query) {
+    memset(query, 0, sizeof(*query));
+    query->end = UINT64_MAX;
+}
+
+static int grow(RegionIndex* index, size_t* cap) {
+    size_t grown = *cap ? *cap * 2 : 256;
+    uint64_t* starts = realloc(index->starts, grown * sizeof(uint64_t));
+    if (starts) index->starts = starts;
+    uint64_t* ends = realloc(index->ends, grown * sizeof(uint64_t));
+    if (ends) index->ends = ends;
+    uint32_t* names = realloc(index->names, grown * sizeof(uint32_t));
+    if (names) index->names = names;
+    uint8_t* kinds = realloc(index->kinds, grown);
+    if (kinds) index->kinds = kinds;
+    uint8_t* perms = realloc(index->perms, grown);
+    if (perms) index->perms = perms;
+    if (!starts || !ends || !names || !kinds || !perms) return -1;
+    *cap = grown;
+    return 0;
+}
+
+// Consecutive VMAs of one file share its name, so only the previous name
+// is checked before appending to the string table
+static uint32_t intern_name(RegionIndex* index, size_t* used, size_t* cap, const char* name, uint32_t prev) {
+    if (*name == '\0') return 0;
+    if (prev && strcmp(index->strings + prev, name) == 0) return prev;
+
+    size_t len = strlen(name) + 1;
+    if (*used + len > *cap) {
+        size_t grown = *cap * 2;
+        while (grown < *used + len) grown *= 2;
+        char* strings = realloc(index->strings, grown);
+        if (strings == NULL) return 0;
+        index->strings = strings;
+        *cap = grown;
+    }
+    memcpy(index->strings + *used, name, len);
+    *used += len;
+    return (uint32_t)(*used - len);
+}
+
+static int anonymous_shm(const char* name) {
+    return *name == '\0' || strncmp(name, "/dev/zero", 9) == 0 ||
+           strncmp(name, "/SYSV", 5) == 0 || strncmp(name, "/dev/shm/", 9) == 0 ||
+           strncmp(name, "/memfd:", 7) == 0;
+}
+
+static RegionKind classify(const char* name, int perms, unsigned long inode) {
+    if (name[0] == '[') {
+        if (strcmp(name, "[heap]") == 0) return REGION_KIND_HEAP;
+        if (strncmp(name, "[stack", 6) == 0) return REGION_KIND_STACK;
+        if (strcmp(name, "[vdso]") == 0) return REGION_KIND_VDSO;
+        if (strncmp(name, "[vvar", 5) == 0) return REGION_KIND_VVAR;
+        if (strcmp(name, "[vsyscall]") == 0) return REGION_KIND_VSYSCALL;
+        if (strncmp(name, "[anon", 5) != 0) return REGION_KIND_SPECIAL;
+    }
+    if (perms & REGION_PERM_SHARED) return anonymous_shm(name) ? REGION_KIND_SHM : REGION_KIND_FILE_SHARED;
+    if (!(perms & (REGION_PERM_READ | REGION_PERM_WRITE | REGION_PERM_EXEC))) return REGION_KIND_GUARD;
+    if (inode != 0 || name[0] == '/') {
+        if (perms & REGION_PERM_EXEC) return REGION_KIND_TEXT;
+        return (perms & REGION_PERM_WRITE) ? REGION_KIND_DATA : REGION_KIND_RODATA;
+    }
+    return REGION_KIND_ANON;
+}
+
+// Parses "start-end perms offset dev inode name"; name points into line
+static int parse_maps_line(char* line, uint64_t* start, uint64_t* end, int* perms,
+                           unsigned long* inode, const char** name) {
+    char* p;
+    *start = strtoull(line, &p, 16);
+    if (*p++ != '-') return -1;
+    *end = strtoull(p, &p, 16);
+    if (*p++ != ' ' || strlen(p) < 4) return -1;
+    *perms = (p[0] == 'r' ? REGION_PERM_READ : 0) | (p[1] == 'w' ? REGION_PERM_WRITE : 0) |
+             (p[2] == 'x' ? REGION_PERM_EXEC : 0) | (p[3] == 's' ? REGION_PERM_SHARED : 0);
+    p += 4;
+    strtoull(p, &p, 16);            // offset
+    while (*p == ' ') p++;
+    p += strcspn(p, " ");           // dev
+    *inode = strtoul(p, &p, 10);
+    while (*p == ' ') p++;
+    p[strcspn(p, "\n")] = '\0';
+    *name = p;
+    return 0;
+}
+
+static int is_anon_rw(const RegionIndex* index, size_t i) {
+    return index->kinds[i] == REGION_KIND_ANON &&
+           (index->perms[i] & (REGION_PERM_READ | REGION_PERM_WRITE)) == (REGION_PERM_READ | REGION_PERM_WRITE);
+}
+
+static int adjacent_guard(const RegionIndex* index, size_t i) {
+    return i < index->count && index->kinds[i] == REGION_KIND_GUARD && index->names[i] == 0;
+}
+
+// A thread arena heap is an aligned REGION_ARENA_SIZE reservation whose used
+// part is read-write and the rest a ---p guard right after it. Zero-filled
+// anonymous memory right after a file's data segment is its bss.
+static void mark_arenas_and_bss(RegionIndex* index) {
+    for (size_t i = 0; i < index->count; i++) {
+        if (!is_anon_rw(index, i)) continue;
+        uint64_t start = index->starts[i], end = index->ends[i];
+        if (start % REGION_ARENA_SIZE == 0) {
+            int whole = end - start == REGION_ARENA_SIZE;
+            int guarded = adjacent_guard(index, i + 1) && index->starts[i + 1] == end &&
+                          index->ends[i + 1] - start == REGION_ARENA_SIZE;
+            if (whole || guarded) {
+                index->kinds[i] = REGION_KIND_ARENA;
+                continue;
+            }
+        }
+        if (i > 0 && index->kinds[i - 1] == REGION_KIND_DATA && index->ends[i - 1] == start && index->names[i] == 0)
+            index->kinds[i] = REGION_KIND_BSS;
+    }
+}
+
+// The stack pointer is the second to last field of /proc/pid/task/tid/syscall
+// for threads in or blocked outside a syscall; running threads print "running"
+static int read_thread_sp(pid_t pid, const char* tid, uint64_t* sp) {
+    char path[300], buf[256];
+    snprintf(path, sizeof(path), "/proc/%d/task/%s/syscall", (int)pid, tid);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return -1;
+    char* line = fgets(buf, sizeof(buf), f);
+    fclose(f);
+    if (line == NULL) return -1;
+
+    uint64_t fields[9];
+    int n = 0;
+    char* p = buf;
+    while (n < 9) {
+        char* next;
+        unsigned long long v = strtoull(p, &next, 0);
+        if (next == p) break;
+        fields[n++] = v;
+        p = next;
+    }
+    if (n < 3) return -1;
+    *sp = fields[n - 2];
+    return 0;
+}
+
+static void mark_thread_stacks(RegionIndex* index, pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    DIR* dir = opendir(path);
+    int found = 0;
+    if (dir != NULL) {
+        struct dirent* de;
+        while ((de = readdir(dir)) != NULL) {
+            uint64_t sp;
+            if (de->d_name[0] < '0' || de->d_name[0] > '9' || read_thread_sp(pid, de->d_name, &sp) != 0) continue;
+            found = 1;
+            long i = region_index_lookup(index, sp);
+            if (i >= 0 && (index->kinds[i] == REGION_KIND_ANON || index->kinds[i] == REGION_KIND_BSS))
+                index->kinds[i] = REGION_KIND_THREAD_STACK;
+        }
+        closedir(dir);
+    }
+    if (found) return;
+
+    // glibc puts the guard below the stack, the other way round from arenas
+    for (size_t i = 1; i < index->count; i++) {
+        if (is_anon_rw(index, i) && adjacent_guard(index, i - 1) && index->ends[i - 1] == index->starts[i] &&
+            index->ends[i] - index->starts[i] <= REGION_THREAD_STACK_MAX)
+            index->kinds[i] = REGION_KIND_THREAD_STACK;
+    }
+}
+
+static int build_fences(RegionIndex* index) {
+    index->num_fences = (index->count + REGION_INDEX_FANOUT - 1) / REGION_INDEX_FANOUT;
+    index->fences = malloc((index->num_fences ? index->num_fences : 1) * sizeof(uint64_t));
+    if (index->fences == NULL) return -1;
+    for (size_t f = 0; f < index->num_fences; f++) {
+        index->fences[f] = index->starts[f * REGION_INDEX_FANOUT];
+    }
+    return 0;
+}
+
+int region_index_build(RegionIndex* index, pid_t pid) {
+    char path[64];
+    char* line = NULL;
+    size_t line_cap = 0, cap = 0, strings_used = 1, strings_cap = 4096;
+
+    memset(index, 0, sizeof(*index));
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+    FILE* maps = fopen(path, "r");
+    if (maps == NULL) return -1;
+    setvbuf(maps, NULL, _IOFBF, 1 << 16);
+
+    index->strings = calloc(1, strings_cap);
+    uint32_t prev_name = 0;
+    while (index->strings != NULL && getline(&line, &line_cap, maps) > 0) {
+        uint64_t start, end;
+        unsigned long inode;
+        int perms;
+        const char* name;
+        if (parse_maps_line(line, &start, &end, &perms, &inode, &name) != 0) continue;
+        if (index->count == cap && grow(index, &cap) != 0) break;
+
+        size_t i = index->count++;
+        index->starts[i] = start;
+        index->ends[i] = end;
+        index->perms[i] = (uint8_t)perms;
+        index->kinds[i] = (uint8_t)classify(name, perms, inode);
+        index->names[i] = prev_name = intern_name(index, &strings_used, &strings_cap, name, prev_name);
+    }
+    free(line);
+    fclose(maps);
+    if (index->strings == NULL || index->count == 0 || build_fences(index) != 0) {
+        region_index_free(index);
+        return -1;
+    }
+
+    mark_arenas_and_bss(index);
+    mark_thread_stacks(index, pid);
+    return 0;
+}
+
+void region_index_free(RegionIndex* index) {
+    free(index->starts);
+    free(index->ends);
+    free(index->names);
+    free(index->kinds);
+    free(index->perms);
+    free(index->strings);
+    free(index->fences);
+    memset(index, 0, sizeof(*index));
+}
+
+long region_index_lookup(const RegionIndex* index, uint64_t addr) {
+    size_t n = index->num_fences;
+    if (n == 0 || addr < index->fences[0]) return -1;
+
+    // Branch-free search for the last fence <= addr
+    const uint64_t* base = index->fences;
+    while (n > 1) {
+        size_t half = n / 2;
+        base = base[half] <= addr ? base + half : base;
+        n -= half;
+    }
+
+    // Within the block every start <= addr moves the candidate forward
+    size_t first = (size_t)(base - index->fences) * REGION_INDEX_FANOUT;
+    size_t last = first + REGION_INDEX_FANOUT < index->count ? first + REGION_INDEX_FANOUT : index->count;
+    size_t i = first;
+    for (size_t j = first + 1; j < last; j++) {
+        i += index->starts[j] <= addr;
+    }
+    return addr < index->ends[i] ? (long)i : -1;
+}
+
+size_t region_index_seek(const RegionIndex* index, uint64_t addr) {
+    size_t lo = 0, hi = index->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->ends[mid] <= addr) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void region_index_lookup_batch(const RegionIndex* index, const uint64_t* addrs, size_t n, int32_t* out) {
+    long prev = -1;
+    for (size_t k = 0; k < n; k++) {
+        uint64_t addr = addrs[k];
+        if (prev >= 0 && addr >= index->starts[prev] && addr < index->ends[prev]) {
+            out[k] = (int32_t)prev;
+            continue;
+        }
+        long i = region_index_lookup(index, addr);
+        out[k] = (int32_t)i;
+        if (i >= 0) prev = i;
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef REGION_INDEX_H
+#define REGION_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// Starts are grouped in blocks of REGION_INDEX_FANOUT; a lookup binary
+// searches the block fences, then scans one block of the starts array
+#define REGION_INDEX_FANOUT 16
+// Anonymous rw-p mappings right above a ---p guard are taken for thread
+// stacks when the threads' stack pointers cannot be read
+#define REGION_THREAD_STACK_MAX (64UL << 20)
+// glibc aligns every non-main arena heap to this size on 64-bit
+#define REGION_ARENA_SIZE (64UL << 20)
+
+#define REGION_KINDS(X) \
+    X(HEAP, "heap") \
+    X(STACK, "stack") \
+    X(THREAD_STACK, "thread_stack") \
+    X(ARENA, "arena") \
+    X(TEXT, "text") \
+    X(RODATA, "rodata") \
+    X(DATA, "data") \
+    X(BSS, "bss") \
+    X(FILE_SHARED, "file_shared") \
+    X(SHM, "shm") \
+    X(ANON, "anon") \
+    X(GUARD, "guard") \
+    X(VDSO, "vdso") \
+    X(VVAR, "vvar") \
+    X(VSYSCALL, "vsyscall") \
+    X(SPECIAL, "special")
+
+#define REGION_KIND_ENUM(id, name) REGION_KIND_##id,
+typedef enum {
+    REGION_KINDS(REGION_KIND_ENUM)
+    REGION_NUM_KINDS
+} RegionKind;
+#undef REGION_KIND_ENUM
+
+// Same bits as MemoryRegion.permissions, plus shared
+#define REGION_PERM_EXEC 0x1
+#define REGION_PERM_WRITE 0x2
+#define REGION_PERM_READ 0x4
+#define REGION_PERM_SHARED 0x8
+
+// Every VMA of a process in address order, one array per field
+typedef struct {
+    uint64_t* starts;
+    uint64_t* ends;
+    uint32_t* names;                // Offsets into strings, 0 = none
+    uint8_t* kinds;
+    uint8_t* perms;
+    char* strings;                  // Offset 0 is the empty string
+    size_t count;
+    uint64_t* fences;               // starts[i * REGION_INDEX_FANOUT]
+    size_t num_fences;
+} RegionIndex;
+
+// Reads /proc/pid/maps and classifies every VMA; 0 on success
+int region_index_build(RegionIndex* index, pid_t pid);
+void region_index_free(RegionIndex* index);
+// Index of the VMA containing addr, or -1 when addr falls in a gap
+long region_index_lookup(const RegionIndex* index, uint64_t addr);
+// Lookup of n addresses; runs of addresses in one VMA skip the search
+void region_index_lookup_batch(const RegionIndex* index, const uint64_t* addrs, size_t n, int32_t* out);
+// First VMA that ends above addr, or count when none does
+size_t region_index_seek(const RegionIndex* index, uint64_t addr);
+const char* region_kind_name(RegionKind kind);
+// Comma-separated kind names to a mask of 1 << kind; 0 on success
+int parse_region_kinds(const char* names, uint32_t* mask);
+
+// Address-range query over the VMAs of a process, shared by the page
+// table and region listings. A truncated result hands back a cursor, the
+// address to resume from, which clients pass back as is.
+typedef struct {
+    pid_t pid;                      // 0 = vmd itself
+    uint64_t start;
+    uint64_t end;                   // Exclusive
+    uint32_t kinds;                 // 0 = every kind
+    uint64_t stride;                // Bytes per page table tile, 0 = the default
+    int limit;                      // 0 = the listing's default
+} RegionQuery;
+
+void region_query_init(RegionQuery* query);
+
+static inline const char* region_index_name(const RegionIndex* index, size_t i) {
+    return index->strings + index->names[i];
+}
+
+static inline int region_query_kind_match(const RegionQuery* query, const RegionIndex* index, size_t i) {
+    return query->kinds == 0 || (query->kinds & (1u << index->kinds[i])) != 0;
+}
+
+#endif
@@ -0,0 +1,335 @@
+#define _GNU_SOURCE
+#include "scheduler.h"
+#include "memory_types.h"
+#include "memory_analysis.h"
+#include "page_table.h"
+#include "memory_hierarchy.h"
+#include "self_stats.h"
+#include "process_scan.h"
+#include "swap.h"
+#include "vmstat.h"
+#include "history.h"
+#include "metrics.h"
+#include "anomaly.h"
+#include "schema.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+extern MemoryAnalytics g_analytics;
+extern pthread_mutex_t g_analytics_mutex;
+
+static volatile sig_atomic_t g_stop = 0;
+static pthread_mutex_t g_sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_sched_wakeup;
+static double g_pressure_avg10 = -1;
+
+static unsigned long fnv_mix(unsigned long h, unsigned long value) {
+    return (h ^ value) * 1099511628211UL;
+}
+
+static int collect_analytics(void) {
+    update_analytics();
+    return 0;
+}
+
+static unsigned long fingerprint_analytics(void) {
+    // MB / percent granularity so measurement noise does not count as change
+    pthread_mutex_lock(&g_analytics_mutex);
+    unsigned long h = 1469598103934665603UL;
+    h = fnv_mix(h, g_analytics.total_memory >> 20);
+    h = fnv_mix(h, g_analytics.free_memory >> 20);
+    h = fnv_mix(h, (unsigned long)(g_analytics.pressure_score * 100));
+    h = fnv_mix(h, (unsigned long)g_analytics.swap_usage_percent);
+    pthread_mutex_unlock(&g_analytics_mutex);
+    return h;
+}
+
+static int collect_pagemap(void) {
+    free(g_analytics.page_table_entries);
+    g_analytics.page_table_entries = NULL;
+    g_analytics.num_entries = 0;
+    get_page_table_info(NULL);
+    return g_analytics.page_table_entries != NULL ? 0 : -1;
+}
+
+static unsigned long fingerprint_pagemap(void) {
+    unsigned long h = 1469598103934665603UL;
+    for (int i = 0; i < g_analytics.num_entries; i++) {
+        PageTableEntry* entry = &g_analytics.page_table_entries[i];
+        h = fnv_mix(h, entry->virtual_addr | entry->is_present | (entry->is_dirty << 1));
+    }
+    return h;
+}
+
+static int collect_hierarchy(void) {
+    for (int i = 0; i < g_analytics.num_regions; i++) {
+        free(g_analytics.memory_regions[i].mapped_file);
+    }
+    free(g_analytics.memory_regions);
+    g_analytics.memory_regions = NULL;
+    g_analytics.num_regions = 0;
+    analyze_memory_hierarchy(NULL);
+    return g_analytics.memory_regions != NULL ? 0 : -1;
+}
+
+static unsigned long fingerprint_hierarchy(void) {
+    unsigned long h = 1469598103934665603UL;
+    for (int i = 0; i < g_analytics.num_regions; i++) {
+        MemoryRegion* region = &g_analytics.memory_regions[i];
+        h = fnv_mix(h, region->start_addr);
+        h = fnv_mix(h, region->end_addr | region->permissions);
+    }
+    return h;
+}
+
+static int collect_processes(void) {
+    if (scan_processes() <= 0) return -1;
+    anomaly_process_sample();
+    history_record_processes();
+    history_record_cgroups();
+    return 0;
+}
+
+static unsigned long fingerprint_processes(void) {
+    ProcessStats top[PROC_SCAN_DEFAULT_TOP];
+    int count = top_processes(top, PROC_SCAN_DEFAULT_TOP, PROC_SORT_RSS);
+    unsigned long h = 1469598103934665603UL;
+    for (int i = 0; i < count; i++) {
+        h = fnv_mix(h, (unsigned long)top[i].pid);
+        h = fnv_mix(h, top[i].rss >> 20);
+    }
+    return h;
+}
+
+// Table order is priority order within a lane
+static Collector g_collectors[] = {
+    { .name = "analytics", .lane = SCHED_LANE_FAST, .base_period_ms = 1000, .max_period_ms = 10000,
+      .budget_us = 2000, .run = collect_analytics, .fingerprint = fingerprint_analytics },
+    { .name = "hierarchy", .lane = SCHED_LANE_BACKGROUND, .base_period_ms = 5000, .max_period_ms = 60000,
+      .budget_us = 20000, .run = collect_hierarchy, .fingerprint = fingerprint_hierarchy },
+    { .name = "pagemap", .lane = SCHED_LANE_BACKGROUND, .base_period_ms = 5000, .max_period_ms = 120000,
+      .budget_us = 50000, .run = collect_pagemap, .fingerprint = fingerprint_pagemap },
+    { .name = "processes", .lane = SCHED_LANE_BACKGROUND, .base_period_ms = 5000, .max_period_ms = 30000,
+      .budget_us = 100000, .run = collect_processes, .fingerprint = fingerprint_processes },
+};
+#define NUM_COLLECTORS (sizeof(g_collectors) / sizeof(g_collectors[0]))
+
+static unsigned long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void handle_stop(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+// PSI "some avg10" for memory, or -1 when the kernel lacks PSI
+static double read_memory_pressure(void) {
+    static int fd = -1;
+    char buf[256];
+    double avg10;
+
+    if (fd < 0) fd = open("/proc/pressure/memory", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+    return sscanf(buf, "some avg10=%lf", &avg10) == 1 ? avg10 : -1;
+}
+
+static void run_collector(Collector* c) {
+    SelfSample cost;
+    self_begin(&cost);
+    int rc = c->run();
+    self_end(c->name, &cost);
+    unsigned long fingerprint = c->fingerprint ? c->fingerprint() : 0;
+
+    pthread_mutex_lock(&g_sched_mutex);
+    c->runs++;
+    c->last_cost_us = cost.wall_ns / 1000;
+
+    if (rc == 0 && c->runs > 1 && fingerprint == c->last_fingerprint) {
+        if (++c->unchanged_runs >= SCHED_BACKOFF_AFTER) {
+            c->period_ms = c->period_ms * 2 < c->max_period_ms ? c->period_ms * 2 : c->max_period_ms;
+            c->unchanged_runs = 0;
+        }
+    } else {
+        c->unchanged_runs = 0;
+        c->period_ms = c->base_period_ms;
+    }
+    c->last_fingerprint = fingerprint;
+
+    // Over-budget collectors are stretched in proportion to their cost
+    c->budget_period_ms = c->base_period_ms;
+    if (c->budget_us > 0 && c->last_cost_us > c->budget_us) {
+        unsigned long long stretched = (unsigned long long)c->base_period_ms * c->last_cost_us / c->budget_us;
+        if (stretched > c->max_period_ms) stretched = c->max_period_ms;
+        c->budget_period_ms = (unsigned int)stretched;
+    }
+    if (c->budget_period_ms > c->period_ms) c->period_ms = c->budget_period_ms;
+    c->next_due_ns = monotonic_ns() + (unsigned long long)c->period_ms * 1000000ULL;
+    pthread_mutex_unlock(&g_sched_mutex);
+}
+
+// Under memory pressure collectors backed off for unchanged data drop back
+// to their base period; an over-budget stretch is kept, since running an
+// expensive scan more often would only add to the pressure. Returns the
+// PSI avg10 it read
+static double check_pressure(void) {
+    double avg10 = read_memory_pressure();
+    pthread_mutex_lock(&g_analytics_mutex);
+    int pressured = g_analytics.pressure_score >= 0.9;
+    pthread_mutex_unlock(&g_analytics_mutex);
+
+    pthread_mutex_lock(&g_sched_mutex);
+    g_pressure_avg10 = avg10;
+    if (avg10 >= SCHED_PRESSURE_AVG10 || pressured) {
+        unsigned long long now = monotonic_ns();
+        for (size_t i = 0; i < NUM_COLLECTORS; i++) {
+            Collector* c = &g_collectors[i];
+            unsigned int floor_ms = c->budget_period_ms > c->base_period_ms ? c->budget_period_ms : c->base_period_ms;
+            if (c->period_ms <= floor_ms) continue;
+            unsigned long long due = now + (unsigned long long)floor_ms * 1000000ULL;
+            c->period_ms = floor_ms;
+            c->unchanged_runs = 0;
+            if (c->next_due_ns > due) c->next_due_ns = due;
+        }
+        pthread_cond_broadcast(&g_sched_wakeup);
+    }
+    pthread_mutex_unlock(&g_sched_mutex);
+    return avg10;
+}
+
+static void print_monitor_line(void) {
+    struct timespec now;
+    char fields[ANALYTICS_JSON_MAX];
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    pthread_mutex_lock(&g_analytics_mutex);
+    analytics_json_members(&g_analytics, ", ", fields);
+    printf("{\"ts\": %ld.%03ld, \"analytics\": {%s}", (long)now.tv_sec, now.tv_nsec / 1000000, fields);
+    printf(", \"vmstat_rates\": {");
+    for (int c = 0; c < VMSTAT_NUM_COUNTERS; c++) {
+        printf("%s\"%s\": %.1f", c ? ", " : "", vmstat_counter_name(c), g_analytics.vmstat.rate[c]);
+    }
+    printf("}");
+    pthread_mutex_unlock(&g_analytics_mutex);
+
+    double swap_in, swap_out;
+    read_swap_rates(&swap_in, &swap_out);
+    printf(", \"swap_in_rate\": %.1f, \"swap_out_rate\": %.1f", swap_in, swap_out);
+
+    pthread_mutex_lock(&g_sched_mutex);
+    printf(", \"pressure_avg10\": %.2f, \"schedule\": {", g_pressure_avg10);
+    for (size_t i = 0; i < NUM_COLLECTORS; i++) {
+        Collector* c = &g_collectors[i];
+        printf("%s\"%s\": {\"period_ms\": %u, \"cost_us\": %llu, \"runs\": %lu}",
+               i ? ", " : "", c->name, c->period_ms, c->last_cost_us, c->runs);
+    }
+    pthread_mutex_unlock(&g_sched_mutex);
+    printf("}}\n");
+    fflush(stdout);
+}
+
+static void run_lane(int lane, unsigned long long deadline_ns) {
+    pthread_mutex_lock(&g_sched_mutex);
+    while (!g_stop) {
+        unsigned long long now = monotonic_ns();
+        if (deadline_ns && now >= deadline_ns) {
+            g_stop = 1;
+            break;
+        }
+
+        int ran = 0;
+        for (size_t i = 0; i < NUM_COLLECTORS && !g_stop; i++) {
+            Collector* c = &g_collectors[i];
+            if (c->lane != lane || c->next_due_ns > now) continue;
+            pthread_mutex_unlock(&g_sched_mutex);
+            run_collector(c);
+            pthread_mutex_lock(&g_sched_mutex);
+            ran = 1;
+        }
+
+        if (ran && lane == SCHED_LANE_FAST) {
+            pthread_mutex_unlock(&g_sched_mutex);
+            double avg10 = check_pressure();
+            print_monitor_line();
+            anomaly_system_sample(avg10);
+            anomaly_flush_alerts();
+            history_record_system();
+            metrics_publish();
+            pthread_mutex_lock(&g_sched_mutex);
+        }
+
+        // Sleep until the next collector in this lane is due, at most 1s
+        unsigned long long next = monotonic_ns() + 1000000000ULL;
+        for (size_t i = 0; i < NUM_COLLECTORS; i++) {
+            if (g_collectors[i].lane == lane && g_collectors[i].next_due_ns < next)
+                next = g_collectors[i].next_due_ns;
+        }
+        if (deadline_ns && next > deadline_ns) next = deadline_ns;
+        struct timespec wake = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+        pthread_cond_timedwait(&g_sched_wakeup, &g_sched_mutex, &wake);
+    }
+    pthread_cond_broadcast(&g_sched_wakeup);
+    pthread_mutex_unlock(&g_sched_mutex);
+}
+
+static void* background_lane(void* arg) {
+    (void)arg;
+    // Lower this thread's priority so scans yield to the fast lane
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+    run_lane(SCHED_LANE_BACKGROUND, 0);
+    return NULL;
+}
+
+void run_resident_monitor(unsigned int duration_s) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_sched_wakeup, &attr);
+    pthread_condattr_destroy(&attr);
+
+    init_analytics();
+    metrics_start();
+    // init_analytics took the vmstat baseline; a first run right away would
+    // divide its deltas by a few microseconds
+    unsigned long long now = monotonic_ns();
+    for (size_t i = 0; i < NUM_COLLECTORS; i++) {
+        g_collectors[i].period_ms = g_collectors[i].base_period_ms;
+        g_collectors[i].next_due_ns = now + (unsigned long long)g_collectors[i].base_period_ms * 1000000ULL;
+    }
+
+    pthread_t background;
+    int have_background = pthread_create(&background, NULL, background_lane, NULL) == 0;
+    run_lane(SCHED_LANE_FAST, duration_s ? now + duration_s * 1000000000ULL : 0);
+    if (have_background) pthread_join(background, NULL);
+    metrics_stop();
+
+    for (int i = 0; i < g_analytics.num_regions; i++) {
+        free(g_analytics.memory_regions[i].mapped_file);
+    }
+    free(g_analytics.memory_regions);
+    free(g_analytics.page_table_entries);
+    g_analytics.memory_regions = NULL;
+    g_analytics.page_table_entries = NULL;
+    g_analytics.num_regions = 0;
+    g_analytics.num_entries = 0;
+    pthread_cond_destroy(&g_sched_wakeup);
+}
@@ -0,0 +1,39 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Lanes: fast collectors run on the main thread, expensive scans on a
+// lower-priority background thread so they never delay the fast metrics
+#define SCHED_LANE_FAST 0
+#define SCHED_LANE_BACKGROUND 1
+
+// A collector that returns the same fingerprint this many times in a row
+// has its period doubled, up to max_period_ms
+#define SCHED_BACKOFF_AFTER 3
+// PSI memory "some avg10" at or above this undoes the unchanged-data
+// backoff, leaving any over-budget stretch in place
+#define SCHED_PRESSURE_AVG10 5.0
+
+typedef struct {
+    const char* name;
+    int lane;
+    unsigned int base_period_ms;
+    unsigned int max_period_ms;
+    unsigned int budget_us;
+    int (*run)(void);
+    unsigned long (*fingerprint)(void);
+
+    // Scheduler state
+    unsigned int period_ms;
+    unsigned int budget_period_ms;  // Base period, or longer after an over-budget run
+    unsigned long long next_due_ns;
+    unsigned long last_fingerprint;
+    int unchanged_runs;
+    unsigned long long last_cost_us;
+    unsigned long runs;
+} Collector;
+
+// Runs the resident monitor for duration_s seconds (0 = until SIGINT or
+// SIGTERM), printing one JSON line per fast-lane cycle
+void run_resident_monitor(unsigned int duration_s);
+
+#endif
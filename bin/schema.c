@@ -0,0 +1,159 @@
+#include "schema.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Doubles are written with two decimals, matching the previous printf
+// output; anything non-finite or beyond 1e15 is clamped
+#define SCHEMA_REAL_LIMIT 1e15
+
+static inline char* put_u64(char* p, unsigned long long v) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static inline char* put_i64(char* p, long long v) {
+    *p = '-';
+    p += v < 0;
+    return put_u64(p, v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v);
+}
+
+static inline char* put_real(char* p, double v) {
+    if (!isfinite(v)) v = 0;
+    v = fmax(fmin(v, SCHEMA_REAL_LIMIT), -SCHEMA_REAL_LIMIT);
+    long long cents = llround(v * 100);
+    *p = '-';
+    p += cents < 0;
+    unsigned long long abs_cents = cents < 0 ? 0ULL - (unsigned long long)cents : (unsigned long long)cents;
+    p = put_u64(p, abs_cents / 100);
+    p[0] = '.';
+    p[1] = (char)('0' + abs_cents / 10 % 10);
+    p[2] = (char)('0' + abs_cents % 10);
+    return p + 3;
+}
+
+#define ANALYTICS_PUT_SIZE(p, v) put_u64(p, v)
+#define ANALYTICS_PUT_COUNT(p, v) put_i64(p, v)
+#define ANALYTICS_PUT_INT(p, v) put_i64(p, v)
+#define ANALYTICS_PUT_REAL(p, v) put_real(p, v)
+
+#define ANALYTICS_WIRE_SIZE uint64_t
+#define ANALYTICS_WIRE_COUNT int64_t
+#define ANALYTICS_WIRE_INT int64_t
+#define ANALYTICS_WIRE_REAL double
+
+#define ANALYTICS_PARSE_SIZE(s) strtoull(s, NULL, 10)
+#define ANALYTICS_PARSE_COUNT(s) strtol(s, NULL, 10)
+#define ANALYTICS_PARSE_INT(s) (int)strtol(s, NULL, 10)
+#define ANALYTICS_PARSE_REAL(s) strtod(s, NULL)
+
+#define ANALYTICS_JSON_WRITE(kind, name, api_name) \
+    memcpy(p, "\"" #name "\": ", sizeof("\"" #name "\": ") - 1); \
+    p = ANALYTICS_PUT_##kind(p + sizeof("\"" #name "\": ") - 1, a->name); \
+    memcpy(p, sep, sep_len); \
+    p += sep_len;
+
+size_t analytics_json_members(const MemoryAnalytics* a, const char* sep, char* buf) {
+    size_t sep_len = strnlen(sep, ANALYTICS_JSON_MAX_SEP);
+    char* p = buf;
+    ANALYTICS_FIELDS(ANALYTICS_JSON_WRITE)
+    // The last separator is dropped
+    p -= sep_len;
+    *p = '\0';
+    return p - buf;
+}
+
+#define ANALYTICS_BINARY_WRITE(kind, name, api_name) \
+    { ANALYTICS_WIRE_##kind v = (ANALYTICS_WIRE_##kind)a->name; memcpy(out, &v, 8); out += 8; }
+
+void analytics_to_binary(const MemoryAnalytics* a, unsigned char* out) {
+    ANALYTICS_FIELDS(ANALYTICS_BINARY_WRITE)
+}
+
+#define ANALYTICS_BINARY_READ(kind, name, api_name) \
+    { ANALYTICS_WIRE_##kind v; memcpy(&v, in, 8); a->name = (ANALYTICS_CTYPE_##kind)v; in += 8; }
+
+void analytics_from_binary(MemoryAnalytics* a, const unsigned char* in) {
+    ANALYTICS_FIELDS(ANALYTICS_BINARY_READ)
+}
+
+static const char* skip_ws(const char* p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+// p is at the opening quote; returns the byte after the closing one
+static const char* skip_string(const char* p) {
+    for (p++; *p != '"'; p++) {
+        if (*p == '\0') return NULL;
+        if (*p == '\\' && *++p == '\0') return NULL;
+    }
+    return p + 1;
+}
+
+// Returns the byte after one JSON value, skipping nested objects, arrays
+// and strings whole, or NULL if the text ends first
+static const char* skip_value(const char* p) {
+    int depth = 0;
+    for (;;) {
+        switch (*p) {
+        case '\0':
+            return NULL;
+        case '"':
+            if ((p = skip_string(p)) == NULL) return NULL;
+            if (depth == 0) return p;
+            continue;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if (depth == 0) return p;
+            if (--depth == 0) return p + 1;
+            break;
+        case ',':
+            if (depth == 0) return p;
+            break;
+        }
+        p++;
+    }
+}
+
+// Only the object's own members are matched, by their whole key, so a
+// field name inside a nested value or a longer key is never picked up
+#define ANALYTICS_JSON_READ(kind, name, api_name) \
+    if (key_len == sizeof(#name) - 1 && memcmp(key, #name, key_len) == 0) { \
+        a->name = ANALYTICS_PARSE_##kind(p); \
+        found++; \
+    }
+
+int analytics_from_json(MemoryAnalytics* a, const char* json) {
+    int found = 0;
+    const char* p = skip_ws(json);
+    if (*p != '{') return -1;
+    p = skip_ws(p + 1);
+    if (*p == '}') return 0;
+    for (;;) {
+        if (*p != '"') return -1;
+        const char* key = p + 1;
+        if ((p = skip_string(p)) == NULL) return -1;
+        size_t key_len = p - 1 - key;
+        p = skip_ws(p);
+        if (*p != ':') return -1;
+        p = skip_ws(p + 1);
+        ANALYTICS_FIELDS(ANALYTICS_JSON_READ)
+        if ((p = skip_value(p)) == NULL) return -1;
+        p = skip_ws(p);
+        if (*p == '}') return found;
+        if (*p != ',') return -1;
+        p = skip_ws(p + 1);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include "memory_types.h"
+#include <stddef.h>
+
+// Serializers generated from ANALYTICS_FIELDS. Each expands to one
+// straight-line block per field; no format strings are parsed at runtime
+
+#define ANALYTICS_COUNT_FIELD(kind, name, api_name) + 1
+#define ANALYTICS_NUM_FIELDS (0 ANALYTICS_FIELDS(ANALYTICS_COUNT_FIELD))
+
+// Every field is 8 bytes in host byte order: uint64 for SIZE, int64 for
+// COUNT and INT, IEEE double for REAL
+#define ANALYTICS_BINARY_SIZE (8 * ANALYTICS_NUM_FIELDS)
+
+// Key, quotes, colon, the longest number and a separator of up to
+// ANALYTICS_JSON_MAX_SEP bytes per field
+#define ANALYTICS_JSON_MAX_SEP 8
+#define ANALYTICS_JSON_FIELD_MAX(kind, name, api_name) + sizeof(#name) + 24 + ANALYTICS_JSON_MAX_SEP
+#define ANALYTICS_JSON_MAX (1 ANALYTICS_FIELDS(ANALYTICS_JSON_FIELD_MAX))
+
+// Writes "name": value pairs joined by sep (no braces) into buf, which
+// must hold ANALYTICS_JSON_MAX bytes; returns the length
+size_t analytics_json_members(const MemoryAnalytics* a, const char* sep, char* buf);
+void analytics_to_binary(const MemoryAnalytics* a, unsigned char* out);
+void analytics_from_binary(MemoryAnalytics* a, const unsigned char* in);
+// Fills the fields that are top-level members of a JSON object; returns
+// how many were found, or -1 if the text is not an object
+int analytics_from_json(MemoryAnalytics* a, const char* json);
+
+#endif
@@ -0,0 +1,43 @@
+// Prints the TypeScript types for ANALYTICS_FIELDS; run by `make types`
+#include "schema.h"
+#include <stdio.h>
+
+#define TS_VMD_FIELD(kind, name, api_name) printf("  " #name ": number\n");
+#define TS_API_FIELD(kind, name, api_name) printf("  " #api_name ": number\n");
+#define TS_MAP_FIELD(kind, name, api_name) printf("    " #api_name ": Number(raw." #name ") || 0,\n");
+#define TS_READ_SIZE "Number(view.getBigUint64(offset + %d, true))"
+#define TS_READ_COUNT "Number(view.getBigInt64(offset + %d, true))"
+#define TS_READ_INT TS_READ_COUNT
+#define TS_READ_REAL "view.getFloat64(offset + %d, true)"
+#define TS_DECODE_FIELD(kind, name, api_name) printf("    " #name ": " TS_READ_##kind ",\n", 8 * field++);
+
+int main(void) {
+    int field = 0;
+
+    printf("// Generated by `make types` in bin/ from ANALYTICS_FIELDS in\n");
+    printf("// bin/memory_types.h. Do not edit by hand.\n\n");
+
+    printf("// Analytics fields as printed by vmd\n");
+    printf("export interface VmdAnalytics {\n");
+    ANALYTICS_FIELDS(TS_VMD_FIELD)
+    printf("}\n\n");
+
+    printf("// The same fields as returned by /api/analytics\n");
+    printf("export interface AnalyticsFields {\n");
+    ANALYTICS_FIELDS(TS_API_FIELD)
+    printf("}\n\n");
+
+    printf("export function toAnalyticsFields(raw: Partial<Record<keyof VmdAnalytics, unknown>>): AnalyticsFields {\n");
+    printf("  return {\n");
+    ANALYTICS_FIELDS(TS_MAP_FIELD)
+    printf("  }\n}\n\n");
+
+    printf("export const ANALYTICS_BINARY_SIZE = %d\n\n", ANALYTICS_BINARY_SIZE);
+    printf("// Decodes the 8-byte-per-field layout written by analytics_to_binary\n");
+    printf("// (little-endian hosts)\n");
+    printf("export function decodeAnalytics(view: DataView, offset = 0): VmdAnalytics {\n");
+    printf("  return {\n");
+    ANALYTICS_FIELDS(TS_DECODE_FIELD)
+    printf("  }\n}\n");
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Round-trips every ANALYTICS_FIELDS entry through the JSON and binary
+// codecs; run by `make check`
+#include "schema.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// Distinct per field, and exact at the JSON writer's two decimals
+#define TEST_VALUE_SIZE(i) ((size_t)1 << 40 | (size_t)(i) * 4099)
+#define TEST_VALUE_COUNT(i) (-1000L * ((i) + 1) - 7)
+#define TEST_VALUE_INT(i) ((i) * 37 + 1)
+#define TEST_VALUE_REAL(i) (-12345.75 + (i) * 1000.25)
+
+#define TEST_FILL(kind, name, api_name) a.name = TEST_VALUE_##kind(field); field++;
+
+#define TEST_SAME_SIZE(x, y) ((x) == (y))
+#define TEST_SAME_COUNT(x, y) ((x) == (y))
+#define TEST_SAME_INT(x, y) ((x) == (y))
+#define TEST_SAME_REAL(x, y) (fabs((x) - (y)) < 0.005)
+
+#define TEST_COMPARE(kind, name, api_name) \
+    if (!TEST_SAME_##kind(want->name, got->name)) { \
+        printf("FAIL %s: " #name " %.2f, want %.2f\n", codec, (double)got->name, (double)want->name); \
+        failures++; \
+    }
+
+static int compare(const char* codec, const MemoryAnalytics* want, const MemoryAnalytics* got) {
+    int failures = 0;
+    ANALYTICS_FIELDS(TEST_COMPARE)
+    return failures;
+}
+
+int main(void) {
+    static MemoryAnalytics a, from_json, from_binary, shadowed;
+    static char members[ANALYTICS_JSON_MAX], json[2 * ANALYTICS_JSON_MAX + 256];
+    unsigned char binary[ANALYTICS_BINARY_SIZE];
+    int field = 0, failures = 0;
+
+    ANALYTICS_FIELDS(TEST_FILL)
+
+    analytics_json_members(&a, ",\n  ", members);
+    snprintf(json, sizeof(json), "{\n  %s\n}", members);
+    int found = analytics_from_json(&from_json, json);
+    if (found != ANALYTICS_NUM_FIELDS) {
+        printf("FAIL json: found %d fields, want %d\n", found, ANALYTICS_NUM_FIELDS);
+        failures++;
+    }
+    failures += compare("json", &a, &from_json);
+
+    analytics_to_binary(&a, binary);
+    analytics_from_binary(&from_binary, binary);
+    failures += compare("binary", &a, &from_binary);
+
+    // Field names inside nested values, strings and longer keys must not
+    // shadow the top-level members that follow them
+    snprintf(json, sizeof(json),
+             "{\"nested\": {\"fault_rate\": 1, \"peak_usage\": [2]}, \"note\": \"\\\"minor_faults\\\": 3\", "
+             "\"total_memory_old\": 4, %s}", members);
+    found = analytics_from_json(&shadowed, json);
+    if (found != ANALYTICS_NUM_FIELDS) {
+        printf("FAIL nested: found %d fields, want %d\n", found, ANALYTICS_NUM_FIELDS);
+        failures++;
+    }
+    failures += compare("nested", &a, &shadowed);
+
+    printf("%d fields, %d failures\n", ANALYTICS_NUM_FIELDS, failures);
+    return failures != 0;
+}
@@ -0,0 +1,220 @@
+#define _GNU_SOURCE
+#include "self_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#define SELF_HIST_BUCKETS 40
+
+typedef struct {
+    const char* name;
+    unsigned long runs;
+    int next;
+    int filled;
+    SelfSample window[SELF_WINDOW];
+    unsigned int wall_hist[SELF_HIST_BUCKETS];
+    unsigned int cpu_hist[SELF_HIST_BUCKETS];
+} CollectorStats;
+
+static CollectorStats g_collectors[SELF_MAX_COLLECTORS];
+static int g_num_collectors = 0;
+static pthread_mutex_t g_self_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread unsigned long long t_allocs;
+static __thread int t_io_fd = -1;
+
+// Count allocations per thread by interposing the allocator entry points
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void* __libc_valloc(size_t size);
+extern void* __libc_pvalloc(size_t size);
+
+void* malloc(size_t size) {
+    t_allocs++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    t_allocs++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    t_allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+// glibc has no __libc_ entry for the aligned variants other than memalign,
+// so they are built on it with the same argument checks
+void* memalign(size_t alignment, size_t size) {
+    t_allocs++;
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    t_allocs++;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    if (alignment == 0 || alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+    t_allocs++;
+    void* ptr = __libc_memalign(alignment, size);
+    if (ptr == NULL) return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+
+void* valloc(size_t size) {
+    t_allocs++;
+    return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size) {
+    t_allocs++;
+    return __libc_pvalloc(size);
+}
+
+static unsigned long long clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Per-thread read/write syscall count and bytes read. Returns the size of
+// this read so it can be excluded from the measured interval.
+static ssize_t read_io_counters(unsigned long long* rw_syscalls, unsigned long long* bytes) {
+    char buf[512];
+    *rw_syscalls = 0;
+    *bytes = 0;
+
+    if (t_io_fd < 0) t_io_fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+    if (t_io_fd < 0) return 0;
+    ssize_t n = pread(t_io_fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return 0;
+    buf[n] = '\0';
+
+    unsigned long long syscr = 0, syscw = 0;
+    char* line = buf;
+    while (line != NULL) {
+        if (strncmp(line, "rchar:", 6) == 0) *bytes = strtoull(line + 6, NULL, 10);
+        else if (strncmp(line, "syscr:", 6) == 0) syscr = strtoull(line + 6, NULL, 10);
+        else if (strncmp(line, "syscw:", 6) == 0) syscw = strtoull(line + 6, NULL, 10);
+        line = strchr(line, '\n');
+        if (line != NULL) line++;
+    }
+    *rw_syscalls = syscr + syscw;
+    return n;
+}
+
+void self_begin(SelfSample* sample) {
+    // The kernel accounts this read after producing its contents, so the
+    // closing read will see one extra syscall and n extra bytes
+    ssize_t n = read_io_counters(&sample->rw_syscalls, &sample->proc_bytes);
+    sample->rw_syscalls += 1;
+    sample->proc_bytes += n;
+    sample->allocs = t_allocs;
+    sample->cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    sample->wall_ns = clock_ns(CLOCK_MONOTONIC);
+}
+
+static inline int log2_bucket(unsigned long long value) {
+    int bucket = 63 - __builtin_clzll(value | 1);
+    return bucket < SELF_HIST_BUCKETS ? bucket : SELF_HIST_BUCKETS - 1;
+}
+
+void self_end(const char* collector, SelfSample* sample) {
+    SelfSample delta;
+    delta.wall_ns = clock_ns(CLOCK_MONOTONIC) - sample->wall_ns;
+    delta.cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID) - sample->cpu_ns;
+    delta.allocs = t_allocs - sample->allocs;
+    unsigned long long rw_syscalls, bytes;
+    read_io_counters(&rw_syscalls, &bytes);
+    delta.rw_syscalls = rw_syscalls > sample->rw_syscalls ? rw_syscalls - sample->rw_syscalls : 0;
+    delta.proc_bytes = bytes > sample->proc_bytes ? bytes - sample->proc_bytes : 0;
+    *sample = delta;
+
+    pthread_mutex_lock(&g_self_mutex);
+    CollectorStats* cs = NULL;
+    for (int i = 0; i < g_num_collectors; i++) {
+        if (strcmp(g_collectors[i].name, collector) == 0) {
+            cs = &g_collectors[i];
+            break;
+        }
+    }
+    if (cs == NULL && g_num_collectors < SELF_MAX_COLLECTORS) {
+        cs = &g_collectors[g_num_collectors++];
+        cs->name = collector;
+    }
+    if (cs != NULL) {
+        // Evict the oldest sample from the rolling histograms
+        if (cs->filled == SELF_WINDOW) {
+            cs->wall_hist[log2_bucket(cs->window[cs->next].wall_ns)]--;
+            cs->cpu_hist[log2_bucket(cs->window[cs->next].cpu_ns)]--;
+        } else {
+            cs->filled++;
+        }
+        cs->window[cs->next] = delta;
+        cs->wall_hist[log2_bucket(delta.wall_ns)]++;
+        cs->cpu_hist[log2_bucket(delta.cpu_ns)]++;
+        cs->next = (cs->next + 1) % SELF_WINDOW;
+        cs->runs++;
+    }
+    pthread_mutex_unlock(&g_self_mutex);
+}
+
+// Upper bound of the histogram bucket holding the given quantile, in us
+static double hist_quantile_us(const unsigned int* hist, int filled, double fraction) {
+    unsigned int target = (unsigned int)(filled * fraction);
+    unsigned int seen = 0;
+    for (int b = 0; b < SELF_HIST_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen > target) return (double)(2ULL << b) / 1000.0;
+    }
+    return 0;
+}
+
+static void output_timing(const char* name, const CollectorStats* cs, const unsigned int* hist,
+                          unsigned long long last, double mean) {
+    printf("\"%s\": {\"last\": %.1f, \"mean\": %.1f, \"p50\": %.1f, \"p99\": %.1f}",
+           name, last / 1000.0, mean / 1000.0,
+           hist_quantile_us(hist, cs->filled, 0.50),
+           hist_quantile_us(hist, cs->filled, 0.99));
+}
+
+void output_self_stats_json(void) {
+    pthread_mutex_lock(&g_self_mutex);
+    printf("  \"self\": {");
+    for (int i = 0; i < g_num_collectors; i++) {
+        const CollectorStats* cs = &g_collectors[i];
+        const SelfSample* last = &cs->window[(cs->next + SELF_WINDOW - 1) % SELF_WINDOW];
+        double wall = 0, cpu = 0, rw_syscalls = 0, bytes = 0, allocs = 0;
+        for (int s = 0; s < cs->filled; s++) {
+            wall += cs->window[s].wall_ns;
+            cpu += cs->window[s].cpu_ns;
+            rw_syscalls += cs->window[s].rw_syscalls;
+            bytes += cs->window[s].proc_bytes;
+            allocs += cs->window[s].allocs;
+        }
+
+        printf("%s\n    \"%s\": {\"runs\": %lu, ", i ? "," : "", cs->name, cs->runs);
+        output_timing("wall_us", cs, cs->wall_hist, last->wall_ns, wall / cs->filled);
+        printf(", ");
+        output_timing("cpu_us", cs, cs->cpu_hist, last->cpu_ns, cpu / cs->filled);
+        printf(", \"rw_syscalls\": %.1f, \"proc_bytes\": %.0f, \"allocs\": %.1f}",
+               rw_syscalls / cs->filled, bytes / cs->filled, allocs / cs->filled);
+    }
+    printf("%s}", g_num_collectors ? "\n  " : "");
+    pthread_mutex_unlock(&g_self_mutex);
+}
@@ -0,0 +1,27 @@
+#ifndef SELF_STATS_H
+#define SELF_STATS_H
+
+#include <stddef.h>
+
+// Cost accounting for vmd's own collectors. Wrap each collector run in
+// self_begin()/self_end(); the last SELF_WINDOW runs of each collector are
+// kept as rolling histograms and reported as the "self" output section.
+// rw_syscalls is syscr + syscw from /proc/thread-self/io: reads and writes
+// only. The open, close, getdents and fstat calls that dominate /proc
+// collection are not counted; wall and cpu time include their cost.
+#define SELF_WINDOW 64
+#define SELF_MAX_COLLECTORS 32
+
+typedef struct {
+    unsigned long long wall_ns;
+    unsigned long long cpu_ns;
+    unsigned long long rw_syscalls;
+    unsigned long long proc_bytes;
+    unsigned long long allocs;
+} SelfSample;
+
+void self_begin(SelfSample* sample);
+void self_end(const char* collector, SelfSample* sample);
+void output_self_stats_json(void);
+
+#endif
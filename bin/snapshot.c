@@ -0,0 +1,741 @@
+#define _GNU_SOURCE
+#include "snapshot.h"
+#include "swap.h"
+#include "state_dir.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#define SNAPSHOT_MAGIC "VMDSNAP1"
+#define SNAPSHOT_LINE 8192
+#define SNAPSHOT_PAGEMAP_BATCH 1024
+#define SNAPSHOT_NAME_MAX 64
+
+#define SNAPSHOT_COUNTER_KEY(id, key) key,
+static const char* g_counter_keys[SNAP_NUM_COUNTERS] = { SNAPSHOT_COUNTERS(SNAPSHOT_COUNTER_KEY) };
+#undef SNAPSHOT_COUNTER_KEY
+
+static const char* g_kind_names[SNAP_NUM_KINDS] = {
+    "anon", "heap", "arena", "stack", "file", "special", "guard"
+};
+
+static unsigned long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Names become file names, so only a safe character set is accepted
+static int valid_name(const char* name) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= SNAPSHOT_NAME_MAX) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '.' && name[i] != '_' && name[i] != '-') return 0;
+    }
+    return name[0] != '.';
+}
+
+static int snapshot_path(char* buf, size_t len, const char* name) {
+    char file[SNAPSHOT_NAME_MAX + 16];
+    snprintf(file, sizeof(file), SNAPSHOT_PREFIX "%s" SNAPSHOT_SUFFIX, name);
+    return vmd_state_path(buf, len, file);
+}
+
+static void print_json_string(const char* s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') printf("\\%c", *s);
+        else if ((unsigned char)*s < 0x20) printf("\\u%04x", *s);
+        else putchar(*s);
+    }
+    putchar('"');
+}
+
+// Consecutive VMAs of one file share its name, so only the previous name
+// is checked before appending to the string table
+static uint32_t intern_name(ProcessSnapshot* snap, size_t* cap, const char* name, uint32_t prev) {
+    if (*name == '\0') return 0;
+    if (prev && strcmp(snap->strings + prev, name) == 0) return prev;
+
+    size_t len = strlen(name) + 1;
+    size_t used = snap->header.strings_size;
+    if (used + len > *cap) {
+        size_t grown = *cap * 2;
+        while (grown < used + len) grown *= 2;
+        char* strings = realloc(snap->strings, grown);
+        if (strings == NULL) return 0;
+        snap->strings = strings;
+        *cap = grown;
+    }
+    memcpy(snap->strings + used, name, len);
+    snap->header.strings_size += len;
+    return (uint32_t)used;
+}
+
+static SnapshotKind classify(const SnapshotVma* v, const char* name) {
+    if (strcmp(name, "[heap]") == 0) return SNAP_KIND_HEAP;
+    if (strncmp(name, "[stack", 6) == 0) return SNAP_KIND_STACK;
+    if (v->inode != 0 || name[0] == '/') return SNAP_KIND_FILE;
+    if (name[0] == '[' && strncmp(name, "[anon", 5) != 0) return SNAP_KIND_SPECIAL;
+    if (!(v->flags & (SNAP_PERM_READ | SNAP_PERM_WRITE | SNAP_PERM_EXEC))) return SNAP_KIND_GUARD;
+    return SNAP_KIND_ANON;
+}
+
+static void set_kind(SnapshotVma* v, SnapshotKind kind) {
+    v->flags = (v->flags & ((1U << SNAP_KIND_SHIFT) - 1)) | ((uint32_t)kind << SNAP_KIND_SHIFT);
+}
+
+// A thread arena heap is an aligned SNAPSHOT_ARENA_SIZE reservation whose
+// used part is read-write and the rest a ---p guard right after it
+static void mark_arenas(ProcessSnapshot* snap) {
+    uint32_t n = snap->header.num_vmas;
+    for (uint32_t i = 0; i < n; i++) {
+        SnapshotVma* v = &snap->vmas[i];
+        if (SNAP_VMA_KIND(v) != SNAP_KIND_ANON || v->start % SNAPSHOT_ARENA_SIZE != 0) continue;
+        if ((v->flags & (SNAP_PERM_READ | SNAP_PERM_WRITE | SNAP_PERM_SHARED)) != (SNAP_PERM_READ | SNAP_PERM_WRITE))
+            continue;
+        int whole = v->end - v->start == SNAPSHOT_ARENA_SIZE;
+        int guarded = i + 1 < n && snap->vmas[i + 1].start == v->end &&
+                      SNAP_VMA_KIND(&snap->vmas[i + 1]) == SNAP_KIND_GUARD &&
+                      snap->vmas[i + 1].end - v->start == SNAPSHOT_ARENA_SIZE;
+        if (whole || guarded) set_kind(v, SNAP_KIND_ARENA);
+    }
+}
+
+static int read_residency(int pagemap, SnapshotVma* v, uint64_t* entries, long page_size) {
+    uint64_t first = v->start / page_size;
+    uint64_t pages = (v->end - v->start) / page_size;
+    v->residency = 0;
+    for (uint64_t done = 0; done < pages; done += SNAPSHOT_PAGEMAP_BATCH) {
+        size_t want = pages - done < SNAPSHOT_PAGEMAP_BATCH ? pages - done : SNAPSHOT_PAGEMAP_BATCH;
+        ssize_t n = pread(pagemap, entries, want * sizeof(entries[0]), (first + done) * sizeof(entries[0]));
+        if (n <= 0) return -1;
+        for (size_t i = 0; i < (size_t)n / sizeof(entries[0]); i++) {
+            if (entries[i] & PM_PRESENT) v->residency |= 1ULL << ((done + i) * 64 / pages);
+        }
+    }
+    return 0;
+}
+
+static int parse_vma_header(const char* line, SnapshotVma* v, const char** name) {
+    unsigned long long start, end, pgoff, inode;
+    unsigned int major, minor;
+    char perms[8];
+    int consumed = 0;
+
+    if (sscanf(line, "%llx-%llx %7s %llx %x:%x %llu %n", &start, &end, perms, &pgoff, &major, &minor,
+               &inode, &consumed) < 7)
+        return -1;
+    memset(v, 0, sizeof(*v));
+    v->start = start;
+    v->end = end;
+    v->pgoff = pgoff;
+    v->inode = inode;
+    v->dev = (uint32_t)makedev(major, minor);
+    if (perms[0] == 'r') v->flags |= SNAP_PERM_READ;
+    if (perms[1] == 'w') v->flags |= SNAP_PERM_WRITE;
+    if (perms[2] == 'x') v->flags |= SNAP_PERM_EXEC;
+    if (perms[3] == 's') v->flags |= SNAP_PERM_SHARED;
+    *name = line + consumed;
+    return 0;
+}
+
+static void parse_counter(const char* line, SnapshotVma* v) {
+    const char* colon = strchr(line, ':');
+    if (colon == NULL) return;
+    size_t len = colon - line;
+    for (int c = 0; c < SNAP_NUM_COUNTERS; c++) {
+        if (strlen(g_counter_keys[c]) == len && memcmp(line, g_counter_keys[c], len) == 0) {
+            v->kb[c] = (uint32_t)strtoul(colon + 1, NULL, 10);
+            return;
+        }
+    }
+}
+
+int capture_snapshot(pid_t pid, ProcessSnapshot* snap) {
+    char path[64];
+    static char line[SNAPSHOT_LINE];
+    size_t cap = 0, strings_cap = 4096;
+
+    memset(snap, 0, sizeof(*snap));
+    snprintf(path, sizeof(path), "/proc/%d/smaps", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return -1;
+    setvbuf(f, NULL, _IOFBF, 1 << 16);
+
+    snap->strings = calloc(1, strings_cap);
+    snap->header.strings_size = 1;
+    uint32_t prev_name = 0;
+    while (snap->strings != NULL && fgets(line, sizeof(line), f)) {
+        // VMA lines start with a lowercase hex address, fields with a capital
+        if (!((line[0] >= '0' && line[0] <= '9') || (line[0] >= 'a' && line[0] <= 'f'))) {
+            if (snap->header.num_vmas > 0) parse_counter(line, &snap->vmas[snap->header.num_vmas - 1]);
+            continue;
+        }
+        if (snap->header.num_vmas == cap) {
+            size_t grown = cap ? cap * 2 : 1024;
+            SnapshotVma* vmas = realloc(snap->vmas, grown * sizeof(SnapshotVma));
+            if (vmas == NULL) break;
+            snap->vmas = vmas;
+            cap = grown;
+        }
+        SnapshotVma* v = &snap->vmas[snap->header.num_vmas];
+        const char* name;
+        if (parse_vma_header(line, v, &name) != 0) continue;
+        line[strcspn(line, "\n")] = '\0';
+        v->name = prev_name = intern_name(snap, &strings_cap, name, prev_name);
+        set_kind(v, classify(v, name));
+        snap->header.num_vmas++;
+    }
+    fclose(f);
+    if (snap->strings == NULL || snap->header.num_vmas == 0) {
+        free_snapshot(snap);
+        return -1;
+    }
+    mark_arenas(snap);
+
+    // Residency needs pagemap, i.e. the same access as ptrace
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)pid);
+    int pagemap = open(path, O_RDONLY | O_CLOEXEC);
+    if (pagemap >= 0) {
+        static uint64_t entries[SNAPSHOT_PAGEMAP_BATCH];
+        long page_size = sysconf(_SC_PAGESIZE);
+        snap->header.flags |= SNAP_HAS_RESIDENCY;
+        for (uint32_t i = 0; i < snap->header.num_vmas; i++) {
+            SnapshotVma* v = &snap->vmas[i];
+            if (v->kb[SNAP_RSS] == 0 || strcmp(snap->strings + v->name, "[vsyscall]") == 0) continue;
+            if (read_residency(pagemap, v, entries, page_size) != 0) {
+                snap->header.flags &= ~SNAP_HAS_RESIDENCY;
+                break;
+            }
+        }
+        close(pagemap);
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    memcpy(snap->header.magic, SNAPSHOT_MAGIC, sizeof(snap->header.magic));
+    snap->header.record_size = sizeof(SnapshotVma);
+    snap->header.num_counters = SNAP_NUM_COUNTERS;
+    snap->header.pid = pid;
+    snap->header.captured_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    snprintf(path, sizeof(path), "/proc/%d/comm", (int)pid);
+    f = fopen(path, "r");
+    if (f != NULL) {
+        if (fgets(snap->header.comm, sizeof(snap->header.comm), f) != NULL)
+            snap->header.comm[strcspn(snap->header.comm, "\n")] = '\0';
+        fclose(f);
+    }
+    return 0;
+}
+
+// Written to a temporary file and renamed, so readers never see half a file
+int save_snapshot(const ProcessSnapshot* snap, const char* name) {
+    char path[512], tmp[520];
+    if (!valid_name(name) || snapshot_path(path, sizeof(path), name) != 0) return -1;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE* f = vmd_state_fopen(tmp, "wb");
+    if (f == NULL) return -1;
+    int ok = fwrite(&snap->header, sizeof(snap->header), 1, f) == 1 &&
+             fwrite(snap->vmas, sizeof(SnapshotVma), snap->header.num_vmas, f) == snap->header.num_vmas &&
+             fwrite(snap->strings, 1, snap->header.strings_size, f) == snap->header.strings_size;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int load_snapshot(const char* name, ProcessSnapshot* snap) {
+    char path[512];
+    struct stat st;
+
+    memset(snap, 0, sizeof(*snap));
+    if (!valid_name(name) || snapshot_path(path, sizeof(path), name) != 0) return -1;
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const SnapshotHeader* h = map;
+    size_t need = sizeof(SnapshotHeader) + (size_t)h->num_vmas * sizeof(SnapshotVma) + h->strings_size;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 || h->record_size != sizeof(SnapshotVma) ||
+        h->num_counters != SNAP_NUM_COUNTERS || h->strings_size == 0 || need > (size_t)st.st_size) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+    snap->header = *h;
+    snap->vmas = (SnapshotVma*)((char*)map + sizeof(SnapshotHeader));
+    snap->strings = (char*)(snap->vmas + h->num_vmas);
+    snap->map = map;
+    snap->map_len = st.st_size;
+
+    // Everything below indexes the string table, so check it once here
+    int valid = snap->strings[h->strings_size - 1] == '\0';
+    for (uint32_t i = 0; valid && i < h->num_vmas; i++) {
+        if (snap->vmas[i].name >= h->strings_size) valid = 0;
+    }
+    if (!valid) {
+        free_snapshot(snap);
+        return -1;
+    }
+    return 0;
+}
+
+void free_snapshot(ProcessSnapshot* snap) {
+    if (snap->map != NULL) {
+        munmap(snap->map, snap->map_len);
+    } else {
+        free(snap->vmas);
+        free(snap->strings);
+    }
+    memset(snap, 0, sizeof(*snap));
+}
+
+int parse_snapshot_sort_key(const char* name, SnapshotSortKey* key) {
+    if (strcmp(name, "rss") == 0) *key = SNAP_SORT_RSS;
+    else if (strcmp(name, "pss") == 0) *key = SNAP_SORT_PSS;
+    else if (strcmp(name, "swap") == 0) *key = SNAP_SORT_SWAP;
+    else return -1;
+    return 0;
+}
+
+static void snapshot_totals(const ProcessSnapshot* snap, unsigned long long* kb) {
+    memset(kb, 0, SNAP_NUM_COUNTERS * sizeof(*kb));
+    for (uint32_t i = 0; i < snap->header.num_vmas; i++) {
+        for (int c = 0; c < SNAP_NUM_COUNTERS; c++) kb[c] += snap->vmas[i].kb[c];
+    }
+}
+
+static void output_snapshot_summary_json(const char* label, const char* name, const ProcessSnapshot* snap) {
+    unsigned long long kb[SNAP_NUM_COUNTERS];
+    unsigned long long size = 0;
+    snapshot_totals(snap, kb);
+    for (uint32_t i = 0; i < snap->header.num_vmas; i++) size += snap->vmas[i].end - snap->vmas[i].start;
+
+    printf("  \"%s\": {\"name\": ", label);
+    print_json_string(name);
+    printf(", \"pid\": %d, \"comm\": ", snap->header.pid);
+    print_json_string(snap->header.comm);
+    printf(", \"captured_ms\": %lld, \"vmas\": %u, \"size\": %llu, \"rss\": %llu, \"pss\": %llu, "
+           "\"swap\": %llu, \"anon_huge\": %llu, \"residency\": %s}",
+           (long long)snap->header.captured_ms, snap->header.num_vmas, size, kb[SNAP_RSS] * 1024,
+           kb[SNAP_PSS] * 1024, kb[SNAP_SWAP] * 1024, kb[SNAP_ANON_HUGE] * 1024,
+           snap->header.flags & SNAP_HAS_RESIDENCY ? "true" : "false");
+}
+
+void output_snapshot_capture_json(pid_t pid, const char* name) {
+    ProcessSnapshot snap;
+    char generated[SNAPSHOT_NAME_MAX];
+
+    if (name == NULL || *name == '\0') {
+        snprintf(generated, sizeof(generated), "%d-%lld", (int)pid, (long long)time(NULL));
+        name = generated;
+    }
+    if (!valid_name(name)) {
+        printf("{\n  \"error\": \"invalid snapshot name\"\n}\n");
+        return;
+    }
+
+    unsigned long long start = monotonic_ns();
+    if (capture_snapshot(pid, &snap) != 0) {
+        printf("{\n  \"error\": \"cannot read smaps of pid %d\"\n}\n", (int)pid);
+        return;
+    }
+    double capture_ms = (monotonic_ns() - start) / 1e6;
+    int saved = save_snapshot(&snap, name) == 0;
+
+    printf("{\n");
+    output_snapshot_summary_json("snapshot", name, &snap);
+    printf(",\n  \"saved\": %s,\n", saved ? "true" : "false");
+    printf("  \"file_bytes\": %zu,\n",
+           sizeof(SnapshotHeader) + snap.header.num_vmas * sizeof(SnapshotVma) + snap.header.strings_size);
+    printf("  \"capture_ms\": %.2f\n", capture_ms);
+    printf("}\n");
+    free_snapshot(&snap);
+}
+
+typedef struct {
+    char name[SNAPSHOT_NAME_MAX];
+    SnapshotHeader header;
+} SnapshotListing;
+
+static int compare_listings(const void* a, const void* b) {
+    const SnapshotListing* la = a;
+    const SnapshotListing* lb = b;
+    if (la->header.captured_ms != lb->header.captured_ms) return la->header.captured_ms < lb->header.captured_ms ? -1 : 1;
+    return strcmp(la->name, lb->name);
+}
+
+static void output_snapshot_list_json(void) {
+    static SnapshotListing listings[SNAPSHOT_MAX_LIST];
+    size_t prefix = strlen(SNAPSHOT_PREFIX), suffix = strlen(SNAPSHOT_SUFFIX);
+    char path[512];
+    int count = 0;
+
+    const char* state_dir = vmd_state_dir();
+    DIR* dir = state_dir != NULL ? opendir(state_dir) : NULL;
+    if (dir != NULL) {
+        struct dirent* entry;
+        while (count < SNAPSHOT_MAX_LIST && (entry = readdir(dir)) != NULL) {
+            size_t len = strlen(entry->d_name);
+            if (len <= prefix + suffix || len - prefix - suffix >= SNAPSHOT_NAME_MAX ||
+                strncmp(entry->d_name, SNAPSHOT_PREFIX, prefix) != 0 ||
+                strcmp(entry->d_name + len - suffix, SNAPSHOT_SUFFIX) != 0)
+                continue;
+            SnapshotListing* l = &listings[count];
+            snprintf(l->name, sizeof(l->name), "%.*s", (int)(len - prefix - suffix), entry->d_name + prefix);
+            if (snapshot_path(path, sizeof(path), l->name) != 0) continue;
+            int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd < 0) continue;
+            int ok = pread(fd, &l->header, sizeof(l->header), 0) == sizeof(l->header) &&
+                     memcmp(l->header.magic, SNAPSHOT_MAGIC, sizeof(l->header.magic)) == 0;
+            close(fd);
+            if (ok) count++;
+        }
+        closedir(dir);
+    }
+    qsort(listings, count, sizeof(SnapshotListing), compare_listings);
+
+    printf("{\n  \"snapshots\": [");
+    for (int i = 0; i < count; i++) {
+        SnapshotListing* l = &listings[i];
+        l->header.comm[sizeof(l->header.comm) - 1] = '\0';
+        printf("%s\n    {\"name\": ", i ? "," : "");
+        print_json_string(l->name);
+        printf(", \"pid\": %d, \"comm\": ", l->header.pid);
+        print_json_string(l->header.comm);
+        printf(", \"captured_ms\": %lld, \"vmas\": %u}", (long long)l->header.captured_ms, l->header.num_vmas);
+    }
+    printf("%s]\n}\n", count ? "\n  " : "");
+}
+
+// Identity of a mapping apart from where it sits. Unnamed anonymous VMAs
+// have nothing else to tell them apart, so when matching moved ones their
+// size is part of the identity too
+static uint64_t vma_identity(const ProcessSnapshot* s, const SnapshotVma* v, int with_size) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const char* p = s->strings + v->name; *p; p++) h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+    h = (h ^ v->inode) * 1099511628211ULL;
+    h = (h ^ v->dev) * 1099511628211ULL;
+    h = (h ^ v->flags) * 1099511628211ULL;
+    if (SNAP_VMA_KIND(v) == SNAP_KIND_FILE) h = (h ^ v->pgoff) * 1099511628211ULL;
+    else if (with_size && v->name == 0) h = (h ^ (v->end - v->start)) * 1099511628211ULL;
+    return h;
+}
+
+static int same_identity(const ProcessSnapshot* a, const SnapshotVma* va, const ProcessSnapshot* b,
+                         const SnapshotVma* vb, int with_size) {
+    if (va->inode != vb->inode || va->dev != vb->dev || va->flags != vb->flags) return 0;
+    if (SNAP_VMA_KIND(va) == SNAP_KIND_FILE && va->pgoff != vb->pgoff) return 0;
+    if (strcmp(a->strings + va->name, b->strings + vb->name) != 0) return 0;
+    if (with_size && va->name == 0 && va->end - va->start != vb->end - vb->start) return 0;
+    return 1;
+}
+
+typedef struct {
+    int32_t old_idx;                // -1 for new mappings
+    int32_t new_idx;                // -1 for removed mappings
+    int64_t delta[3];               // RSS, PSS, swap in kB
+    int64_t size_delta;
+    uint64_t start;                 // New address, or the old one when removed
+} DiffEntry;
+
+static const SnapshotCounter g_sort_counters[3] = { SNAP_RSS, SNAP_PSS, SNAP_SWAP };
+static int g_sort_slot;
+
+// Largest growth first; ties in address order so output is stable
+static int compare_entries(const void* a, const void* b) {
+    const DiffEntry* ea = a;
+    const DiffEntry* eb = b;
+    if (ea->delta[g_sort_slot] != eb->delta[g_sort_slot]) return ea->delta[g_sort_slot] < eb->delta[g_sort_slot] ? 1 : -1;
+    if (ea->size_delta != eb->size_delta) return ea->size_delta < eb->size_delta ? 1 : -1;
+    if (ea->start != eb->start) return ea->start < eb->start ? -1 : 1;
+    // A removed mapping sorts after a new one at the same address
+    return (ea->new_idx < 0) - (eb->new_idx < 0);
+}
+
+typedef struct {
+    int32_t* match;                 // Old index for each new VMA, or -1
+    uint8_t* used;                  // Old VMAs already matched
+    uint32_t matched;
+    uint32_t moved;
+    DiffEntry* entries;
+    uint32_t num_entries;
+} SnapshotDiff;
+
+// Pass 1 pairs VMAs that still start at the same address, which covers
+// in-place growth of the heap, arenas and mappings; pass 2 hashes the
+// leftovers by identity to pair mappings that moved
+static int diff_snapshots(const ProcessSnapshot* a, const ProcessSnapshot* b, SnapshotDiff* d) {
+    uint32_t na = a->header.num_vmas, nb = b->header.num_vmas;
+    memset(d, 0, sizeof(*d));
+    d->match = malloc((nb + 1) * sizeof(int32_t));
+    d->used = calloc(na + 1, 1);
+    d->entries = malloc((na + nb + 1) * sizeof(DiffEntry));
+    if (d->match == NULL || d->used == NULL || d->entries == NULL) return -1;
+    for (uint32_t j = 0; j < nb; j++) d->match[j] = -1;
+
+    uint32_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (a->vmas[i].start < b->vmas[j].start) {
+            i++;
+        } else if (a->vmas[i].start > b->vmas[j].start) {
+            j++;
+        } else {
+            if (same_identity(a, &a->vmas[i], b, &b->vmas[j], 0)) {
+                d->match[j] = i;
+                d->used[i] = 1;
+                d->matched++;
+            }
+            i++;
+            j++;
+        }
+    }
+
+    if (d->matched < na && d->matched < nb) {
+        // One slot per distinct identity, holding a queue of old VMAs in
+        // address order, so many same-sized anonymous VMAs stay linear
+        size_t slots = 16;
+        while (slots < 2 * (size_t)(na - d->matched)) slots *= 2;
+        int32_t* head = malloc(slots * sizeof(int32_t));
+        int32_t* tail = malloc(slots * sizeof(int32_t));
+        uint64_t* hashes = malloc(slots * sizeof(uint64_t));
+        int32_t* next = malloc(na * sizeof(int32_t));
+        if (head == NULL || tail == NULL || hashes == NULL || next == NULL) {
+            free(head);
+            free(tail);
+            free(hashes);
+            free(next);
+            return -1;
+        }
+        memset(head, 0xff, slots * sizeof(int32_t));
+        for (i = 0; i < na; i++) {
+            if (d->used[i]) continue;
+            uint64_t h = vma_identity(a, &a->vmas[i], 1);
+            size_t slot = h & (slots - 1);
+            while (head[slot] >= 0 &&
+                   (hashes[slot] != h || !same_identity(a, &a->vmas[head[slot]], a, &a->vmas[i], 1)))
+                slot = (slot + 1) & (slots - 1);
+            next[i] = -1;
+            if (head[slot] < 0) {
+                head[slot] = i;
+                hashes[slot] = h;
+            } else {
+                next[tail[slot]] = i;
+            }
+            tail[slot] = i;
+        }
+        for (j = 0; j < nb; j++) {
+            if (d->match[j] >= 0) continue;
+            uint64_t h = vma_identity(b, &b->vmas[j], 1);
+            size_t slot = h & (slots - 1);
+            // Drained queues are left as -2 so probing still passes them
+            while (head[slot] != -1 && (head[slot] == -2 || hashes[slot] != h ||
+                                        !same_identity(a, &a->vmas[head[slot]], b, &b->vmas[j], 1)))
+                slot = (slot + 1) & (slots - 1);
+            int32_t o = head[slot];
+            if (o < 0) continue;
+            head[slot] = next[o] >= 0 ? next[o] : -2;
+            d->match[j] = o;
+            d->used[o] = 1;
+            d->matched++;
+            if (a->vmas[o].start != b->vmas[j].start) d->moved++;
+        }
+        free(head);
+        free(tail);
+        free(hashes);
+        free(next);
+    }
+
+    for (j = 0; j < nb; j++) {
+        const SnapshotVma* nv = &b->vmas[j];
+        const SnapshotVma* ov = d->match[j] >= 0 ? &a->vmas[d->match[j]] : NULL;
+        DiffEntry* e = &d->entries[d->num_entries];
+        e->old_idx = d->match[j];
+        e->new_idx = j;
+        for (int k = 0; k < 3; k++) e->delta[k] = (int64_t)nv->kb[g_sort_counters[k]] - (ov ? ov->kb[g_sort_counters[k]] : 0);
+        e->size_delta = (int64_t)(nv->end - nv->start) - (int64_t)(ov ? ov->end - ov->start : 0);
+        e->start = nv->start;
+        // Unchanged pairs are dropped here rather than sorted
+        if (ov == NULL || e->delta[0] || e->delta[1] || e->delta[2] || e->size_delta || ov->start != nv->start)
+            d->num_entries++;
+    }
+    for (i = 0; i < na; i++) {
+        if (d->used[i]) continue;
+        const SnapshotVma* ov = &a->vmas[i];
+        DiffEntry* e = &d->entries[d->num_entries++];
+        e->old_idx = i;
+        e->new_idx = -1;
+        for (int k = 0; k < 3; k++) e->delta[k] = -(int64_t)ov->kb[g_sort_counters[k]];
+        e->size_delta = -(int64_t)(ov->end - ov->start);
+        e->start = ov->start;
+    }
+    return 0;
+}
+
+static void free_diff(SnapshotDiff* d) {
+    free(d->match);
+    free(d->used);
+    free(d->entries);
+}
+
+static const char* change_name(const ProcessSnapshot* a, const ProcessSnapshot* b, const DiffEntry* e) {
+    if (e->old_idx < 0) return "new";
+    if (e->new_idx < 0) return "removed";
+    if (a->vmas[e->old_idx].start != b->vmas[e->new_idx].start) return "moved";
+    if (e->delta[g_sort_slot] > 0) return "grown";
+    if (e->delta[g_sort_slot] < 0) return "shrunk";
+    return e->size_delta ? "resized" : "changed";
+}
+
+static void output_kind_totals_json(const ProcessSnapshot* a, const ProcessSnapshot* b) {
+    long long vmas[SNAP_NUM_KINDS] = {0}, size[SNAP_NUM_KINDS] = {0};
+    long long kb[SNAP_NUM_KINDS][3] = {{0}};
+    for (int side = 0; side < 2; side++) {
+        const ProcessSnapshot* s = side ? b : a;
+        int sign = side ? 1 : -1;
+        for (uint32_t i = 0; i < s->header.num_vmas; i++) {
+            const SnapshotVma* v = &s->vmas[i];
+            SnapshotKind kind = SNAP_VMA_KIND(v);
+            if (kind >= SNAP_NUM_KINDS) continue;
+            vmas[kind] += sign;
+            size[kind] += sign * (long long)(v->end - v->start);
+            for (int k = 0; k < 3; k++) kb[kind][k] += sign * (long long)v->kb[g_sort_counters[k]];
+        }
+    }
+
+    printf("  \"by_kind\": [");
+    for (int k = 0; k < SNAP_NUM_KINDS; k++) {
+        printf("%s\n    {\"kind\": \"%s\", \"vmas_delta\": %lld, \"size_delta\": %lld, \"rss_delta\": %lld, "
+               "\"pss_delta\": %lld, \"swap_delta\": %lld}",
+               k ? "," : "", g_kind_names[k], vmas[k], size[k], kb[k][0] * 1024, kb[k][1] * 1024, kb[k][2] * 1024);
+    }
+    printf("\n  ],\n");
+}
+
+// Heap, arena and stack VMAs that grew in place, plus new arenas
+static void output_expansions_json(const ProcessSnapshot* a, const ProcessSnapshot* b, const SnapshotDiff* d,
+                                   int limit) {
+    int printed = 0;
+    printf("  \"expansions\": [");
+    for (uint32_t j = 0; j < b->header.num_vmas && printed < limit; j++) {
+        const SnapshotVma* nv = &b->vmas[j];
+        const SnapshotVma* ov = d->match[j] >= 0 ? &a->vmas[d->match[j]] : NULL;
+        SnapshotKind kind = SNAP_VMA_KIND(nv);
+        if (kind != SNAP_KIND_HEAP && kind != SNAP_KIND_ARENA && kind != SNAP_KIND_STACK) continue;
+        unsigned long long old_size = ov ? ov->end - ov->start : 0;
+        if (ov != NULL && nv->end - nv->start <= old_size) continue;
+        if (ov == NULL && kind != SNAP_KIND_ARENA) continue;
+        printf("%s\n    {\"kind\": \"%s\", \"start_addr\": \"0x%llx\", \"old_size\": %llu, \"new_size\": %llu, "
+               "\"rss_delta\": %lld}",
+               printed ? "," : "", g_kind_names[kind], (unsigned long long)nv->start, old_size,
+               (unsigned long long)(nv->end - nv->start),
+               ((long long)nv->kb[SNAP_RSS] - (ov ? (long long)ov->kb[SNAP_RSS] : 0)) * 1024);
+        printed++;
+    }
+    printf("%s],\n", printed ? "\n  " : "");
+}
+
+static void output_region_json(const ProcessSnapshot* a, const ProcessSnapshot* b, const DiffEntry* e) {
+    const SnapshotVma* ov = e->old_idx >= 0 ? &a->vmas[e->old_idx] : NULL;
+    const SnapshotVma* nv = e->new_idx >= 0 ? &b->vmas[e->new_idx] : NULL;
+    const SnapshotVma* v = nv ? nv : ov;
+    const ProcessSnapshot* s = nv ? b : a;
+
+    printf("    {\"change\": \"%s\", \"kind\": \"%s\", \"name\": ", change_name(a, b, e), g_kind_names[SNAP_VMA_KIND(v)]);
+    print_json_string(s->strings + v->name);
+    printf(", \"start_addr\": \"0x%llx\", \"end_addr\": \"0x%llx\"", (unsigned long long)v->start,
+           (unsigned long long)v->end);
+    if (ov && nv && ov->start != nv->start) printf(", \"old_start_addr\": \"0x%llx\"", (unsigned long long)ov->start);
+    printf(", \"size_delta\": %lld, \"rss\": %llu, \"rss_delta\": %lld, \"pss_delta\": %lld, \"swap_delta\": %lld",
+           (long long)e->size_delta, nv ? (unsigned long long)nv->kb[SNAP_RSS] * 1024 : 0,
+           (long long)e->delta[0] * 1024, (long long)e->delta[1] * 1024, (long long)e->delta[2] * 1024);
+    if ((a->header.flags & b->header.flags) & SNAP_HAS_RESIDENCY) {
+        printf(", \"residency_old\": \"%016llx\", \"residency_new\": \"%016llx\"",
+               ov ? (unsigned long long)ov->residency : 0, nv ? (unsigned long long)nv->residency : 0);
+    }
+    printf("}");
+}
+
+void output_snapshot_diff_json(const char* from, const char* to, SnapshotSortKey key, int limit) {
+    ProcessSnapshot a, b;
+    SnapshotDiff d;
+
+    if (from == NULL || *from == '\0') {
+        output_snapshot_list_json();
+        return;
+    }
+    if (limit <= 0) limit = SNAPSHOT_DEFAULT_TOP;
+    unsigned long long start = monotonic_ns();
+    if (load_snapshot(from, &a) != 0) {
+        printf("{\n  \"error\": \"cannot load snapshot\"\n}\n");
+        return;
+    }
+    int live = to == NULL || *to == '\0';
+    if (live ? capture_snapshot(a.header.pid, &b) != 0 : load_snapshot(to, &b) != 0) {
+        printf("{\n  \"error\": \"%s\"\n}\n", live ? "process is gone" : "cannot load snapshot");
+        free_snapshot(&a);
+        return;
+    }
+    double load_ms = (monotonic_ns() - start) / 1e6;
+
+    start = monotonic_ns();
+    g_sort_slot = key == SNAP_SORT_PSS ? 1 : key == SNAP_SORT_SWAP ? 2 : 0;
+    if (diff_snapshots(&a, &b, &d) != 0) {
+        printf("{\n  \"error\": \"out of memory\"\n}\n");
+        free_diff(&d);
+        free_snapshot(&a);
+        free_snapshot(&b);
+        return;
+    }
+    qsort(d.entries, d.num_entries, sizeof(DiffEntry), compare_entries);
+    double diff_ms = (monotonic_ns() - start) / 1e6;
+
+    uint32_t added = 0, removed = 0;
+    for (uint32_t i = 0; i < d.num_entries; i++) {
+        if (d.entries[i].old_idx < 0) added++;
+        if (d.entries[i].new_idx < 0) removed++;
+    }
+
+    static const char* sort_names[3] = { "rss", "pss", "swap" };
+    printf("{\n");
+    output_snapshot_summary_json("from", from, &a);
+    printf(",\n");
+    output_snapshot_summary_json("to", live ? "live" : to, &b);
+    printf(",\n");
+    printf("  \"sort\": \"%s\",\n", sort_names[g_sort_slot]);
+    printf("  \"load_ms\": %.3f,\n", load_ms);
+    printf("  \"diff_ms\": %.3f,\n", diff_ms);
+    printf("  \"matched\": %u,\n", d.matched);
+    printf("  \"moved\": %u,\n", d.moved);
+    printf("  \"new\": %u,\n", added);
+    printf("  \"removed\": %u,\n", removed);
+    output_kind_totals_json(&a, &b);
+    output_expansions_json(&a, &b, &d, limit);
+    printf("  \"regions\": [");
+    for (uint32_t i = 0; i < d.num_entries && i < (uint32_t)limit; i++) {
+        printf("%s\n", i ? "," : "");
+        output_region_json(&a, &b, &d.entries[i]);
+    }
+    printf("%s]\n}\n", d.num_entries ? "\n  " : "");
+
+    free_diff(&d);
+    free_snapshot(&a);
+    free_snapshot(&b);
+}
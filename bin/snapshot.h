@@ -0,0 +1,109 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// Snapshots are saved as <state dir>/snapshot-<name>.vmds
+#define SNAPSHOT_PREFIX "snapshot-"
+#define SNAPSHOT_SUFFIX ".vmds"
+#define SNAPSHOT_DEFAULT_TOP 50
+#define SNAPSHOT_MAX_LIST 256
+// glibc aligns every non-main arena heap to this size on 64-bit
+#define SNAPSHOT_ARENA_SIZE (64UL << 20)
+
+// smaps fields kept per VMA, all in kB
+#define SNAPSHOT_COUNTERS(X) \
+    X(RSS, "Rss") \
+    X(PSS, "Pss") \
+    X(SHARED_CLEAN, "Shared_Clean") \
+    X(SHARED_DIRTY, "Shared_Dirty") \
+    X(PRIVATE_CLEAN, "Private_Clean") \
+    X(PRIVATE_DIRTY, "Private_Dirty") \
+    X(REFERENCED, "Referenced") \
+    X(ANONYMOUS, "Anonymous") \
+    X(ANON_HUGE, "AnonHugePages") \
+    X(SWAP, "Swap") \
+    X(SWAP_PSS, "SwapPss") \
+    X(LOCKED, "Locked")
+
+#define SNAPSHOT_COUNTER_ENUM(id, key) SNAP_##id,
+typedef enum {
+    SNAPSHOT_COUNTERS(SNAPSHOT_COUNTER_ENUM)
+    SNAP_NUM_COUNTERS
+} SnapshotCounter;
+#undef SNAPSHOT_COUNTER_ENUM
+
+typedef enum {
+    SNAP_KIND_ANON,
+    SNAP_KIND_HEAP,
+    SNAP_KIND_ARENA,
+    SNAP_KIND_STACK,
+    SNAP_KIND_FILE,
+    SNAP_KIND_SPECIAL,              // [vdso], [vvar] and other bracketed names
+    SNAP_KIND_GUARD,                // Anonymous ---p reservations
+    SNAP_NUM_KINDS
+} SnapshotKind;
+
+#define SNAP_PERM_READ 0x1
+#define SNAP_PERM_WRITE 0x2
+#define SNAP_PERM_EXEC 0x4
+#define SNAP_PERM_SHARED 0x8
+#define SNAP_KIND_SHIFT 8
+#define SNAP_VMA_KIND(v) ((SnapshotKind)(((v)->flags >> SNAP_KIND_SHIFT) & 0xff))
+
+// On-disk record, one per VMA in address order
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t pgoff;
+    uint64_t inode;
+    uint64_t residency;             // Bit i: a page in the i-th 64th is present
+    uint32_t name;                  // Offset into the string table, 0 = none
+    uint32_t dev;
+    uint32_t flags;                 // SNAP_PERM_* | kind << SNAP_KIND_SHIFT
+    uint32_t kb[SNAP_NUM_COUNTERS];
+} SnapshotVma;
+
+#define SNAP_HAS_RESIDENCY 0x1
+
+typedef struct {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t num_counters;
+    uint32_t num_vmas;
+    uint32_t strings_size;
+    int32_t pid;
+    uint32_t flags;
+    int64_t captured_ms;
+    char comm[16];
+} SnapshotHeader;
+
+// A snapshot either captured in memory or mapped from its file
+typedef struct {
+    SnapshotHeader header;
+    SnapshotVma* vmas;
+    char* strings;                  // Offset 0 is the empty string
+    void* map;
+    size_t map_len;
+} ProcessSnapshot;
+
+typedef enum {
+    SNAP_SORT_RSS,
+    SNAP_SORT_PSS,
+    SNAP_SORT_SWAP
+} SnapshotSortKey;
+
+// Reads /proc/pid/smaps and, when readable, pagemap residency; 0 on success
+int capture_snapshot(pid_t pid, ProcessSnapshot* snap);
+int save_snapshot(const ProcessSnapshot* snap, const char* name);
+int load_snapshot(const char* name, ProcessSnapshot* snap);
+void free_snapshot(ProcessSnapshot* snap);
+int parse_snapshot_sort_key(const char* name, SnapshotSortKey* key);
+void output_snapshot_capture_json(pid_t pid, const char* name);
+// Diffs two saved snapshots; an empty to diffs against a live capture of
+// the from snapshot's process, an empty from lists saved snapshots
+void output_snapshot_diff_json(const char* from, const char* to, SnapshotSortKey key, int limit);
+
+#endif
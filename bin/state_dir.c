@@ -0,0 +1,57 @@
+#include "state_dir.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+static char g_dir[4096];
+static int g_dir_ok;
+static pthread_once_t g_dir_once = PTHREAD_ONCE_INIT;
+
+static void init_state_dir(void) {
+    const char* env = getenv("VMD_STATE_DIR");
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    int n;
+    if (env != NULL && *env != '\0')
+        n = snprintf(g_dir, sizeof(g_dir), "%s", env);
+    else if (runtime != NULL && *runtime == '/')
+        n = snprintf(g_dir, sizeof(g_dir), "%s/vmd", runtime);
+    else
+        n = snprintf(g_dir, sizeof(g_dir), VMD_DEFAULT_STATE_DIR "%u", (unsigned)geteuid());
+    if (n < 0 || (size_t)n >= sizeof(g_dir)) return;
+
+    // A directory someone else created first, or a symlink planted in its
+    // place, is refused rather than written through
+    struct stat st;
+    mkdir(g_dir, 0700);
+    g_dir_ok = lstat(g_dir, &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == geteuid() &&
+               (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+    if (!g_dir_ok) fprintf(stderr, "vmd: refusing state directory %s\n", g_dir);
+}
+
+const char* vmd_state_dir(void) {
+    pthread_once(&g_dir_once, init_state_dir);
+    return g_dir_ok ? g_dir : NULL;
+}
+
+int vmd_state_path(char* buf, size_t len, const char* name) {
+    const char* dir = vmd_state_dir();
+    if (dir == NULL) return -1;
+    int n = snprintf(buf, len, "%s/%s", dir, name);
+    return n < 0 || (size_t)n >= len ? -1 : 0;
+}
+
+FILE* vmd_state_fopen(const char* path, const char* mode) {
+    int flags;
+    if (mode[0] == 'r') flags = O_RDONLY;
+    else if (mode[0] == 'a') flags = O_WRONLY | O_CREAT | O_APPEND;
+    else flags = O_WRONLY | O_CREAT | O_TRUNC;
+    int fd = open(path, flags | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) return NULL;
+    FILE* f = fdopen(fd, mode);
+    if (f == NULL) close(fd);
+    return f;
+}
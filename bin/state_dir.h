@@ -0,0 +1,23 @@
+#ifndef STATE_DIR_H
+#define STATE_DIR_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Per-user default under /tmp; the effective uid is appended
+#define VMD_DEFAULT_STATE_DIR "/tmp/vmd-"
+
+// Directory for results that outlive one vmd run: $VMD_STATE_DIR, else
+// $XDG_RUNTIME_DIR/vmd, else /tmp/vmd-<uid>. Created 0700 on first use.
+// vmd usually runs as root and writes fixed names there, so NULL is
+// returned unless it is a real directory (not a symlink) owned by this
+// user and not writable by group or others
+const char* vmd_state_dir(void);
+// Writes <state dir>/<name> into buf; returns -1 if it does not fit or
+// the directory was refused
+int vmd_state_path(char* buf, size_t len, const char* name);
+// fopen for paths in the state dir ("r", "w", "wb" or "a"): never follows
+// a symlink at the last component and creates files 0600
+FILE* vmd_state_fopen(const char* path, const char* mode);
+
+#endif
@@ -0,0 +1,254 @@
+#include "swap.h"
+#include "vmstat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#define SWAP_PAGEMAP_BATCH 1024
+#define SWAP_RATE_INTERVAL_MS 250
+
+int read_swap_devices(SwapDevice* devices, int max) {
+    char line[512];
+    int count = 0;
+    FILE* f = fopen("/proc/swaps", "r");
+    if (f == NULL) return 0;
+
+    // Skip the header; sizes are in kB
+    if (fgets(line, sizeof(line), f) == NULL) {
+        fclose(f);
+        return 0;
+    }
+    while (count < max && fgets(line, sizeof(line), f)) {
+        SwapDevice* d = &devices[count];
+        unsigned long size, used;
+        if (sscanf(line, "%127s %15s %lu %lu %d", d->filename, d->type, &size, &used, &d->priority) != 5)
+            continue;
+        d->size = size * 1024;
+        d->used = used * 1024;
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+static int compare_regions(const void* a, const void* b) {
+    const SwapRegion* ra = a;
+    const SwapRegion* rb = b;
+    if (ra->swapped_pages != rb->swapped_pages) return ra->swapped_pages < rb->swapped_pages ? 1 : -1;
+    return 0;
+}
+
+// Walks pagemap for every VMA of pid and keeps those with swapped pages,
+// largest first. Without CAP_SYS_ADMIN the kernel zeroes the swap type and
+// offset; offset 0 is the swap header, so all-zero offsets mean "hidden".
+int scan_swapped_regions(pid_t pid, SwapRegion* regions, int max) {
+    char path[64], line[512];
+    unsigned long long entries[SWAP_PAGEMAP_BATCH];
+    long page_size = sysconf(_SC_PAGESIZE);
+    int count = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)pid);
+    int pagemap = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+    FILE* maps = fopen(path, "r");
+    if (pagemap < 0 || maps == NULL) {
+        if (pagemap >= 0) close(pagemap);
+        if (maps != NULL) fclose(maps);
+        return -1;
+    }
+
+    while (count < max && fgets(line, sizeof(line), maps)) {
+        SwapRegion region;
+        memset(&region, 0, sizeof(region));
+        region.swap_type = -1;
+        if (sscanf(line, "%lx-%lx %4s %*s %*s %*s %127[^\n]", &region.start_addr,
+                   &region.end_addr, region.perms, region.mapped_file) < 3)
+            continue;
+        if (strcmp(region.mapped_file, "[vsyscall]") == 0) continue;
+
+        size_t type_pages[32] = {0};
+        int offsets_visible = 0;
+        unsigned long first = region.start_addr / page_size;
+        unsigned long last = region.end_addr / page_size;
+        for (unsigned long page = first; page < last; page += SWAP_PAGEMAP_BATCH) {
+            size_t want = last - page < SWAP_PAGEMAP_BATCH ? last - page : SWAP_PAGEMAP_BATCH;
+            ssize_t n = pread(pagemap, entries, want * sizeof(entries[0]), page * sizeof(entries[0]));
+            if (n <= 0) break;
+            for (size_t i = 0; i < (size_t)n / sizeof(entries[0]); i++) {
+                unsigned long long e = entries[i];
+                if (e & PM_PRESENT) {
+                    region.present_pages++;
+                } else if (e & PM_SWAPPED) {
+                    region.swapped_pages++;
+                    type_pages[PM_SWAP_TYPE(e)]++;
+                    if (PM_SWAP_OFFSET(e) != 0) offsets_visible = 1;
+                }
+            }
+        }
+        if (region.swapped_pages == 0) continue;
+
+        if (offsets_visible) {
+            region.swap_type = 0;
+            for (int t = 1; t < 32; t++) {
+                if (type_pages[t] > type_pages[region.swap_type]) region.swap_type = t;
+            }
+        }
+        regions[count++] = region;
+    }
+
+    close(pagemap);
+    fclose(maps);
+    qsort(regions, count, sizeof(SwapRegion), compare_regions);
+    return count;
+}
+
+static unsigned long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void read_swap_rates(double* swap_in, double* swap_out) {
+    static VmstatSnapshot vmstat;
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&lock);
+    int ok = vmstat_sample(&vmstat) == 0;
+    *swap_in = ok ? vmstat.rate[VMSTAT_PSWPIN] : 0;
+    *swap_out = ok ? vmstat.rate[VMSTAT_PSWPOUT] : 0;
+    pthread_mutex_unlock(&lock);
+}
+
+static int read_sysfs_string(const char* path, char* buf, size_t len) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return -1;
+    int ok = fgets(buf, len, f) != NULL;
+    fclose(f);
+    if (!ok) return -1;
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+static size_t meminfo_bytes(const char* field) {
+    char line[256], key[64];
+    unsigned long value;
+    size_t bytes = 0;
+    FILE* f = fopen("/proc/meminfo", "r");
+    if (f == NULL) return 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%63[^:]: %lu", key, &value) == 2 && strcmp(key, field) == 0) {
+            bytes = value * 1024;
+            break;
+        }
+    }
+    fclose(f);
+    return bytes;
+}
+
+// Pool size comes from meminfo on 5.19+, debugfs on older kernels
+static void output_zswap_json(void) {
+    char enabled[16], compressor[32], max_pool[16], buf[64];
+
+    if (read_sysfs_string("/sys/module/zswap/parameters/enabled", enabled, sizeof(enabled)) != 0) {
+        printf("  \"zswap\": {\"available\": false},\n");
+        return;
+    }
+    if (read_sysfs_string("/sys/module/zswap/parameters/compressor", compressor, sizeof(compressor)) != 0)
+        strcpy(compressor, "");
+    if (read_sysfs_string("/sys/module/zswap/parameters/max_pool_percent", max_pool, sizeof(max_pool)) != 0)
+        strcpy(max_pool, "0");
+
+    size_t pool = meminfo_bytes("Zswap");
+    size_t stored = meminfo_bytes("Zswapped");
+    if (pool == 0 && read_sysfs_string("/sys/kernel/debug/zswap/pool_total_size", buf, sizeof(buf)) == 0)
+        pool = strtoull(buf, NULL, 10);
+    if (stored == 0 && read_sysfs_string("/sys/kernel/debug/zswap/stored_pages", buf, sizeof(buf)) == 0)
+        stored = strtoull(buf, NULL, 10) * sysconf(_SC_PAGESIZE);
+
+    printf("  \"zswap\": {\"available\": true, \"enabled\": %s, \"compressor\": \"%s\", "
+           "\"max_pool_percent\": %d, \"pool_bytes\": %zu, \"stored_bytes\": %zu, \"ratio\": %.2f},\n",
+           enabled[0] == 'Y' || enabled[0] == '1' ? "true" : "false", compressor, atoi(max_pool),
+           pool, stored, pool ? (double)stored / pool : 0.0);
+}
+
+static void output_zram_json(void) {
+    char path[300], buf[256];
+    int first = 1;
+
+    printf("  \"zram\": [");
+    DIR* dir = opendir("/sys/block");
+    if (dir != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strncmp(entry->d_name, "zram", 4) != 0) continue;
+
+            // mm_stat: orig_data_size compr_data_size mem_used_total ...
+            unsigned long long orig = 0, compr = 0, used = 0, disksize = 0;
+            snprintf(path, sizeof(path), "/sys/block/%s/mm_stat", entry->d_name);
+            if (read_sysfs_string(path, buf, sizeof(buf)) == 0)
+                sscanf(buf, "%llu %llu %llu", &orig, &compr, &used);
+            snprintf(path, sizeof(path), "/sys/block/%s/disksize", entry->d_name);
+            if (read_sysfs_string(path, buf, sizeof(buf)) == 0) disksize = strtoull(buf, NULL, 10);
+
+            printf("%s{\"device\": \"%s\", \"disksize\": %llu, \"orig_data_size\": %llu, "
+                   "\"compr_data_size\": %llu, \"mem_used_total\": %llu, \"ratio\": %.2f}",
+                   first ? "" : ", ", entry->d_name, disksize, orig, compr, used,
+                   compr ? (double)orig / compr : 0.0);
+            first = 0;
+        }
+        closedir(dir);
+    }
+    printf("],\n");
+}
+
+void output_swap_json(pid_t pid, int limit) {
+    SwapDevice devices[SWAP_MAX_DEVICES];
+    double swap_in, swap_out;
+    unsigned long long start = monotonic_ns();
+
+    read_swap_rates(&swap_in, &swap_out);
+    int num_devices = read_swap_devices(devices, SWAP_MAX_DEVICES);
+    SwapRegion* regions = malloc(SWAP_MAX_REGIONS * sizeof(SwapRegion));
+    int num_regions = regions ? scan_swapped_regions(pid, regions, SWAP_MAX_REGIONS) : -1;
+
+    // Rates need two vmstat samples; the region scan counts toward the wait
+    unsigned long long elapsed_ms = (monotonic_ns() - start) / 1000000;
+    if (elapsed_ms < SWAP_RATE_INTERVAL_MS) usleep((SWAP_RATE_INTERVAL_MS - elapsed_ms) * 1000);
+    read_swap_rates(&swap_in, &swap_out);
+
+    printf("{\n");
+    printf("  \"devices\": [");
+    for (int i = 0; i < num_devices; i++) {
+        printf("%s\n    {\"filename\": \"%s\", \"type\": \"%s\", \"size\": %zu, \"used\": %zu, \"priority\": %d}",
+               i ? "," : "", devices[i].filename, devices[i].type, devices[i].size,
+               devices[i].used, devices[i].priority);
+    }
+    printf("%s],\n", num_devices ? "\n  " : "");
+    output_zswap_json();
+    output_zram_json();
+    printf("  \"rates\": {\"swap_in_pages_per_sec\": %.1f, \"swap_out_pages_per_sec\": %.1f},\n",
+           swap_in, swap_out);
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t swapped = 0;
+    for (int i = 0; i < num_regions; i++) swapped += regions[i].swapped_pages * page_size;
+    if (limit <= 0) limit = SWAP_DEFAULT_TOP;
+
+    printf("  \"process\": {\"pid\": %d, \"readable\": %s, \"swapped_bytes\": %zu, \"swapped_regions\": %d, \"regions\": [",
+           (int)pid, num_regions >= 0 ? "true" : "false", swapped, num_regions > 0 ? num_regions : 0);
+    for (int i = 0; i < num_regions && i < limit; i++) {
+        SwapRegion* r = &regions[i];
+        const char* device = r->swap_type >= 0 && r->swap_type < num_devices ? devices[r->swap_type].filename : "";
+        printf("%s\n    {\"start\": \"0x%lx\", \"end\": \"0x%lx\", \"perms\": \"%s\", \"file\": \"%s\", "
+               "\"swapped_bytes\": %zu, \"present_bytes\": %zu, \"swap_type\": %d, \"device\": \"%s\"}",
+               i ? "," : "", r->start_addr, r->end_addr, r->perms, r->mapped_file,
+               r->swapped_pages * page_size, r->present_pages * page_size, r->swap_type, device);
+    }
+    printf("%s]}\n}\n", num_regions > 0 ? "\n  " : "");
+    free(regions);
+}
@@ -0,0 +1,26 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "memory_types.h"
+#include <sys/types.h>
+
+#define SWAP_MAX_DEVICES 32
+#define SWAP_MAX_REGIONS 4096
+#define SWAP_DEFAULT_TOP 50
+
+// pagemap entry bits, see Documentation/admin-guide/mm/pagemap.rst
+#define PM_PRESENT (1ULL << 63)
+#define PM_SWAPPED (1ULL << 62)
+#define PM_SOFT_DIRTY (1ULL << 55)
+#define PM_PFN_MASK ((1ULL << 55) - 1)
+#define PM_SWAP_TYPE(e) ((int)((e) & 0x1f))
+#define PM_SWAP_OFFSET(e) (((e) & PM_PFN_MASK) >> 5)
+
+int read_swap_devices(SwapDevice* devices, int max);
+// Swapped pages per VMA of pid; returns the number of regions or -1
+int scan_swapped_regions(pid_t pid, SwapRegion* regions, int max);
+// pswpin / pswpout per second since the previous call (0 on the first)
+void read_swap_rates(double* swap_in, double* swap_out);
+void output_swap_json(pid_t pid, int limit);
+
+#endif
@@ -0,0 +1,236 @@
+#define _GNU_SOURCE
+#include "tlb_bench.h"
+#include "bench_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define TLB_PAGE 4096UL
+#define TLB_HUGE_PAGE (2UL << 20)
+#define TLB_MIN_BYTES (64UL << 10)
+#define TLB_DEFAULT_MAX (512UL << 20)
+#define TLB_LOADS (1UL << 20)
+#define TLB_CHUNKS 4
+#define TLB_KNEE_RISE 1.3
+
+typedef enum { BACKING_4K, BACKING_THP, BACKING_HUGETLB, NUM_BACKINGS } Backing;
+
+static const char* g_backing_names[NUM_BACKINGS] = { "4k", "thp", "hugetlb" };
+
+static void* volatile g_tlb_sink;
+
+int page_table_levels(void) {
+    static int levels = 0;
+    if (levels) return levels;
+
+    // The kernel only honours a hint above 47 bits with 5-level paging
+    void* hint = (void*)(1UL << 48);
+    void* addr = mmap(hint, TLB_PAGE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    levels = addr != MAP_FAILED && (unsigned long)addr >= (1UL << 47) ? 5 : 4;
+    if (addr != MAP_FAILED) munmap(addr, TLB_PAGE);
+    return levels;
+}
+
+static void read_thp_mode(char* buf, size_t len) {
+    char line[128];
+    snprintf(buf, len, "unavailable");
+    FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (f == NULL) return;
+    if (fgets(line, sizeof(line), f) != NULL) {
+        char* open = strchr(line, '[');
+        char* close = open ? strchr(open, ']') : NULL;
+        if (close != NULL) snprintf(buf, len, "%.*s", (int)(close - open - 1), open + 1);
+    }
+    fclose(f);
+}
+
+static long hugetlb_free_pages(void) {
+    char line[128];
+    long free_pages = 0;
+    FILE* f = fopen("/proc/meminfo", "r");
+    if (f == NULL) return 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "HugePages_Free: %ld", &free_pages) == 1) break;
+    }
+    fclose(f);
+    return free_pages;
+}
+
+static char* map_backing(Backing backing, size_t bytes) {
+    char* addr;
+    if (backing == BACKING_HUGETLB) {
+        addr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        return addr == MAP_FAILED ? NULL : addr;
+    }
+
+    // Over-map so THP can back the region from its first byte
+    char* raw = mmap(NULL, bytes + TLB_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    addr = (char*)(((unsigned long)raw + TLB_HUGE_PAGE - 1) & ~(TLB_HUGE_PAGE - 1));
+    if (addr > raw) munmap(raw, addr - raw);
+    munmap(addr + bytes, raw + TLB_HUGE_PAGE - addr);
+    madvise(addr, bytes, backing == BACKING_THP ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    return addr;
+}
+
+// The line touched in each 4 KB page is a hash of the whole page number.
+// Huge pages are physically contiguous, so a line offset that repeated
+// with the low page bits would pile every access into a few cache sets;
+// every backing touches the same lines, so only translation cost differs
+static inline char* page_slot(char* buf, size_t page) {
+    return buf + page * TLB_PAGE + (((page * 0x9E3779B97F4A7C15ULL) >> 58) << 6);
+}
+
+static double chase_pages(char* buf, size_t pages, int random, uint64_t* seed) {
+    if (random) {
+        // Sattolo's shuffle: one cycle through every page
+        for (size_t i = 0; i < pages; i++) *(size_t*)page_slot(buf, i) = i;
+        for (size_t i = pages - 1; i > 0; i--) {
+            size_t j = next_random(seed) % i;
+            size_t* a = (size_t*)page_slot(buf, i);
+            size_t* b = (size_t*)page_slot(buf, j);
+            size_t tmp = *a;
+            *a = *b;
+            *b = tmp;
+        }
+        for (size_t i = 0; i < pages; i++) {
+            char** slot = (char**)page_slot(buf, i);
+            *slot = page_slot(buf, *(size_t*)slot);
+        }
+    } else {
+        for (size_t i = 0; i < pages; i++) *(char**)page_slot(buf, i) = page_slot(buf, (i + 1) % pages);
+    }
+
+    char** p = (char**)page_slot(buf, 0);
+    size_t warm = pages < TLB_LOADS ? pages : TLB_LOADS;
+    for (size_t i = 0; i < warm; i++) p = (char**)*p;
+
+    // Best of several chunks, so a preemption does not fake a knee
+    uint64_t best = UINT64_MAX;
+    for (int chunk = 0; chunk < TLB_CHUNKS; chunk++) {
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < TLB_LOADS / TLB_CHUNKS; i++) p = (char**)*p;
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    g_tlb_sink = p;
+    return (double)best / (TLB_LOADS / TLB_CHUNKS);
+}
+
+static void find_knee(TlbSeries* s) {
+    if (s->num_points == 0) return;
+    s->base_ns = s->points[0].ns;
+    for (int i = 1; i < s->num_points && i < 3; i++) {
+        if (s->points[i].ns < s->base_ns) s->base_ns = s->points[i].ns;
+    }
+    s->knee_bytes = s->points[s->num_points - 1].bytes;
+    // Two points in a row above the threshold mark the knee
+    for (int i = 1; i + 1 < s->num_points; i++) {
+        if (s->points[i].ns > s->base_ns * TLB_KNEE_RISE && s->points[i + 1].ns > s->base_ns * TLB_KNEE_RISE) {
+            s->knee_bytes = s->points[i - 1].bytes;
+            break;
+        }
+    }
+}
+
+int run_tlb_bench(TlbSeries* series, int max, size_t max_bytes) {
+    size_t avail = (size_t)sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+    uint64_t seed = 0x9E3779B97F4A7C15ULL ^ now_ns();
+    char thp_mode[32];
+    int count = 0;
+
+    if (max_bytes == 0) max_bytes = TLB_DEFAULT_MAX;
+    if (avail && max_bytes > avail / 2) max_bytes = avail / 2;
+    max_bytes &= ~(TLB_HUGE_PAGE - 1);
+    if (max_bytes < TLB_HUGE_PAGE) max_bytes = TLB_HUGE_PAGE;
+    read_thp_mode(thp_mode, sizeof(thp_mode));
+
+    for (int b = 0; b < NUM_BACKINGS && count + 2 <= max; b++) {
+        TlbSeries* pair = &series[count];
+        count += 2;
+        memset(pair, 0, 2 * sizeof(TlbSeries));
+        for (int r = 0; r < 2; r++) {
+            snprintf(pair[r].backing, sizeof(pair[r].backing), "%s", g_backing_names[b]);
+            snprintf(pair[r].pattern, sizeof(pair[r].pattern), "%s", r ? "random" : "strided");
+            pair[r].page_size = b == BACKING_4K ? TLB_PAGE : TLB_HUGE_PAGE;
+        }
+        if (b == BACKING_THP && strcmp(thp_mode, "never") == 0) continue;
+
+        // hugetlb is limited to what the reserved pool can back
+        size_t bytes = max_bytes;
+        if (b == BACKING_HUGETLB && bytes > (size_t)hugetlb_free_pages() * TLB_HUGE_PAGE)
+            bytes = (size_t)hugetlb_free_pages() * TLB_HUGE_PAGE;
+        char* buf = bytes ? map_backing(b, bytes) : NULL;
+        if (buf == NULL) continue;
+        // Populate up front so no point pays for faults
+        for (size_t off = 0; off < bytes; off += TLB_PAGE) buf[off] = 0;
+        for (int r = 0; r < 2; r++) {
+            pair[r].available = 1;
+            // Working sets grow by alternating factors of 1.5 and 4/3
+            for (int k = 0; pair[r].num_points < TLB_MAX_POINTS; k++) {
+                size_t set = TLB_MIN_BYTES << (k / 2);
+                if (k & 1) set += set / 2;
+                if (set > bytes) break;
+                LatencyPoint* p = &pair[r].points[pair[r].num_points++];
+                p->bytes = set;
+                p->ns = chase_pages(buf, set / TLB_PAGE, r, &seed);
+            }
+            find_knee(&pair[r]);
+        }
+        munmap(buf, bytes);
+    }
+    return count;
+}
+
+static const TlbSeries* find_series(const TlbSeries* series, int count, const char* backing, const char* pattern) {
+    for (int i = 0; i < count; i++) {
+        if (series[i].available && strcmp(series[i].backing, backing) == 0 &&
+            strcmp(series[i].pattern, pattern) == 0)
+            return &series[i];
+    }
+    return NULL;
+}
+
+// Ratio of 4 KB to huge page latency at the largest common working set
+static double speedup(const TlbSeries* base, const TlbSeries* huge) {
+    if (base == NULL || huge == NULL) return 0;
+    int n = base->num_points < huge->num_points ? base->num_points : huge->num_points;
+    if (n == 0 || huge->points[n - 1].ns <= 0) return 0;
+    return base->points[n - 1].ns / huge->points[n - 1].ns;
+}
+
+void output_tlb_bench_json(size_t max_bytes) {
+    static TlbSeries series[TLB_MAX_SERIES];
+    char thp_mode[32];
+    read_thp_mode(thp_mode, sizeof(thp_mode));
+    long huge_free = hugetlb_free_pages();
+    int count = run_tlb_bench(series, TLB_MAX_SERIES, max_bytes);
+
+    printf("{\n");
+    printf("  \"page_table_levels\": %d,\n", page_table_levels());
+    printf("  \"thp_mode\": \"%s\",\n", thp_mode);
+    printf("  \"hugetlb_free_pages\": %ld,\n", huge_free);
+    printf("  \"series\": [");
+    for (int i = 0; i < count; i++) {
+        const TlbSeries* s = &series[i];
+        printf("%s\n    {\"backing\": \"%s\", \"pattern\": \"%s\", \"available\": %s, \"page_size\": %zu, "
+               "\"knee_bytes\": %zu, \"knee_pages\": %zu, \"base_ns\": %.2f, \"points\": [",
+               i ? "," : "", s->backing, s->pattern, s->available ? "true" : "false", s->page_size,
+               s->knee_bytes, s->knee_bytes / s->page_size, s->base_ns);
+        for (int p = 0; p < s->num_points; p++)
+            printf("%s{\"bytes\": %zu, \"ns\": %.2f}", p ? ", " : "", s->points[p].bytes, s->points[p].ns);
+        printf("]}");
+    }
+    printf("%s],\n", count ? "\n  " : "");
+
+    const TlbSeries* base = find_series(series, count, "4k", "random");
+    printf("  \"speedup\": {\"thp_random\": %.2f, \"hugetlb_random\": %.2f, \"thp_strided\": %.2f, "
+           "\"hugetlb_strided\": %.2f}\n",
+           speedup(base, find_series(series, count, "thp", "random")),
+           speedup(base, find_series(series, count, "hugetlb", "random")),
+           speedup(find_series(series, count, "4k", "strided"), find_series(series, count, "thp", "strided")),
+           speedup(find_series(series, count, "4k", "strided"), find_series(series, count, "hugetlb", "strided")));
+    printf("}\n");
+}
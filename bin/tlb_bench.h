@@ -0,0 +1,28 @@
+#ifndef TLB_BENCH_H
+#define TLB_BENCH_H
+
+#include "cache_probe.h"
+
+#define TLB_MAX_POINTS 40
+#define TLB_MAX_SERIES 6
+
+typedef struct {
+    char backing[8];        // 4k, thp or hugetlb
+    char pattern[8];        // strided or random
+    int available;
+    size_t page_size;
+    size_t knee_bytes;      // Largest working set still at base latency
+    double base_ns;
+    int num_points;
+    LatencyPoint points[TLB_MAX_POINTS];
+} TlbSeries;
+
+// Depth of this process's page tables: 5 when the kernel hands out
+// addresses above 47 bits, else 4
+int page_table_levels(void);
+// One access per 4 KB page over growing working sets, for every backing
+// and pattern; 0 picks the default max_bytes
+int run_tlb_bench(TlbSeries* series, int max, size_t max_bytes);
+void output_tlb_bench_json(size_t max_bytes);
+
+#endif
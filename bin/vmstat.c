@@ -0,0 +1,152 @@
+#include "vmstat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define VMSTAT_MAX_LINES 1024
+#define VMSTAT_UNTRACKED -1
+
+#define VMSTAT_NAME(id, key) key,
+static const char* g_counter_names[] = { VMSTAT_COUNTERS(VMSTAT_NAME) };
+#undef VMSTAT_NAME
+
+// /proc/vmstat stays open and is re-read with pread. Its line order is
+// fixed for the life of the kernel, so the first read learns which line
+// holds which counter and later reads only parse the values of those
+// lines, checking the key to detect a layout change.
+static int g_fd = -1;
+static char* g_buf = NULL;
+static size_t g_buf_cap = 0;
+static short g_layout[VMSTAT_MAX_LINES];
+static int g_layout_lines = 0;
+static pthread_mutex_t g_vmstat_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int find_counter(const char* key, size_t len) {
+    for (int c = 0; c < VMSTAT_NUM_COUNTERS; c++) {
+        if (strlen(g_counter_names[c]) == len && memcmp(g_counter_names[c], key, len) == 0) return c;
+    }
+    return VMSTAT_UNTRACKED;
+}
+
+static int parse_counters(unsigned long long* values, int learn) {
+    const char* p = g_buf;
+    int line = 0;
+
+    while (*p && line < VMSTAT_MAX_LINES) {
+        const char* space = strchr(p, ' ');
+        if (space == NULL) break;
+        size_t len = space - p;
+
+        int c;
+        if (learn) {
+            c = find_counter(p, len);
+            g_layout[line] = c;
+        } else {
+            if (line >= g_layout_lines) return -1;
+            c = g_layout[line];
+            if (c != VMSTAT_UNTRACKED &&
+                (strlen(g_counter_names[c]) != len || memcmp(g_counter_names[c], p, len) != 0))
+                return -1;
+        }
+        if (c != VMSTAT_UNTRACKED) values[c] = strtoull(space + 1, NULL, 10);
+
+        p = strchr(space, '\n');
+        if (p == NULL) break;
+        p++;
+        line++;
+    }
+
+    if (learn) g_layout_lines = line;
+    return learn || line == g_layout_lines ? 0 : -1;
+}
+
+static int read_counters(unsigned long long* values) {
+    pthread_mutex_lock(&g_vmstat_mutex);
+    if (g_fd < 0) g_fd = open("/proc/vmstat", O_RDONLY | O_CLOEXEC);
+    if (g_fd < 0) {
+        pthread_mutex_unlock(&g_vmstat_mutex);
+        return -1;
+    }
+
+    // Grow the buffer until the whole file fits in one read
+    ssize_t n;
+    while (1) {
+        if (g_buf_cap == 0) {
+            g_buf_cap = 8192;
+            g_buf = malloc(g_buf_cap);
+        }
+        if (g_buf == NULL) {
+            g_buf_cap = 0;
+            pthread_mutex_unlock(&g_vmstat_mutex);
+            return -1;
+        }
+        n = pread(g_fd, g_buf, g_buf_cap - 1, 0);
+        if (n < 0 || (size_t)n < g_buf_cap - 1) break;
+        char* bigger = realloc(g_buf, g_buf_cap * 2);
+        if (bigger == NULL) break;
+        g_buf = bigger;
+        g_buf_cap *= 2;
+    }
+    if (n <= 0) {
+        pthread_mutex_unlock(&g_vmstat_mutex);
+        return -1;
+    }
+    g_buf[n] = '\0';
+
+    memset(values, 0, VMSTAT_NUM_COUNTERS * sizeof(values[0]));
+    if (g_layout_lines == 0 || parse_counters(values, 0) != 0) {
+        memset(values, 0, VMSTAT_NUM_COUNTERS * sizeof(values[0]));
+        parse_counters(values, 1);
+    }
+    pthread_mutex_unlock(&g_vmstat_mutex);
+    return 0;
+}
+
+int vmstat_sample(VmstatSnapshot* snap) {
+    unsigned long long values[VMSTAT_NUM_COUNTERS];
+    struct timespec now;
+
+    if (read_counters(values) != 0) return -1;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int first = snap->taken.tv_sec == 0 && snap->taken.tv_nsec == 0;
+    snap->interval_s = first ? 0 : (now.tv_sec - snap->taken.tv_sec) +
+                                   (now.tv_nsec - snap->taken.tv_nsec) / 1e9;
+    for (int c = 0; c < VMSTAT_NUM_COUNTERS; c++) {
+        snap->delta[c] = !first && values[c] > snap->value[c] ? values[c] - snap->value[c] : 0;
+        snap->rate[c] = snap->interval_s > 0 ? snap->delta[c] / snap->interval_s : 0;
+        snap->value[c] = values[c];
+    }
+    snap->taken = now;
+    return 0;
+}
+
+const char* vmstat_counter_name(VmstatCounter counter) {
+    return counter >= 0 && counter < VMSTAT_NUM_COUNTERS ? g_counter_names[counter] : "";
+}
+
+static double ratio(unsigned long long part, unsigned long long whole) {
+    return whole ? (double)part / whole : 0.0;
+}
+
+void output_vmstat_json(const VmstatSnapshot* snap) {
+    printf("  \"vmstat\": {\"interval_s\": %.3f, \"counters\": {", snap->interval_s);
+    for (int c = 0; c < VMSTAT_NUM_COUNTERS; c++) {
+        printf("%s\"%s\": {\"value\": %llu, \"delta\": %llu, \"rate\": %.2f}",
+               c ? ", " : "", g_counter_names[c], snap->value[c], snap->delta[c], snap->rate[c]);
+    }
+
+    // Pages reclaimed per page scanned over the interval; low values mean
+    // reclaim is working hard for little gain
+    printf("}, \"reclaim\": {\"kswapd_efficiency\": %.3f, \"direct_efficiency\": %.3f, "
+           "\"direct_scan_share\": %.3f}, \"thp_fallback_ratio\": %.3f}",
+           ratio(snap->delta[VMSTAT_PGSTEAL_KSWAPD], snap->delta[VMSTAT_PGSCAN_KSWAPD]),
+           ratio(snap->delta[VMSTAT_PGSTEAL_DIRECT], snap->delta[VMSTAT_PGSCAN_DIRECT]),
+           ratio(snap->delta[VMSTAT_PGSCAN_DIRECT],
+                 snap->delta[VMSTAT_PGSCAN_DIRECT] + snap->delta[VMSTAT_PGSCAN_KSWAPD]),
+           ratio(snap->delta[VMSTAT_THP_FAULT_FALLBACK],
+                 snap->delta[VMSTAT_THP_FAULT_ALLOC] + snap->delta[VMSTAT_THP_FAULT_FALLBACK]));
+}
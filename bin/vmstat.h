@@ -0,0 +1,17 @@
+#ifndef VMSTAT_H
+#define VMSTAT_H
+
+#include "memory_types.h"
+
+// One-shot runs wait at least this long between samples so rates are
+// not computed over a few microseconds
+#define VMSTAT_MIN_INTERVAL_MS 100
+
+// Reads /proc/vmstat and updates snap with values, deltas and rates since
+// its previous sample. The first sample of a snapshot has zero deltas.
+int vmstat_sample(VmstatSnapshot* snap);
+const char* vmstat_counter_name(VmstatCounter counter);
+// Prints "  \"vmstat\": {...}" without a trailing newline
+void output_vmstat_json(const VmstatSnapshot* snap);
+
+#endif
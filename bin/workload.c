@@ -0,0 +1,440 @@
+// vmd_workload: reproducible memory load for exercising the dashboard.
+// Each thread maps chunks until its share of the target RSS is reached,
+// timing the first touch of every page, and runs the selected access
+// pattern over its chunks in between. Reports are printed as JSON lines.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define WL_MAX_THREADS 64
+#define WL_MAX_CHUNKS 4096
+#define WL_HIST_BUCKETS 40
+#define WL_LINE 64
+#define WL_HUGE_PAGE (2UL << 20)
+// Work between checks of the clock and the stop flag
+#define WL_SLICE_BYTES (1UL << 20)
+
+typedef enum {
+    PATTERN_SEQ,
+    PATTERN_RANDOM,
+    PATTERN_STRIDED,
+    PATTERN_CHASE,
+    PATTERN_THP,
+    PATTERN_MADVISE
+} Pattern;
+
+static const char* g_pattern_names[] = { "seq", "random", "strided", "chase", "thp", "madvise" };
+
+typedef struct {
+    Pattern pattern;
+    int threads;
+    size_t chunk_bytes;
+    size_t target_bytes;
+    unsigned int interval_ms;
+    size_t stride;
+    unsigned int duration_s;
+    unsigned int report_ms;
+    unsigned long seed;
+} WorkloadConfig;
+
+typedef struct {
+    char* addr;
+    size_t len;
+} Chunk;
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    unsigned long long rng;
+    Chunk chunks[WL_MAX_CHUNKS];
+    int num_chunks;
+    size_t mapped;
+    int stride_chunk;               // Where the strided walk resumes
+    size_t stride_off;
+
+    // Read by the reporter; updated with relaxed atomics
+    unsigned long long bytes_accessed;
+    unsigned long long chase_hops;
+    unsigned long long chase_ns;
+    unsigned long long faults;
+    unsigned long long fault_ns;
+    unsigned long long madvise_calls;
+    unsigned long long fault_hist[WL_HIST_BUCKETS];
+} Worker;
+
+static WorkloadConfig g_config = {
+    .pattern = PATTERN_SEQ,
+    .threads = 1,
+    .chunk_bytes = 16UL << 20,
+    .target_bytes = 256UL << 20,
+    .interval_ms = 0,
+    .stride = 4096,
+    .duration_s = 0,
+    .report_ms = 1000,
+    .seed = 1,
+};
+static Worker g_workers[WL_MAX_THREADS];
+static volatile sig_atomic_t g_stop = 0;
+static volatile unsigned long long g_sink;
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long xorshift(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static inline int log2_bucket(unsigned long long value) {
+    int bucket = 63 - __builtin_clzll(value | 1);
+    return bucket < WL_HIST_BUCKETS ? bucket : WL_HIST_BUCKETS - 1;
+}
+
+static void handle_stop(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+// Links every cache line of the chunk into one random cycle (Sattolo)
+static void build_chase(Worker* w, Chunk* c) {
+    size_t lines = c->len / WL_LINE;
+    size_t* order = malloc(lines * sizeof(size_t));
+    if (order == NULL) return;
+    for (size_t i = 0; i < lines; i++) order[i] = i;
+    for (size_t i = lines - 1; i > 0; i--) {
+        size_t j = xorshift(&w->rng) % i;
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (size_t i = 0; i < lines; i++)
+        *(char**)(c->addr + order[i] * WL_LINE) = c->addr + order[(i + 1) % lines] * WL_LINE;
+    free(order);
+}
+
+// Touches every page once (every huge page for THP) and records the time
+// each first touch took
+static void first_touch(Worker* w, Chunk* c, size_t step) {
+    for (size_t off = 0; off < c->len && !g_stop; off += step) {
+        unsigned long long start = now_ns();
+        c->addr[off] = 1;
+        unsigned long long elapsed = now_ns() - start;
+        __atomic_fetch_add(&w->faults, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&w->fault_ns, elapsed, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&w->fault_hist[log2_bucket(elapsed)], 1, __ATOMIC_RELAXED);
+    }
+}
+
+static int map_chunk(Worker* w, size_t len) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    Chunk c;
+
+    if (w->num_chunks == WL_MAX_CHUNKS) return -1;
+    if (g_config.pattern == PATTERN_THP) {
+        // Over-map and trim so the chunk is huge-page aligned
+        len = (len + WL_HUGE_PAGE - 1) & ~(WL_HUGE_PAGE - 1);
+        char* raw = mmap(NULL, len + WL_HUGE_PAGE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) return -1;
+        char* aligned = (char*)(((unsigned long)raw + WL_HUGE_PAGE - 1) & ~(WL_HUGE_PAGE - 1));
+        if (aligned > raw) munmap(raw, aligned - raw);
+        munmap(aligned + len, raw + WL_HUGE_PAGE - aligned);
+        madvise(aligned, len, MADV_HUGEPAGE);
+        c.addr = aligned;
+    } else {
+        c.addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (c.addr == MAP_FAILED) return -1;
+    }
+    c.len = len;
+
+    first_touch(w, &c, g_config.pattern == PATTERN_THP ? WL_HUGE_PAGE : page);
+    if (g_config.pattern == PATTERN_CHASE) build_chase(w, &c);
+    w->chunks[w->num_chunks++] = c;
+    __atomic_fetch_add(&w->mapped, len, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// One slice of the access pattern over a random chunk, or the next stretch
+// of the strided walk over all of them; returns bytes touched
+static size_t run_slice(Worker* w) {
+    Chunk* c = &w->chunks[xorshift(&w->rng) % w->num_chunks];
+    size_t slice = c->len < WL_SLICE_BYTES ? c->len : WL_SLICE_BYTES;
+    size_t base = c->len > slice ? (xorshift(&w->rng) % (c->len / slice)) * slice : 0;
+    unsigned long long sum = 0;
+    size_t bytes = 0;
+
+    switch (g_config.pattern) {
+        case PATTERN_SEQ:
+        case PATTERN_THP: {
+            unsigned long long* p = (unsigned long long*)(c->addr + base);
+            for (size_t i = 0; i < slice / sizeof(*p); i++) {
+                sum += p[i];
+                p[i] = sum;
+            }
+            bytes = slice;
+            break;
+        }
+        case PATTERN_RANDOM:
+            for (size_t i = 0; i < slice / WL_LINE; i++) {
+                char* line = c->addr + (xorshift(&w->rng) % (c->len / WL_LINE)) * WL_LINE;
+                sum += *(unsigned long long*)line;
+                *(unsigned long long*)line = sum;
+            }
+            bytes = slice;
+            break;
+        case PATTERN_STRIDED:
+            // One access per line's worth of slice, continuing across chunk
+            // boundaries, so successive slices cover the whole working set
+            for (size_t i = 0; i < slice / WL_LINE; i++) {
+                Chunk* s = &w->chunks[w->stride_chunk];
+                sum += *(unsigned long long*)(s->addr + w->stride_off);
+                bytes += g_config.stride < WL_LINE ? g_config.stride : WL_LINE;
+                w->stride_off += g_config.stride;
+                if (w->stride_off >= s->len) {
+                    w->stride_off = 0;
+                    w->stride_chunk = (w->stride_chunk + 1) % w->num_chunks;
+                }
+            }
+            break;
+        case PATTERN_CHASE: {
+            size_t hops = slice / WL_LINE;
+            char* p = c->addr + base;
+            unsigned long long start = now_ns();
+            for (size_t i = 0; i < hops; i++) p = *(char**)p;
+            __atomic_fetch_add(&w->chase_ns, now_ns() - start, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&w->chase_hops, hops, __ATOMIC_RELAXED);
+            sum = (unsigned long long)p;
+            bytes = hops * WL_LINE;
+            break;
+        }
+        case PATTERN_MADVISE: {
+            // Drop the slice and fault it straight back in
+            size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            madvise(c->addr + base, slice, MADV_DONTNEED);
+            __atomic_fetch_add(&w->madvise_calls, 1, __ATOMIC_RELAXED);
+            Chunk refault = { c->addr + base, slice };
+            first_touch(w, &refault, page);
+            bytes = slice;
+            break;
+        }
+    }
+    g_sink += sum;
+    return bytes;
+}
+
+static void* worker_main(void* arg) {
+    Worker* w = arg;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t share = g_config.target_bytes / g_config.threads / page * page;
+    unsigned long long next_alloc = now_ns();
+
+    while (!g_stop) {
+        unsigned long long now = now_ns();
+        // The last chunk is cut to what is left of the share, so a chunk
+        // larger than the share still maps something
+        if (w->mapped < share && now >= next_alloc) {
+            size_t len = share - w->mapped < g_config.chunk_bytes ? share - w->mapped : g_config.chunk_bytes;
+            if (map_chunk(w, len) != 0) {
+                fprintf(stderr, "vmd_workload: thread %d failed to map a chunk\n", w->id);
+                share = w->mapped;
+            }
+            next_alloc = now + (unsigned long long)g_config.interval_ms * 1000000ULL;
+            continue;
+        }
+        if (w->num_chunks == 0) {
+            usleep(1000);
+            continue;
+        }
+        __atomic_fetch_add(&w->bytes_accessed, run_slice(w), __ATOMIC_RELAXED);
+    }
+
+    for (int i = 0; i < w->num_chunks; i++) munmap(w->chunks[i].addr, w->chunks[i].len);
+    return NULL;
+}
+
+static size_t read_rss(void) {
+    unsigned long size, resident;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f == NULL) return 0;
+    int ok = fscanf(f, "%lu %lu", &size, &resident) == 2;
+    fclose(f);
+    return ok ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+static double hist_quantile_us(const unsigned long long* hist, unsigned long long total, double fraction) {
+    unsigned long long target = (unsigned long long)(total * fraction);
+    unsigned long long seen = 0;
+    for (int b = 0; b < WL_HIST_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen > target) return (double)(2ULL << b) / 1000.0;
+    }
+    return 0;
+}
+
+typedef struct {
+    unsigned long long bytes;
+    unsigned long long hops;
+    unsigned long long chase_ns;
+    unsigned long long faults;
+    unsigned long long fault_ns;
+    unsigned long long madvise_calls;
+    unsigned long long hist[WL_HIST_BUCKETS];
+    size_t mapped;
+} Totals;
+
+static void collect_totals(Totals* t) {
+    memset(t, 0, sizeof(*t));
+    for (int i = 0; i < g_config.threads; i++) {
+        Worker* w = &g_workers[i];
+        t->bytes += __atomic_load_n(&w->bytes_accessed, __ATOMIC_RELAXED);
+        t->hops += __atomic_load_n(&w->chase_hops, __ATOMIC_RELAXED);
+        t->chase_ns += __atomic_load_n(&w->chase_ns, __ATOMIC_RELAXED);
+        t->faults += __atomic_load_n(&w->faults, __ATOMIC_RELAXED);
+        t->fault_ns += __atomic_load_n(&w->fault_ns, __ATOMIC_RELAXED);
+        t->madvise_calls += __atomic_load_n(&w->madvise_calls, __ATOMIC_RELAXED);
+        t->mapped += __atomic_load_n(&w->mapped, __ATOMIC_RELAXED);
+        for (int b = 0; b < WL_HIST_BUCKETS; b++)
+            t->hist[b] += __atomic_load_n(&w->fault_hist[b], __ATOMIC_RELAXED);
+    }
+}
+
+// Bandwidth and fault figures cover the interval since the previous report;
+// the fault percentiles are cumulative
+static void print_report(const Totals* now, const Totals* prev, size_t rss, double interval_s,
+                         double elapsed_s, int final) {
+    unsigned long long faults = now->faults - prev->faults;
+    unsigned long long hops = now->hops - prev->hops;
+
+    printf("{\"elapsed_s\": %.2f, \"pattern\": \"%s\", \"threads\": %d, \"rss\": %zu, \"mapped\": %zu, "
+           "\"target\": %zu, \"bandwidth_mb_s\": %.1f, \"chase_ns_per_hop\": %.2f, \"madvise_calls\": %llu, "
+           "\"faults\": %llu, \"fault_rate\": %.1f, \"fault_us\": {\"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f}%s}\n",
+           elapsed_s, g_pattern_names[g_config.pattern], g_config.threads, rss, now->mapped,
+           g_config.target_bytes, interval_s > 0 ? (now->bytes - prev->bytes) / interval_s / (1 << 20) : 0.0,
+           hops ? (double)(now->chase_ns - prev->chase_ns) / hops : 0.0, now->madvise_calls,
+           now->faults, interval_s > 0 ? faults / interval_s : 0.0,
+           faults ? (now->fault_ns - prev->fault_ns) / 1000.0 / faults : 0.0,
+           hist_quantile_us(now->hist, now->faults, 0.50), hist_quantile_us(now->hist, now->faults, 0.99),
+           final ? ", \"final\": true" : "");
+    fflush(stdout);
+}
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  -p, --pattern NAME     seq, random, strided, chase, thp or madvise (default seq)\n");
+    printf("  -t, --threads N        worker threads (default 1)\n");
+    printf("  -c, --chunk-mb N       size of each mapped chunk (default 16)\n");
+    printf("  -m, --target-mb N      total RSS to build up to, split across threads (default 256)\n");
+    printf("  -i, --interval-ms N    delay between chunk allocations per thread (default 0)\n");
+    printf("  -s, --stride N         bytes between accesses for the strided pattern, which walks\n");
+    printf("                         every mapped chunk in turn (default 4096)\n");
+    printf("  -d, --duration S       stop after S seconds, 0 runs until SIGINT/SIGTERM (default 0)\n");
+    printf("  -r, --report-ms N      report interval (default 1000)\n");
+    printf("  -S, --seed N           random seed for reproducible runs (default 1)\n");
+}
+
+static int parse_pattern(const char* name, Pattern* pattern) {
+    for (size_t i = 0; i < sizeof(g_pattern_names) / sizeof(g_pattern_names[0]); i++) {
+        if (strcmp(name, g_pattern_names[i]) == 0) {
+            *pattern = (Pattern)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    static const struct option options[] = {
+        { "pattern", required_argument, NULL, 'p' },
+        { "threads", required_argument, NULL, 't' },
+        { "chunk-mb", required_argument, NULL, 'c' },
+        { "target-mb", required_argument, NULL, 'm' },
+        { "interval-ms", required_argument, NULL, 'i' },
+        { "stride", required_argument, NULL, 's' },
+        { "duration", required_argument, NULL, 'd' },
+        { "report-ms", required_argument, NULL, 'r' },
+        { "seed", required_argument, NULL, 'S' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "p:t:c:m:i:s:d:r:S:h", options, NULL)) != -1) {
+        switch (opt) {
+            case 'p':
+                if (parse_pattern(optarg, &g_config.pattern) != 0) {
+                    fprintf(stderr, "Unknown pattern: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't': g_config.threads = atoi(optarg); break;
+            case 'c': g_config.chunk_bytes = strtoull(optarg, NULL, 10) << 20; break;
+            case 'm': g_config.target_bytes = strtoull(optarg, NULL, 10) << 20; break;
+            case 'i': g_config.interval_ms = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 's': g_config.stride = strtoull(optarg, NULL, 10); break;
+            case 'd': g_config.duration_s = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'r': g_config.report_ms = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'S': g_config.seed = strtoul(optarg, NULL, 10); break;
+            case 'h': usage(argv[0]); return 0;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (g_config.threads < 1 || g_config.threads > WL_MAX_THREADS || g_config.chunk_bytes == 0 ||
+        g_config.stride < sizeof(unsigned long long) || g_config.report_ms == 0) {
+        fprintf(stderr, "Invalid options\n");
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    int started = 0;
+    for (int i = 0; i < g_config.threads; i++) {
+        Worker* w = &g_workers[i];
+        w->id = i;
+        w->rng = (g_config.seed + 1) * 0x9E3779B97F4A7C15ULL + (unsigned long long)i * 0xBF58476D1CE4E5B9ULL;
+        if (pthread_create(&w->thread, NULL, worker_main, w) != 0) break;
+        started++;
+    }
+    g_config.threads = started;
+
+    unsigned long long start = now_ns();
+    unsigned long long last = start;
+    Totals prev, now;
+    memset(&prev, 0, sizeof(prev));
+    while (!g_stop) {
+        usleep(g_config.report_ms * 1000);
+        unsigned long long t = now_ns();
+        collect_totals(&now);
+        print_report(&now, &prev, read_rss(), (t - last) / 1e9, (t - start) / 1e9, 0);
+        prev = now;
+        last = t;
+        if (g_config.duration_s && t - start >= g_config.duration_s * 1000000000ULL) g_stop = 1;
+    }
+
+    // Final line covers the whole run, with RSS taken before the workers unmap
+    size_t rss = read_rss();
+    for (int i = 0; i < started; i++) pthread_join(g_workers[i].thread, NULL);
+
+    unsigned long long end = now_ns();
+    collect_totals(&now);
+    memset(&prev, 0, sizeof(prev));
+    print_report(&now, &prev, rss, (end - start) / 1e9, (end - start) / 1e9, 1);
+    return 0;
+}